@@ -50,3 +50,44 @@ This generates a gif with the callgraph of p.
 
 Note that if you needed to strip the program, it's still possible
 to use pprof if you call it on the unstripped version.
+
+<h2>Sampling PHP stacks</h2>
+
+The server has its own sampling profiler that needs no special build and is
+cheap enough to leave on. It samples the PHP call stack of each request thread
+100 times per second of the thread's CPU time (Debug.SamplingProfiler in
+options.compiled has the settings). Run
+
+  GET http://[server]:9999/prof-sample-on
+
+and later
+
+  GET http://[server]:9999/prof-sample-dump > stacks.folded
+
+Each line is one distinct stack, root first, followed by how many times it was
+sampled. flamegraph.pl turns it into a flame graph:
+
+  flamegraph.pl stacks.folded > stacks.svg
+
+prof-sample-clear discards what was collected so far, and prof-sample-off stops
+sampling.
+
+<h2>Sampling request memory</h2>
+
+To find out which PHP code allocates the memory that requests use, turn on the
+allocation profiler (Debug.AllocationProfiler in options.compiled):
+
+  GET http://[server]:9999/prof-alloc-on
+
+and later
+
+  GET http://[server]:9999/prof-alloc-dump > alloc.folded
+
+About once every 512KB of smart-allocated memory, the PHP stack doing the
+allocation is charged with 512KB. Each line is one URL and stack, the URL as
+the root frame, followed by the bytes sampled there, so
+
+  flamegraph.pl alloc.folded > alloc.svg
+
+shows memory by page first and by code path under it. Only memory coming from
+SmartAllocator is seen; string buffers and memory extensions malloc() are not.
@@ -0,0 +1,123 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <compiler/analysis/escape_analysis.h>
+#include <compiler/analysis/analysis_result.h>
+#include <compiler/analysis/block_scope.h>
+#include <compiler/analysis/type.h>
+#include <compiler/analysis/variable_table.h>
+#include <compiler/expression/simple_variable.h>
+#include <compiler/statement/foreach_statement.h>
+#include <compiler/statement/method_statement.h>
+#include <compiler/statement/statement_list.h>
+
+using namespace HPHP;
+using namespace std;
+using namespace boost;
+
+///////////////////////////////////////////////////////////////////////////////
+
+int EscapeAnalysis::StackArrayCount = 0;
+int EscapeAnalysis::BorrowedArrayCount = 0;
+
+int EscapeAnalysis::analyze(AnalysisResultPtr ar, MethodStatementPtr m) {
+  StatementListPtr stmts = m->getStmts();
+  if (!stmts) return 0;
+  m_variables = ar->getScope()->getVariables();
+  m_canBorrow =
+    !m_variables->getAttribute(VariableTable::ContainsDynamicVariable) &&
+    !m_variables->getAttribute(VariableTable::ContainsExtract) &&
+    !HasDynamicAccess(stmts);
+  return mark(stmts);
+}
+
+int EscapeAnalysis::mark(ConstructPtr c) {
+  if (!c) return 0;
+  int count = 0;
+  for (int i = 0, n = c->getKidCount(); i < n; i++) {
+    count += mark(c->getNthKid(i));
+  }
+
+  ForEachStatementPtr loop = dynamic_pointer_cast<ForEachStatement>(c);
+  if (!loop || loop->isRef() ||
+      loop->isStackArray() || loop->isBorrowedArray()) {
+    return count;
+  }
+  ExpressionPtr array = loop->getArrayExp();
+  TypePtr type = array->getActualType();
+  if (!type || !type->is(Type::KindOfArray)) return count;
+
+  if (!array->is(Expression::KindOfSimpleVariable)) {
+    loop->setStackArray();
+    StackArrayCount++;
+    count++;
+  } else if (canBorrow(loop)) {
+    loop->setBorrowedArray();
+    BorrowedArrayCount++;
+    count++;
+  }
+  return count;
+}
+
+bool EscapeAnalysis::canBorrow(ForEachStatementPtr loop) {
+  if (!m_canBorrow) return false;
+  SimpleVariablePtr var =
+    static_pointer_cast<SimpleVariable>(loop->getArrayExp());
+  const string &name = var->getName();
+  if (var->isThis() || var->isSuperGlobal()) return false;
+  if (!m_variables->isLocal(name) && !m_variables->isParameter(name)) {
+    return false;
+  }
+  if (!m_variables->getFinalType(name)->is(Type::KindOfArray)) return false;
+
+  return !IsWritten(loop->getNameExp(), name) &&
+    !IsWritten(loop->getValueExp(), name) &&
+    !IsWritten(loop->getBody(), name);
+}
+
+bool EscapeAnalysis::HasDynamicAccess(ConstructPtr c) {
+  if (!c) return false;
+  ExpressionPtr e = dynamic_pointer_cast<Expression>(c);
+  if (e && (e->is(Expression::KindOfIncludeExpression) ||
+            e->is(Expression::KindOfDynamicVariable))) {
+    return true;
+  }
+  for (int i = 0, n = c->getKidCount(); i < n; i++) {
+    if (HasDynamicAccess(c->getNthKid(i))) return true;
+  }
+  return false;
+}
+
+bool EscapeAnalysis::IsWritten(ConstructPtr c, const string &name) {
+  if (!c) return false;
+  SimpleVariablePtr var = dynamic_pointer_cast<SimpleVariable>(c);
+  if (var) {
+    if (var->getName() == name &&
+        (var->getContext() & (Expression::LValue |
+                              Expression::RefValue |
+                              Expression::RefParameter |
+                              Expression::UnsetContext |
+                              Expression::OprLValue |
+                              Expression::InvokeArgument |
+                              Expression::DeepReference))) {
+      return true;
+    }
+  }
+  for (int i = 0, n = c->getKidCount(); i < n; i++) {
+    if (IsWritten(c->getNthKid(i), name)) return true;
+  }
+  return false;
+}
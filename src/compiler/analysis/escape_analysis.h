@@ -0,0 +1,70 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __ESCAPE_ANALYSIS_H__
+#define __ESCAPE_ANALYSIS_H__
+
+#include <compiler/expression/expression.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+DECLARE_BOOST_TYPES(MethodStatement);
+DECLARE_BOOST_TYPES(ForEachStatement);
+DECLARE_BOOST_TYPES(VariableTable);
+
+/**
+ * Finds the arrays foreach iterates over that never leave the function, so
+ * that code generation can skip the refcounting and heap allocation that
+ * come with them:
+ *
+ *   - a temporary array, like a literal or what a function returns, is
+ *     kept in an Array on the stack and walked by an ArrayIter on the stack,
+ *     instead of going into a Variant and a heap-allocated iterator;
+ *   - a local (or parameter) whose type is Array, and that the loop never
+ *     assigns, unsets, or passes or takes by reference, is walked by an
+ *     ArrayIter that holds no reference of its own. Nothing else can reach
+ *     a local, unless the function has dynamic variables, extract() or
+ *     include, and we leave those alone.
+ */
+class EscapeAnalysis {
+public:
+  /**
+   * Loops optimized so far, over all functions.
+   */
+  static int StackArrayCount;
+  static int BorrowedArrayCount;
+
+  /**
+   * Returns the number of loops marked in this function.
+   */
+  int analyze(AnalysisResultPtr ar, MethodStatementPtr m);
+
+private:
+  VariableTablePtr m_variables;
+  bool m_canBorrow;
+
+  int mark(ConstructPtr c);
+  bool canBorrow(ForEachStatementPtr loop);
+
+  static bool HasDynamicAccess(ConstructPtr c);
+  static bool IsWritten(ConstructPtr c, const std::string &name);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __ESCAPE_ANALYSIS_H__
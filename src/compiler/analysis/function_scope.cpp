@@ -504,9 +504,14 @@ void FunctionScope::setReturnType(AnalysisResultPtr ar, TypePtr type) {
   // no change can be made to virtual function's prototype
   if (m_overriding) return;
 
+  // an overriding method may return arrays of something else, and nothing
+  // would check that at run time
+  if (m_method && type->getElementType()) type = Type::Array;
+
   if (m_returnType) {
     type = Type::Coerce(ar, m_returnType, type);
-    if (type && !Type::SameType(m_returnType, type)) {
+    if (type && (!Type::SameType(m_returnType, type) ||
+                 !Type::SameElementType(m_returnType, type))) {
       ar->incNewlyInferred();
       if (!ar->isFirstPass()) {
         Logger::Verbose("Corrected function return type %s -> %s",
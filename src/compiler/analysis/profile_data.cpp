@@ -0,0 +1,134 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <compiler/analysis/profile_data.h>
+#include <compiler/option.h>
+#include <util/logger.h>
+#include <util/util.h>
+#include <fstream>
+
+using namespace HPHP;
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+
+ProfileData ProfileData::TheProfileData;
+
+bool ProfileData::load(const char *filename) {
+  ifstream f(filename);
+  if (f.fail()) {
+    Logger::Error("Unable to open profile data %s", filename);
+    return false;
+  }
+  ostringstream text;
+  text << f.rdbuf();
+  int64 total = m_total;
+  loadFromString(text.str());
+  Logger::Info("Loaded %lld samples from %s",
+               (long long)(m_total - total), filename);
+  return true;
+}
+
+void ProfileData::loadFromString(const string &text) {
+  vector<string> lines;
+  Util::split('\n', text.c_str(), lines, true);
+  for (unsigned int i = 0; i < lines.size(); i++) {
+    const string &line = lines[i];
+    size_t space = line.rfind(' ');
+    if (space == string::npos || space == 0) continue;
+    int64 count = atoll(line.c_str() + space + 1);
+    if (count <= 0) continue;
+
+    vector<string> frames;
+    Util::split(';', line.substr(0, space).c_str(), frames, true);
+    if (!frames.empty()) addStack(frames, count);
+  }
+}
+
+void ProfileData::addStack(const vector<string> &frames, int64 count) {
+  m_total += count;
+
+  // recursion puts a function on the stack more than once, but the sample
+  // was still spent in it only once
+  set<string> seen;
+  string caller;
+  for (unsigned int i = 0; i < frames.size(); i++) {
+    string func = Util::toLower(frames[i]);
+    m_names.insert(frames[i]);
+    if (seen.insert(func).second) {
+      m_inclusive[func] += count;
+    }
+    if (!caller.empty()) {
+      m_calls[caller + ";" + func] += count;
+    }
+    caller = func;
+  }
+  m_self[caller] += count;
+}
+
+int64 ProfileData::Find(const FunctionCountMap &counts, const string &key) {
+  FunctionCountMap::const_iterator iter = counts.find(key);
+  return iter == counts.end() ? 0 : iter->second;
+}
+
+int64 ProfileData::getInclusive(const string &func) const {
+  return Find(m_inclusive, Util::toLower(func));
+}
+
+int64 ProfileData::getSelf(const string &func) const {
+  return Find(m_self, Util::toLower(func));
+}
+
+int64 ProfileData::getCalls(const string &caller, const string &callee) const {
+  return Find(m_calls, Util::toLower(caller) + ";" + Util::toLower(callee));
+}
+
+bool ProfileData::isHot(int64 count) const {
+  return count > 0 && count * 100.0 >= m_total * Option::HotFunctionPercent;
+}
+
+bool ProfileData::isHot(const string &func) const {
+  return isHot(getInclusive(func));
+}
+
+bool ProfileData::isHotCall(const string &caller, const string &callee) const {
+  return isHot(getCalls(caller, callee));
+}
+
+int ProfileData::assignFunctionSections() {
+  if (Option::HotFunctionSection.empty()) return 0;
+
+  // FunctionSections is keyed by the names as written, and so are the
+  // frames we sampled, so those are what we put in
+  set<string> configured;
+  for (map<string, string>::const_iterator iter =
+         Option::FunctionSections.begin();
+       iter != Option::FunctionSections.end(); ++iter) {
+    if (!iter->second.empty()) configured.insert(Util::toLower(iter->first));
+  }
+
+  int placed = 0;
+  for (set<string>::const_iterator iter = m_names.begin();
+       iter != m_names.end(); ++iter) {
+    string func = Util::toLower(*iter);
+    if (isHot(Find(m_inclusive, func)) &&
+        configured.find(func) == configured.end()) {
+      Option::FunctionSections[*iter] = Option::HotFunctionSection;
+      placed++;
+    }
+  }
+  return placed;
+}
@@ -0,0 +1,88 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __PROFILE_DATA_H__
+#define __PROFILE_DATA_H__
+
+#include <compiler/hphp.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Production profile fed back into compilation. The input is what the
+ * server's sampling profiler dumps from the admin port ("prof-sample-dump"):
+ * one "root;caller;callee count" line per distinct PHP stack. Frame names are
+ * the original function names ("foo", "Cls::bar") that code generation also
+ * uses for FunctionSections, so both match without any mapping.
+ *
+ * From those lines we keep, per function, how many samples it was on the
+ * stack (inclusive) and on top of it (self), and for each caller/callee pair
+ * how many samples went through that call.
+ */
+class ProfileData {
+public:
+  static ProfileData TheProfileData;
+
+public:
+  ProfileData() : m_total(0) {}
+
+  /**
+   * Adds up samples from one dump; loading several dumps, say from
+   * different machines, merges them.
+   */
+  bool load(const char *filename);
+  void loadFromString(const std::string &text);
+
+  bool isLoaded() const { return m_total > 0;}
+  int64 getTotal() const { return m_total;}
+
+  int64 getInclusive(const std::string &func) const;
+  int64 getSelf(const std::string &func) const;
+  int64 getCalls(const std::string &caller, const std::string &callee) const;
+
+  /**
+   * Hot means on the stack in at least Option::HotFunctionPercent of all
+   * samples. Nothing is hot without a profile.
+   */
+  bool isHot(const std::string &func) const;
+  bool isHotCall(const std::string &caller, const std::string &callee) const;
+
+  /**
+   * Puts hot functions into Option::HotFunctionSection, unless
+   * FunctionSections already names a section for them. Returns how many
+   * functions were placed.
+   */
+  int assignFunctionSections();
+
+private:
+  typedef hphp_string_map<int64> FunctionCountMap; // lower-cased names
+
+  int64 m_total;
+  FunctionCountMap m_inclusive;
+  FunctionCountMap m_self;
+  FunctionCountMap m_calls; // "caller;callee"
+  std::set<std::string> m_names; // as they were sampled
+
+  void addStack(const std::vector<std::string> &frames, int64 count);
+  bool isHot(int64 count) const;
+  static int64 Find(const FunctionCountMap &counts, const std::string &key);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __PROFILE_DATA_H__
@@ -0,0 +1,128 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <compiler/analysis/shape_analysis.h>
+#include <compiler/expression/array_element_expression.h>
+#include <compiler/expression/array_pair_expression.h>
+#include <compiler/expression/assignment_expression.h>
+#include <compiler/expression/expression_list.h>
+#include <compiler/expression/scalar_expression.h>
+#include <compiler/expression/simple_variable.h>
+#include <compiler/expression/unary_op_expression.h>
+#include <compiler/statement/method_statement.h>
+#include <compiler/statement/return_statement.h>
+#include <compiler/statement/statement_list.h>
+#include <compiler/parser/hphp.tab.hpp>
+#include <runtime/base/array/shaped_array.h>
+#include <util/hash.h>
+
+using namespace HPHP;
+using namespace std;
+using namespace boost;
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool ShapeAnalysis::IsShapeKey(ExpressionPtr key) {
+  ScalarExpressionPtr sc = dynamic_pointer_cast<ScalarExpression>(key);
+  if (!sc || !sc->isLiteralString()) return false;
+  string s = sc->getLiteralString();
+  int64 res;
+  return !is_strictly_integer(s.c_str(), s.size(), res);
+}
+
+ExpressionListPtr ShapeAnalysis::GetRecordLiteral(ExpressionPtr e) {
+  if (!e || !e->is(Expression::KindOfUnaryOpExpression)) {
+    return ExpressionListPtr();
+  }
+  UnaryOpExpressionPtr u = static_pointer_cast<UnaryOpExpression>(e);
+  if (u->getOp() != T_ARRAY) return ExpressionListPtr();
+  ExpressionListPtr pairs =
+    dynamic_pointer_cast<ExpressionList>(u->getExpression());
+  if (!pairs || pairs->getCount() == 0 ||
+      pairs->getCount() > ShapedArray::MaxSize) {
+    return ExpressionListPtr();
+  }
+  for (int i = 0; i < pairs->getCount(); i++) {
+    ArrayPairExpressionPtr ap =
+      dynamic_pointer_cast<ArrayPairExpression>((*pairs)[i]);
+    if (!ap || ap->isRef() || !IsShapeKey(ap->getName())) {
+      return ExpressionListPtr();
+    }
+  }
+  return pairs;
+}
+
+int ShapeAnalysis::analyze(MethodStatementPtr m) {
+  m_unshaped.clear();
+  StatementListPtr stmts = m->getStmts();
+  if (!stmts) return 0;
+  collect(stmts);
+  return mark(stmts);
+}
+
+void ShapeAnalysis::collect(ConstructPtr c) {
+  if (!c) return;
+  for (int i = 0, n = c->getKidCount(); i < n; i++) {
+    collect(c->getNthKid(i));
+  }
+
+  ExpressionPtr e = dynamic_pointer_cast<Expression>(c);
+  if (!e) return;
+  if (e->is(Expression::KindOfSimpleVariable)) {
+    // a reference can change the array behind our back, and a foreach by
+    // reference escalates it anyway
+    if (e->hasContext(Expression::RefValue) ||
+        e->hasContext(Expression::RefParameter)) {
+      m_unshaped.insert(static_pointer_cast<SimpleVariable>(e)->getName());
+    }
+  } else if (e->is(Expression::KindOfArrayElementExpression)) {
+    ArrayElementExpressionPtr ae =
+      static_pointer_cast<ArrayElementExpression>(e);
+    ExpressionPtr var = ae->getVariable();
+    if (!var->is(Expression::KindOfSimpleVariable)) return;
+    ExpressionPtr offset = ae->getOffset();
+    if (!offset || ae->hasContext(Expression::UnsetContext) ||
+        (ae->hasContext(Expression::LValue) && !IsShapeKey(offset))) {
+      m_unshaped.insert(static_pointer_cast<SimpleVariable>(var)->getName());
+    }
+  }
+}
+
+int ShapeAnalysis::mark(ConstructPtr c) {
+  if (!c) return 0;
+  int count = 0;
+  for (int i = 0, n = c->getKidCount(); i < n; i++) {
+    count += mark(c->getNthKid(i));
+  }
+
+  ExpressionListPtr pairs;
+  if (ReturnStatementPtr r = dynamic_pointer_cast<ReturnStatement>(c)) {
+    pairs = GetRecordLiteral(r->getRetExp());
+  } else if (AssignmentExpressionPtr a =
+             dynamic_pointer_cast<AssignmentExpression>(c)) {
+    ExpressionPtr var = a->getVariable();
+    if (var->is(Expression::KindOfSimpleVariable) &&
+        !m_unshaped.count(static_pointer_cast<SimpleVariable>(var)->
+                          getName())) {
+      pairs = GetRecordLiteral(a->getValue());
+    }
+  }
+  if (pairs) {
+    pairs->setShaped();
+    count++;
+  }
+  return count;
+}
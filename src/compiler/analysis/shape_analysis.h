@@ -0,0 +1,58 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __SHAPE_ANALYSIS_H__
+#define __SHAPE_ANALYSIS_H__
+
+#include <compiler/expression/expression.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+DECLARE_BOOST_TYPES(MethodStatement);
+DECLARE_BOOST_TYPES(ExpressionList);
+
+/**
+ * Picks the array literals that are built as a ShapedArray: those with at
+ * most ShapedArray::MaxSize elements, all keyed by string literals, that a
+ * function returns or assigns to a local. A local disqualifies its literals
+ * when the function appends to it, writes or unsets a key of it that is not
+ * a string literal, unsets any of its keys, or takes a reference to it.
+ *
+ * None of this is needed for correctness, since a ShapedArray escalates by
+ * itself; it only keeps us from building arrays that are bound to escalate.
+ */
+class ShapeAnalysis {
+public:
+  static bool IsShapeKey(ExpressionPtr key);
+  static ExpressionListPtr GetRecordLiteral(ExpressionPtr e);
+
+  /**
+   * Returns the number of literals marked.
+   */
+  int analyze(MethodStatementPtr m);
+
+private:
+  std::set<std::string> m_unshaped;
+
+  void collect(ConstructPtr c);
+  int mark(ConstructPtr c);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __SHAPE_ANALYSIS_H__
@@ -118,7 +118,8 @@ TypePtr SymbolTable::coerceTo(AnalysisResultPtr ar,
   }
 
   TypePtr newType = Type::Coerce(ar, iter->second, type);
-  if (!Type::SameType(iter->second, newType)) {
+  if (!Type::SameType(iter->second, newType) ||
+      !Type::SameElementType(iter->second, newType)) {
     iter->second = newType;
   }
   return newType;
@@ -137,7 +138,8 @@ TypePtr SymbolTable::setType(AnalysisResultPtr ar, const std::string &name,
     TypePtr ret = coerceTo(ar, coerced? m_coerced : m_rtypes, name, type);
     TypePtr newType = getType(name, true);
     if (!newType) newType = NEW_TYPE(Some);
-    if (!Type::SameType(oldType, newType)) {
+    if (!Type::SameType(oldType, newType) ||
+        !Type::SameElementType(oldType, newType)) {
       ar->incNewlyInferred();
     }
     return newType;
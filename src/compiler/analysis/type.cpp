@@ -41,6 +41,32 @@ TypePtr Type::CreateObjectType(const std::string &classname) {
   return TypePtr(new Type(KindOfObject, classname));
 }
 
+TypePtr Type::CreateArrayType(TypePtr elementType) {
+  TypePtr element;
+  if (elementType->isInteger()) {
+    element = Type::Int64; // they are all int64 once stored
+  } else {
+    switch (elementType->m_kindOf) {
+    case KindOfBoolean:
+    case KindOfDouble:
+    case KindOfString:
+    case KindOfSome:
+      element = elementType;
+      break;
+    case KindOfObject:
+      if (!elementType->m_name.empty()) element = elementType;
+      break;
+    default:
+      break;
+    }
+  }
+  if (!element) return Type::Array;
+
+  TypePtr type(new Type(KindOfArray));
+  type->m_elementType = element;
+  return type;
+}
+
 TypePtr Type::GetType(KindOf kindOf) {
   switch (kindOf) {
   case KindOfBoolean:     return Type::Boolean;
@@ -181,7 +207,20 @@ bool Type::IsCoercionNeeded(AnalysisResultPtr ar, TypePtr t1, TypePtr t2) {
   return !Type::IsLegalCast(ar, t1, t2);
 }
 
+TypePtr Type::CoerceArrays(TypePtr type1, TypePtr type2) {
+  TypePtr element1 = type1->m_elementType;
+  TypePtr element2 = type2->m_elementType;
+  if (!element1 || !element2) return Type::Array;
+  if (element1->is(KindOfSome)) return type2;
+  if (element2->is(KindOfSome)) return type1;
+  if (SameType(element1, element2)) return type1;
+  return Type::Array;
+}
+
 TypePtr Type::Coerce(AnalysisResultPtr ar, TypePtr type1, TypePtr type2) {
+  if (type1->m_kindOf == KindOfArray && type2->m_kindOf == KindOfArray) {
+    return CoerceArrays(type1, type2);
+  }
   if (SameType(type1, type2)) return type1;
   if (type1->m_kindOf == KindOfVariant ||
       type2->m_kindOf == KindOfVariant) return Type::Variant;
@@ -214,6 +253,9 @@ TypePtr Type::Coerce(AnalysisResultPtr ar, TypePtr type1, TypePtr type2) {
 }
 
 TypePtr Type::Union(AnalysisResultPtr ar, TypePtr type1, TypePtr type2) {
+  if (type1->m_kindOf == KindOfArray && type2->m_kindOf == KindOfArray) {
+    return CoerceArrays(type1, type2);
+  }
   if (SameType(type1, type2)) {
     return type1;
   }
@@ -251,6 +293,11 @@ bool Type::SameType(TypePtr type1, TypePtr type2) {
   return false;
 }
 
+bool Type::SameElementType(TypePtr type1, TypePtr type2) {
+  return SameType(type1 ? type1->m_elementType : TypePtr(),
+                  type2 ? type2->m_elementType : TypePtr());
+}
+
 bool Type::IsExactType(KindOf kindOf) {
   // clever trick thanks to mwilliams - this will evaluate
   // to true iff exactly one bit is set in kindOf
@@ -353,6 +400,10 @@ bool Type::isInteger() const {
   return false;
 }
 
+bool Type::hasKnownElementType() const {
+  return m_elementType && !m_elementType->is(KindOfSome);
+}
+
 bool Type::isSpecificObject() const {
   return m_kindOf == KindOfObject && !m_name.empty();
 }
@@ -491,7 +542,9 @@ std::string Type::toString() const {
   case KindOfInt64:       return "Int64";
   case KindOfDouble:      return "Double";
   case KindOfString:      return "String";
-  case KindOfArray:       return "Array";
+  case KindOfArray:
+    if (m_elementType) return "Array<" + m_elementType->toString() + ">";
+    return "Array";
   case KindOfVariant:     return "Variant";
   case KindOfSome:
   case KindOfAny:         return "Any";
@@ -551,7 +604,10 @@ TypePtr Type::Inferred(AnalysisResultPtr ar, TypePtr type1, TypePtr type2) {
   KindOf k1 = type1->m_kindOf;
   KindOf k2 = type2->m_kindOf;
 
-  if (k1 == k2) return type1;
+  if (k1 == k2) {
+    if (k1 == KindOfArray) return CoerceArrays(type1, type2);
+    return type1;
+  }
 
   // If one set is a subset of the other, return the subset.
   if ((k1 & k2) == k1) return type1;
@@ -72,6 +72,15 @@ public:
    */
   static TypePtr CreateObjectType(const std::string &classname);
 
+  /**
+   * Arrays whose values are all known to be of one type: array<Int64>,
+   * array<String> or array<Object - Foo>, say. Any other kind of value,
+   * references included, gives a plain Array. Element types only ever
+   * weaken: merging two arrays that disagree about them gives a plain Array,
+   * and an empty array literal, array<Any>, agrees with everything.
+   */
+  static TypePtr CreateArrayType(TypePtr elementType);
+
   /**
    * For inferred, return static type objects; for uncertain, create new
    * ones.
@@ -118,6 +127,13 @@ public:
    */
   static bool SameType(TypePtr type1, TypePtr type2);
 
+  /**
+   * SameType() does not look at element types, so that no casts are
+   * generated between arrays, but type inference has to, to tell whether
+   * anything has changed.
+   */
+  static bool SameElementType(TypePtr type1, TypePtr type2);
+
   /**
    * Testing type conversion for constants.
    */
@@ -147,6 +163,8 @@ public:
   }
   bool isNoObjectInvolved() const;
   const std::string &getName() const { return m_name;}
+  TypePtr getElementType() const { return m_elementType;}
+  bool hasKnownElementType() const;
   static TypePtr combinedPrimType(TypePtr t1, TypePtr t2);
 
   /**
@@ -190,6 +208,9 @@ public:
 private:
   KindOf m_kindOf;
   std::string m_name;
+  TypePtr m_elementType; // arrays only
+
+  static TypePtr CoerceArrays(TypePtr type1, TypePtr type2);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -538,7 +538,15 @@ void VariableTable::forceVariant(AnalysisResultPtr ar,
 
 TypePtr VariableTable::setType(AnalysisResultPtr ar, const string &name,
                                TypePtr type, bool coerce) {
-  if (m_allVariants) type = Type::Variant;
+  if (m_allVariants) {
+    type = Type::Variant;
+  } else if (type && type->getElementType() &&
+             (!isLocal(name) || isPseudoMainTable())) {
+    // parameters, globals, statics and properties can all be written where
+    // type inference does not see it, so only plain locals keep what is
+    // known about their elements
+    type = Type::Array;
+  }
   TypePtr ret = SymbolTable::setType(ar, name, type, coerce || m_allVariants);
   if (!ret) return ret;
 
@@ -113,6 +113,40 @@ const char *BuiltinSymbols::BaseSysRsrcClasses[] = {
   NULL
 };
 
+/**
+ * Builtins that return arrays of values of one type, which ext_*.idl has no
+ * way to say.
+ */
+static const struct {
+  const char *name;
+  Type::KindOf elementType;
+} s_homogeneousArrayFunctions[] = {
+  { "get_declared_classes",                  Type::KindOfString },
+  { "get_declared_interfaces",               Type::KindOfString },
+  { "get_class_methods",                     Type::KindOfString },
+  { "hash_algos",                            Type::KindOfString },
+  { "headers_list",                          Type::KindOfString },
+  { "mb_list_encodings",                     Type::KindOfString },
+  { "mcrypt_list_algorithms",                Type::KindOfString },
+  { "mcrypt_list_modes",                     Type::KindOfString },
+  { "pdo_drivers",                           Type::KindOfString },
+  { "stream_get_transports",                 Type::KindOfString },
+  { "mcrypt_enc_get_supported_key_sizes",    Type::KindOfInt64  },
+  { "mcrypt_module_get_supported_key_sizes", Type::KindOfInt64  },
+  { "sys_getloadavg",                        Type::KindOfDouble },
+  { NULL, 0 }
+};
+
+static TypePtr homogeneous_array_type(const char *name) {
+  for (int i = 0; s_homogeneousArrayFunctions[i].name; i++) {
+    if (strcmp(s_homogeneousArrayFunctions[i].name, name) == 0) {
+      return Type::CreateArrayType(
+        Type::GetType(s_homogeneousArrayFunctions[i].elementType));
+    }
+  }
+  return Type::Array;
+}
+
 StringToClassScopePtrMap BuiltinSymbols::s_classes;
 VariableTablePtr BuiltinSymbols::s_variables;
 ConstantTablePtr BuiltinSymbols::s_constants;
@@ -265,6 +299,7 @@ FunctionScopePtr BuiltinSymbols::ParseExtFunction(AnalysisResultPtr ar,
   FunctionScopePtr f(new FunctionScope(false, name, reference));
   f->setParamCounts(ar, minParam, maxParam);
   if (retType) {
+    if (retType->is(Type::KindOfArray)) retType = homogeneous_array_type(name);
     f->setReturnType(ar, retType);
   }
 
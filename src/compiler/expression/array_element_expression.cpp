@@ -287,7 +287,15 @@ TypePtr ArrayElementExpression::inferTypes(AnalysisResultPtr ar,
                                    self);
       }
     }
-    m_variable->inferAndCheck(ar, Type::Array, true);
+    TypePtr arrayType = Type::Array;
+    if (coerce && hasContext(AssignmentLHS) &&
+        !hasContext(OprLValue) && !hasContext(RefValue) &&
+        !hasContext(RefParameter) &&
+        !type->is(Type::KindOfSome) && !type->is(Type::KindOfAny)) {
+      // $a[] = value: $a holds whatever type value has
+      arrayType = Type::CreateArrayType(type);
+    }
+    m_variable->inferAndCheck(ar, arrayType, true);
   }
 
   if (varType && Type::SameType(varType, Type::String)) {
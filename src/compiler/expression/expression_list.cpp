@@ -33,7 +33,7 @@ using namespace boost;
 
 ExpressionList::ExpressionList(EXPRESSION_CONSTRUCTOR_PARAMETERS, ListKind kind)
   : Expression(EXPRESSION_CONSTRUCTOR_PARAMETER_VALUES), m_outputCount(-1),
-    m_arrayElements(false), m_kind(kind) {
+    m_arrayElements(false), m_shaped(false), m_kind(kind) {
 }
 
 ExpressionPtr ExpressionList::clone() {
@@ -488,7 +488,8 @@ void ExpressionList::outputCPPInternal(CodeGenerator &cg,
     if (pre) {
       cg_printf(" %s", m_cppTemp.c_str());
     }
-    cg_printf("(%d, %s)", m_exps.size(), isVector ? "true" : "false");
+    cg_printf("(%d, %s%s)", m_exps.size(), isVector ? "true" : "false",
+              m_shaped ? ", false, true" : "");
     if (pre) cg_printf(";\n");
     needsComma = true;
   }
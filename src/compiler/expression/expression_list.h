@@ -57,6 +57,12 @@ public:
 
   bool isScalarArrayPairs() const;
 
+  /**
+   * Array literal used as a record, see ShapeAnalysis.
+   */
+  void setShaped() { m_shaped = true;}
+  bool isShaped() const { return m_shaped;}
+
   int getCount() const { return m_exps.size();}
   ExpressionPtr &operator[](int index);
 
@@ -89,6 +95,7 @@ private:
   ExpressionPtrVec m_exps;
   int m_outputCount;
   bool m_arrayElements;
+  bool m_shaped;
   ListKind m_kind;
 };
 
@@ -126,7 +126,7 @@ TypePtr QOpExpression::inferTypes(AnalysisResultPtr ar, TypePtr type,
     // special case on literal string since String is slower than Variant
     m_expYes->inferAndCheck(ar, typeYes, false);
     m_expNo->inferAndCheck(ar, typeYes, false);
-    return typeYes;
+    return Type::Coerce(ar, typeYes, typeNo); // arrays may still disagree
   }
   else {
     return Type::Variant;
@@ -20,6 +20,7 @@
 #include <compiler/analysis/function_scope.h>
 #include <compiler/analysis/class_scope.h>
 #include <compiler/analysis/code_error.h>
+#include <compiler/analysis/profile_data.h>
 #include <compiler/expression/expression_list.h>
 #include <compiler/statement/statement_list.h>
 #include <compiler/statement/exp_statement.h>
@@ -506,14 +507,24 @@ ExpressionPtr SimpleFunctionCall::optimize(AnalysisResultPtr ar) {
     }
   }
 
-  if (!m_funcScope->getInlineAsExpr() ||
-      !m_funcScope->getStmt() ||
-      m_funcScope->getStmt()->getRecursiveCount() > 10) {
+  if (!m_funcScope->getInlineAsExpr() || !m_funcScope->getStmt()) {
     return ExpressionPtr();
   }
 
   FunctionScopePtr fs = ar->getFunctionScope();
   if (!fs || fs->inPseudoMain()) return ExpressionPtr();
+
+  // a profile only ever raises the budget: samples miss plenty of code
+  // that still runs, and that code must not lose the baseline inlining
+  int maxSize = 10;
+  const ProfileData &profile = ProfileData::TheProfileData;
+  if (profile.isHotCall(fs->getOriginalFullName(),
+                        m_funcScope->getOriginalFullName())) {
+    maxSize = max(maxSize, Option::HotCallInlineSize);
+  }
+  if (m_funcScope->getStmt()->getRecursiveCount() > maxSize) {
+    return ExpressionPtr();
+  }
   VariableTablePtr vt = fs->getVariables();
   int nAct = m_params ? m_params->getCount() : 0;
   int nMax = m_funcScope->getMaxParamCount();
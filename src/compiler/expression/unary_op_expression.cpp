@@ -22,6 +22,7 @@
 #include <compiler/statement/statement_list.h>
 #include <compiler/option.h>
 #include <compiler/expression/expression_list.h>
+#include <compiler/expression/array_pair_expression.h>
 #include <compiler/analysis/function_scope.h>
 #include <compiler/expression/simple_variable.h>
 #include <compiler/analysis/variable_table.h>
@@ -317,6 +318,33 @@ void UnaryOpExpression::setExistContext() {
   }
 }
 
+/**
+ * The one type all values of an array literal have, Any if it has no values
+ * at all, or Variant if they disagree.
+ */
+static TypePtr literal_element_type(ExpressionPtr exp) {
+  TypePtr element = NEW_TYPE(Some);
+  if (!exp) return element;
+  ExpressionListPtr pairs = dynamic_pointer_cast<ExpressionList>(exp);
+  if (!pairs) return Type::Variant;
+  for (int i = 0; i < pairs->getCount(); i++) {
+    ArrayPairExpressionPtr pair =
+      dynamic_pointer_cast<ArrayPairExpression>((*pairs)[i]);
+    if (!pair || pair->isRef()) return Type::Variant;
+    TypePtr type = pair->getValue()->getActualType();
+    if (!type || type->is(Type::KindOfSome) || type->is(Type::KindOfAny)) {
+      return Type::Variant;
+    }
+    if (type->isInteger()) type = Type::Int64;
+    if (element->is(Type::KindOfSome)) {
+      element = type;
+    } else if (!Type::SameType(element, type)) {
+      return Type::Variant;
+    }
+  }
+  return element;
+}
+
 TypePtr UnaryOpExpression::inferTypes(AnalysisResultPtr ar, TypePtr type,
                                       bool coerce) {
   TypePtr et; // expected m_exp's type
@@ -427,6 +455,9 @@ TypePtr UnaryOpExpression::inferTypes(AnalysisResultPtr ar, TypePtr type,
     }
   }
 
+  if (m_op == T_ARRAY) {
+    rt = Type::CreateArrayType(literal_element_type(m_exp));
+  }
   return rt;
 }
 
@@ -150,6 +150,11 @@ std::string Option::RTTIDirectory;
 bool Option::GenRTTIProfileData = false;
 bool Option::UseRTTIProfileData = false;
 
+std::string Option::ProfileDataFile;
+double Option::HotFunctionPercent = 1.0;
+std::string Option::HotFunctionSection = "hot";
+int Option::HotCallInlineSize = 30;
+
 bool Option::GenerateCPPMacros = true;
 bool Option::GenerateCPPMain = false;
 bool Option::GenerateCPPComments = true;
@@ -190,6 +195,8 @@ bool Option::EliminateDeadCode = true;
 bool Option::LocalCopyProp = true;
 bool Option::StringLoopOpts = true;
 bool Option::AutoInline = false;
+bool Option::ArrayShapes = false;
+bool Option::EscapeAnalysis = true;
 
 bool Option::FlAnnotate = false;
 bool Option::SystemGen = false;
@@ -346,6 +353,13 @@ void Option::Load(Hdf &config) {
   }
   EnableXHP = config["EnableXHP"].getBool();
   RTTIOutputFile = config["RTTIOutputFile"].getString();
+  {
+    Hdf profile = config["ProfileData"];
+    ProfileDataFile = profile["File"].getString();
+    HotFunctionPercent = profile["HotFunctionPercent"].getDouble(1.0);
+    HotFunctionSection = profile["HotFunctionSection"].getString("hot");
+    HotCallInlineSize = profile["HotCallInlineSize"].getInt32(30);
+  }
   EnableEval = (EvalLevel)config["EnableEval"].getByte(0);
   AllDynamic = config["AllDynamic"].getBool(true);
   AllVolatile = config["AllVolatile"].getBool();
@@ -357,6 +371,8 @@ void Option::Load(Hdf &config) {
   LocalCopyProp      = config["LocalCopyProp"].getBool(true);
   StringLoopOpts     = config["StringLoopOpts"].getBool(true);
   AutoInline         = config["AutoInline"].getBool(false);
+  ArrayShapes        = config["ArrayShapes"].getBool(false);
+  EscapeAnalysis     = config["EscapeAnalysis"].getBool(true);
 
   if (m_hookHandler) m_hookHandler(config);
 
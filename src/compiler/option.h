@@ -133,6 +133,15 @@ public:
   static bool GenRTTIProfileData;
   static bool UseRTTIProfileData;
 
+  /**
+   * Sampled stacks from production (admin "prof-sample-dump"), used for
+   * function placement and inlining. See ProfileData.
+   */
+  static std::string ProfileDataFile;
+  static double HotFunctionPercent;
+  static std::string HotFunctionSection;
+  static int HotCallInlineSize;
+
   /**
    * Generate concatN (n > 6) service routines
    */
@@ -318,6 +327,8 @@ public:
   static bool LocalCopyProp;
   static bool StringLoopOpts;
   static bool AutoInline;
+  static bool ArrayShapes;
+  static bool EscapeAnalysis;
 
   static bool FlAnnotate; // annotate emitted code withe compiler file-line info
   static bool SystemGen; // -t cpp -f sys
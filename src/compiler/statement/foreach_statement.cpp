@@ -21,6 +21,7 @@
 #include <compiler/option.h>
 #include <compiler/analysis/code_error.h>
 #include <compiler/analysis/class_scope.h>
+#include <compiler/analysis/variable_table.h>
 
 using namespace HPHP;
 using namespace std;
@@ -35,7 +36,7 @@ ForEachStatement::ForEachStatement
  ExpressionPtr value, bool valueRef, StatementPtr stmt)
   : LoopStatement(STATEMENT_CONSTRUCTOR_PARAMETER_VALUES),
     m_array(array), m_name(name), m_value(value), m_ref(valueRef),
-    m_stmt(stmt) {
+    m_stmt(stmt), m_stackArray(false), m_borrowedArray(false) {
   if (!m_value) {
     m_value = m_name;
     m_ref = nameRef;
@@ -142,11 +143,26 @@ void ForEachStatement::inferTypes(AnalysisResultPtr ar) {
     ar->getCodeError()->record(self, CodeError::ComplexForEach, self);
   }
 
-  m_array->inferAndCheck(ar, Type::Array, true);
+  TypePtr arrayType = Type::Array;
+  if (!m_ref && m_array->is(Expression::KindOfSimpleVariable)) {
+    // iterating over an array should not lose what is known of its values
+    SimpleVariablePtr var = dynamic_pointer_cast<SimpleVariable>(m_array);
+    TypePtr varType = ar->getScope()->getVariables()->
+      getType(var->getName(), true);
+    if (varType && varType->getElementType()) arrayType = varType;
+  }
+  m_array->inferAndCheck(ar, arrayType, true);
   if (m_name) {
     m_name->inferAndCheck(ar, NEW_TYPE(Primitive), true);
   }
-  m_value->inferAndCheck(ar, Type::Variant, true);
+  TypePtr valueType = Type::Variant;
+  if (!m_ref && m_value->is(Expression::KindOfSimpleVariable)) {
+    TypePtr actualType = m_array->getActualType();
+    if (actualType && actualType->hasKnownElementType()) {
+      valueType = actualType->getElementType();
+    }
+  }
+  m_value->inferAndCheck(ar, valueType, true);
   if (m_ref) {
     TypePtr actualType = m_array->getActualType();
     if (!actualType ||
@@ -195,7 +211,8 @@ void ForEachStatement::outputCPPImpl(CodeGenerator &cg, AnalysisResultPtr ar) {
   if (m_ref ||
       !m_array->is(Expression::KindOfSimpleVariable) ||
       m_array->isThis()) {
-    cg_printf("Variant %s%d", Option::MapPrefix, mapId);
+    cg_printf("%s %s%d", m_stackArray ? "Array" : "Variant",
+              Option::MapPrefix, mapId);
     bool wrap = m_array->preOutputCPP(cg, ar, 0);
     if (wrap) {
       cg_printf(";\n");
@@ -240,7 +257,9 @@ void ForEachStatement::outputCPPImpl(CodeGenerator &cg, AnalysisResultPtr ar) {
     cg_printf("); %s%d->advance();", Option::IterPrefix, iterId);
   } else {
     if (passTemp) {
-      cg_printf("ArrayIterPtr %s%d = %s%d.begin(",
+      isArray = m_stackArray;
+      cg_printf("%s %s%d = %s%d.begin(",
+                isArray ? "ArrayIter" : "ArrayIterPtr",
                 Option::IterPrefix, iterId,
                 Option::MapPrefix, mapId);
       ClassScopePtr cls = ar->getClassScope();
@@ -248,7 +267,24 @@ void ForEachStatement::outputCPPImpl(CodeGenerator &cg, AnalysisResultPtr ar) {
         cg_printf("%sclass_name", Option::StaticPropertyPrefix);
       }
       cg_printf("); ");
-      cg_printf("!%s%d->end(); %s%d->next()",
+      if (isArray) {
+        cg_printf("!%s%d.end(); ++%s%d",
+                  Option::IterPrefix, iterId,
+                  Option::IterPrefix, iterId);
+      } else {
+        cg_printf("!%s%d->end(); %s%d->next()",
+                  Option::IterPrefix, iterId,
+                  Option::IterPrefix, iterId);
+      }
+    } else if (m_borrowedArray) {
+      isArray = true;
+      cg_printf("ArrayIter %s%d(", Option::IterPrefix, iterId);
+      TypePtr expectedType = m_array->getExpectedType();
+      m_array->setExpectedType(TypePtr());
+      m_array->outputCPP(cg, ar);
+      m_array->setExpectedType(expectedType);
+      cg_printf(", ArrayIter::NoReference); ");
+      cg_printf("!%s%d.end(); ++%s%d",
                 Option::IterPrefix, iterId,
                 Option::IterPrefix, iterId);
     } else {
@@ -283,10 +319,22 @@ void ForEachStatement::outputCPPImpl(CodeGenerator &cg, AnalysisResultPtr ar) {
   cg_printf("LOOP_COUNTER_CHECK(%d);\n", labelId);
 
   if (!m_ref) {
-    cg_printf(isArray ? "%s%d.second(" : "%s%d->second(",
-              Option::IterPrefix, iterId);
-    m_value->outputCPP(cg, ar);
-    cg_printf(");\n");
+    TypePtr valueType = m_value->getActualType();
+    if (valueType && !valueType->is(Type::KindOfVariant) &&
+        valueType->isExactType()) {
+      // values of an array<T> are read as T, without going through a
+      // Variant of our own
+      m_value->outputCPP(cg, ar);
+      cg_printf(" = ");
+      valueType->outputCPPCast(cg, ar);
+      cg_printf(isArray ? "(%s%d.secondRef());\n" : "(%s%d->secondRef());\n",
+                Option::IterPrefix, iterId);
+    } else {
+      cg_printf(isArray ? "%s%d.second(" : "%s%d->second(",
+                Option::IterPrefix, iterId);
+      m_value->outputCPP(cg, ar);
+      cg_printf(");\n");
+    }
     if (m_name) {
       m_name->outputCPP(cg, ar);
       cg_printf(isArray ? " = %s%d.first();\n" : " = %s%d->first();\n",
@@ -37,12 +37,29 @@ public:
     return 1 + (m_stmt ? m_stmt->getRecursiveCount() : 0);
   }
 
+  ExpressionPtr getArrayExp() const { return m_array;}
+  ExpressionPtr getNameExp() const { return m_name;}
+  ExpressionPtr getValueExp() const { return m_value;}
+  StatementPtr getBody() const { return m_stmt;}
+  bool isRef() const { return m_ref;}
+
+  /**
+   * Set by EscapeAnalysis: the array is a temporary that can live on the
+   * stack, or a local that can be iterated without holding a reference.
+   */
+  void setStackArray() { m_stackArray = true;}
+  void setBorrowedArray() { m_borrowedArray = true;}
+  bool isStackArray() const { return m_stackArray;}
+  bool isBorrowedArray() const { return m_borrowedArray;}
+
 private:
   ExpressionPtr m_array;
   ExpressionPtr m_name;
   ExpressionPtr m_value;
   bool m_ref;
   StatementPtr m_stmt;
+  bool m_stackArray;
+  bool m_borrowedArray;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -32,6 +32,8 @@
 #include <compiler/analysis/dependency_graph.h>
 #include <compiler/builtin_symbols.h>
 #include <compiler/analysis/alias_manager.h>
+#include <compiler/analysis/shape_analysis.h>
+#include <compiler/analysis/escape_analysis.h>
 
 using namespace HPHP;
 using namespace std;
@@ -392,6 +394,20 @@ StatementPtr MethodStatement::postOptimize(AnalysisResultPtr ar) {
   } else {
     ar->postOptimize(m_stmt);
   }
+  if (ar->getPhase() != AnalysisResult::AnalyzeInclude &&
+      Option::ArrayShapes && !funcScope->inPseudoMain()) {
+    ShapeAnalysis sa;
+    MethodStatementPtr self =
+      static_pointer_cast<MethodStatement>(shared_from_this());
+    sa.analyze(self);
+  }
+  if (ar->getPhase() != AnalysisResult::AnalyzeInclude &&
+      Option::EscapeAnalysis && !funcScope->inPseudoMain()) {
+    EscapeAnalysis ea;
+    MethodStatementPtr self =
+      static_pointer_cast<MethodStatement>(shared_from_this());
+    ea.analyze(ar, self);
+  }
   ar->popScope();
   return StatementPtr();
 }
@@ -24,6 +24,8 @@
 #include <compiler/analysis/alias_manager.h>
 #include <compiler/analysis/dependency_graph.h>
 #include <compiler/analysis/code_error.h>
+#include <compiler/analysis/profile_data.h>
+#include <compiler/analysis/escape_analysis.h>
 #include <util/json.h>
 #include <util/logger.h>
 #include <compiler/analysis/symbol_table.h>
@@ -85,6 +87,7 @@ struct ProgramOptions {
   int optimizeLevel;
   string filecache;
   string rttiDirectory;
+  string profileData;
   string javaRoot;
   bool generateFFI;
   bool dump;
@@ -271,6 +274,9 @@ int prepareOptions(ProgramOptions &po, int argc, char **argv) {
      "if specified, generate a static file cache with this file name")
     ("rtti-directory", value<string>(&po.rttiDirectory)->default_value(""),
      "the directory of rtti profiling data")
+    ("profile-data", value<string>(&po.profileData)->default_value(""),
+     "sampled stacks from production (admin prof-sample-dump) to optimize "
+     "for, overriding ProfileData.File")
     ("java-root",
      value<string>(&po.javaRoot)->default_value("php"),
      "the root package of generated Java FFI classes")
@@ -772,6 +778,16 @@ int cppTarget(const ProgramOptions &po, AnalysisResultPtr ar,
   if (!po.noTypeInference) {
     Option::GenerateInferredTypes = true;
   }
+  if (!po.profileData.empty()) {
+    Option::ProfileDataFile = po.profileData;
+  }
+  if (!Option::ProfileDataFile.empty() &&
+      ProfileData::TheProfileData.load(Option::ProfileDataFile.c_str())) {
+    int placed = ProfileData::TheProfileData.assignFunctionSections();
+    Logger::Info("%d hot functions placed in .text.%s", placed,
+                 Option::HotFunctionSection.c_str());
+  }
+
   if (Option::PreOptimization) {
     Timer timer(Timer::WallTime, "pre-optimizing");
     ar->preOptimize();
@@ -795,6 +811,12 @@ int cppTarget(const ProgramOptions &po, AnalysisResultPtr ar,
     Timer timer(Timer::WallTime, "post-optimizing");
     ar->postOptimize();
   }
+  if (Option::EscapeAnalysis) {
+    Logger::Info("%d foreach temporaries kept on the stack, "
+                 "%d local arrays iterated without refcounting",
+                 EscapeAnalysis::StackArrayCount,
+                 EscapeAnalysis::BorrowedArrayCount);
+  }
   ar->analyzeProgramFinal();
   //MethodSlot::genMethodSlot(ar);
 
@@ -0,0 +1,169 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/allocation_profiler.h>
+#include <runtime/base/sampling_profiler.h>
+#include <runtime/base/execution_context.h>
+#include <runtime/base/frame_injection.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/base/memory/smart_allocator.h>
+#include <util/lock.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// what a countdown starts at when nothing is to be sampled
+const int64 NoSample = 0x7FFFFFFFFFFFFFFFLL;
+
+bool s_running = false;
+int64 s_dropped = 0;
+hphp_string_map<int64> s_sites; // folded stack => bytes
+Mutex s_mutex;
+
+int64 get_interval() {
+  int64 interval = RuntimeOption::AllocationProfilerInterval;
+  return interval > 0 ? interval : 512 * 1024;
+}
+
+/**
+ * Uniformly distributed in [1, 2 * interval), which averages to interval.
+ * Each thread draws from its own xorshift state, so that neither the lock
+ * nor the sequence of the C library's random(), which PHP's rand() also
+ * uses, is touched.
+ */
+int64 next_countdown(MemoryUsageStats &stats) {
+  int64 interval = get_interval();
+  if (interval == 1) return 1;
+  uint64 x = stats.sampleRandom;
+  if (x == 0) {
+    x = ((uint64)(intptr_t)&stats * 0x9E3779B97F4A7C15ULL) ^ time(NULL);
+    if (x == 0) x = 1;
+  }
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  stats.sampleRandom = x;
+  return 1 + x % (2 * interval - 1);
+}
+
+void append_url(string &out) {
+  if (g_context.isNull() || g_context->getTransport() == NULL) {
+    out += "[none]";
+    return;
+  }
+  string url = g_context->getTransport()->getCommand();
+  out += '/';
+  for (unsigned int i = 0; i < url.size(); i++) {
+    char ch = url[i];
+    out += (ch == ';' || ch == ' ') ? '_' : ch;
+  }
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void AllocationProfiler::Start() {
+  Lock lock(s_mutex);
+  s_running = true;
+}
+
+void AllocationProfiler::Stop() {
+  // countdowns that are already running out are stopped by OnSample()
+  Lock lock(s_mutex);
+  s_running = false;
+}
+
+bool AllocationProfiler::IsRunning() {
+  return s_running;
+}
+
+void AllocationProfiler::Clear() {
+  Lock lock(s_mutex);
+  s_sites.clear();
+  s_dropped = 0;
+}
+
+void AllocationProfiler::StartCountdown(MemoryUsageStats &stats) {
+  stats.sampleCountdown = s_running ? next_countdown(stats) : NoSample;
+}
+
+void AllocationProfiler::OnSample(MemoryUsageStats &stats) {
+  if (!s_running) {
+    stats.sampleCountdown = NoSample;
+    return;
+  }
+  int64 samples = 0;
+  while (stats.sampleCountdown <= 0) {
+    stats.sampleCountdown += next_countdown(stats);
+    samples++;
+  }
+  RecordStack(ThreadInfo::s_threadInfo->m_top, samples * get_interval());
+}
+
+void AllocationProfiler::RecordStack(const FrameInjection *top,
+                                     int64 bytes) {
+  char buf[SamplingProfiler::MaxStackSize];
+  int size = SamplingProfiler::FoldStack(top, buf);
+  string key;
+  append_url(key);
+  key += ';';
+  key.append(buf, size);
+
+  Lock lock(s_mutex);
+  hphp_string_map<int64>::iterator iter = s_sites.find(key);
+  if (iter != s_sites.end()) {
+    iter->second += bytes;
+  } else if ((int)s_sites.size() < RuntimeOption::AllocationProfilerTableSize) {
+    s_sites[key] = bytes;
+  } else {
+    s_dropped++;
+  }
+}
+
+static bool more_bytes(const pair<int64, const string*> &a,
+                       const pair<int64, const string*> &b) {
+  return a.first > b.first;
+}
+
+int AllocationProfiler::Dump(std::string &out) {
+  Lock lock(s_mutex);
+  vector<pair<int64, const string*> > sites;
+  for (hphp_string_map<int64>::const_iterator iter = s_sites.begin();
+       iter != s_sites.end(); ++iter) {
+    sites.push_back(pair<int64, const string*>(iter->second, &iter->first));
+  }
+  sort(sites.begin(), sites.end(), more_bytes);
+
+  char bytes[32];
+  for (unsigned int i = 0; i < sites.size(); i++) {
+    snprintf(bytes, sizeof(bytes), " %lld\n", (long long)sites[i].first);
+    out += *sites[i].second;
+    out += bytes;
+  }
+  return sites.size();
+}
+
+int64 AllocationProfiler::GetDroppedCount() {
+  return s_dropped;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,89 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_ALLOCATION_PROFILER_H__
+#define __HPHP_ALLOCATION_PROFILER_H__
+
+#include <runtime/base/types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+struct MemoryUsageStats;
+
+/**
+ * Sampling profiler of request memory, cheap enough to leave on. Every
+ * SmartAllocator allocation counts down the bytes left before the thread's
+ * next sample, which is one subtraction and one comparison on the fast path.
+ * When the countdown runs out, the PHP stack of the allocating thread is
+ * folded like SamplingProfiler does and charged with the bytes that the
+ * sample stands for, under the URL of the request being served.
+ *
+ * Sampling points are drawn at random, Debug.AllocationProfiler.Interval
+ * bytes apart on average, so that loops allocating the same sizes over and
+ * over do not always or never hit them. Samples are rare enough to take a
+ * lock and allocate.
+ *
+ * Dump() writes "url;root;caller;callee bytes" lines, which flamegraph.pl
+ * reads directly, with the URL as the bottom frame.
+ */
+class AllocationProfiler {
+public:
+  static void Start();
+  static void Stop();
+  static bool IsRunning();
+
+  /**
+   * Forget all samples collected so far.
+   */
+  static void Clear();
+
+  /**
+   * Called whenever MemoryManager resets its stats, around each request, to
+   * set up the thread's countdown depending on whether the profiler is
+   * running.
+   */
+  static void StartCountdown(MemoryUsageStats &stats);
+
+  /**
+   * Called by SmartAllocator once the countdown in stats has run out.
+   * Takes as many samples as sampling points were passed and starts the
+   * next countdown.
+   */
+  static void OnSample(MemoryUsageStats &stats);
+
+  /**
+   * Charge the stack ending at top, under the current request's URL, with
+   * bytes.
+   */
+  static void RecordStack(const FrameInjection *top, int64 bytes);
+
+  /**
+   * Folded stacks, most bytes first. Returns the number of stacks.
+   */
+  static int Dump(std::string &out);
+
+  /**
+   * Samples lost because Debug.AllocationProfiler.TableSize different
+   * stacks were already in the table.
+   */
+  static int64 GetDroppedCount();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_ALLOCATION_PROFILER_H__
@@ -16,6 +16,7 @@
 #include <runtime/base/array/array_init.h>
 #include <runtime/base/array/zend_array.h>
 #include <runtime/base/array/small_array.h>
+#include <runtime/base/array/shaped_array.h>
 #include <runtime/base/runtime_option.h>
 
 namespace HPHP {
@@ -23,13 +24,16 @@ namespace HPHP {
 // ArrayInit
 
 ArrayInit::ArrayInit(ssize_t n, bool isVector /* = false */,
-                     bool keepRef /* = false */) : m_data(NULL) {
+                     bool keepRef /* = false */,
+                     bool shaped /* = false */) : m_data(NULL) {
   if (n == 0) {
     if (RuntimeOption::UseSmallArray && !keepRef) {
       m_data = StaticEmptySmallArray::Get();
     } else {
       m_data = StaticEmptyZendArray::Get();
     }
+  } else if (shaped && n <= ShapedArray::MaxSize && !keepRef) {
+    m_data = NEW(ShapedArray)();
   } else if (n <= SmallArray::SARR_SIZE && !keepRef &&
              RuntimeOption::UseSmallArray) {
     m_data = NEW(SmallArray)();
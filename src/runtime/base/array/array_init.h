@@ -66,38 +66,42 @@ namespace HPHP {
  * For arrays that need to have C++ references/pointers to their elements for
  * an extended period of time, set keepRef to true, so that there will not
  * be reference-breaking escalation.
+ *
+ * Set shaped to true for literals whose keys are all string literals and
+ * that are used as records; they are built as a ShapedArray.
  */
 class ArrayInit {
 public:
-  ArrayInit(ssize_t n, bool isVector = false, bool keepRef = false);
+  ArrayInit(ssize_t n, bool isVector = false, bool keepRef = false,
+            bool shaped = false);
   ~ArrayInit() {
     // In case an exception interrupts the initialization.
     if (m_data) m_data->release();
   }
 
   ArrayInit &set(int p, CVarRef v) {
-    m_data->append(v, false);
+    escalate(m_data->append(v, false));
     return *this;
   }
 
   ArrayInit &setRef(int p, CVarRef v) {
     v.setContagious();
-    m_data->append(v, false);
+    escalate(m_data->append(v, false));
     return *this;
   }
 
   ArrayInit &set(int p, int64 name, CVarRef v, int64 prehash = -1,
                  bool keyConverted = false) {
-    m_data->set(name, v, false, prehash);
+    escalate(m_data->set(name, v, false, prehash));
     return *this;
   }
 
   ArrayInit &set(int p, litstr name, CVarRef v, int64 prehash = -1,
                  bool keyConverted = false) {
     if (keyConverted) {
-      m_data->set(name, v, false, prehash);
+      escalate(m_data->set(name, v, false, prehash));
     } else {
-      m_data->set(String(name).toKey(), v, false, prehash);
+      escalate(m_data->set(String(name).toKey(), v, false, prehash));
     }
     return *this;
   }
@@ -105,9 +109,9 @@ public:
   ArrayInit &set(int p, CStrRef name, CVarRef v, int64 prehash = -1,
                  bool keyConverted = false) {
     if (keyConverted) {
-      m_data->set(name, v, false, prehash);
+      escalate(m_data->set(name, v, false, prehash));
     } else if (!name.isNull()) {
-      m_data->set(name.toKey(), v, false, prehash);
+      escalate(m_data->set(name.toKey(), v, false, prehash));
     }
     return *this;
   }
@@ -115,11 +119,11 @@ public:
   ArrayInit &set(int p, CVarRef name, CVarRef v, int64 prehash = -1,
                  bool keyConverted = false) {
     if (keyConverted) {
-      m_data->set(name, v, false, prehash);
+      escalate(m_data->set(name, v, false, prehash));
     } else {
       Variant k(name.toKey());
       if (!k.isNull()) {
-        m_data->set(k, v, false, prehash);
+        escalate(m_data->set(k, v, false, prehash));
       }
     }
     return *this;
@@ -129,11 +133,11 @@ public:
   ArrayInit &set(int p, const T &name, CVarRef v, int64 prehash = -1,
                  bool keyConverted = false) {
     if (keyConverted) {
-      m_data->set(name, v, false, prehash);
+      escalate(m_data->set(name, v, false, prehash));
     } else {
       Variant k(Variant(name).toKey());
       if (!k.isNull()) {
-        m_data->set(k, v, false, prehash);
+        escalate(m_data->set(k, v, false, prehash));
       }
     }
     return *this;
@@ -142,7 +146,7 @@ public:
   ArrayInit &setRef(int p, int64 name, CVarRef v, int64 prehash = -1,
                     bool keyConverted = false) {
     v.setContagious();
-    m_data->set(name, v, false, prehash);
+    escalate(m_data->set(name, v, false, prehash));
     return *this;
   }
 
@@ -150,9 +154,9 @@ public:
                     bool keyConverted = false) {
     v.setContagious();
     if (keyConverted) {
-      m_data->set(name, v, false, prehash);
+      escalate(m_data->set(name, v, false, prehash));
     } else {
-      m_data->set(String(name).toKey(), v, false, prehash);
+      escalate(m_data->set(String(name).toKey(), v, false, prehash));
     }
     return *this;
   }
@@ -161,9 +165,9 @@ public:
                     bool keyConverted = false) {
     v.setContagious();
     if (keyConverted) {
-      m_data->set(name, v, false, prehash);
+      escalate(m_data->set(name, v, false, prehash));
     } else {
-      m_data->set(name.toKey(), v, false, prehash);
+      escalate(m_data->set(name.toKey(), v, false, prehash));
     }
     return *this;
   }
@@ -172,12 +176,12 @@ public:
                     bool keyConverted = false) {
     if (keyConverted) {
       v.setContagious();
-      m_data->set(name, v, false, prehash);
+      escalate(m_data->set(name, v, false, prehash));
     } else {
       Variant key(name.toKey());
       if (!key.isNull()) {
         v.setContagious();
-        m_data->set(key, v, false, prehash);
+        escalate(m_data->set(key, v, false, prehash));
       } else {
         v.clearContagious();
       }
@@ -190,12 +194,12 @@ public:
                     bool keyConverted = false) {
     if (keyConverted) {
       v.setContagious();
-      m_data->set(name, v, false, prehash);
+      escalate(m_data->set(name, v, false, prehash));
     } else {
       Variant key(Variant(name).toKey());
       if (!key.isNull()) {
         v.setContagious();
-        m_data->set(key, v, false, prehash);
+        escalate(m_data->set(key, v, false, prehash));
       } else {
         v.clearContagious();
       }
@@ -211,6 +215,13 @@ public:
   operator ArrayData *() { return create(); }
 private:
   ArrayData *m_data;
+
+  void escalate(ArrayData *escalated) {
+    if (escalated) {
+      m_data->release();
+      m_data = escalated;
+    }
+  }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
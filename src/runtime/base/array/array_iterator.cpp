@@ -24,22 +24,27 @@ namespace HPHP {
 // ArrayIter
 
 ArrayIter::ArrayIter(const ArrayData *data)
-  : m_data(data), m_pos(0) {
+  : m_data(data), m_pos(0), m_borrowed(false) {
   create();
 }
 
 ArrayIter::ArrayIter(const ArrayIter &iter)
-  : m_data(iter.m_data), m_pos(0) {
+  : m_data(iter.m_data), m_pos(0), m_borrowed(false) {
   create();
 }
 
 ArrayIter::ArrayIter(CArrRef array)
-  : m_data(array.get()), m_pos(0) {
+  : m_data(array.get()), m_pos(0), m_borrowed(false) {
   create();
 }
 
+ArrayIter::ArrayIter(CArrRef array, NoRef)
+  : m_data(array.get()), m_pos(0), m_borrowed(true) {
+  m_pos = m_data ? m_data->iter_begin() : ArrayData::invalid_index;
+}
+
 ArrayIter::~ArrayIter() {
-  if (m_data) {
+  if (m_data && !m_borrowed) {
     m_data->decRefCount();
   }
 }
@@ -64,6 +64,15 @@ public:
   ArrayIter(CArrRef array);
   ~ArrayIter();
 
+  /**
+   * For an array that nothing can change or release until the iteration is
+   * over: the iterator takes no reference of its own, so there is no
+   * refcounting at all. Code generation only does this for local arrays
+   * the loop body never writes.
+   */
+  enum NoRef { NoReference };
+  ArrayIter(CArrRef array, NoRef);
+
   bool end();
   void next();
   Variant first();
@@ -74,6 +83,7 @@ public:
 private:
   const ArrayData *m_data;
   ssize_t m_pos;
+  bool m_borrowed;
 
   void create();
 };
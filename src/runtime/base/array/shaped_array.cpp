@@ -0,0 +1,501 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/array/shaped_array.h>
+#include <runtime/base/array/zend_array.h>
+#include <runtime/base/runtime_error.h>
+#include <util/hash.h>
+#include <util/lock.h>
+
+namespace HPHP {
+
+IMPLEMENT_SMART_ALLOCATION_NOCALLBACKS(ShapedArray);
+
+///////////////////////////////////////////////////////////////////////////////
+// shapes
+
+ArrayShape ArrayShape::s_empty;
+static Mutex s_transitionMutex;
+
+ArrayShape::ArrayShape() : m_size(0), m_transitionCount(0) {
+}
+
+ArrayShape::ArrayShape(const ArrayShape *parent, StringData *key)
+  : m_size(parent->m_size + 1), m_transitionCount(0) {
+  ASSERT(parent->m_size < MaxSize && key->isStatic());
+  for (int i = 0; i < parent->m_size; i++) {
+    m_keys[i] = parent->m_keys[i];
+    m_hashes[i] = parent->m_hashes[i];
+  }
+  m_keys[parent->m_size] = key;
+  m_hashes[parent->m_size] = key->hash();
+}
+
+int ArrayShape::find(const StringData *key, int64 prehash /* = -1 */) const {
+  // generated code mostly looks keys up with the very literals that built
+  // the array
+  for (int i = 0; i < m_size; i++) {
+    if (m_keys[i] == key) return i;
+  }
+  int64 hash = prehash >= 0 ? prehash : key->hash();
+  for (int i = 0; i < m_size; i++) {
+    if (m_hashes[i] == hash && m_keys[i]->same(key)) return i;
+  }
+  return -1;
+}
+
+int ArrayShape::find(const char *key, int len,
+                     int64 prehash /* = -1 */) const {
+  for (int i = 0; i < m_size; i++) {
+    if (m_keys[i]->data() == key) return i;
+  }
+  int64 hash = prehash >= 0 ? prehash : hash_string(key, len);
+  for (int i = 0; i < m_size; i++) {
+    StringData *k = m_keys[i];
+    if (m_hashes[i] == hash && k->size() == len &&
+        memcmp(k->data(), key, len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const ArrayShape *ArrayShape::transition(const StringData *key) const {
+  if (m_size == MaxSize) return NULL;
+  int64 hash = key->hash();
+  const ArrayShape *shape = findTransition(key->data(), key->size(), hash);
+  if (shape || !key->isStatic()) return shape;
+  return addTransition(key->data(), key->size(), hash, key);
+}
+
+const ArrayShape *ArrayShape::transition(const char *key, int len) const {
+  if (m_size == MaxSize) return NULL;
+  int64 hash = hash_string(key, len);
+  const ArrayShape *shape = findTransition(key, len, hash);
+  if (shape) return shape;
+  return addTransition(key, len, hash, NULL);
+}
+
+const ArrayShape *ArrayShape::findTransition(const char *key, int len,
+                                             int64 hash) const {
+  int count = *(volatile int *)&m_transitionCount;
+  for (int i = 0; i < count; i++) {
+    const ArrayShape *shape = m_transitions[i];
+    StringData *k = shape->m_keys[m_size];
+    if (shape->m_hashes[m_size] == hash && k->size() == len &&
+        memcmp(k->data(), key, len) == 0) {
+      return shape;
+    }
+  }
+  return NULL;
+}
+
+const ArrayShape *ArrayShape::addTransition(const char *key, int len,
+                                            int64 hash,
+                                            const StringData *staticKey)
+  const {
+  Lock lock(s_transitionMutex);
+  const ArrayShape *shape = findTransition(key, len, hash);
+  if (shape) return shape;
+  if (m_transitionCount == MaxTransitions) return NULL;
+
+  StringData *k = const_cast<StringData *>(staticKey);
+  if (k == NULL) {
+    // a literal C string lives as long as the program, and so does a shape
+    k = new StringData(key, len, AttachLiteral);
+    k->setStatic();
+  }
+  shape = new ArrayShape(this, k);
+
+  // readers do not lock, so the shape has to be complete before they can
+  // see it
+  m_transitions[m_transitionCount] = shape;
+  __sync_synchronize();
+  m_transitionCount++;
+  return shape;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// constructors
+
+ShapedArray::ShapedArray() : m_shape(ArrayShape::Empty()) {
+}
+
+ShapedArray::ShapedArray(const ShapedArray &src)
+  : ArrayData(&src), m_shape(src.m_shape) {
+  for (int i = 0; i < m_shape->size(); i++) {
+    const Variant &v = src.m_values[i];
+    if (v.isReferenced()) v.setContagious();
+    m_values[i] = v;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// iterations, using the default position-based ones from ArrayData
+
+Variant ShapedArray::getKey(ssize_t pos) const {
+  ASSERT(pos >= 0 && pos < size());
+  return m_shape->getKey(pos);
+}
+
+Variant ShapedArray::getValue(ssize_t pos) const {
+  ASSERT(pos >= 0 && pos < size());
+  return m_values[pos];
+}
+
+void ShapedArray::fetchValue(ssize_t pos, Variant &v) const {
+  ASSERT(pos >= 0 && pos < size());
+  v = m_values[pos];
+}
+
+CVarRef ShapedArray::getValueRef(ssize_t pos) const {
+  ASSERT(pos >= 0 && pos < size());
+  return m_values[pos];
+}
+
+bool ShapedArray::isVectorData() const {
+  // every key is a string
+  return size() == 0;
+}
+
+void ShapedArray::getFullPos(FullPos &pos) {
+  // it should have been escalated
+  throw FatalErrorException("ShapedArray should have been escalated");
+}
+
+bool ShapedArray::setFullPos(const FullPos &pos) {
+  // it should have been escalated
+  throw FatalErrorException("ShapedArray should have been escalated");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lookups
+
+int ShapedArray::find(CVarRef k) const {
+  if (k.isNumeric()) return -1;
+  String key = k.toString();
+  return m_shape->find(key.get());
+}
+
+bool ShapedArray::exists(int64 k, int64 prehash /* = -1 */) const {
+  return false;
+}
+
+bool ShapedArray::exists(litstr k, int64 prehash /* = -1 */) const {
+  return m_shape->find(k, strlen(k), prehash) >= 0;
+}
+
+bool ShapedArray::exists(CStrRef k, int64 prehash /* = -1 */) const {
+  return m_shape->find(k.get(), prehash) >= 0;
+}
+
+bool ShapedArray::exists(CVarRef k, int64 prehash /* = -1 */) const {
+  return find(k) >= 0;
+}
+
+bool ShapedArray::idxExists(ssize_t idx) const {
+  return idx >= 0 && idx < size();
+}
+
+Variant ShapedArray::get(int64 k, int64 prehash /* = -1 */,
+                         bool error /* = false */) const {
+  if (error) {
+    raise_notice("Undefined index: %lld", k);
+  }
+  return null;
+}
+
+Variant ShapedArray::get(litstr k, int64 prehash /* = -1 */,
+                         bool error /* = false */) const {
+  int i = m_shape->find(k, strlen(k), prehash);
+  if (i >= 0) {
+    return m_values[i];
+  }
+  if (error) {
+    raise_notice("Undefined index: %s", k);
+  }
+  return null;
+}
+
+Variant ShapedArray::get(CStrRef k, int64 prehash /* = -1 */,
+                         bool error /* = false */) const {
+  int i = m_shape->find(k.get(), prehash);
+  if (i >= 0) {
+    return m_values[i];
+  }
+  if (error) {
+    raise_notice("Undefined index: %s", k.data());
+  }
+  return null;
+}
+
+Variant ShapedArray::get(CVarRef k, int64 prehash /* = -1 */,
+                         bool error /* = false */) const {
+  int i = find(k);
+  if (i >= 0) {
+    return m_values[i];
+  }
+  if (error) {
+    raise_notice("Undefined index: %s", k.toString().data());
+  }
+  return null;
+}
+
+void ShapedArray::load(CVarRef k, Variant &v) const {
+  int i = find(k);
+  if (i >= 0) {
+    const Variant &value = m_values[i];
+    if (value.isReferenced()) v = ref(value); else v = value;
+  }
+}
+
+ssize_t ShapedArray::getIndex(int64 k, int64 prehash /* = -1 */) const {
+  return ArrayData::invalid_index;
+}
+
+ssize_t ShapedArray::getIndex(litstr k, int64 prehash /* = -1 */) const {
+  int i = m_shape->find(k, strlen(k), prehash);
+  return i >= 0 ? i : ArrayData::invalid_index;
+}
+
+ssize_t ShapedArray::getIndex(CStrRef k, int64 prehash /* = -1 */) const {
+  int i = m_shape->find(k.get(), prehash);
+  return i >= 0 ? i : ArrayData::invalid_index;
+}
+
+ssize_t ShapedArray::getIndex(CVarRef k, int64 prehash /* = -1 */) const {
+  int i = find(k);
+  return i >= 0 ? i : ArrayData::invalid_index;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// append/insert/update
+
+ArrayData *ShapedArray::escalate(bool mutableIteration /* = false */) const {
+  if (mutableIteration) {
+    // Let ZendArray handle all the quirky cases.
+    return escalateToZendArray();
+  }
+  return const_cast<ShapedArray *>(this);
+}
+
+ArrayData *ShapedArray::escalateToZendArray() const {
+  int n = size();
+  ZendArray *ret = NEW(ZendArray)(n);
+  for (int i = 0; i < n; i++) {
+    const Variant &v = m_values[i];
+    if (v.isReferenced()) v.setContagious();
+    ret->set(String(m_shape->getKey(i)), v, false, -1);
+  }
+  // Set m_pos in the escalated array
+  if (m_pos >= 0 && m_pos < n) {
+    ret->setPosition(ret->getIndex(String(m_shape->getKey(m_pos))));
+  } else {
+    ret->setPosition(0);
+  }
+  return ret;
+}
+
+ShapedArray *ShapedArray::slot(int index, const ArrayShape *shape,
+                               Variant *&ret, bool copy, bool checkExist) {
+  ShapedArray *result = NULL;
+  if (index < 0) {
+    // values past the end of a shape are always null, so the new key's
+    // slot is ready to use
+    ASSERT(shape && shape->size() == size() + 1);
+    index = size();
+    if (copy) {
+      result = copyImpl();
+      result->m_shape = shape;
+    } else {
+      m_shape = shape;
+    }
+  } else if (copy && !checkExist) {
+    result = copyImpl();
+  }
+  ret = &(result ? result : this)->m_values[index];
+  return result;
+}
+
+ArrayData *ShapedArray::lval(Variant *&ret, bool copy) {
+  int n = size();
+  ASSERT(n > 0);
+  if (copy) {
+    ShapedArray *a = copyImpl();
+    ret = &a->m_values[n - 1];
+    return a;
+  }
+  ret = &m_values[n - 1];
+  return NULL;
+}
+
+ArrayData *ShapedArray::lval(int64 k, Variant *&ret, bool copy,
+                             int64 prehash /* = -1 */,
+                             bool checkExist /* = false */) {
+  ArrayData *a = escalateToZendArray();
+  a->lval(k, ret, false, prehash);
+  return a;
+}
+
+ArrayData *ShapedArray::lval(litstr k, Variant *&ret, bool copy,
+                             int64 prehash /* = -1 */,
+                             bool checkExist /* = false */) {
+  int len = strlen(k);
+  int index = m_shape->find(k, len, prehash);
+  const ArrayShape *shape = NULL;
+  if (index < 0 && (shape = m_shape->transition(k, len)) == NULL) {
+    ArrayData *a = escalateToZendArray();
+    a->lval(k, ret, false, prehash);
+    return a;
+  }
+  return slot(index, shape, ret, copy, checkExist);
+}
+
+ArrayData *ShapedArray::lval(CStrRef k, Variant *&ret, bool copy,
+                             int64 prehash /* = -1 */,
+                             bool checkExist /* = false */) {
+  int index = m_shape->find(k.get(), prehash);
+  const ArrayShape *shape = NULL;
+  if (index < 0 && (shape = m_shape->transition(k.get())) == NULL) {
+    ArrayData *a = escalateToZendArray();
+    a->lval(k, ret, false, prehash);
+    return a;
+  }
+  return slot(index, shape, ret, copy, checkExist);
+}
+
+ArrayData *ShapedArray::lval(CVarRef k, Variant *&ret, bool copy,
+                             int64 prehash /* = -1 */,
+                             bool checkExist /* = false */) {
+  if (k.isNumeric()) {
+    return lval(k.toInt64(), ret, copy, prehash, checkExist);
+  } else {
+    return lval(k.toString(), ret, copy, prehash, checkExist);
+  }
+}
+
+ArrayData *ShapedArray::set(int64 k, CVarRef v, bool copy,
+                            int64 prehash /* = -1 */) {
+  ArrayData *a = escalateToZendArray();
+  a->set(k, v, false, prehash);
+  return a;
+}
+
+ArrayData *ShapedArray::set(litstr k, CVarRef v, bool copy,
+                            int64 prehash /* = -1 */) {
+  int len = strlen(k);
+  int index = m_shape->find(k, len, prehash);
+  const ArrayShape *shape = NULL;
+  if (index < 0 && (shape = m_shape->transition(k, len)) == NULL) {
+    ArrayData *a = escalateToZendArray();
+    a->set(k, v, false, prehash);
+    return a;
+  }
+  Variant *ret;
+  ShapedArray *result = slot(index, shape, ret, copy, false);
+  *ret = v;
+  return result;
+}
+
+ArrayData *ShapedArray::set(CStrRef k, CVarRef v, bool copy,
+                            int64 prehash /* = -1 */) {
+  int index = m_shape->find(k.get(), prehash);
+  const ArrayShape *shape = NULL;
+  if (index < 0 && (shape = m_shape->transition(k.get())) == NULL) {
+    ArrayData *a = escalateToZendArray();
+    a->set(k, v, false, prehash);
+    return a;
+  }
+  Variant *ret;
+  ShapedArray *result = slot(index, shape, ret, copy, false);
+  *ret = v;
+  return result;
+}
+
+ArrayData *ShapedArray::set(CVarRef k, CVarRef v, bool copy,
+                            int64 prehash /* = -1 */) {
+  if (k.isNumeric()) {
+    return set(k.toInt64(), v, copy, prehash);
+  }
+  return set(k.toString(), v, copy, prehash);
+}
+
+ArrayData *ShapedArray::copy() const {
+  return copyImpl();
+}
+
+ArrayData *ShapedArray::append(CVarRef v, bool copy) {
+  ArrayData *a = escalateToZendArray();
+  a->append(v, false);
+  return a;
+}
+
+ArrayData *ShapedArray::append(const ArrayData *elems, ArrayOp op,
+                               bool copy) {
+  if (elems->size() == 0) return NULL;
+  ArrayData *a = escalateToZendArray();
+  a->append(elems, op, false);
+  return a;
+}
+
+ArrayData *ShapedArray::prepend(CVarRef v, bool copy) {
+  ArrayData *a = escalateToZendArray();
+  a->prepend(v, false);
+  return a;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// delete
+
+ArrayData *ShapedArray::remove(int64 k, bool copy, int64 prehash /* = -1 */) {
+  return NULL;
+}
+
+ArrayData *ShapedArray::remove(litstr k, bool copy, int64 prehash /* = -1 */) {
+  if (m_shape->find(k, strlen(k), prehash) < 0) return NULL;
+  ArrayData *a = escalateToZendArray();
+  a->remove(k, false, prehash);
+  return a;
+}
+
+ArrayData *ShapedArray::remove(CStrRef k, bool copy,
+                               int64 prehash /* = -1 */) {
+  if (m_shape->find(k.get(), prehash) < 0) return NULL;
+  ArrayData *a = escalateToZendArray();
+  a->remove(k, false, prehash);
+  return a;
+}
+
+ArrayData *ShapedArray::remove(CVarRef k, bool copy,
+                               int64 prehash /* = -1 */) {
+  if (k.isNumeric()) {
+    return remove(k.toInt64(), copy, prehash);
+  }
+  return remove(k.toString(), copy, prehash);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// misc
+
+void ShapedArray::onSetStatic() {
+  // keys are static already
+  for (int i = 0; i < size(); i++) {
+    m_values[i].setStatic();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,189 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_SHAPED_ARRAY_H__
+#define __HPHP_SHAPED_ARRAY_H__
+
+#include <runtime/base/types.h>
+#include <runtime/base/array/array_data.h>
+#include <runtime/base/memory/smart_allocator.h>
+#include <runtime/base/complex_types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The ordered list of string keys of a record-like array. Shapes are shared
+ * by all arrays built with the same keys in the same order, so they live for
+ * the whole process: each one knows the shapes it turns into when one more
+ * key is added, and looking a transition up takes no lock.
+ *
+ * Keys are static strings, either the named literals of generated code, or
+ * copies of literal C strings made the first time a transition is taken.
+ */
+class ArrayShape {
+public:
+  static const int MaxSize = 16;
+  static const int MaxTransitions = 8;
+
+  /**
+   * The shape without any key, where every ShapedArray starts.
+   */
+  static const ArrayShape *Empty() { return &s_empty;}
+
+  int size() const { return m_size;}
+  StringData *getKey(int index) const { return m_keys[index];}
+
+  /**
+   * Offset of a key, or -1. A prehash of -1 means "not computed".
+   */
+  int find(const StringData *key, int64 prehash = -1) const;
+  int find(const char *key, int len, int64 prehash = -1) const;
+
+  /**
+   * The shape with one more key. A non-static key can only take a
+   * transition some static key has already created. Returns NULL when the
+   * shape is full or has run out of transitions.
+   */
+  const ArrayShape *transition(const StringData *key) const;
+  const ArrayShape *transition(const char *key, int len) const;
+
+private:
+  static ArrayShape s_empty;
+
+  ArrayShape();
+  ArrayShape(const ArrayShape *parent, StringData *key);
+
+  int m_size;
+  StringData *m_keys[MaxSize];
+  int64 m_hashes[MaxSize];
+
+  mutable int m_transitionCount;
+  mutable const ArrayShape *m_transitions[MaxTransitions];
+
+  const ArrayShape *findTransition(const char *key, int len,
+                                   int64 hash) const;
+  const ArrayShape *addTransition(const char *key, int len, int64 hash,
+                                  const StringData *staticKey) const;
+};
+
+/**
+ * Array whose keys are all described by an ArrayShape, with values stored
+ * in key order at fixed offsets, so a lookup compares at most a handful of
+ * pointers or hashes and never probes a hash table. Code generation builds
+ * these for array literals that are used as records. Anything a shape
+ * cannot describe, like integer keys, appending, removing a key or more
+ * than ArrayShape::MaxSize keys, escalates to ZendArray, just like
+ * SmallArray does when it runs out of room.
+ */
+class ShapedArray : public ArrayData {
+public:
+  static const int MaxSize = ArrayShape::MaxSize;
+
+  ShapedArray();
+  ShapedArray(const ShapedArray &src);
+  virtual ~ShapedArray() { }
+
+  const ArrayShape *getShape() const { return m_shape;}
+
+  virtual ssize_t size() const { return m_shape->size(); }
+
+  virtual Variant getKey(ssize_t pos) const;
+  virtual Variant getValue(ssize_t pos) const;
+  virtual void fetchValue(ssize_t pos, Variant & v) const;
+  virtual CVarRef getValueRef(ssize_t pos) const;
+  virtual bool isVectorData() const;
+  virtual bool supportValueRef() const { return true; }
+
+  virtual bool exists(int64   k, int64 prehash = -1) const;
+  virtual bool exists(litstr  k, int64 prehash = -1) const;
+  virtual bool exists(CStrRef k, int64 prehash = -1) const;
+  virtual bool exists(CVarRef k, int64 prehash = -1) const;
+
+  virtual bool idxExists(ssize_t idx) const;
+
+  virtual Variant get(int64   k, int64 prehash = -1, bool error = false) const;
+  virtual Variant get(litstr  k, int64 prehash = -1, bool error = false) const;
+  virtual Variant get(CStrRef k, int64 prehash = -1, bool error = false) const;
+  virtual Variant get(CVarRef k, int64 prehash = -1, bool error = false) const;
+
+  virtual void load(CVarRef k, Variant &v) const;
+
+  virtual ssize_t getIndex(int64 k, int64 prehash = -1) const;
+  virtual ssize_t getIndex(litstr k, int64 prehash = -1) const;
+  virtual ssize_t getIndex(CStrRef k, int64 prehash = -1) const;
+  virtual ssize_t getIndex(CVarRef k, int64 prehash = -1) const;
+
+  virtual ArrayData *lval(Variant *&ret, bool copy);
+  virtual ArrayData *lval(int64   k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+  virtual ArrayData *lval(litstr  k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+  virtual ArrayData *lval(CStrRef k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+  virtual ArrayData *lval(CVarRef k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+
+  virtual ArrayData *set(int64   k, CVarRef v, bool copy, int64 prehash = -1);
+  virtual ArrayData *set(litstr  k, CVarRef v, bool copy, int64 prehash = -1);
+  virtual ArrayData *set(CStrRef k, CVarRef v, bool copy, int64 prehash = -1);
+  virtual ArrayData *set(CVarRef k, CVarRef v, bool copy, int64 prehash = -1);
+
+  virtual ArrayData *remove(int64   k, bool copy, int64 prehash = -1);
+  virtual ArrayData *remove(litstr  k, bool copy, int64 prehash = -1);
+  virtual ArrayData *remove(CStrRef k, bool copy, int64 prehash = -1);
+  virtual ArrayData *remove(CVarRef k, bool copy, int64 prehash = -1);
+
+  virtual ArrayData *copy() const;
+  virtual ArrayData *append(CVarRef v, bool copy);
+  virtual ArrayData *append(const ArrayData *elems, ArrayOp op, bool copy);
+  virtual ArrayData *prepend(CVarRef v, bool copy);
+  virtual void onSetStatic();
+
+  virtual void getFullPos(FullPos &pos);
+  virtual bool setFullPos(const FullPos &pos);
+
+  virtual ArrayData *escalate(bool mutableIteration = false) const;
+
+  DECLARE_SMART_ALLOCATION_NOCALLBACKS(ShapedArray);
+
+private:
+  const ArrayShape *m_shape;
+  Variant m_values[MaxSize];
+
+  ArrayData *escalateToZendArray() const;
+
+  ShapedArray *copyImpl() const {
+    ShapedArray *a = NEW(ShapedArray)(*this);
+    a->_count = 0;
+    return a;
+  }
+
+  int find(CVarRef k) const;
+
+  /**
+   * Points ret at the value of key number index, or, when index is -1, at
+   * the value of the key that takes this array to shape. Returns the copy
+   * that was made, if any.
+   */
+  ShapedArray *slot(int index, const ArrayShape *shape, Variant *&ret,
+                    bool copy, bool checkExist);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_SHAPED_ARRAY_H__
@@ -0,0 +1,280 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/array/sort_keys.h>
+#include <runtime/base/zend/zend_functions.h>
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+// below this, introsort beats the passes of a radix sort
+static const int RadixSortMinSize = 1024;
+
+struct SortKeys::StringLess {
+  const SortKeys *keys;
+  explicit StringLess(const SortKeys *k) : keys(k) {}
+  bool operator()(int i1, int i2) const {
+    const StringKey &s1 = keys->m_strings[i1];
+    const StringKey &s2 = keys->m_strings[i2];
+    int len = s1.len < s2.len ? s1.len : s2.len;
+    int ret = memcmp(s1.data, s2.data, len);
+    return ret < 0 || (ret == 0 && s1.len < s2.len);
+  }
+};
+
+SortKeys::SortKeys()
+  : m_kind(None), m_descending(false), m_totalOrder(false) {
+}
+
+bool SortKeys::init(CArrRef arr, const std::vector<ssize_t> &positions,
+                    bool by_key, Array::PFUNC_CMP cmp_func) {
+  m_kind = None;
+  bool numeric = false;
+  bool regular = false;
+  if (cmp_func == Array::SortRegularAscending ||
+      cmp_func == Array::SortRegularDescending) {
+    regular = true;
+  } else if (cmp_func == Array::SortNumericAscending ||
+             cmp_func == Array::SortNumericDescending) {
+    numeric = true;
+  } else if (cmp_func != Array::SortStringAscending &&
+             cmp_func != Array::SortStringDescending) {
+    return false;
+  }
+  m_descending = cmp_func == Array::SortRegularDescending ||
+    cmp_func == Array::SortNumericDescending ||
+    cmp_func == Array::SortStringDescending;
+
+  int count = positions.size();
+  if (count == 0) return false;
+  Variant first = by_key ? arr->getKey(positions[0]) :
+    arr->getValue(positions[0]);
+  Kind kind;
+  if (numeric) {
+    kind = Doubles;
+  } else if (first.isString()) {
+    kind = regular ? Strings : CStrings;
+  } else if (!regular) {
+    return false;
+  } else if (first.isInteger()) {
+    kind = Ints;
+  } else if (first.isDouble()) {
+    kind = Doubles;
+  } else {
+    return false;
+  }
+
+  m_ints.clear();
+  m_doubles.clear();
+  m_strings.clear();
+  m_holders.clear();
+  if (kind == Ints) {
+    m_ints.reserve(count);
+  } else if (kind == Doubles) {
+    m_doubles.reserve(count);
+  } else {
+    m_strings.reserve(count);
+    m_holders.reserve(count);
+  }
+  m_totalOrder = true;
+
+  for (int i = 0; i < count; i++) {
+    Variant v = by_key ? arr->getKey(positions[i]) :
+      arr->getValue(positions[i]);
+    switch (kind) {
+    case Ints:
+      if (!v.isInteger()) return false;
+      m_ints.push_back(v.toInt64());
+      break;
+    case Doubles:
+      {
+        double d;
+        if (numeric) {
+          // conversions of anything else could have side effects
+          switch (v.getType()) {
+          case KindOfNull:
+          case KindOfBoolean:
+          case KindOfByte:
+          case KindOfInt16:
+          case KindOfInt32:
+          case KindOfInt64:
+          case KindOfDouble:
+          case KindOfStaticString:
+          case KindOfString:
+            d = v.toDouble();
+            break;
+          default:
+            return false;
+          }
+        } else {
+          if (!v.isDouble()) return false;
+          d = v.toDouble();
+        }
+        if (isnan(d)) return false; // comparisons would not be consistent
+        m_doubles.push_back(d);
+      }
+      break;
+    default:
+      if (!v.isString()) return false;
+      addString(v, kind);
+      break;
+    }
+  }
+  m_kind = kind;
+  return true;
+}
+
+void SortKeys::addString(CVarRef v, Kind kind) {
+  String s = v.toString();
+  StringKey key;
+  key.data = s.data();
+  key.len = s.size();
+  key.num = KindOfNull;
+  if (kind == Strings) {
+    // numeric strings compare as numbers, and not always consistently
+    key.num = is_numeric_string(key.data, key.len, &key.lval, &key.dval, 0);
+    if (key.num == KindOfDouble && !finite(key.dval)) {
+      key.num = KindOfNull;
+    }
+    if (key.num != KindOfNull) m_totalOrder = false;
+  } else if (memchr(key.data, '\0', key.len)) {
+    m_totalOrder = false;
+  }
+  m_holders.push_back(s);
+  m_strings.push_back(key);
+}
+
+int SortKeys::compareStrings(const StringKey &s1, const StringKey &s2) const {
+  if (s1.num != KindOfNull && s2.num != KindOfNull) {
+    // just like StringData::numericCompare()
+    if (s1.num == KindOfInt64 && s2.num == KindOfInt64) {
+      if (s1.lval > s2.lval) return 1;
+      if (s1.lval == s2.lval) return 0;
+      return -1;
+    }
+    double d1 = s1.num == KindOfInt64 ? (double)s1.lval : s1.dval;
+    double d2 = s2.num == KindOfInt64 ? (double)s2.lval : s2.dval;
+    if (d1 > d2) return 1;
+    if (d1 == d2) return 0;
+    return -1;
+  }
+  int len = s1.len < s2.len ? s1.len : s2.len;
+  int ret = memcmp(s1.data, s2.data, len);
+  if (ret) return ret;
+  if (s1.len == s2.len) return 0;
+  return len < s1.len ? 1 : -1;
+}
+
+int SortKeys::compare(int i1, int i2) const {
+  int ret;
+  switch (m_kind) {
+  case Ints:
+    {
+      int64 v1 = m_ints[i1];
+      int64 v2 = m_ints[i2];
+      ret = v1 < v2 ? -1 : (v1 == v2 ? 0 : 1);
+    }
+    break;
+  case Doubles:
+    {
+      double v1 = m_doubles[i1];
+      double v2 = m_doubles[i2];
+      ret = v1 < v2 ? -1 : (v1 == v2 ? 0 : 1);
+    }
+    break;
+  case Strings:
+    ret = compareStrings(m_strings[i1], m_strings[i2]);
+    break;
+  case CStrings:
+    ret = strcmp(m_strings[i1].data, m_strings[i2].data);
+    break;
+  default:
+    ASSERT(false);
+    return 0;
+  }
+  return m_descending ? -ret : ret;
+}
+
+bool SortKeys::canReorderTies(bool by_key, bool renumber) const {
+  if (!by_key && !renumber) return false;
+  // doubles that compare equal can still print differently, like 0 and -0
+  return m_kind == Ints ||
+    ((m_kind == Strings || m_kind == CStrings) && m_totalOrder);
+}
+
+void SortKeys::sort(std::vector<int> &indices) const {
+  ASSERT(m_kind == Ints || m_kind == Strings || m_kind == CStrings);
+  if (m_kind == Ints && (int)indices.size() >= RadixSortMinSize) {
+    radixSort(indices);
+  } else if (m_kind == Ints) {
+    vector<pair<int64, int> > pairs;
+    pairs.reserve(indices.size());
+    for (unsigned int i = 0; i < indices.size(); i++) {
+      pairs.push_back(make_pair(m_ints[indices[i]], indices[i]));
+    }
+    std::sort(pairs.begin(), pairs.end());
+    for (unsigned int i = 0; i < pairs.size(); i++) {
+      indices[i] = pairs[i].second;
+    }
+  } else {
+    std::sort(indices.begin(), indices.end(), StringLess(this));
+  }
+  if (m_descending) {
+    reverse(indices.begin(), indices.end());
+  }
+}
+
+void SortKeys::radixSort(std::vector<int> &indices) const {
+  int count = indices.size();
+  // with the sign bit flipped, unsigned order is signed order
+  vector<pair<uint64, int> > from(count), to(count);
+  for (int i = 0; i < count; i++) {
+    from[i].first = (uint64)m_ints[indices[i]] ^ (1ULL << 63);
+    from[i].second = indices[i];
+  }
+
+  int histogram[256];
+  for (int shift = 0; shift < 64; shift += 8) {
+    memset(histogram, 0, sizeof(histogram));
+    for (int i = 0; i < count; i++) {
+      histogram[(from[i].first >> shift) & 0xFF]++;
+    }
+    // nothing to do when every key has the same byte here
+    if (histogram[(from[0].first >> shift) & 0xFF] == count) continue;
+
+    int offset = 0;
+    for (int b = 0; b < 256; b++) {
+      int n = histogram[b];
+      histogram[b] = offset;
+      offset += n;
+    }
+    for (int i = 0; i < count; i++) {
+      to[histogram[(from[i].first >> shift) & 0xFF]++] = from[i];
+    }
+    from.swap(to);
+  }
+
+  for (int i = 0; i < count; i++) {
+    indices[i] = from[i].second;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,103 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_SORT_KEYS_H__
+#define __HPHP_SORT_KEYS_H__
+
+#include <runtime/base/complex_types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The keys or values a sort compares, taken out of their Variants once
+ * before sorting, so that comparisons work on plain integers, doubles or
+ * string bytes instead of converting and dispatching on types every time.
+ *
+ * This only stands in for Array's own regular, numeric and string
+ * comparisons, and only when every operand has a type the comparison
+ * handles without side effects. compare() gives the same answer the
+ * comparison function would, so zend_qsort() orders ties just like PHP.
+ * When ties cannot be told apart afterwards, sort() skips zend_qsort()
+ * altogether for a radix sort or an introsort.
+ */
+class SortKeys {
+public:
+  SortKeys();
+
+  /**
+   * Takes the keys or values at positions out of arr, if cmp_func is one of
+   * the comparisons this class knows. Returns false when the sort has to
+   * call cmp_func after all.
+   */
+  bool init(CArrRef arr, const std::vector<ssize_t> &positions, bool by_key,
+            Array::PFUNC_CMP cmp_func);
+  bool valid() const { return m_kind != None;}
+
+  /**
+   * What cmp_func returns for operands number i1 and i2, or at least a
+   * number of the same sign.
+   */
+  int compare(int i1, int i2) const;
+
+  /**
+   * Whether operands that compare equal are identical, or cannot even
+   * occur, so the order of ties is invisible in the sorted array.
+   */
+  bool canReorderTies(bool by_key, bool renumber) const;
+
+  /**
+   * Sorts indices by operand, when canReorderTies().
+   */
+  void sort(std::vector<int> &indices) const;
+
+private:
+  enum Kind {
+    None,
+    Ints,      // regular comparison of integers
+    Doubles,   // regular comparison of doubles, or numeric comparison
+    Strings,   // regular comparison of strings
+    CStrings,  // string comparison of strings, stopping at NUL
+  };
+
+  struct StringKey {
+    const char *data;
+    int len;
+    DataType num;  // what the string is as a number, if it is one
+    int64 lval;
+    double dval;
+  };
+
+  Kind m_kind;
+  bool m_descending;
+  bool m_totalOrder; // string operands compare like their bytes
+  std::vector<int64> m_ints;
+  std::vector<double> m_doubles;
+  std::vector<StringKey> m_strings;
+  std::vector<String> m_holders; // keeping m_strings' bytes around
+
+  void addString(CVarRef v, Kind kind);
+  int compareStrings(const StringKey &s1, const StringKey &s2) const;
+
+  void radixSort(std::vector<int> &indices) const;
+
+  struct StringLess;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_SORT_KEYS_H__
@@ -104,10 +104,7 @@ ssize_t ZendArray::iter_rewind(ssize_t prev) const {
 Variant ZendArray::getKey(ssize_t pos) const {
   ASSERT(pos && pos != ArrayData::invalid_index);
   Bucket *p = reinterpret_cast<Bucket *>(pos);
-  if (p->key) {
-    return p->key;
-  }
-  return (int64)p->h;
+  return p->getKey();
 }
 
 Variant ZendArray::getValue(ssize_t pos) const {
@@ -131,7 +128,7 @@ CVarRef ZendArray::getValueRef(ssize_t pos) const {
 bool ZendArray::isVectorData() const {
   int64 index = 0;
   for (Bucket *p = m_pListHead; p; p = p->pListNext) {
-    if (p->key || p->h != index++) return false;
+    if (p->hasStrKey() || p->h != index++) return false;
   }
   return true;
 }
@@ -179,10 +176,7 @@ Variant ZendArray::end() {
 Variant ZendArray::key() const {
   if (m_pos) {
     Bucket *p = reinterpret_cast<Bucket *>(m_pos);
-    if (p->key) {
-      return p->key;
-    }
-    return (int64)p->h;
+    return p->getKey();
   }
   return null;
 }
@@ -225,17 +219,9 @@ Variant ZendArray::each() {
 ///////////////////////////////////////////////////////////////////////////////
 // lookups
 
-static bool hit_string_key(const ZendArray::Bucket *p, const char *k, int len,
-                           int64 hash) {
-  if (!p->key) return false;
-  const char *data = p->key->data();
-  return data == k || p->h == hash && p->key->size() == len &&
-         memcmp(data, k, len) == 0;
-}
-
 ZendArray::Bucket *ZendArray::find(int64 h) const {
   for (Bucket *p = m_arBuckets[h & m_nTableMask]; p; p = p->pNext) {
-    if (p->key == NULL && p->h == h) {
+    if (!p->hasStrKey() && p->h == h) {
       return p;
     }
   }
@@ -252,7 +238,7 @@ ZendArray::Bucket *ZendArray::find(const char *k, int len,
     }
   }
   for (Bucket *p = m_arBuckets[prehash & m_nTableMask]; p; p = p->pNext) {
-    if (hit_string_key(p, k, len, prehash)) return p;
+    if (p->hitStrKey(k, len, prehash)) return p;
   }
   return NULL;
 }
@@ -261,7 +247,7 @@ ZendArray::Bucket ** ZendArray::findForErase(int64 h) const {
   Bucket ** ret = &(m_arBuckets[h & m_nTableMask]);
   Bucket * p = *ret;
   while (p) {
-    if (p->key == NULL && p->h == h) {
+    if (!p->hasStrKey() && p->h == h) {
       return ret;
     }
     ret = &(p->pNext);
@@ -282,7 +268,7 @@ ZendArray::Bucket ** ZendArray::findForErase(const char *k, int len,
   Bucket ** ret = &(m_arBuckets[prehash & m_nTableMask]);
   Bucket * p = *ret;
   while (p) {
-    if (hit_string_key(p, k, len, prehash)) return ret;
+    if (p->hitStrKey(k, len, prehash)) return ret;
     ret = &(p->pNext);
     p = *ret;
   }
@@ -292,7 +278,7 @@ ZendArray::Bucket ** ZendArray::findForErase(const char *k, int len,
 ZendArray::Bucket ** ZendArray::findForErase(Bucket * bucketPtr) const {
   if (bucketPtr == NULL)
     return NULL;
-  int64 h = bucketPtr->h;
+  int64 h = bucketPtr->hash();
   Bucket ** ret = &(m_arBuckets[h & m_nTableMask]);
   Bucket * p = *ret;
   while (p) {
@@ -517,7 +503,7 @@ void ZendArray::resize() {
 void ZendArray::rehash() {
   memset(m_arBuckets, 0, m_nTableSize * sizeof(Bucket *));
   for (Bucket *p = m_pListHead; p; p = p->pListNext) {
-    uint nIndex = (p->h & m_nTableMask);
+    uint nIndex = (p->hash() & m_nTableMask);
     CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
     SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
   }
@@ -526,7 +512,7 @@ void ZendArray::rehash() {
 bool ZendArray::nextInsert(CVarRef data) {
   int64 h = m_nNextFreeElement;
   Bucket * p = NEW(Bucket)(data);
-  p->h = h;
+  p->setIntKey(h);
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
@@ -549,7 +535,7 @@ bool ZendArray::addLval(int64 h, Variant **pDest, bool doFind /* = true */) {
     }
   }
   p = NEW(Bucket)();
-  p->h = h;
+  p->setIntKey(h);
   if (pDest) {
     *pDest = &p->data;
   }
@@ -580,9 +566,7 @@ bool ZendArray::addLval(litstr key, int len, int64 h, Variant **pDest,
     }
   }
   p = NEW(Bucket)();
-  p->key = NEW(StringData)(key, len, AttachLiteral);
-  p->key->incRefCount();
-  p->h = h;
+  p->setStrKey(key, len, h);
   *pDest = &p->data;
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
@@ -606,13 +590,7 @@ bool ZendArray::addLval(StringData *key, int64 h, Variant **pDest,
     }
   }
   p = NEW(Bucket)();
-  if (key->isShared()) {
-    p->key = key->copy(false);
-  } else {
-    p->key = key;
-  }
-  p->key->incRefCount();
-  p->h = h;
+  p->setStrKey(key, h);
   *pDest = &p->data;
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
@@ -630,7 +608,7 @@ bool ZendArray::add(int64 h, CVarRef data) {
     return false;
   }
   p = NEW(Bucket)(data);
-  p->h = h;
+  p->setIntKey(h);
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
@@ -651,9 +629,7 @@ bool ZendArray::add(litstr key, int64 h, CVarRef data) {
     return false;
   }
   p = NEW(Bucket)(data);
-  p->key = NEW(StringData)(key, len, AttachLiteral);
-  p->key->incRefCount();
-  p->h = h;
+  p->setStrKey(key, len, h);
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
@@ -670,13 +646,7 @@ bool ZendArray::add(StringData *key, int64 h, CVarRef data) {
     return false;
   }
   p = NEW(Bucket)(data);
-  if (key->isShared()) {
-    p->key = key->copy(false);
-  } else {
-    p->key = key;
-  }
-  p->key->incRefCount();
-  p->h = h;
+  p->setStrKey(key, h);
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
   SET_ARRAY_BUCKET_HEAD(m_arBuckets, nIndex, p);
@@ -695,7 +665,7 @@ bool ZendArray::update(int64 h, CVarRef data) {
   }
 
   p = NEW(Bucket)(data);
-  p->h = h;
+  p->setIntKey(h);
 
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
@@ -720,9 +690,7 @@ bool ZendArray::update(litstr key, int64 h, CVarRef data) {
   }
 
   p = NEW(Bucket)(data);
-  p->key = NEW(StringData)(key, len, AttachLiteral);
-  p->key->incRefCount();
-  p->h = h;
+  p->setStrKey(key, len, h);
 
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
@@ -744,13 +712,7 @@ bool ZendArray::update(StringData *key, int64 h, CVarRef data) {
   }
 
   p = NEW(Bucket)(data);
-  if (key->isShared()) {
-    p->key = key->copy(false);
-  } else {
-    p->key = key;
-  }
-  p->key->incRefCount();
-  p->h = h;
+  p->setStrKey(key, h);
 
   uint nIndex = (h & m_nTableMask);
   CONNECT_TO_BUCKET_DLLIST(p, m_arBuckets[nIndex]);
@@ -1042,13 +1004,9 @@ ZendArray *ZendArray::copyImpl() const {
       p->data.setContagious();
     }
     Bucket *np = NEW(Bucket)(p->data);
-    np->h = p->h;
-    if (p->key) {
-      np->key = p->key;
-      np->key->incRefCount();
-    }
+    np->copyKey(p);
 
-    uint nIndex = (p->h & target->m_nTableMask);
+    uint nIndex = (p->hash() & target->m_nTableMask);
     np->pNext = target->m_arBuckets[nIndex];
     target->m_arBuckets[nIndex] = np;
 
@@ -1073,10 +1031,10 @@ ZendArray *ZendArray::copyImpl() const {
   } else if (p == m_pListHead) {
     target->m_pos = (ssize_t)target->m_pListHead;
   } else {
-    if (p->key) {
-      target->m_pos = (ssize_t)target->find(p->key->data(),
-                                            p->key->size(),
-                                            (int64)p->h);
+    if (p->hasStrKey()) {
+      target->m_pos = (ssize_t)target->find(p->strKeyData(),
+                                            p->strKeySize(),
+                                            p->hash());
     } else {
       target->m_pos = (ssize_t)target->find((int64)p->h);
     }
@@ -1163,7 +1121,8 @@ ArrayData *ZendArray::pop(Variant &value) {
   }
   if (m_pListTail) {
     value = m_pListTail->data;
-    if (!m_pListTail->key && (uint)m_pListTail->h == m_nNextFreeElement - 1) {
+    if (!m_pListTail->hasStrKey() &&
+        (uint)m_pListTail->h == m_nNextFreeElement - 1) {
       m_nNextFreeElement--;
     }
     prepareBucketHeadsForWrite();
@@ -1254,7 +1213,7 @@ void ZendArray::renumber() {
   unsigned long i = 0;
   Bucket* p = m_pListHead;
   for (; p; p = p->pListNext) {
-    if (p->key == NULL) {
+    if (!p->hasStrKey()) {
       if (p->h != (int64)i) {
         goto rehashNeeded;
       }
@@ -1266,7 +1225,7 @@ void ZendArray::renumber() {
 
 rehashNeeded:
   for (; p; p = p->pListNext) {
-    if (p->key == NULL) {
+    if (!p->hasStrKey()) {
       p->h = i;
       ++i;
     }
@@ -1285,8 +1244,10 @@ void ZendArray::freeStrongIterators() {
 
 void ZendArray::onSetStatic() {
   for (Bucket *p = m_pListHead; p; p = p->pListNext) {
-    if (p->key) {
-      p->key->setStatic();
+    if (p->hasStrKey()) {
+      // threads will share this array, so getKey() must not change it
+      p->promoteKey();
+      p->skey->setStatic();
     }
     p->data.setStatic();
   }
@@ -1390,24 +1351,79 @@ void ZendArray::sweep() {
 // class Bucket
 
 ZendArray::Bucket::Bucket() :
-  h(0), key(NULL), pListNext(NULL), pListLast(NULL), pNext(NULL) {
+  pListNext(NULL), pListLast(NULL), pNext(NULL) {
+  setIntKey(0);
 }
 
 ZendArray::Bucket::Bucket(CVarRef d) :
-  h(0), key(NULL), data(d), pListNext(NULL), pListLast(NULL), pNext(NULL) {
+  data(d), pListNext(NULL), pListLast(NULL), pNext(NULL) {
+  setIntKey(0);
 }
 
 ZendArray::Bucket::~Bucket() {
-  if (key && key->decRefCount() == 0) {
-    DELETE(StringData)(key);
+  if (tag() == KeyString && skey->decRefCount() == 0) {
+    DELETE(StringData)(skey);
+  }
+}
+
+Variant ZendArray::Bucket::getKey() {
+  if (ktag == KeyInteger) return (int64)h;
+  promoteKey();
+  return skey;
+}
+
+void ZendArray::Bucket::promoteKey() {
+  if (ktag == KeyInteger || ktag == KeyString) return;
+  StringData *key = NEW(StringData)(ikey, ktag, CopyString);
+  key->incRefCount();
+  skey = key;
+  ktag = KeyString;
+}
+
+void ZendArray::Bucket::setStrKey(litstr k, int len, int64 hash) {
+  if (len <= KeyInlineMax) {
+    memcpy(ikey, k, len);
+    ktag = len;
+  } else {
+    skey = NEW(StringData)(k, len, AttachLiteral);
+    skey->incRefCount();
+    ktag = KeyString;
+  }
+  khash = hash;
+}
+
+void ZendArray::Bucket::setStrKey(StringData *k, int64 hash) {
+  int len = k->size();
+  if (len <= KeyInlineMax) {
+    memcpy(ikey, k->data(), len);
+    ktag = len;
+  } else {
+    skey = k->isShared() ? k->copy(false) : k;
+    skey->incRefCount();
+    ktag = KeyString;
+  }
+  khash = hash;
+}
+
+void ZendArray::Bucket::copyKey(const Bucket *src) {
+  if (src->ktag == KeyInteger) {
+    setIntKey(src->h);
+    return;
+  }
+  memcpy(ikey, src->ikey, sizeof(ikey));
+  ktag = src->ktag;
+  khash = src->khash;
+  if (ktag == KeyString) {
+    skey->incRefCount();
   }
 }
 
 void ZendArray::Bucket::dump() {
-  printf("ZendArray::Bucket: %llx, %p, %p, %p\n",
-         h, pListNext, pListLast, pNext);
-  if (key) {
-    key->dump();
+  printf("ZendArray::Bucket: %p, %p, %p\n", pListNext, pListLast, pNext);
+  switch (tag()) {
+  case KeyInteger: printf("%lld\n", (long long)h); break;
+  case KeyString:  skey->dump(); break;
+  default:         printf("%.*s\n", (int)tag(), ikey); break;
   }
   data.dump();
 }
@@ -115,18 +115,81 @@ public:
   virtual CVarRef currentRef();
   virtual CVarRef endRef();
 
+  /**
+   * An element and its key. Integer keys, and string keys of up to
+   * KeyInlineMax bytes, are stored right in the bucket, so short string keys
+   * need neither a StringData of their own nor reference counting. Longer
+   * keys point to a StringData. ktag tells which: the length of an inline
+   * key, KeyInteger or KeyString. String keys keep the low 32 bits of their
+   * hash, which is all a table mask ever uses, so copies and rehashes never
+   * hash them again, and lookups compare the hash before any bytes.
+   *
+   * getKey() turns an inline key into a StringData the first time the key is
+   * asked for, so iterating over an array more than once allocates at most
+   * once per key. Static arrays, which threads share, have all their keys
+   * turned into StringData up front.
+   */
   class Bucket {
   public:
+    static const int KeyInlineMax = 11;
+    static const unsigned char KeyInteger = 0xFF;
+    static const unsigned char KeyString = 0xFE;
+
     Bucket();
     Bucket(CVarRef d);
     ~Bucket();
 
-    int64       h;
-    StringData *key;
     Variant     data;
     Bucket     *pListNext;
     Bucket     *pListLast;
     Bucket     *pNext;
+    union {
+      int64       h;                 // integer key
+      StringData *skey;              // long string key
+      struct {
+        char          ikey[KeyInlineMax]; // short string key
+        unsigned char ktag;
+        uint32        khash;              // string keys only
+      };
+    };
+
+    unsigned char tag() const { return ktag; }
+    bool hasStrKey() const { return tag() != KeyInteger; }
+    const char *strKeyData() const {
+      return tag() == KeyString ? skey->data() : ikey;
+    }
+    int strKeySize() const {
+      return tag() == KeyString ? skey->size() : tag();
+    }
+    bool hitStrKey(const char *k, int len, int64 hash) const {
+      if (ktag == KeyInteger || khash != (uint32)hash) return false;
+      if (ktag == KeyString) {
+        const char *data = skey->data();
+        return data == k || (skey->size() == len &&
+                             memcmp(data, k, len) == 0);
+      }
+      return ktag == len && memcmp(ikey, k, len) == 0;
+    }
+
+    /**
+     * What the bucket is chained by in the hash table: an integer key, or
+     * the low 32 bits of a string key's hash.
+     */
+    int64 hash() const { return ktag == KeyInteger ? h : (int64)khash;}
+    Variant getKey();
+
+    void setIntKey(int64 k) {
+      h = k;
+      ktag = KeyInteger;
+    }
+    void setStrKey(litstr k, int len, int64 hash);
+    void setStrKey(StringData *k, int64 hash);
+    void copyKey(const Bucket *src);
+
+    /**
+     * Replace an inline key with a StringData.
+     */
+    void promoteKey();
 
     /**
      * Memory allocator methods.
@@ -329,8 +329,7 @@ Variant f_unserialize(CStrRef str) {
     return false;
   }
 
-  istringstream in(std::string(str.data(), str.size()));
-  VariableUnserializer vu(in);
+  VariableUnserializer vu(str.data(), str.size());
   Variant v;
   try {
     v = vu.unserialize();
@@ -646,9 +646,8 @@ ClassInfoUnique::ClassInfoUnique(const char **&p) {
       staticVariable->name = *p++;
       staticVariable->valueLen = (int64)(*p++);
       staticVariable->valueText = *p++;
-      istringstream in(std::string(staticVariable->valueText,
-                                   staticVariable->valueLen));
-      VariableUnserializer vu(in);
+      VariableUnserializer vu(staticVariable->valueText,
+                              staticVariable->valueLen);
       try {
         staticVariable->value = vu.unserialize();
         staticVariable->value.setStatic();
@@ -683,8 +682,7 @@ ClassInfoUnique::ClassInfoUnique(const char **&p) {
     constant->valueText = *p++;
 
     if (constant->valueText) {
-      istringstream in(std::string(constant->valueText, constant->valueLen));
-      VariableUnserializer vu(in);
+      VariableUnserializer vu(constant->valueText, constant->valueLen);
       try {
         constant->value = vu.unserialize();
         constant->value.setStatic();
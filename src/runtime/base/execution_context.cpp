@@ -237,7 +237,7 @@ void ExecutionContext::obStart(CVarRef handler /* = null */) {
 
 String ExecutionContext::obCopyContents() {
   if (!m_buffers.empty()) {
-    StringBuffer &oss = m_buffers.back()->oss;
+    ChunkedBuffer &oss = m_buffers.back()->oss;
     if (!oss.empty()) {
       return oss.copy();
     }
@@ -247,7 +247,7 @@ String ExecutionContext::obCopyContents() {
 
 String ExecutionContext::obDetachContents() {
   if (!m_buffers.empty()) {
-    StringBuffer &oss = m_buffers.back()->oss;
+    ChunkedBuffer &oss = m_buffers.back()->oss;
     if (!oss.empty()) {
       return oss.detach();
     }
@@ -255,6 +255,17 @@ String ExecutionContext::obDetachContents() {
   return "";
 }
 
+void ExecutionContext::obSendContents(Transport *transport) {
+  ASSERT(transport);
+  if (m_buffers.empty()) {
+    transport->sendRaw((void*)"", 0);
+    return;
+  }
+  ChunkedBuffer &oss = m_buffers.back()->oss;
+  transport->sendBuffer(oss);
+  oss.reset();
+}
+
 int ExecutionContext::obGetContentLength() {
   if (m_buffers.empty()) {
     return 0;
@@ -290,7 +301,10 @@ bool ExecutionContext::obFlush() {
       }
       return true;
     }
-    writeStdout(last->oss.data(), last->oss.size());
+    for (const ChunkedBuffer::Chunk *chunk = last->oss.head(); chunk;
+         chunk = chunk->next) {
+      writeStdout(chunk->data, chunk->size);
+    }
     last->oss.reset();
     return true;
   }
@@ -343,12 +357,15 @@ void ExecutionContext::flush() {
              (m_transport == NULL ||
               (m_transport->getHTTPVersion() == "1.1" &&
                m_transport->getMethod() != Transport::HEAD))) {
-    StringBuffer &oss = m_buffers.front()->oss;
+    ChunkedBuffer &oss = m_buffers.front()->oss;
     if (!oss.empty()) {
       if (m_transport) {
-        m_transport->sendRaw((void*)oss.data(), oss.size(), 200, false, true);
+        m_transport->sendBuffer(oss, 200, true);
       } else {
-        writeStdout(oss.data(), oss.size());
+        for (const ChunkedBuffer::Chunk *chunk = oss.head(); chunk;
+             chunk = chunk->next) {
+          writeStdout(chunk->data, chunk->size);
+        }
         fflush(stdout);
       }
       oss.reset();
@@ -18,6 +18,7 @@
 #include <runtime/base/memory/leak_detectable.h>
 #include <runtime/base/memory/sweepable.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/allocation_profiler.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -32,6 +33,7 @@ MemoryManager::MemoryManager() : m_enabled(false), m_checkpoint(false) {
   if (RuntimeOption::EnableMemoryManager) {
     m_enabled = true;
   }
+  m_stats.sampleRandom = 0;
   resetStats();
   m_stats.maxBytes = 0;
 }
@@ -41,6 +43,7 @@ void MemoryManager::resetStats() {
   m_stats.alloc = 0;
   m_stats.peakUsage = 0;
   m_stats.peakAlloc = 0;
+  AllocationProfiler::StartCountdown(m_stats);
 }
 
 void MemoryManager::add(SmartAllocatorImpl *allocator) {
@@ -16,9 +16,11 @@
 
 #include <runtime/base/memory/smart_allocator.h>
 #include <runtime/base/memory/memory_manager.h>
+#include <runtime/base/memory/smart_block_pool.h>
 #include <runtime/base/resource_data.h>
 #include <runtime/base/server/server_stats.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/allocation_profiler.h>
 #include <util/logger.h>
 
 using namespace std;
@@ -83,7 +85,7 @@ SmartAllocatorImpl::SmartAllocatorImpl(int nameEnum, int itemCount,
   ASSERT(m_stats);
 
   m_colMax = m_itemSize * m_itemCount;
-  m_blocks.push_back((char *)malloc(m_colMax));
+  m_blocks.push_back((char *)SmartBlockPool::Acquire(m_colMax));
   m_stats->alloc += m_colMax;
   if (m_stats->alloc > m_stats->peakAlloc) {
     m_stats->peakAlloc = m_stats->alloc;
@@ -107,7 +109,7 @@ SmartAllocatorImpl::SmartAllocatorImpl(int nameEnum, int itemCount,
 SmartAllocatorImpl::~SmartAllocatorImpl() {
   unsigned int size = m_blocks.size();
   for (unsigned int i = m_backupBlocks.size(); i < size; i += m_multiplier) {
-    free(m_blocks[i]);
+    SmartBlockPool::Release(m_blocks[i], m_colMax * m_multiplier);
   }
   size = m_backupBlocks.size();
   for (unsigned int i = 0; i < size; i++) {
@@ -125,6 +127,9 @@ void *SmartAllocatorImpl::alloc() {
   if (m_stats->usage > m_stats->peakUsage) {
     checkMemUsage();
   }
+  if ((m_stats->sampleCountdown -= m_itemSize) <= 0) {
+    AllocationProfiler::OnSample(*m_stats);
+  }
   if (m_stats->usage <= m_stats->peakUsage && m_freelist.size() > 0) {
     // Fast path
 #ifdef SMART_ALLOCATOR_STACKTRACE
@@ -143,7 +148,8 @@ void *SmartAllocatorImpl::allocHelper() {
     if (m_allocatedBlocks == 0) {
       // used up the last batch
       ASSERT((m_blocks.size() - m_backupBlocks.size()) % m_multiplier == 0);
-      m_blocks.push_back((char *)malloc(m_colMax * m_multiplier));
+      m_blocks.push_back(
+        (char *)SmartBlockPool::Acquire(m_colMax * m_multiplier));
       m_allocatedBlocks = m_multiplier - 1;
     } else {
       // still have some blocks left from the last batch
@@ -344,19 +350,22 @@ void SmartAllocatorImpl::rollbackObjects(LinearAllocator &allocator) {
     ASSERT(m_freelist.size() == 0);
     for (unsigned int i = m_multiplier; i < m_blocks.size();
          i += m_multiplier) {
-      free(m_blocks[i]);
+      SmartBlockPool::Release(m_blocks[i], m_colMax * m_multiplier);
     }
     m_blocks.resize(1);
     if (m_multiplier != newMultiplier) {
-      m_blocks[0] = (char *)realloc(m_blocks[0], m_colMax * newMultiplier);
+      // nothing in the block is alive, so there is nothing to copy over
+      SmartBlockPool::Release(m_blocks[0], m_colMax * m_multiplier);
+      m_blocks[0] = (char *)SmartBlockPool::Acquire(m_colMax * newMultiplier);
     }
 
     m_multiplier = newMultiplier;
     m_allocatedBlocks = m_multiplier - 1;
   } else {
+    // blocks past the checkpoint can be reused by any thread
     for (unsigned int i = m_backupBlocks.size(); i < m_blocks.size();
          i += m_multiplier) {
-      free(m_blocks[i]);
+      SmartBlockPool::Release(m_blocks[i], m_colMax * m_multiplier);
     }
     m_blocks.resize(m_backupBlocks.size());
     copyMemoryBlocks(m_blocks, m_backupBlocks, m_colChecked, m_colMax);
@@ -119,6 +119,8 @@ struct MemoryUsageStats {
   int64 alloc;     // how many bytes are currently malloc-ed
   int64 peakUsage; // how many bytes have been dispensed at maximum
   int64 peakAlloc; // how many bytes malloc-ed at maximum
+  int64 sampleCountdown; // bytes left until AllocationProfiler samples
+  uint64 sampleRandom;   // AllocationProfiler's random state for this thread
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,168 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/memory/smart_block_pool.h>
+#include <runtime/base/runtime_option.h>
+#include <util/atomic.h>
+#include <util/lock.h>
+#include <util/striped_counter.h>
+#include <util/util.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// allocators use a few dozen distinct block sizes at most
+const int MaxClasses = 64;
+
+struct PooledBlock {
+  char *ptr;
+  time_t released;
+};
+
+/**
+ * Blocks of one size, oldest first. Blocks are handed out from the back,
+ * so the ones given back to the kernel are always at the front.
+ */
+struct SizeClass {
+  explicit SizeClass(size_t s) : size(s), advised(0) {}
+
+  size_t size;
+  Mutex mutex;
+  vector<PooledBlock> blocks;
+  size_t advised; // blocks[0..advised) have no pages left
+};
+
+// never freed, as allocators of exiting threads may still release blocks
+// during static destruction
+SizeClass *s_classes[MaxClasses];
+
+int64 s_pooledBytes = 0;
+int64 s_advisedBytes = 0;
+StripedCounter s_hits;
+StripedCounter s_misses;
+
+SizeClass *find_class(size_t size, bool create) {
+  for (int i = 0; i < MaxClasses; i++) {
+    SizeClass *cls = *(SizeClass * volatile *)&s_classes[i];
+    if (cls == NULL) {
+      if (!create) return NULL;
+      SizeClass *created = new SizeClass(size);
+      cls = __sync_val_compare_and_swap(&s_classes[i], (SizeClass*)NULL,
+                                        created);
+      if (cls == NULL) return created;
+      // somebody else took the slot first, maybe with the same size
+      delete created;
+    }
+    if (cls->size == size) return cls;
+  }
+  return NULL;
+}
+
+void advise(char *block, size_t size) {
+#ifdef MADV_DONTNEED
+  // only whole pages inside the block, leaving malloc's headers alone
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t)block + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)block + size) & ~(page - 1);
+  if (start < end) {
+    madvise((void*)start, end - start, MADV_DONTNEED);
+  }
+#endif
+}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void *SmartBlockPool::Acquire(size_t size) {
+  SizeClass *cls = find_class(size, false);
+  if (cls) {
+    Lock lock(cls->mutex);
+    if (!cls->blocks.empty()) {
+      char *block = cls->blocks.back().ptr;
+      cls->blocks.pop_back();
+      if (cls->advised > cls->blocks.size()) {
+        cls->advised = cls->blocks.size();
+        atomic_add(s_advisedBytes, -(int64)size);
+      }
+      atomic_add(s_pooledBytes, -(int64)size);
+      s_hits.inc();
+      return block;
+    }
+  }
+  s_misses.inc();
+  return malloc(size);
+}
+
+void SmartBlockPool::Release(void *block, size_t size) {
+  if (block == NULL) return;
+  if (s_pooledBytes + (int64)size > RuntimeOption::SmartBlockPoolMaxBytes) {
+    free(block);
+    return;
+  }
+  SizeClass *cls = find_class(size, true);
+  if (cls == NULL) {
+    free(block);
+    return;
+  }
+  PooledBlock pooled;
+  pooled.ptr = (char*)block;
+  pooled.released = time(NULL);
+  atomic_add(s_pooledBytes, (int64)size);
+  Lock lock(cls->mutex);
+  cls->blocks.push_back(pooled);
+}
+
+void SmartBlockPool::Trim(int idleSeconds) {
+  time_t cutoff = time(NULL) - idleSeconds;
+  for (int i = 0; i < MaxClasses; i++) {
+    SizeClass *cls = *(SizeClass * volatile *)&s_classes[i];
+    if (cls == NULL) break;
+    Lock lock(cls->mutex);
+    while (cls->advised < cls->blocks.size() &&
+           cls->blocks[cls->advised].released <= cutoff) {
+      advise(cls->blocks[cls->advised].ptr, cls->size);
+      cls->advised++;
+      atomic_add(s_advisedBytes, (int64)cls->size);
+    }
+  }
+}
+
+std::string SmartBlockPool::ReportStats(int indent) {
+  int64 blocks = 0;
+  int sizes = 0;
+  for (; sizes < MaxClasses; sizes++) {
+    SizeClass *cls = *(SizeClass * volatile *)&s_classes[sizes];
+    if (cls == NULL) break;
+    Lock lock(cls->mutex);
+    blocks += cls->blocks.size();
+  }
+  string out;
+  Util::appendXmlElement(out, indent, "Sizes", sizes);
+  Util::appendXmlElement(out, indent, "Blocks", blocks);
+  Util::appendXmlElement(out, indent, "PooledBytes", s_pooledBytes);
+  Util::appendXmlElement(out, indent, "AdvisedBytes", s_advisedBytes);
+  Util::appendXmlElement(out, indent, "Hits", s_hits.get());
+  Util::appendXmlElement(out, indent, "Misses", s_misses.get());
+  return out;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,67 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_SMART_BLOCK_POOL_H__
+#define __HPHP_SMART_BLOCK_POOL_H__
+
+#include <util/base.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Process-wide pool of SmartAllocator blocks, one free list per block size.
+ *
+ * Every request thread grows its allocators past the memory checkpoint as
+ * the request needs, and rolls them back when the request ends. Instead of
+ * going back to malloc(), and from there to whichever arena the thread used,
+ * blocks released by rollback wait here for the next thread that needs a
+ * block of that size, so a burst on some threads does not leave memory
+ * stranded with them once it is over. Up to Server.SmartBlockPool.MaxMB is
+ * kept, anything over is freed, and blocks nobody has asked for in
+ * Server.SmartBlockPool.IdleSeconds give their pages back to the kernel
+ * with madvise(MADV_DONTNEED) while staying in the pool.
+ */
+class SmartBlockPool {
+public:
+  /**
+   * A block of "size" bytes, from the pool if it has one.
+   */
+  static void *Acquire(size_t size);
+
+  /**
+   * Hands a block obtained from Acquire() or malloc() back to the pool.
+   */
+  static void Release(void *block, size_t size);
+
+  /**
+   * Gives back the pages of blocks that have been in the pool for at least
+   * idleSeconds. Called about once a second by the server's watch dog.
+   */
+  static void Trim(int idleSeconds);
+
+  /**
+   * Pooled blocks and bytes, how many of those bytes were given back, and
+   * how many blocks were reused, as XML elements. The counters are bumped
+   * without synchronization, so they are approximate.
+   */
+  static std::string ReportStats(int indent);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_SMART_BLOCK_POOL_H__
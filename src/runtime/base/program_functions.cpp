@@ -25,6 +25,7 @@
 #include <runtime/base/server/pagelet_server.h>
 #include <runtime/base/server/xbox_server.h>
 #include <runtime/base/server/http_server.h>
+#include <runtime/base/server/prefork_server.h>
 #include <runtime/base/server/replay_transport.h>
 #include <runtime/base/server/http_request_handler.h>
 #include <runtime/base/server/admin_request_handler.h>
@@ -39,6 +40,9 @@
 #include <runtime/base/source_info.h>
 #include <runtime/base/rtti_info.h>
 #include <runtime/base/frame_injection.h>
+#include <runtime/base/sampling_profiler.h>
+#include <runtime/base/allocation_profiler.h>
+#include <runtime/base/time/timezone.h>
 #include <runtime/ext/extension.h>
 #include <runtime/ext/ext_fb.h>
 #include <runtime/ext/ext_json.h>
@@ -49,6 +53,7 @@
 #include <runtime/eval/debugger/debugger_client.h>
 #include <runtime/base/fiber_async_func.h>
 #include <runtime/base/util/simple_counter.h>
+#include <runtime/base/util/dns_cache.h>
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/positional_options.hpp>
@@ -793,12 +798,20 @@ void hphp_process_init() {
   XboxServer::Restart();
   Extension::InitModules();
   apc_load(RuntimeOption::ApcLoadThread);
+  TimeZone::Preload(RuntimeOption::TimeZonePreload);
   StaticString::FinishInit();
   Eval::Debugger::StartServer();
+  if (RuntimeOption::EnableSamplingProfiler) {
+    SamplingProfiler::Start();
+  }
+  if (RuntimeOption::EnableAllocationProfiler) {
+    AllocationProfiler::Start();
+  }
 }
 
 void hphp_session_init() {
   ThreadInfo::s_threadInfo->onSessionInit();
+  SamplingProfiler::OnSessionInit(ThreadInfo::s_threadInfo.get());
   MemoryManager::TheMemoryManager()->resetStats();
 
   if (!s_warmup_state->done) {
@@ -989,7 +1002,13 @@ void hphp_session_exit() {
   }
   mm->resetStats();
 
-  if (mm->afterCheckpoint()) {
+  if (mm->afterCheckpoint() && PreforkServer::IsRetiring()) {
+    // this worker process exits right after its last request, and the
+    // kernel throws its pages away: resources still need closing, but
+    // there is no point in restoring the checkpoint
+    ServerStatsHelper ssh("sweep");
+    mm->sweepAll();
+  } else if (mm->afterCheckpoint()) {
     ServerStatsHelper ssh("rollback");
     mm->sweepAll();
 
@@ -1009,8 +1028,25 @@ void hphp_session_exit() {
   }
 }
 
+bool hphp_warmup_thread() {
+  hphp_session_init();
+  ExecutionContext *context = hphp_context_init();
+  const std::string &warmupDoc = RuntimeOption::WarmupDocument;
+  String oldCwd = context->getCwd();
+  if (!warmupDoc.empty()) {
+    hphp_chdir_file(warmupDoc);
+  }
+  bool error;
+  bool ret = hphp_warmup(context, warmupDoc, "", "", error);
+  context->setCwd(oldCwd);
+  hphp_context_exit(context, false);
+  hphp_session_exit();
+  return ret;
+}
+
 void hphp_process_exit() {
   Eval::Debugger::Stop();
+  DnsCache::Stop();
   Extension::ShutdownModules();
 }
 
@@ -78,6 +78,13 @@ void hphp_context_exit(ExecutionContext *context, bool psp,
 
 void hphp_session_exit();
 void hphp_process_exit();
+
+/**
+ * Runs WarmupDocument and takes the memory checkpoint on the calling thread
+ * without serving a request, so that a process forked off this thread
+ * starts out warmed up. Returns false if warmup failed.
+ */
+bool hphp_warmup_thread();
 bool hphp_is_warmup_enabled();
 void hphp_set_warmup_enabled();
 
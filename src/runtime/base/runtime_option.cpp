@@ -77,6 +77,9 @@ std::string RuntimeOption::ServerIP;
 std::string RuntimeOption::ServerPrimaryIP;
 int RuntimeOption::ServerPort;
 int RuntimeOption::ServerThreadCount = 50;
+int RuntimeOption::ServerEventLoopCount = 1;
+int RuntimeOption::ServerPreforkWorkers = 0;
+int RuntimeOption::ServerPreforkMaxRequests = 1;
 int RuntimeOption::PageletServerThreadCount = 0;
 int RuntimeOption::FiberCount = 0;
 int RuntimeOption::RequestTimeoutSeconds = 0;
@@ -136,6 +139,8 @@ std::string RuntimeOption::XboxServerInfoReqInitFunc;
 std::string RuntimeOption::XboxServerInfoReqInitDoc;
 std::string RuntimeOption::XboxProcessMessageFunc = "xbox_process_message";
 std::string RuntimeOption::XboxPassword;
+int RuntimeOption::XboxConnectionPoolSize = 0;
+bool RuntimeOption::XboxFBSerializeMessages = false;
 
 std::string RuntimeOption::SourceRoot;
 std::vector<std::string> RuntimeOption::IncludeSearchPaths;
@@ -168,6 +173,9 @@ std::set<std::string> RuntimeOption::StaticFileGenerators;
 FilesMatchPtrVec RuntimeOption::FilesMatches;
 
 std::string RuntimeOption::TakeoverFilename;
+int RuntimeOption::TakeoverDrainSeconds = 5;
+int64 RuntimeOption::TakeoverAPCMaxBytes = 0;
+std::vector<std::string> RuntimeOption::TakeoverAPCPrefixes;
 int RuntimeOption::AdminServerPort;
 int RuntimeOption::AdminThreadCount = 1;
 std::string RuntimeOption::AdminPassword;
@@ -201,6 +209,12 @@ bool RuntimeOption::TranslateSource = false;
 bool RuntimeOption::RecordInput = false;
 bool RuntimeOption::ClearInputOnSuccess = true;
 std::string RuntimeOption::ProfilerOutputDir;
+bool RuntimeOption::EnableSamplingProfiler = false;
+int RuntimeOption::SamplingProfilerFrequency = 100;
+int RuntimeOption::SamplingProfilerTableSize = 4096;
+bool RuntimeOption::EnableAllocationProfiler = false;
+int64 RuntimeOption::AllocationProfilerInterval = 512 * 1024;
+int RuntimeOption::AllocationProfilerTableSize = 4096;
 std::string RuntimeOption::CoreDumpEmail;
 bool RuntimeOption::CoreDumpReport = true;
 bool RuntimeOption::LocalMemcache = false;
@@ -234,6 +248,8 @@ int64 RuntimeOption::MaxMemcacheKeyCount = 0;
 int RuntimeOption::SocketDefaultTimeout = 5;
 bool RuntimeOption::EnableMemoryManager = true;
 bool RuntimeOption::CheckMemory = false;
+int64 RuntimeOption::SmartBlockPoolMaxBytes = 64 * 1024 * 1024;
+int RuntimeOption::SmartBlockPoolIdleSeconds = 30;
 bool RuntimeOption::UseZendArray = true;
 bool RuntimeOption::UseSmallArray = false;
 bool RuntimeOption::UseDirectCopy = false;
@@ -241,6 +257,8 @@ bool RuntimeOption::EnableApc = true;
 bool RuntimeOption::EnableConstLoad = false;
 bool RuntimeOption::ApcUseSharedMemory = false;
 int RuntimeOption::ApcSharedMemorySize = 1024; // 1GB
+bool RuntimeOption::ApcSharedMemoryCompact = false;
+int RuntimeOption::ApcSharedMemoryChunkSize = 1024; // 1MB
 std::string RuntimeOption::ApcPrimeLibrary;
 int RuntimeOption::ApcLoadThread = 1;
 std::set<std::string> RuntimeOption::ApcCompletionKeys;
@@ -256,9 +274,7 @@ int RuntimeOption::ApcPurgeFrequency = 4096;
 
 bool RuntimeOption::EnableDnsCache = false;
 int RuntimeOption::DnsCacheTTL = 10 * 60; // 10 minutes
-time_t RuntimeOption::DnsCacheKeyMaturityThreshold = 20;
-size_t RuntimeOption::DnsCacheMaximumCapacity = 0;
-int RuntimeOption::DnsCacheKeyFrequencyUpdatePeriod = 1000;
+int RuntimeOption::DnsCacheNegativeTTL = 10;
 
 std::map<std::string, std::string> RuntimeOption::ServerVariables;
 std::map<std::string, std::string> RuntimeOption::EnvVariables;
@@ -295,6 +311,11 @@ std::string RuntimeOption::MailForceExtraParameters;
 int RuntimeOption::PregBacktraceLimit = 100000;
 int RuntimeOption::PregRecursionLimit = 100000;
 
+int RuntimeOption::StringInternTableSize = 65536;
+int RuntimeOption::StringInternMaxLength = 64;
+
+std::vector<std::string> RuntimeOption::TimeZonePreload;
+
 ///////////////////////////////////////////////////////////////////////////////
 // keep this block after all the above static variables, or we will have
 // static variable dependency problems on initialization
@@ -473,6 +494,9 @@ void RuntimeOption::Load(Hdf &config) {
     ServerPrimaryIP = Util::GetPrimaryIP();
     ServerPort = server["Port"].getInt16(80);
     ServerThreadCount = server["ThreadCount"].getInt32(50);
+    ServerEventLoopCount = server["EventLoops"].getInt32(1);
+    ServerPreforkWorkers = server["Prefork.Workers"].getInt32(0);
+    ServerPreforkMaxRequests = server["Prefork.MaxRequests"].getInt32(1);
     RequestTimeoutSeconds = server["RequestTimeoutSeconds"].getInt32(0);
     RequestMemoryMaxBytes = server["RequestMemoryMaxBytes"].getInt32(-1);
     ResponseQueueCount = server["ResponseQueueCount"].getInt32(0);
@@ -505,6 +529,12 @@ void RuntimeOption::Load(Hdf &config) {
     AlwaysPopulateRawPostData = server["AlwaysPopulateRawPostData"].getBool();
     LibEventSyncSend = server["LibEventSyncSend"].getBool(true);
     TakeoverFilename = server["TakeoverFilename"].getString();
+    {
+      Hdf takeover = server["Takeover"];
+      TakeoverDrainSeconds = takeover["DrainSeconds"].getInt32(5);
+      TakeoverAPCMaxBytes = takeover["APC"]["MaxMB"].getInt64(0) * 1024 * 1024;
+      takeover["APC"]["Prefixes"].get(TakeoverAPCPrefixes);
+    }
     ExpiresActive = server["ExpiresActive"].getBool(true);
     ExpiresDefault = server["ExpiresDefault"].getInt32(2592000);
     if (ExpiresDefault < 0) ExpiresDefault = 2592000;
@@ -590,6 +620,11 @@ void RuntimeOption::Load(Hdf &config) {
 
     EnableMemoryManager = server["EnableMemoryManager"].getBool(true);
     CheckMemory = server["CheckMemory"].getBool();
+    {
+      Hdf pool = server["SmartBlockPool"];
+      SmartBlockPoolMaxBytes = pool["MaxMB"].getInt64(64) * 1024 * 1024;
+      SmartBlockPoolIdleSeconds = pool["IdleSeconds"].getInt32(30);
+    }
     UseZendArray = server["UseZendArray"].getBool(true);
     UseSmallArray = server["UseSmallArray"].getBool(false);
     UseDirectCopy = server["UseDirectCopy"].getBool(false);
@@ -599,6 +634,9 @@ void RuntimeOption::Load(Hdf &config) {
     EnableConstLoad = apc["EnableConstLoad"].getBool(false);
     ApcUseSharedMemory = apc["UseSharedMemory"].getBool();
     ApcSharedMemorySize = apc["SharedMemorySize"].getInt32(1024 /* 1GB */);
+    ApcSharedMemoryCompact = apc["SharedMemoryCompact"].getBool();
+    ApcSharedMemoryChunkSize =
+      apc["SharedMemoryChunkSize"].getInt32(1024 /* 1MB */);
     ApcPrimeLibrary = apc["PrimeLibrary"].getString();
     ApcLoadThread = apc["LoadThread"].getInt16(2);
     apc["CompletionKeys"].get(ApcCompletionKeys);
@@ -635,10 +673,7 @@ void RuntimeOption::Load(Hdf &config) {
     Hdf dns = server["DnsCache"];
     EnableDnsCache = dns["Enable"].getBool();
     DnsCacheTTL = dns["TTL"].getInt32(600); // 10 minutes
-    DnsCacheKeyMaturityThreshold = dns["KeyMaturityThreshold"].getInt32(20);
-    DnsCacheMaximumCapacity = dns["MaximumCapacity"].getInt64(0);
-    DnsCacheKeyFrequencyUpdatePeriod = dns["KeyFrequencyUpdatePeriod"].
-      getInt32(1000);
+    DnsCacheNegativeTTL = dns["NegativeTTL"].getInt32(10);
 
     Hdf upload = server["Upload"];
     UploadMaxFileSize =
@@ -716,6 +751,8 @@ void RuntimeOption::Load(Hdf &config) {
     XboxServerInfoReqInitDoc = xbox["ServerInfo.RequestInitDocument"].get("");
     XboxProcessMessageFunc =
       xbox["ProcessMessageFunc"].get("xbox_process_message");
+    XboxConnectionPoolSize = xbox["ConnectionPoolSize"].getInt32(0);
+    XboxFBSerializeMessages = xbox["FBSerializeMessages"].getBool(false);
   }
   {
     PageletServerThreadCount = config["PageletServer.ThreadCount"].getInt32(0);
@@ -780,6 +817,19 @@ void RuntimeOption::Load(Hdf &config) {
     RecordInput = debug["RecordInput"].getBool();
     ClearInputOnSuccess = debug["ClearInputOnSuccess"].getBool(true);
     ProfilerOutputDir = debug["ProfilerOutputDir"].getString("/tmp");
+    {
+      Hdf sampling = debug["SamplingProfiler"];
+      EnableSamplingProfiler = sampling["Enable"].getBool();
+      SamplingProfilerFrequency = sampling["Frequency"].getInt32(100);
+      SamplingProfilerTableSize = sampling["TableSize"].getInt32(4096);
+    }
+    {
+      Hdf allocation = debug["AllocationProfiler"];
+      EnableAllocationProfiler = allocation["Enable"].getBool();
+      AllocationProfilerInterval =
+        allocation["Interval"].getInt64(512 * 1024);
+      AllocationProfilerTableSize = allocation["TableSize"].getInt32(4096);
+    }
     CoreDumpEmail = debug["CoreDumpEmail"].getString();
     if (!CoreDumpEmail.empty()) {
       StackTrace::ReportEmail = CoreDumpEmail;
@@ -872,6 +922,15 @@ void RuntimeOption::Load(Hdf &config) {
     PregBacktraceLimit = preg["BacktraceLimit"].getInt32(100000);
     PregRecursionLimit = preg["RecursionLimit"].getInt32(100000);
   }
+  {
+    Hdf intern = config["StringIntern"];
+    StringInternTableSize = intern["TableSize"].getInt32(65536);
+    StringInternMaxLength = intern["MaxLength"].getInt32(64);
+  }
+  {
+    Hdf tz = config["TimeZone"];
+    tz["Preload"].get(TimeZonePreload);
+  }
 
   Extension::LoadModules(config);
 }
@@ -74,6 +74,9 @@ public:
   static std::string ServerPrimaryIP;
   static int ServerPort;
   static int ServerThreadCount;
+  static int ServerEventLoopCount;
+  static int ServerPreforkWorkers;
+  static int ServerPreforkMaxRequests;
   static int PageletServerThreadCount;
   static int FiberCount;
   static int RequestTimeoutSeconds;
@@ -134,6 +137,8 @@ public:
   static std::string XboxServerInfoReqInitDoc;
   static std::string XboxProcessMessageFunc;
   static std::string XboxPassword;
+  static int XboxConnectionPoolSize;
+  static bool XboxFBSerializeMessages;
 
   static std::string SourceRoot;
   static std::vector<std::string> IncludeSearchPaths;
@@ -166,6 +171,9 @@ public:
   static FilesMatchPtrVec FilesMatches;
 
   static std::string TakeoverFilename;
+  static int TakeoverDrainSeconds;
+  static int64 TakeoverAPCMaxBytes;
+  static std::vector<std::string> TakeoverAPCPrefixes;
   static int AdminServerPort;
   static int AdminThreadCount;
   static std::string AdminPassword;
@@ -199,6 +207,12 @@ public:
   static bool RecordInput;
   static bool ClearInputOnSuccess;
   static std::string ProfilerOutputDir;
+  static bool EnableSamplingProfiler;
+  static int SamplingProfilerFrequency;
+  static int SamplingProfilerTableSize;
+  static bool EnableAllocationProfiler;
+  static int64 AllocationProfilerInterval;
+  static int AllocationProfilerTableSize;
   static std::string CoreDumpEmail;
   static bool CoreDumpReport;
   static bool LocalMemcache;
@@ -232,6 +246,8 @@ public:
   static int  SocketDefaultTimeout;
   static bool EnableMemoryManager;
   static bool CheckMemory;
+  static int64 SmartBlockPoolMaxBytes;
+  static int SmartBlockPoolIdleSeconds;
   static bool UseZendArray; // ignored: ZendArray is always enabled
   static bool UseSmallArray;
   static bool UseDirectCopy;
@@ -239,6 +255,8 @@ public:
   static bool EnableConstLoad;
   static bool ApcUseSharedMemory;
   static int ApcSharedMemorySize;
+  static bool ApcSharedMemoryCompact;
+  static int ApcSharedMemoryChunkSize;
   static std::string ApcPrimeLibrary;
   static int ApcLoadThread;
   static std::set<std::string> ApcCompletionKeys;
@@ -262,9 +280,7 @@ public:
 
   static bool EnableDnsCache;
   static int DnsCacheTTL;
-  static time_t DnsCacheKeyMaturityThreshold;
-  static size_t DnsCacheMaximumCapacity;
-  static int DnsCacheKeyFrequencyUpdatePeriod;
+  static int DnsCacheNegativeTTL;
 
   static std::map<std::string, std::string> ServerVariables;
 
@@ -309,6 +325,13 @@ public:
   static int PregBacktraceLimit;
   static int PregRecursionLimit;
 
+  // process-wide string interning
+  static int StringInternTableSize;
+  static int StringInternMaxLength;
+
+  // timezones parsed at startup
+  static std::vector<std::string> TimeZonePreload;
+
   static bool FastMethodCall;
 };
 
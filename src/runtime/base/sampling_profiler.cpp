@@ -0,0 +1,294 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/sampling_profiler.h>
+#include <runtime/base/frame_injection.h>
+#include <runtime/base/runtime_option.h>
+#include <util/atomic.h>
+#include <util/hash.h>
+#include <util/lock.h>
+#include <util/logger.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct StackSlot {
+  int64 hash;    // 0 while the slot is free
+  int64 count;
+  int ready;     // set once stack[] is filled in
+  int size;
+  char stack[SamplingProfiler::MaxStackSize];
+};
+
+const int MaxDepth = 256;
+
+StackSlot *s_slots = NULL;
+int s_slotCount = 0;
+int64 s_dropped = 0;
+
+// s_running is also the tag our timers carry in sigev_value, so the handler
+// can tell its own SIGPROFs from anyone else's
+int s_running = 0;
+int s_inFlight = 0;
+int s_generation = 0;
+Mutex s_mutex;
+
+__thread ThreadInfo *t_info = NULL;
+
+/**
+ * Each thread's CPU clock timer, deleted when the thread goes away.
+ */
+class SampleTimer {
+public:
+  SampleTimer() : m_armed(false), m_generation(0) {}
+  ~SampleTimer() { disarm();}
+
+  void arm(int generation) {
+    if (m_armed && m_generation == generation) return;
+    disarm();
+
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_value.sival_ptr = &s_running;
+    sev.sigev_notify_thread_id = syscall(SYS_gettid);
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &m_timer) != 0) {
+      Logger::Warning("Unable to create sampling timer: %s",
+                      strerror(errno));
+      return;
+    }
+
+    int frequency = RuntimeOption::SamplingProfilerFrequency;
+    if (frequency <= 0) frequency = 100;
+    int64 interval = 1000000000LL / frequency;
+    struct itimerspec ts;
+    ts.it_interval.tv_sec = interval / 1000000000;
+    ts.it_interval.tv_nsec = interval % 1000000000;
+    ts.it_value = ts.it_interval;
+    if (timer_settime(m_timer, 0, &ts, NULL) != 0) {
+      Logger::Warning("Unable to start sampling timer: %s", strerror(errno));
+      timer_delete(m_timer);
+      return;
+    }
+    m_armed = true;
+    m_generation = generation;
+  }
+
+  void disarm() {
+    if (m_armed) {
+      timer_delete(m_timer);
+      m_armed = false;
+    }
+  }
+
+private:
+  bool m_armed;
+  int m_generation;
+  timer_t m_timer;
+};
+IMPLEMENT_THREAD_LOCAL(SampleTimer, s_timer);
+
+void on_sample(int sig, siginfo_t *si, void *context) {
+  if (si->si_code != SI_TIMER || si->si_value.sival_ptr != &s_running) {
+    return;
+  }
+  ThreadInfo *info = t_info;
+  if (info == NULL) return;
+
+  int savedErrno = errno;
+  atomic_inc(s_inFlight);
+  if (*(volatile int *)&s_running) {
+    SamplingProfiler::RecordStack(*(FrameInjection *volatile *)&info->m_top);
+  }
+  atomic_dec(s_inFlight);
+  errno = savedErrno;
+}
+
+/**
+ * Frame names go into the folded line as they are, except for the two
+ * characters that are part of the format.
+ */
+int append_frame(char *buf, int pos, const char *name) {
+  if (pos) {
+    if (pos >= SamplingProfiler::MaxStackSize) return pos;
+    buf[pos++] = ';';
+  }
+  for (; *name && pos < SamplingProfiler::MaxStackSize; name++) {
+    char ch = *name;
+    buf[pos++] = (ch == ';' || ch == ' ') ? '_' : ch;
+  }
+  return pos;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SamplingProfiler::Start() {
+  Lock lock(s_mutex);
+  if (s_running) return;
+
+  if (s_slots == NULL) {
+    // allocated once and never freed, so that a late signal can never see
+    // a table that went away
+    s_slotCount = RuntimeOption::SamplingProfilerTableSize;
+    if (s_slotCount <= 0) s_slotCount = 4096;
+    s_slots = (StackSlot*)calloc(s_slotCount, sizeof(StackSlot));
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = on_sample;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGPROF, &sa, NULL);
+
+  s_generation++;
+  atomic_inc(s_running);
+}
+
+void SamplingProfiler::Stop() {
+  Lock lock(s_mutex);
+  if (s_running) {
+    // the timers themselves are deleted by their threads, at their next
+    // request, or when they exit
+    atomic_dec(s_running);
+  }
+}
+
+bool SamplingProfiler::IsRunning() {
+  return s_running;
+}
+
+void SamplingProfiler::Clear() {
+  Lock lock(s_mutex);
+  if (s_slots == NULL) return;
+
+  bool running = s_running;
+  if (running) atomic_dec(s_running);
+  while (*(volatile int *)&s_inFlight) {
+    usleep(100);
+  }
+  memset(s_slots, 0, s_slotCount * sizeof(StackSlot));
+  s_dropped = 0;
+  if (running) atomic_inc(s_running);
+}
+
+void SamplingProfiler::OnSessionInit(ThreadInfo *info) {
+  t_info = info;
+  if (s_running) {
+    s_timer->arm(s_generation);
+  } else if (!s_timer.isNull()) {
+    s_timer->disarm();
+  }
+}
+
+void SamplingProfiler::RecordStack(const FrameInjection *top) {
+  if (s_slots == NULL) return;
+
+  char buf[MaxStackSize];
+  int size = FoldStack(top, buf);
+
+  int64 hash = hash_string(buf, size) | 1;
+  int index = (uint64)hash % s_slotCount;
+  for (int probe = 0; probe < s_slotCount; probe++) {
+    StackSlot &slot = s_slots[index];
+    int64 current = slot.hash;
+    if (current == 0) {
+      current = __sync_val_compare_and_swap(&slot.hash, (int64)0, hash);
+      if (current == 0) {
+        memcpy(slot.stack, buf, size);
+        slot.size = size;
+        __sync_synchronize();
+        slot.ready = 1;
+        atomic_add(slot.count, (int64)1);
+        return;
+      }
+    }
+    if (current == hash) {
+      atomic_add(slot.count, (int64)1);
+      return;
+    }
+    if (++index == s_slotCount) index = 0;
+  }
+  atomic_add(s_dropped, (int64)1);
+}
+
+int SamplingProfiler::FoldStack(const FrameInjection *top, char *buf) {
+  const char *names[MaxDepth];
+  int depth = 0;
+  for (const FrameInjection *frame = top; frame && depth < MaxDepth;
+       frame = frame->getPrev()) {
+    names[depth++] = frame->getFunction();
+  }
+
+  int size = 0;
+  if (depth == 0) {
+    size = append_frame(buf, size, "[native]");
+  }
+  while (depth > 0) {
+    size = append_frame(buf, size, names[--depth]);
+  }
+  return size;
+}
+
+static bool more_samples(const pair<int64, const StackSlot*> &a,
+                         const pair<int64, const StackSlot*> &b) {
+  return a.first > b.first;
+}
+
+int SamplingProfiler::Dump(std::string &out) {
+  Lock lock(s_mutex);
+  if (s_slots == NULL) return 0;
+
+  vector<pair<int64, const StackSlot*> > stacks;
+  for (int i = 0; i < s_slotCount; i++) {
+    const StackSlot &slot = s_slots[i];
+    if (*(volatile int *)&slot.ready && slot.count) {
+      stacks.push_back(pair<int64, const StackSlot*>(slot.count, &slot));
+    }
+  }
+  sort(stacks.begin(), stacks.end(), more_samples);
+
+  char count[32];
+  for (unsigned int i = 0; i < stacks.size(); i++) {
+    const StackSlot *slot = stacks[i].second;
+    snprintf(count, sizeof(count), " %lld\n", (long long)stacks[i].first);
+    out.append(slot->stack, slot->size);
+    out += count;
+  }
+  return stacks.size();
+}
+
+int64 SamplingProfiler::GetDroppedCount() {
+  return s_dropped;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
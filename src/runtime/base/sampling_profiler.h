@@ -0,0 +1,85 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_SAMPLING_PROFILER_H__
+#define __HPHP_SAMPLING_PROFILER_H__
+
+#include <runtime/base/types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Statistical profiler that is cheap enough to leave on. Each request thread
+ * gets a timer on its own CPU clock; when it fires, the SIGPROF handler walks
+ * the thread's FrameInjection chain and counts the stack in a fixed-size,
+ * process-wide table. The table is lock-free: a stack claims a slot with one
+ * compare-and-swap the first time it is seen, and after that every sample is
+ * a single atomic add. Nothing is allocated in the signal handler.
+ *
+ * Dump() writes the table in the folded format flamegraph.pl reads, one
+ * "root;caller;callee count" line per distinct stack.
+ */
+class SamplingProfiler {
+public:
+  /**
+   * Longest folded stack kept, in bytes; longer ones lose their leaf frames.
+   */
+  static const int MaxStackSize = 480;
+
+  static void Start();
+  static void Stop();
+  static bool IsRunning();
+
+  /**
+   * Forget all samples collected so far.
+   */
+  static void Clear();
+
+  /**
+   * Called at the start of each request to arm or disarm the calling
+   * thread's timer, depending on whether the profiler is running.
+   */
+  static void OnSessionInit(ThreadInfo *info);
+
+  /**
+   * Count one sample of the stack ending at top. This is what the signal
+   * handler calls, and it is safe to call from one.
+   */
+  static void RecordStack(const FrameInjection *top);
+
+  /**
+   * Writes the folded form of the stack ending at top into buf, which has
+   * room for MaxStackSize bytes, and returns its size. It is safe to call
+   * from a signal handler.
+   */
+  static int FoldStack(const FrameInjection *top, char *buf);
+
+  /**
+   * Folded stacks, most frequent first. Returns the number of stacks.
+   */
+  static int Dump(std::string &out);
+
+  /**
+   * Samples lost because the table was full.
+   */
+  static int64 GetDroppedCount();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_SAMPLING_PROFILER_H__
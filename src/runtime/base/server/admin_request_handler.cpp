@@ -30,6 +30,11 @@
 #include <runtime/base/memory/leak_detectable.h>
 #include <runtime/ext/mysql_stats.h>
 #include <runtime/base/shared/shared_store_stats.h>
+#include <runtime/base/sampling_profiler.h>
+#include <runtime/base/allocation_profiler.h>
+#include <runtime/base/string_intern_table.h>
+#include <runtime/base/memory/smart_block_pool.h>
+#include <runtime/base/util/dns_cache.h>
 
 #ifdef GOOGLE_CPU_PROFILER
 #include <google/profiler.h>
@@ -89,6 +94,9 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "/check-load:      how many threads are actively handling requests\n"
         "/check-mem:       report memory quick statistics in log file\n"
         "/check-apc:       report APC quick statistics\n"
+        "/check-intern:    report string intern table statistics\n"
+        "/check-pool:      report SmartAllocator block pool statistics\n"
+        "/check-dns:       report DNS cache statistics\n"
         "/check-sql:       report SQL table statistics\n"
 
         "/status.xml:      show server status in XML\n"
@@ -133,6 +141,20 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "    keysample     optional, only dump keys that belongs to the same\n"
         "                  group as <keysample>\n"
 
+        "/prof-sample-on:  turn on sampling profiler\n"
+        "/prof-sample-off: turn off sampling profiler\n"
+        "/prof-sample-clear:\n"
+        "                  discard samples collected so far\n"
+        "/prof-sample-dump:\n"
+        "                  sampled PHP stacks in folded (flamegraph) format\n"
+        "/prof-alloc-on:   turn on allocation profiler\n"
+        "/prof-alloc-off:  turn off allocation profiler\n"
+        "/prof-alloc-clear:\n"
+        "                  discard allocation samples collected so far\n"
+        "/prof-alloc-dump:\n"
+        "                  sampled bytes by URL and PHP stack, in folded\n"
+        "                  (flamegraph) format\n"
+
 #ifdef GOOGLE_CPU_PROFILER
         "/prof-cpu-on:     turn on CPU profiler\n"
         "/prof-cpu-off:    turn off CPU profiler\n"
@@ -398,6 +420,30 @@ bool AdminRequestHandler::handleCheckRequest(const std::string &cmd,
     transport->sendString(stats);
     return true;
   }
+  if (cmd == "check-intern") {
+    string stats = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    stats += "<StringIntern>\n";
+    stats += StringInternTable::ReportStats(1);
+    stats += "</StringIntern>\n";
+    transport->sendString(stats);
+    return true;
+  }
+  if (cmd == "check-pool") {
+    string stats = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    stats += "<SmartBlockPool>\n";
+    stats += SmartBlockPool::ReportStats(1);
+    stats += "</SmartBlockPool>\n";
+    transport->sendString(stats);
+    return true;
+  }
+  if (cmd == "check-dns") {
+    string stats = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    stats += "<DnsCache>\n";
+    stats += DnsCache::ReportStats(1);
+    stats += "</DnsCache>\n";
+    transport->sendString(stats);
+    return true;
+  }
   if (cmd == "check-sql") {
     string stats = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
     stats += "<SQL>\n";
@@ -520,6 +566,12 @@ bool AdminRequestHandler::handleStatsRequest(const std::string &cmd,
 
 bool AdminRequestHandler::handleProfileRequest(const std::string &cmd,
                                                Transport *transport) {
+  if (handleSamplingProfilerRequest(cmd, transport)) {
+    return true;
+  }
+  if (handleAllocationProfilerRequest(cmd, transport)) {
+    return true;
+  }
 #ifdef GOOGLE_CPU_PROFILER
   if (handleCPUProfilerRequest(cmd, transport)) {
     return true;
@@ -533,6 +585,70 @@ bool AdminRequestHandler::handleProfileRequest(const std::string &cmd,
   return false;
 }
 
+bool AdminRequestHandler::handleSamplingProfilerRequest(const std::string &cmd,
+                                                        Transport *transport) {
+  if (cmd == "prof-sample-on") {
+    SamplingProfiler::Start();
+    transport->sendString("OK\n");
+    return true;
+  }
+  if (cmd == "prof-sample-off") {
+    SamplingProfiler::Stop();
+    transport->sendString("OK\n");
+    return true;
+  }
+  if (cmd == "prof-sample-clear") {
+    SamplingProfiler::Clear();
+    transport->sendString("OK\n");
+    return true;
+  }
+  if (cmd == "prof-sample-dump") {
+    string out;
+    SamplingProfiler::Dump(out);
+    int64 dropped = SamplingProfiler::GetDroppedCount();
+    if (dropped) {
+      Logger::Warning("Sampling profiler table full, %lld samples dropped",
+                      (long long)dropped);
+    }
+    transport->addHeader("Content-Type", "text/plain");
+    transport->sendString(out);
+    return true;
+  }
+  return false;
+}
+
+bool AdminRequestHandler::handleAllocationProfilerRequest(
+  const std::string &cmd, Transport *transport) {
+  if (cmd == "prof-alloc-on") {
+    AllocationProfiler::Start();
+    transport->sendString("OK\n");
+    return true;
+  }
+  if (cmd == "prof-alloc-off") {
+    AllocationProfiler::Stop();
+    transport->sendString("OK\n");
+    return true;
+  }
+  if (cmd == "prof-alloc-clear") {
+    AllocationProfiler::Clear();
+    transport->sendString("OK\n");
+    return true;
+  }
+  if (cmd == "prof-alloc-dump") {
+    string out;
+    AllocationProfiler::Dump(out);
+    int64 dropped = AllocationProfiler::GetDroppedCount();
+    if (dropped) {
+      Logger::Warning("Allocation profiler table full, %lld samples dropped",
+                      (long long)dropped);
+    }
+    transport->addHeader("Content-Type", "text/plain");
+    transport->sendString(out);
+    return true;
+  }
+  return false;
+}
+
 #if (defined(GOOGLE_CPU_PROFILER) || defined(GOOGLE_HEAP_PROFILER))
 
 // call pprof to generate outputs
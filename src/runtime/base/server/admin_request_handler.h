@@ -39,6 +39,10 @@ private:
   bool handleProfileRequest(const std::string &cmd, Transport *transport);
   bool handleLeakRequest   (const std::string &cmd, Transport *transport);
   bool handleAPCSizeRequest (const std::string &cmd, Transport *transport);
+  bool handleSamplingProfilerRequest(const std::string &cmd,
+                                     Transport *transport);
+  bool handleAllocationProfilerRequest(const std::string &cmd,
+                                       Transport *transport);
 
 #ifdef GOOGLE_CPU_PROFILER
   bool handleCPUProfilerRequest (const std::string &cmd, Transport *transport);
@@ -19,6 +19,7 @@
 #include <runtime/base/zend/zend_string.h>
 #include <runtime/base/program_functions.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/string_intern_table.h>
 #include <runtime/base/server/source_root_info.h>
 #include <runtime/base/server/request_uri.h>
 #include <runtime/base/server/transport.h>
@@ -56,6 +57,83 @@ static bool read_all_post_data(Transport *transport,
   return false;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// $_ENV and the $_SERVER entries that are the same for every request to a
+// virtual host are built once into static arrays. A request starts from a
+// copy-on-write reference to them, and only pays for the entries it adds.
+
+typedef std::map<const VirtualHost*, StaticArray> ServerVariableMap;
+static StaticArray s_env_variables;
+static ServerVariableMap s_server_variables;
+
+static void prepare_env_variables(Variant &env) {
+  process_env_variables(env);
+  env.set("HPHP", 1);
+  env.set("HPHP_SERVER", 1);
+#ifdef HOTPROFILER
+  env.set("HPHP_HOTPROFILER", 1);
+#endif
+}
+
+/**
+ * Configured ServerVariables and the virtual host's own ones win over
+ * whatever the request itself brings in, so they are set last.
+ */
+static void prepare_server_overrides(Variant &server,
+                                     const VirtualHost *vhost) {
+  for (map<string, string>::const_iterator iter =
+         RuntimeOption::ServerVariables.begin();
+       iter != RuntimeOption::ServerVariables.end(); ++iter) {
+      server.set(String(iter->first), String(iter->second));
+  }
+  const map<string, string> &vServerVars = vhost->getServerVars();
+  for (map<string, string>::const_iterator iter =
+         vServerVars.begin();
+       iter != vServerVars.end(); ++iter) {
+    server.set(String(iter->first), String(iter->second));
+  }
+}
+
+static void prepare_static_server_variables(Variant &server,
+                                            const VirtualHost *vhost) {
+  server.set("argc", 0);
+  server.set("GATEWAY_INTERFACE", "CGI/1.1");
+  server.set("SERVER_ADDR", String(RuntimeOption::ServerPrimaryIP));
+  server.set("SERVER_PORT", RuntimeOption::ServerPort);
+  server.set("SERVER_SOFTWARE", "HPHP");
+  server.set("SERVER_PROTOCOL", "HTTP/1.1");
+  server.set("SERVER_ADMIN", "");
+  server.set("SERVER_SIGNATURE", "");
+  server.set("HTTPS", "");
+  server.set("REMOTE_HOST", ""); // I don't think we need to nslookup
+  server.set("REMOTE_PORT", 0);  // TODO: quite useless
+  server.set("DOCUMENT_ROOT", String(vhost->getDocumentRoot()));
+  prepare_server_overrides(server, vhost);
+}
+
+static StaticArray make_static(CVarRef v) {
+  // the temporary Array's decRef after this is a no-op on a static array
+  return StaticArray(v.toArray().get());
+}
+
+void HttpProtocol::InitSystemVariables() {
+  ASSERT(s_env_variables.isNull() && s_server_variables.empty());
+
+  Variant env = Array::Create();
+  prepare_env_variables(env);
+  s_env_variables = make_static(env);
+
+  Variant server = Array::Create();
+  prepare_static_server_variables(server, &VirtualHost::GetDefault());
+  s_server_variables[&VirtualHost::GetDefault()] = make_static(server);
+  for (unsigned int i = 0; i < RuntimeOption::VirtualHosts.size(); i++) {
+    const VirtualHost *vhost = RuntimeOption::VirtualHosts[i].get();
+    server = Array::Create();
+    prepare_static_server_variables(server, vhost);
+    s_server_variables[vhost] = make_static(server);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 const VirtualHost *HttpProtocol::GetVirtualHost(Transport *transport) {
@@ -88,12 +166,11 @@ void HttpProtocol::PrepareSystemVariables(Transport *transport,
   pm_php$globals$symbols_php();
 
   // $_ENV
-  process_env_variables(g->gv__ENV);
-  g->gv__ENV.set("HPHP", 1);
-  g->gv__ENV.set("HPHP_SERVER", 1);
-#ifdef HOTPROFILER
-  g->gv__ENV.set("HPHP_HOTPROFILER", 1);
-#endif
+  if (s_env_variables.isNull()) {
+    prepare_env_variables(g->gv__ENV);
+  } else {
+    g->gv__ENV = s_env_variables;
+  }
 
   Variant &request = g->gv__REQUEST;
 
@@ -164,19 +241,31 @@ void HttpProtocol::PrepareSystemVariables(Transport *transport,
 
   // $_SERVER
   Variant &server = g->gv__SERVER;
+  ServerVariableMap::const_iterator prebuilt = s_server_variables.find(vhost);
+  if (prebuilt != s_server_variables.end()) {
+    server = prebuilt->second;
+  }
 
   // HTTP_ headers -- we don't exclude headers we handle elsewhere (e.g.,
   // Content-Type, Authorization), since the CGI "spec" merely says the server
   // "may" exclude them; this is not what APE does, but it's harmless.
   HeaderMap headers;
   transport->getHeaders(headers);
+  string key;
   for (HeaderMap::const_iterator iter = headers.begin();
        iter != headers.end(); ++iter) {
     const vector<string> &values = iter->second;
+    if (values.empty()) continue;
+    key = "HTTP_";
+    key += iter->first;
+    for (unsigned int i = 5; i < key.size(); i++) {
+      key[i] = key[i] == '-' ? '_' : toupper(key[i]);
+    }
+    StringData *interned = StringInternTable::InternRepeated
+      (key.data(), key.size(), hash_string(key.data(), key.size()));
+    String skey = interned ? String(interned) : String(key);
     for (unsigned int i = 0; i < values.size(); i++) {
-      String key = "HTTP_";
-      key += StringUtil::ToUpper(iter->first).replace("-", "_");
-      server.set(key, String(values[i]));
+      server.set(skey, String(values[i]));
     }
   }
   string host = transport->getHeader("Host");
@@ -257,15 +346,7 @@ void HttpProtocol::PrepareSystemVariables(Transport *transport,
   }
 
   server.set("argv", r.queryString());
-  server.set("argc", 0);
-  server.set("GATEWAY_INTERFACE", "CGI/1.1");
-  server.set("SERVER_ADDR", String(RuntimeOption::ServerPrimaryIP));
   server.set("SERVER_NAME", hostName);
-  server.set("SERVER_PORT", RuntimeOption::ServerPort);
-  server.set("SERVER_SOFTWARE", "HPHP");
-  server.set("SERVER_PROTOCOL", "HTTP/1.1");
-  server.set("SERVER_ADMIN", "");
-  server.set("SERVER_SIGNATURE", "");
   switch (transport->getMethod()) {
   case Transport::GET:  server.set("REQUEST_METHOD", "GET");  break;
   case Transport::HEAD: server.set("REQUEST_METHOD", "HEAD"); break;
@@ -278,26 +359,15 @@ void HttpProtocol::PrepareSystemVariables(Transport *transport,
     break;
   default:              server.set("REQUEST_METHOD", "");     break;
   }
-  server.set("HTTPS", "");
   server.set("REQUEST_TIME", time(NULL));
   server.set("QUERY_STRING", r.queryString());
 
   server.set("REMOTE_ADDR", String(transport->getRemoteHost(), CopyString));
-  server.set("REMOTE_HOST", ""); // I don't think we need to nslookup
-  server.set("REMOTE_PORT", 0);  // TODO: quite useless
 
-  server.set("DOCUMENT_ROOT", String(vhost->getDocumentRoot()));
-
-  for (map<string, string>::const_iterator iter =
-         RuntimeOption::ServerVariables.begin();
-       iter != RuntimeOption::ServerVariables.end(); ++iter) {
-      server.set(String(iter->first), String(iter->second));
-  }
-  const map<string, string> &vServerVars = vhost->getServerVars();
-  for (map<string, string>::const_iterator iter =
-         vServerVars.begin();
-       iter != vServerVars.end(); ++iter) {
-    server.set(String(iter->first), String(iter->second));
+  if (prebuilt != s_server_variables.end()) {
+    prepare_server_overrides(server, vhost);
+  } else {
+    prepare_static_server_variables(server, vhost);
   }
   sri.setServerVariables(server);
 
@@ -331,6 +401,11 @@ void HttpProtocol::ClearRecord(bool success, const std::string &tmpfile) {
 
 void HttpProtocol::CopyParams(Variant &dest, Variant &src) {
   if (src.isArray()) {
+    if (!dest.isArray() || dest.toArray().empty()) {
+      // nothing to merge into yet, so share src copy-on-write
+      dest = src;
+      return;
+    }
     Array srcArray = src.toArray();
     for (ArrayIter iter(srcArray); iter; ++iter) {
       dest.set(iter.first(), iter.second());
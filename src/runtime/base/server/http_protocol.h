@@ -31,6 +31,13 @@ class StringBuffer;
 class HttpProtocol {
 public:
   static const VirtualHost *GetVirtualHost(Transport *transport);
+
+  /**
+   * Prebuilds $_ENV and the per virtual host part of $_SERVER that
+   * PrepareSystemVariables() starts each request from. Has to be called
+   * before request threads start, as the results are static arrays.
+   */
+  static void InitSystemVariables();
   static void PrepareSystemVariables(Transport *transport, const RequestURI &r,
                                      const SourceRootInfo &sourceRootInfo);
   static bool ProxyRequest(Transport *transport, bool force,
@@ -303,15 +303,19 @@ bool HttpRequestHandler::executePHPRequest(Transport *transport,
                       error, errorMsg);
 
     if (ret) {
-      String content = context->obDetachContents();
-      if (cachableDynamicContent && !content.empty()) {
-        ASSERT(transport->getUrl());
-        string key = file + transport->getUrl();
-        DynamicContentCache::TheCache.store(key, content.data(),
-                                            content.size());
-      }
       code = 200;
-      transport->sendRaw((void*)content.data(), content.size());
+      if (cachableDynamicContent) {
+        String content = context->obDetachContents();
+        if (!content.empty()) {
+          ASSERT(transport->getUrl());
+          string key = file + transport->getUrl();
+          DynamicContentCache::TheCache.store(key, content.data(),
+                                              content.size());
+        }
+        transport->sendRaw((void*)content.data(), content.size());
+      } else {
+        context->obSendContents(transport);
+      }
     } else if (error) {
       code = 500;
 
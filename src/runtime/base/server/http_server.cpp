@@ -17,7 +17,10 @@
 #include <runtime/base/server/http_server.h>
 #include <runtime/base/server/libevent_server.h>
 #include <runtime/base/server/libevent_server_with_takeover.h>
+#include <runtime/base/server/prefork_server.h>
+#include <runtime/base/server/libevent_server_group.h>
 #include <runtime/base/server/http_request_handler.h>
+#include <runtime/base/server/http_protocol.h>
 #include <runtime/base/server/admin_request_handler.h>
 #include <runtime/base/server/server_stats.h>
 #include <runtime/base/server/xbox_server.h>
@@ -27,6 +30,7 @@
 #include <runtime/base/source_info.h>
 #include <runtime/base/rtti_info.h>
 #include <runtime/base/memory/memory_manager.h>
+#include <runtime/base/memory/smart_block_pool.h>
 #include <util/logger.h>
 #include <runtime/base/externals.h>
 #include <runtime/base/util/http_client.h>
@@ -51,6 +55,15 @@ time_t HttpServer::StartTime;
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * What the prefork template runs in place of the rest of the constructor,
+ * which it was forked off before.
+ */
+static void init_prefork_template() {
+  hphp_process_init();
+  HttpProtocol::InitSystemVariables();
+}
+
 HttpServer::HttpServer()
   : m_stopped(false),
     m_loggerThread(this, &HttpServer::flushLog),
@@ -59,7 +72,24 @@ HttpServer::HttpServer()
   // enabling mutex profiling, but it's not turned on
   LockProfiler::s_pfunc_profile = server_stats_log_mutex;
 
-  if (RuntimeOption::TakeoverFilename.empty()) {
+  PreforkServer *prefork = NULL;
+  if (RuntimeOption::ServerPreforkWorkers > 0) {
+    if (!RuntimeOption::TakeoverFilename.empty()) {
+      Logger::Warning("TakeoverFilename is ignored by the prefork server");
+    }
+    prefork = new TypedServer<PreforkServer, HttpRequestHandler>
+      (RuntimeOption::ServerIP, RuntimeOption::ServerPort,
+       RuntimeOption::ServerPreforkWorkers,
+       RuntimeOption::RequestTimeoutSeconds);
+    m_pageServer = ServerPtr(prefork);
+  } else if (RuntimeOption::TakeoverFilename.empty() &&
+             RuntimeOption::ServerEventLoopCount > 1) {
+    m_pageServer = ServerPtr
+      (new TypedServer<LibEventServerGroup, HttpRequestHandler>
+       (RuntimeOption::ServerIP, RuntimeOption::ServerPort,
+        RuntimeOption::ServerThreadCount,
+        RuntimeOption::RequestTimeoutSeconds));
+  } else if (RuntimeOption::TakeoverFilename.empty()) {
     m_pageServer = ServerPtr
       (new TypedServer<LibEventServer, HttpRequestHandler>
        (RuntimeOption::ServerIP, RuntimeOption::ServerPort,
@@ -116,7 +146,13 @@ HttpServer::HttpServer()
   SourceInfo::TheSourceInfo.load();
   RTTIInfo::TheRTTIInfo.init(true);
 
+  if (prefork) {
+    // while this is still the only thread: hphp_process_init() is about to
+    // start pagelet and xbox threads, and run() everything else
+    prefork->forkTemplate(init_prefork_template);
+  }
   hphp_process_init();
+  HttpProtocol::InitSystemVariables();
 
   Server::InstallStopSignalHandlers(m_pageServer);
   Server::InstallStopSignalHandlers(m_adminServer);
@@ -386,6 +422,10 @@ void HttpServer::watchDog() {
     sleep(1);
     ++count;
 
+    if (RuntimeOption::SmartBlockPoolIdleSeconds > 0) {
+      SmartBlockPool::Trim(RuntimeOption::SmartBlockPoolIdleSeconds);
+    }
+
     if (RuntimeOption::MaxRSSPollingCycle > 0 &&
         (count % RuntimeOption::MaxRSSPollingCycle) == 0) { // every minute
       checkMemory();
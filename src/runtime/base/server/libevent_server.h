@@ -144,7 +144,7 @@ public:
   /**
    * Request handler called by evhttp library.
    */
-  void onRequest(evhttp_request *request);
+  virtual void onRequest(evhttp_request *request);
   void onChunkedRead();
 
   /**
@@ -185,15 +185,15 @@ protected:
   TimeoutThread m_timeoutThreadData;
   AsyncFunc<TimeoutThread> m_timeoutThread;
 
+  // dispatcher thread runs this function
+  void dispatch();
+
 private:
   JobQueueDispatcher<LibEventJobPtr, LibEventWorker> m_dispatcher;
   AsyncFunc<LibEventServer> m_dispatcherThread;
 
   PendingResponseQueue m_responseQueue;
 
-  // dispatcher thread runs this function
-  void dispatch();
-
   void dispatchWithTimeout(int timeoutSeconds);
 };
 
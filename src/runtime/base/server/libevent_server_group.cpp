@@ -0,0 +1,254 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/server/libevent_server_group.h>
+#include <runtime/base/runtime_option.h>
+#include <util/logger.h>
+#include <util/util.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+bool reuse_port_supported() {
+#ifdef SO_REUSEPORT
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  int on = 1;
+  bool ret = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == 0;
+  close(fd);
+  return ret;
+#else
+  return false;
+#endif
+}
+
+bool make_address(const std::string &address, int port, sockaddr_in &addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_aton(address.c_str(), &addr.sin_addr) == 0) {
+    Logger::Error("Invalid server address %s", address.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Whether somebody is already listening on the port. SO_REUSEPORT would let
+ * us quietly share it with them, say another server instance, so the group
+ * checks with a plain bind first, which fails on any listening socket.
+ */
+bool port_in_use(const std::string &address, int port) {
+  sockaddr_in addr;
+  if (!make_address(address, port, addr)) return false;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  bool ret = bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 &&
+    errno == EADDRINUSE;
+  close(fd);
+  return ret;
+}
+
+int bind_accept_socket(const std::string &address, int port,
+                       bool reusePort) {
+  sockaddr_in addr;
+  if (!make_address(address, port, addr)) return -1;
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    Logger::Error("socket: %s", Util::safe_strerror(errno).c_str());
+    return -1;
+  }
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+  if (reusePort) {
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+  }
+#endif
+  // a loop sharing the socket may find somebody else took the connection
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    int errno_save = errno;
+    close(fd);
+    errno = errno_save;
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * One event loop of the group, handing requests to the group's handlers.
+ */
+class EventLoop : public LibEventServer {
+public:
+  EventLoop(Server *owner, const std::string &address, int port, int thread,
+            int timeoutSeconds)
+    : LibEventServer(address, port, thread, timeoutSeconds),
+      m_owner(owner), m_sharedSock(-1) {
+  }
+
+  /**
+   * Accept on a copy of this socket instead of binding one.
+   */
+  void setSharedSocket(int fd) { m_sharedSock = fd;}
+
+  virtual RequestHandler *createRequestHandler() {
+    return m_owner->createRequestHandler();
+  }
+  virtual void releaseRequestHandler(RequestHandler *handler) {
+    m_owner->releaseRequestHandler(handler);
+  }
+  virtual void onThreadExit(RequestHandler *handler) {
+    m_owner->onThreadExit(handler);
+  }
+  virtual bool shouldHandle(const std::string &cmd) {
+    return m_owner->shouldHandle(cmd);
+  }
+
+protected:
+  virtual int getAcceptSocket() {
+    int fd = m_sharedSock >= 0 ? dup(m_sharedSock) :
+      bind_accept_socket(m_address, m_port, true);
+    if (fd < 0) {
+      Logger::Error("Fail to bind port %d", m_port);
+      return -1;
+    }
+    if (evhttp_accept_socket(m_server, fd) < 0) {
+      Logger::Error("evhttp_accept_socket: %s",
+                    Util::safe_strerror(errno).c_str());
+      close(fd);
+      return -1;
+    }
+    m_accept_sock = fd;
+    return 0;
+  }
+
+private:
+  Server *m_owner;
+  int m_sharedSock;
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+LibEventServerGroup::LibEventServerGroup(const std::string &address,
+                                         int port, int thread,
+                                         int timeoutSeconds)
+  : Server(address, port, thread) {
+  int count = RuntimeOption::ServerEventLoopCount;
+  if (count > thread) count = thread;
+  if (count < 1) count = 1;
+  for (int i = 0; i < count; i++) {
+    // the first loops take what does not divide evenly
+    int share = thread / count + (i < thread % count ? 1 : 0);
+    m_loops.push_back(new EventLoop(this, address, port, share,
+                                    timeoutSeconds));
+  }
+}
+
+LibEventServerGroup::~LibEventServerGroup() {
+  for (unsigned int i = 0; i < m_loops.size(); i++) {
+    delete m_loops[i];
+  }
+}
+
+void LibEventServerGroup::start() {
+  if (getStatus() == RUNNING) return;
+
+  int shared = -1;
+  if (reuse_port_supported()) {
+    if (port_in_use(m_address, m_port)) {
+      Logger::Error("Fail to bind port %d: already in use", m_port);
+      throw FailedToListenException(m_address, m_port);
+    }
+  } else {
+    shared = bind_accept_socket(m_address, m_port, false);
+    if (shared < 0) {
+      Logger::Error("Fail to bind port %d", m_port);
+      throw FailedToListenException(m_address, m_port);
+    }
+    for (unsigned int i = 0; i < m_loops.size(); i++) {
+      ((EventLoop*)m_loops[i])->setSharedSocket(shared);
+    }
+  }
+
+  unsigned int started = 0;
+  try {
+    for (; started < m_loops.size(); started++) {
+      m_loops[started]->start();
+    }
+  } catch (...) {
+    for (unsigned int i = 0; i < started; i++) {
+      m_loops[i]->stop();
+    }
+    if (shared >= 0) close(shared);
+    throw;
+  }
+  if (shared >= 0) close(shared); // every loop has its own copy
+
+  setStatus(RUNNING);
+  Logger::Info("running %d event loops on port %d%s", (int)m_loops.size(),
+               m_port, shared >= 0 ? ", sharing one socket" : "");
+}
+
+void LibEventServerGroup::waitForEnd() {
+  for (unsigned int i = 0; i < m_loops.size(); i++) {
+    m_loops[i]->waitForEnd();
+  }
+}
+
+void LibEventServerGroup::stop() {
+  {
+    Lock lock(m_mutex);
+    if (getStatus() != RUNNING) return;
+    setStatus(STOPPING);
+  }
+  for (unsigned int i = 0; i < m_loops.size(); i++) {
+    m_loops[i]->stop();
+  }
+  setStatus(STOPPED);
+}
+
+int LibEventServerGroup::getActiveWorker() {
+  int count = 0;
+  for (unsigned int i = 0; i < m_loops.size(); i++) {
+    count += m_loops[i]->getActiveWorker();
+  }
+  return count;
+}
+
+bool LibEventServerGroup::enableSSL(const std::string &certFile,
+                                    const std::string &keyFile, int port) {
+  return m_loops[0]->enableSSL(certFile, keyFile, port);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,62 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HTTP_SERVER_LIB_EVENT_SERVER_GROUP_H__
+#define __HTTP_SERVER_LIB_EVENT_SERVER_GROUP_H__
+
+#include <runtime/base/server/libevent_server.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Page server made of several LibEventServers on the same port, each with
+ * its own event loop thread, listening socket and share of the worker
+ * threads, so that accepting connections, parsing requests and writing
+ * responses no longer all happen on one thread.
+ *
+ * Where the kernel supports SO_REUSEPORT, every loop binds a socket of its
+ * own and new connections are spread over them by the kernel. The port has
+ * to be free when the group starts, so that it is never shared with
+ * sockets that another process opened the same way. Elsewhere,
+ * all loops accept on copies of one socket, and whichever loop gets to a
+ * new connection first takes it.
+ */
+class LibEventServerGroup : public Server {
+public:
+  LibEventServerGroup(const std::string &address, int port, int thread,
+                      int timeoutSeconds);
+  ~LibEventServerGroup();
+
+  virtual void start();
+  virtual void waitForEnd();
+  virtual void stop();
+  virtual int getActiveWorker();
+
+  /**
+   * SSL connections are all served by the first loop.
+   */
+  virtual bool enableSSL(const std::string &certFile,
+                         const std::string &keyFile, int port);
+
+private:
+  std::vector<LibEventServer*> m_loops;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HTTP_SERVER_LIB_EVENT_SERVER_GROUP_H__
@@ -17,7 +17,11 @@
 #include <runtime/base/server/libevent_server_with_takeover.h>
 #include <util/logger.h>
 #include <runtime/base/string_util.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/base/program_functions.h>
+#include <runtime/ext/ext_apc.h>
 #include <afdt.h>
+#include <sys/socket.h>
 
 /*
 LibEventServerWithTakeover extends LibEventServer with the ability
@@ -39,6 +43,19 @@ we can give the socket to the next instance that starts.
 It is a little bit of a hack to use libafdt to send the shutdown
 request, but we need to synchronously shut down the admin server,
 so we cannot use the admin server for it.
+
+Before asking for the socket, a server configured with
+Server.Takeover.APC.MaxMB asks for APC entries first: the existing
+server answers with one end of a socket pair, and writes entries to
+the other end from a separate thread, while it keeps serving. Only
+once they are all stored does the new server take the port, so it
+starts with a warm cache.
+
+Once the socket is gone, the existing server keeps serving requests
+that come in on connections it already has, telling clients to close
+each one after its response, so they reconnect to the new server.
+When stopping, it waits for those to go quiet, for at most
+Server.Takeover.DrainSeconds.
 */
 
 // We use a very simple protocol for communicating over libafdt:
@@ -50,6 +67,8 @@ so we cannot use the admin server for it.
 #define C_TERM_OK  "\x05"
 #define C_TERM_BAD "\x06"
 #define C_UNKNOWN  "\x07"
+#define C_APC_REQ  "\x08"
+#define C_APC_RESP "\x09"
 
 namespace HPHP {
 
@@ -82,11 +101,27 @@ static int fd_transfer_request_handler(
   return fd;
 }
 
+static void fd_transfer_post_handler(
+    const uint8_t* request,
+    uint32_t request_length,
+    const uint8_t* response,
+    uint32_t response_length,
+    int sent_fd,
+    void* userdata) {
+  LibEventServerWithTakeover* server = (LibEventServerWithTakeover*)userdata;
+  String req((const char*)request, request_length, CopyString);
+  server->afdtPost(req, sent_fd);
+}
+
 LibEventServerWithTakeover::LibEventServerWithTakeover
 (const std::string &address, int port, int thread, int timeoutSeconds)
   : LibEventServer(address, port, thread, timeoutSeconds),
     m_delete_handle(NULL),
-    m_took_over(false)
+    m_took_over(false),
+    m_draining(false),
+    m_last_request(0),
+    m_apc_fd(-1),
+    m_apc_sender(this, &LibEventServerWithTakeover::sendApc)
 {
 }
 
@@ -107,6 +142,8 @@ int LibEventServerWithTakeover::afdtRequest(String request, String* response) {
       // log message is not too harmful.
       Logger::Error("Unable to delete accept socket");
     }
+    m_last_request = time(NULL);
+    m_draining = true;
     return m_accept_sock;
   } else if (request == P_VERSION C_TERM_REQ) {
     Logger::Info("takeover: request is a terminate request");
@@ -153,6 +190,22 @@ int LibEventServerWithTakeover::afdtRequest(String request, String* response) {
     }
     Logger::Info("takeover: notification complete");
     return -1;
+  } else if (request == P_VERSION C_APC_REQ) {
+    Logger::Info("takeover: request is an APC request");
+    *response = P_VERSION C_UNKNOWN;
+    if (m_apc_fd >= 0 || RuntimeOption::TakeoverAPCMaxBytes <= 0) {
+      return -1;
+    }
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+      Logger::Error("Unable to create APC socket pair: %s",
+                    Util::safe_strerror(errno).c_str());
+      return -1;
+    }
+    m_apc_fd = fds[0];
+    m_apc_sender.start();
+    *response = P_VERSION C_APC_RESP;
+    return fds[1]; // closed by afdtPost() once sent
   } else {
     Logger::Info("takeover: request is unrecognize");
     *response = P_VERSION C_UNKNOWN;
@@ -160,6 +213,96 @@ int LibEventServerWithTakeover::afdtRequest(String request, String* response) {
   }
 }
 
+void LibEventServerWithTakeover::afdtPost(String request, int fd) {
+  if (request == P_VERSION C_APC_REQ && fd >= 0) {
+    close(fd);
+  }
+}
+
+void LibEventServerWithTakeover::sendApc() {
+  // the new server keeps reading, unless something went wrong with it
+  struct timeval timeout = { 10 , 0 };
+  setsockopt(m_apc_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  int64 sent = 0;
+  hphp_session_init();
+  try {
+    sent = apc_dump_handoff(m_apc_fd, RuntimeOption::TakeoverAPCPrefixes,
+                            RuntimeOption::TakeoverAPCMaxBytes);
+  } catch (Exception &e) {
+    Logger::Error("takeover: APC hand-off failed: %s",
+                  e.getMessage().c_str());
+  }
+  hphp_session_exit();
+  close(m_apc_fd);
+  Logger::Info("takeover: sent %lld bytes of APC", (long long)sent);
+}
+
+void LibEventServerWithTakeover::receiveApc() {
+  Logger::Info("takeover: requesting APC entries");
+  uint8_t apc_request[3] = P_VERSION C_APC_REQ;
+  uint8_t apc_response[3] = {0,0,0};
+  uint32_t response_len = sizeof(apc_response);
+  int fd = -1;
+  afdt_error_t err = AFDT_ERROR_T_INIT;
+  struct timeval timeout = { 2 , 0 };
+  int ret = afdt_sync_client(
+      m_transfer_fname.c_str(),
+      apc_request,
+      sizeof(apc_request) - 1,
+      apc_response,
+      &response_len,
+      &fd,
+      &timeout,
+      &err);
+  if (ret < 0) {
+    fd_transfer_error_hander(&err, NULL);
+    return;
+  }
+  if (fd < 0) {
+    // an older server, or one not configured to hand APC over
+    Logger::Info("takeover: no APC entries offered");
+    return;
+  }
+
+  // the old server is still busy serving, but it should not stall
+  timeout.tv_sec = 10;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  int count = 0;
+  hphp_session_init();
+  try {
+    count = apc_load_handoff(fd);
+  } catch (Exception &e) {
+    Logger::Error("takeover: APC hand-off failed: %s",
+                  e.getMessage().c_str());
+  }
+  hphp_session_exit();
+  close(fd);
+  Logger::Info("takeover: stored %d APC entries", count);
+}
+
+void LibEventServerWithTakeover::onRequest(evhttp_request *request) {
+  if (m_draining) {
+    // have the client reconnect, to the new server, for its next request
+    m_last_request = time(NULL);
+    evhttp_add_header(request->output_headers, "Connection", "close");
+  }
+  LibEventServer::onRequest(request);
+}
+
+void LibEventServerWithTakeover::drain() {
+  Logger::Info("takeover: draining connections");
+  time_t deadline = time(NULL) + RuntimeOption::TakeoverDrainSeconds;
+  while (time(NULL) < deadline) {
+    if (getActiveWorker() == 0 && time(NULL) - m_last_request >= 1) {
+      break;
+    }
+    usleep(100000);
+  }
+  Logger::Info("takeover: connections drained");
+}
+
 void LibEventServerWithTakeover::setupFdServer() {
   int ret;
   ret = unlink(m_transfer_fname.c_str());
@@ -173,7 +316,7 @@ void LibEventServerWithTakeover::setupFdServer() {
       m_transfer_fname.c_str(),
       m_eventBase,
       fd_transfer_request_handler,
-      afdt_no_post,
+      fd_transfer_post_handler,
       fd_transfer_error_hander,
       &m_delete_handle,
       this);
@@ -207,6 +350,10 @@ int LibEventServerWithTakeover::getAcceptSocket() {
     return -1;
   }
 
+  if (RuntimeOption::TakeoverAPCMaxBytes > 0) {
+    receiveApc();
+  }
+
   Logger::Info("takeover: beginning listen socket acquisition");
   uint8_t fd_request[3] = P_VERSION C_FD_REQ;
   uint8_t fd_response[3] = {0,0,0};
@@ -316,9 +463,13 @@ void LibEventServerWithTakeover::start() {
 }
 
 void LibEventServerWithTakeover::stop() {
+  if (m_draining && getStatus() == RUNNING) {
+    drain();
+  }
   if (m_delete_handle != NULL) {
     afdt_close_server(m_delete_handle);
   }
+  m_apc_sender.waitForEnd();
   m_accept_sock = -1;
   LibEventServer::stop();
 }
@@ -18,6 +18,7 @@
 #define __HTTP_SERVER_LIB_EVENT_SERVER_WITH_TAKEOVER_H__
 
 #include <runtime/base/server/libevent_server.h>
+#include <util/async_func.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -27,6 +28,12 @@ class TakeoverListener;
 /**
  * LibEventServer that adds the ability to take over an accept socket
  * from another process, and give its accept socket up.
+ *
+ * Before taking the socket over, a new server can ask the old one for some
+ * of its APC entries. After giving the socket up, the old server keeps
+ * serving requests on connections it still has, closing each one after its
+ * response, and stops once they have gone quiet or after
+ * Server.Takeover.DrainSeconds.
  */
 class LibEventServerWithTakeover : public LibEventServer {
 public:
@@ -34,6 +41,7 @@ public:
                              int timeoutSeconds);
 
   virtual void stop();
+  virtual void onRequest(evhttp_request *request);
 
   // Set the name of the file to be used for a Unix domain socket
   // over which to transfer the accept socket.
@@ -53,6 +61,10 @@ public:
   // They are not a part of the public interface.
   void afdtResponse(String response, int fd);
   int afdtRequest(String request, String* response);
+  void afdtPost(String request, int fd);
+
+  // Runs on its own thread, writing APC entries to the other server.
+  void sendApc();
 
 protected:
   virtual void start();
@@ -60,11 +72,18 @@ protected:
 
   void setupFdServer();
   void notifyTakeoverComplete();
+  void receiveApc();
+  void drain();
 
   void* m_delete_handle;
   std::string m_transfer_fname;
   std::set<TakeoverListener*> m_takeover_listeners;
   bool m_took_over;
+
+  volatile bool m_draining;
+  volatile time_t m_last_request;
+  int m_apc_fd;
+  AsyncFunc<LibEventServerWithTakeover> m_apc_sender;
 };
 
 class TakeoverListener {
@@ -18,6 +18,7 @@
 #include <runtime/base/server/libevent_server.h>
 #include <runtime/base/server/server.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/util/chunked_buffer.h>
 #include <util/util.h>
 
 namespace HPHP {
@@ -262,6 +263,29 @@ void LibEventTransport::sendImpl(const void *data, int size, int code,
   m_sendStarted = true;
 }
 
+void LibEventTransport::sendChunksImpl(const ChunkedBuffer &buf, int code) {
+  ASSERT(!m_sendStarted && !m_sendEnded);
+
+  if (m_method != HEAD) {
+    // libevent 1.4's evbuffer is one contiguous piece of memory, so it can't
+    // take over our chunks; growing it once and filling it chunk by chunk at
+    // least avoids flattening into a temporary string and repeated reallocs.
+    evbuffer *output = m_request->output_buffer;
+    evbuffer_expand(output, buf.size());
+    for (const ChunkedBuffer::Chunk *chunk = buf.head(); chunk;
+         chunk = chunk->next) {
+      evbuffer_add(output, chunk->data, chunk->size);
+    }
+  } else {
+    char size[11];
+    snprintf(size, sizeof(size), "%d", buf.size());
+    addHeaderImpl("Content-Length", size);
+  }
+  m_server->onResponse(m_workerId, m_request, code);
+  m_sendEnded = true;
+  m_sendStarted = true;
+}
+
 void LibEventTransport::onSendEndImpl() {
   if (m_chunkedEncoding) {
     m_server->onChunkedResponseEnd(m_workerId, m_request);
@@ -47,6 +47,7 @@ public:
   virtual void addRequestHeaderImpl(const char *name, const char *value);
   virtual void removeRequestHeaderImpl(const char *name);
   virtual void sendImpl(const void *data, int size, int code, bool chunked);
+  virtual void sendChunksImpl(const ChunkedBuffer &buf, int code);
   virtual void onSendEndImpl();
   virtual bool isServerStopping();
 
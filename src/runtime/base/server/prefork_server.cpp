@@ -0,0 +1,529 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/server/prefork_server.h>
+#include <runtime/base/server/libevent_server.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/base/program_functions.h>
+#include <util/logger.h>
+#include <util/process.h>
+#include <util/util.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#if !defined(__APPLE__)
+#include <sys/prctl.h>
+#endif
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+volatile sig_atomic_t s_stopping = 0;
+bool s_retiring = false;
+
+void on_stop(int sig) {
+  s_stopping = 1;
+}
+
+void install_stop_handler(void (*handler)(int)) {
+  // no SA_RESTART, so that the template's waitpid() wakes up
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handler;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGUSR1, &sa, NULL);
+}
+
+void die_with_parent() {
+#if !defined(__APPLE__)
+  prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+}
+
+int64 elapsed_usec(const timeval &start) {
+  timeval end;
+  gettimeofday(&end, NULL);
+  return (end.tv_sec - start.tv_sec) * 1000000LL +
+    (end.tv_usec - start.tv_usec);
+}
+
+/**
+ * Passes fd to the process at the other end of a UNIX domain socket.
+ */
+bool send_fd(int sock, int fd) {
+  char byte = 0;
+  iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  int ret;
+  while ((ret = sendmsg(sock, &msg, 0)) < 0 && errno == EINTR) {}
+  return ret == 1;
+}
+
+/**
+ * Receives what send_fd() passed. Returns -1 if the other end went away,
+ * or if a signal came first.
+ */
+int recv_fd(int sock) {
+  char byte;
+  iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+
+  char control[CMSG_SPACE(sizeof(int))];
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  if (recvmsg(sock, &msg, 0) != 1) {
+    return -1;
+  }
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS) {
+    return -1;
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  return fd;
+}
+
+/**
+ * What a worker process runs: a LibEventServer without any worker threads,
+ * handling each request right in its event loop.
+ */
+class PreforkWorker : public LibEventServer {
+public:
+  static PreforkWorker *s_worker;
+
+  PreforkWorker(Server *owner, const std::string &address, int port,
+                int timeoutSeconds, int acceptSock, int *busy)
+    : LibEventServer(address, port, 1, timeoutSeconds),
+      m_owner(owner), m_busy(busy), m_served(0) {
+    m_accept_sock = acceptSock;
+  }
+
+  int getServed() const { return m_served;}
+
+  void serve() {
+    if (evhttp_accept_socket(m_server, m_accept_sock) < 0) {
+      Logger::Error("evhttp_accept_socket: %s",
+                    Util::safe_strerror(errno).c_str());
+      return;
+    }
+    // one connection at a time: whoever else is waiting goes to an idle
+    // worker, and a retiring worker has no other keep-alive connection to
+    // drop
+    evhttp_set_connection_limit(m_server, 1);
+    setStatus(RUNNING);
+    m_worker.create(0, &m_queue, this);
+    m_worker.onThreadEnter();
+    m_timeoutThread.start();
+
+    dispatch();
+
+    m_timeoutThreadData.stop();
+    m_timeoutThread.waitForEnd();
+  }
+
+  /**
+   * Called from the signal handler: finish the request at hand, if any,
+   * and leave the event loop.
+   */
+  void signalStop() {
+    setStatus(STOPPED);
+    if (write(m_pipeStop.getIn(), "", 1) < 0) {
+      // nothing we can do in a signal handler
+    }
+  }
+
+  void onRetired() {
+    setStatus(STOPPED);
+    event_base_loopbreak(m_eventBase);
+  }
+
+  virtual void onRequest(evhttp_request *request);
+
+  virtual RequestHandler *createRequestHandler() {
+    return m_owner->createRequestHandler();
+  }
+  virtual void releaseRequestHandler(RequestHandler *handler) {
+    m_owner->releaseRequestHandler(handler);
+  }
+  virtual void onThreadExit(RequestHandler *handler) {
+    m_owner->onThreadExit(handler);
+  }
+  virtual bool shouldHandle(const std::string &cmd) {
+    return m_owner->shouldHandle(cmd);
+  }
+
+private:
+  Server *m_owner;
+  volatile int *m_busy;
+  int m_served;
+  JobQueue<LibEventJobPtr> m_queue; // never used, but workers need one
+  LibEventWorker m_worker;
+};
+
+PreforkWorker *PreforkWorker::s_worker = NULL;
+
+void on_worker_stop(int sig) {
+  if (PreforkWorker::s_worker) {
+    PreforkWorker::s_worker->signalStop();
+  }
+}
+
+void on_retired(evhttp_connection *evcon, void *obj) {
+  ((PreforkWorker*)obj)->onRetired();
+}
+
+void PreforkWorker::onRequest(evhttp_request *request) {
+  if (getStatus() != RUNNING) {
+    Logger::Error("throwing away one new request while shutting down");
+    return;
+  }
+  if (RuntimeOption::EnableKeepAlive &&
+      RuntimeOption::ConnectionTimeoutSeconds > 0) {
+    evhttp_connection_set_timeout(request->evcon,
+                                  RuntimeOption::ConnectionTimeoutSeconds);
+  }
+
+  ++m_served;
+  if (RuntimeOption::ServerPreforkMaxRequests > 0 &&
+      m_served >= RuntimeOption::ServerPreforkMaxRequests) {
+    // this is the only connection there is, so once this response is out
+    // and it is closed, nothing is left to serve
+    s_retiring = true;
+    evhttp_del_accept_socket(m_server, m_accept_sock);
+    evhttp_add_header(request->output_headers, "Connection", "close");
+    evhttp_connection_set_closecb(request->evcon, on_retired, this);
+  }
+
+  *m_busy = 1;
+  m_worker.doJob(LibEventJobPtr(new LibEventJob(request)));
+  *m_busy = 0;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PreforkServer::PreforkServer(const std::string &address, int port,
+                             int thread, int timeoutSeconds)
+  : Server(address, port, thread), m_timeoutSeconds(timeoutSeconds),
+    m_accept_sock(-1), m_control(-1), m_template(-1), m_busy(NULL) {
+}
+
+PreforkServer::~PreforkServer() {
+  if (m_accept_sock >= 0) {
+    close(m_accept_sock);
+  }
+  if (m_control >= 0) {
+    close(m_control); // a template still waiting for start() exits
+  }
+}
+
+bool PreforkServer::IsRetiring() {
+  return s_retiring;
+}
+
+int PreforkServer::bindAcceptSocket() {
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(m_port);
+  if (inet_aton(m_address.c_str(), &addr.sin_addr) == 0) {
+    Logger::Error("Invalid server address %s", m_address.c_str());
+    return -1;
+  }
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    Logger::Error("socket: %s", Util::safe_strerror(errno).c_str());
+    return -1;
+  }
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  // every idle worker is woken up for a new connection, and all but one
+  // of them find nothing to accept
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    Logger::Error("Fail to bind port %d", m_port);
+    close(fd);
+    return -1;
+  }
+  m_accept_sock = fd;
+  return 0;
+}
+
+void PreforkServer::forkTemplate(TemplateInit init /* = NULL */) {
+  if (m_template > 0) return;
+
+  int threads = Process::GetThreadCount(getpid());
+  if (threads > 1) {
+    throw Exception("Unable to fork prefork template: %d threads are "
+                    "running already", threads);
+  }
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    throw Exception("Unable to create prefork control socket: %s",
+                    Util::safe_strerror(errno).c_str());
+  }
+  void *busy = mmap(NULL, sizeof(int) * m_threadCount,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                    -1, 0);
+  if (busy == MAP_FAILED) {
+    close(fds[0]);
+    close(fds[1]);
+    throw Exception("Unable to map worker slots: %s",
+                    Util::safe_strerror(errno).c_str());
+  }
+  m_busy = (int*)busy;
+  memset(m_busy, 0, sizeof(int) * m_threadCount);
+
+  fflush(NULL);
+  pid_t pid = fork();
+  if (pid < 0) {
+    throw Exception("Unable to fork template process: %s",
+                    Util::safe_strerror(errno).c_str());
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    runTemplate(fds[1], init); // never returns
+  }
+  close(fds[1]);
+  m_control = fds[0];
+  m_template = pid;
+  Logger::Info("prefork template %d forked", pid);
+}
+
+void PreforkServer::start() {
+  if (getStatus() == RUNNING) return;
+
+  forkTemplate();
+  if (bindAcceptSocket() != 0) {
+    throw FailedToListenException(m_address, m_port);
+  }
+
+  // the template answers once it is warmed up and has started forking
+  bool started = send_fd(m_control, m_accept_sock);
+  if (started) {
+    char ack;
+    int ret;
+    while ((ret = read(m_control, &ack, 1)) < 0 && errno == EINTR) {}
+    started = ret == 1;
+  }
+  // workers have their own copies
+  close(m_accept_sock);
+  m_accept_sock = -1;
+  if (!started) {
+    throw Exception("prefork template %d exited before starting workers",
+                    m_template);
+  }
+  setStatus(RUNNING);
+  Logger::Info("prefork template %d started", m_template);
+}
+
+void PreforkServer::runTemplate(int control, TemplateInit init) {
+  install_stop_handler(on_stop);
+  die_with_parent();
+
+  // the thread pools of the server process did not make it through fork(),
+  // and workers cannot start any of their own
+  RuntimeOption::PageletServerThreadCount = 0;
+  RuntimeOption::XboxServerThreadCount = 0;
+  RuntimeOption::EnableDebuggerServer = false;
+
+  timeval start;
+  gettimeofday(&start, NULL);
+  if (init) {
+    init();
+  }
+  if (!hphp_warmup_thread()) {
+    Logger::Error("prefork template failed to warm up");
+  }
+  Logger::Info("prefork template warmed up in %lld us",
+               (long long)elapsed_usec(start));
+
+  m_accept_sock = recv_fd(control);
+  if (m_accept_sock < 0) {
+    // the server process stopped, or never started the page server
+    fflush(NULL);
+    _exit(0);
+  }
+  fcntl(m_accept_sock, F_SETFD, FD_CLOEXEC);
+  if (write(control, "", 1) < 0) {
+    Logger::Error("prefork template failed to report back: %s",
+                  Util::safe_strerror(errno).c_str());
+  }
+  close(control);
+
+  vector<pid_t> slots(m_threadCount, 0);
+  while (!s_stopping) {
+    for (int slot = 0; slot < m_threadCount && !s_stopping; slot++) {
+      if (slots[slot]) continue;
+      // or else whatever is still buffered gets written by every worker
+      fflush(NULL);
+      gettimeofday(&start, NULL);
+      pid_t pid = fork();
+      if (pid == 0) {
+        runWorker(slot); // never returns
+      }
+      if (pid < 0) {
+        Logger::Error("Unable to fork worker: %s",
+                      Util::safe_strerror(errno).c_str());
+        sleep(1);
+        break;
+      }
+      Logger::Verbose("forked worker %d in %lld us", pid,
+                      (long long)elapsed_usec(start));
+      slots[slot] = pid;
+    }
+
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid <= 0) continue;
+    for (int slot = 0; slot < m_threadCount; slot++) {
+      if (slots[slot] == pid) {
+        slots[slot] = 0;
+        // a worker that died in the middle of a request never got to
+        // clear its slot
+        m_busy[slot] = 0;
+        break;
+      }
+    }
+    if (WIFSIGNALED(status)) {
+      Logger::Error("worker %d killed by signal %d", pid, WTERMSIG(status));
+    }
+  }
+
+  for (int slot = 0; slot < m_threadCount; slot++) {
+    if (slots[slot]) {
+      kill(slots[slot], SIGTERM);
+    }
+  }
+  while (waitpid(-1, NULL, 0) > 0 || errno == EINTR) {}
+  fflush(NULL);
+  _exit(0);
+}
+
+void PreforkServer::runWorker(int slot) {
+  die_with_parent();
+  timeval start;
+  gettimeofday(&start, NULL);
+
+  PreforkWorker worker(this, m_address, m_port, m_timeoutSeconds,
+                       m_accept_sock, m_busy + slot);
+  PreforkWorker::s_worker = &worker;
+  install_stop_handler(on_worker_stop);
+  if (!s_stopping) {
+    worker.serve();
+  }
+
+  // resident pages this worker still shares with the template and its
+  // siblings, against those it has had to copy or allocate
+  long long sharedKB, privateKB;
+  Process::GetProcessSharing(getpid(), sharedKB, privateKB);
+  Logger::Info("worker %d served %d requests in %lld ms, "
+               "private %lldKB, shared %lldKB", (int)getpid(),
+               worker.getServed(), (long long)elapsed_usec(start) / 1000,
+               privateKB, sharedKB);
+  fflush(NULL);
+  _exit(0);
+}
+
+void PreforkServer::waitForTemplate() {
+  pid_t pid;
+  {
+    Lock lock(m_mutex);
+    pid = m_template;
+  }
+  if (pid > 0) {
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {}
+    Lock lock(m_mutex);
+    m_template = -1;
+  }
+}
+
+void PreforkServer::waitForEnd() {
+  waitForTemplate();
+}
+
+void PreforkServer::stop() {
+  {
+    // a template that was forked but never started has to go, too
+    Lock lock(m_mutex);
+    if (getStatus() == STOPPING) return;
+    setStatus(STOPPING);
+    if (m_template > 0) {
+      kill(m_template, SIGTERM);
+    }
+  }
+  waitForTemplate();
+  setStatus(STOPPED);
+}
+
+int PreforkServer::getActiveWorker() {
+  if (!m_busy) return 0;
+  int active = 0;
+  for (int slot = 0; slot < m_threadCount; slot++) {
+    active += ((volatile int *)m_busy)[slot];
+  }
+  return active;
+}
+
+bool PreforkServer::enableSSL(const std::string &certFile,
+                              const std::string &keyFile, int port) {
+  Logger::Error("SSL is not supported by the prefork page server");
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,93 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HTTP_SERVER_PREFORK_SERVER_H__
+#define __HTTP_SERVER_PREFORK_SERVER_H__
+
+#include <runtime/base/server/server.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Page server that isolates requests with processes instead of rolling
+ * memory back after each one.
+ *
+ * forkTemplate() forks a template process while the server process is still
+ * running on its only thread. The template finishes initializing the
+ * runtime, warms up and waits for start() to hand it the page port. It then
+ * forks "thread" worker processes off its warmed-up heap and replaces each
+ * one as it exits. A worker holds one connection at a time and serves its
+ * requests right from its event loop, on the same thread that was warmed
+ * up, so its first request starts at the memory checkpoint without
+ * restoring anything. After Server.Prefork.MaxRequests requests it stops
+ * accepting, skips the rollback of its last request and exits; with the
+ * default of one, no request ever rolls back. Pages a worker never wrote to
+ * stay shared with the template and every other worker.
+ *
+ * The admin server, satellites and logging threads keep running in the
+ * server process; pagelet and xbox tasks are not available to workers,
+ * which have no threads to run them on.
+ */
+class PreforkServer : public Server {
+public:
+  /**
+   * What the template runs to finish initializing the runtime, before it
+   * warms up.
+   */
+  typedef void (*TemplateInit)();
+
+  PreforkServer(const std::string &address, int port, int thread,
+                int timeoutSeconds);
+  ~PreforkServer();
+
+  /**
+   * Forks the template process. This process must not be running any other
+   * thread yet, or a lock one of them holds at the time stays locked in the
+   * template and all of its workers. start() calls this if nobody did.
+   */
+  void forkTemplate(TemplateInit init = NULL);
+
+  virtual void start();
+  virtual void waitForEnd();
+  virtual void stop();
+  virtual int getActiveWorker();
+  virtual bool enableSSL(const std::string &certFile,
+                         const std::string &keyFile, int port);
+
+  /**
+   * Whether this is a worker process serving its last request, which has
+   * no need to roll memory back afterwards.
+   */
+  static bool IsRetiring();
+
+private:
+  int m_timeoutSeconds;
+  int m_accept_sock;
+  int m_control; // to the template, for handing it m_accept_sock
+  pid_t m_template;
+  int *m_busy; // one slot per worker, shared with all of them
+
+  int bindAcceptSocket();
+  void runTemplate(int control, TemplateInit init);
+  void runWorker(int slot);
+  void waitForTemplate();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HTTP_SERVER_PREFORK_SERVER_H__
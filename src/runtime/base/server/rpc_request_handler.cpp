@@ -23,6 +23,7 @@
 #include <runtime/base/server/source_root_info.h>
 #include <runtime/base/server/request_uri.h>
 #include <runtime/ext/ext_json.h>
+#include <runtime/ext/ext_fb.h>
 #include <util/process.h>
 
 using namespace std;
@@ -30,6 +31,29 @@ using namespace std;
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
+static const char *FBContentType = "application/x-fb-serialize";
+static const char *JSONContentType = "application/json";
+
+/**
+ * fb_serialize() encoding of a value when the caller asked for format=fb,
+ * JSON otherwise, or when the value has objects that fb_serialize() cannot
+ * take. contentType tells the caller which one it got.
+ */
+static String encode_value(CVarRef value, bool binary,
+                           const char *&contentType) {
+  if (binary) {
+    Variant encoded = f_fb_serialize(value);
+    if (encoded.isString()) {
+      contentType = FBContentType;
+      return encoded.toString();
+    }
+    contentType = JSONContentType;
+  }
+  return f_json_encode(value);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 RPCRequestHandler::RPCRequestHandler() : m_count(0), m_reset(false) {
   hphp_session_init();
   m_context = hphp_context_init();
@@ -113,6 +137,7 @@ bool RPCRequestHandler::executePHPFunction(Transport *transport,
   }
 
   bool error = false;
+  bool binary = transport->getParam("format") == "fb";
 
   Array params;
   std::string sparams = transport->getParam("params");
@@ -136,11 +161,24 @@ bool RPCRequestHandler::executePHPFunction(Transport *transport,
         params.append(jparams);
       }
     } else {
-      // single string parameter, used by xbox to avoid any en/decoding
       int size;
       const void *data = transport->getPostData(size);
       if (data && size) {
-        params.append(String((char*)data, size, AttachLiteral));
+        if (binary) {
+          // all parameters in one fb_serialize()-d array
+          Variant success;
+          Variant bparams =
+            f_fb_unserialize(String((char*)data, size, AttachLiteral),
+                             ref(success));
+          if (same(success, true) && bparams.isArray()) {
+            params = bparams.toArray();
+          } else {
+            error = true;
+          }
+        } else {
+          // single string parameter, used by xbox to avoid any en/decoding
+          params.append(String((char*)data, size, AttachLiteral));
+        }
       }
     }
   }
@@ -173,14 +211,27 @@ bool RPCRequestHandler::executePHPFunction(Transport *transport,
                            error, errorMsg);
     if (ret) {
       String response;
+      const char *contentType = NULL;
       switch (output) {
-        case 0: response = f_json_encode(funcRet);   break;
+        case 0: response = encode_value(funcRet, binary, contentType); break;
         case 1: response = m_context->obDetachContents(); break;
-        case 2:
-          response =
-            f_json_encode(CREATE_MAP2("output", m_context->obDetachContents(),
-                                      "return", f_json_encode(funcRet)));
+        case 2: {
+          String out = m_context->obDetachContents();
+          if (binary) {
+            // no need to encode the return twice when it is not JSON
+            response = encode_value(CREATE_MAP2("output", out,
+                                                "return", funcRet),
+                                    binary, contentType);
+            if (contentType == FBContentType) break;
+          }
+          response = f_json_encode(CREATE_MAP2("output", out,
+                                               "return",
+                                               f_json_encode(funcRet)));
           break;
+        }
+      }
+      if (contentType) {
+        transport->addHeader("Content-Type", contentType);
       }
       code = 200;
       transport->sendRaw((void*)response.data(), response.size());
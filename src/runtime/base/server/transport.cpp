@@ -27,6 +27,7 @@
 #include <runtime/base/zend/zend_url.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/server/access_log.h>
+#include <runtime/base/util/chunked_buffer.h>
 
 using namespace std;
 
@@ -578,6 +579,21 @@ void Transport::prepareHeaders(bool compressed, const void *data, int size) {
   }
 }
 
+bool Transport::shouldCompress(int size) {
+  if (m_compressionDecision == NotDecidedYet) {
+    decideCompression();
+  }
+  if (!isCompressionEnabled() || m_compressionDecision == ShouldNotCompress) {
+    return false;
+  }
+
+  // There isn't that much need to gzip response, when it can fit into one
+  // Ethernet packet (1500 bytes), unless we are doing chunked encoding,
+  // where we don't really know if next chunk will benefit from compresseion.
+  return m_chunkedEncoding || size > 1000 ||
+    m_compressionDecision == HasToCompress;
+}
+
 String Transport::prepareResponse(const void *data, int size, bool &compressed,
                                   bool last) {
   String response((const char *)data, size, AttachLiteral);
@@ -585,37 +601,27 @@ String Transport::prepareResponse(const void *data, int size, bool &compressed,
   // we don't use chunk encoding to send anything pre-compressed
   ASSERT(!compressed || !m_chunkedEncoding);
 
-  if (m_compressionDecision == NotDecidedYet) {
-    decideCompression();
-  }
-  if (compressed || !isCompressionEnabled() ||
-      m_compressionDecision == ShouldNotCompress) {
+  if (!shouldCompress(size) || compressed) {
     return response;
   }
 
-  // There isn't that much need to gzip response, when it can fit into one
-  // Ethernet packet (1500 bytes), unless we are doing chunked encoding,
-  // where we don't really know if next chunk will benefit from compresseion.
-  if (m_chunkedEncoding || size > 1000 ||
-      m_compressionDecision == HasToCompress) {
-    if (m_compressor == NULL) {
-      m_compressor = new StreamCompressor(RuntimeOption::GzipCompressionLevel,
-                                          CODING_GZIP, true);
-    }
-    int len = size;
-    char *compressedData =
-      m_compressor->compress((const char*)data, len, last);
-    if (compressedData) {
-      String deleter(compressedData, len, AttachString);
-      if (m_chunkedEncoding || len < size ||
-          m_compressionDecision == HasToCompress) {
-        response = deleter;
-        compressed = true;
-      }
-    } else {
-      Logger::Error("Unable to compress response: level=%d len=%d",
-                    RuntimeOption::GzipCompressionLevel, len);
+  if (m_compressor == NULL) {
+    m_compressor = new StreamCompressor(RuntimeOption::GzipCompressionLevel,
+                                        CODING_GZIP, true);
+  }
+  int len = size;
+  char *compressedData =
+    m_compressor->compress((const char*)data, len, last);
+  if (compressedData) {
+    String deleter(compressedData, len, AttachString);
+    if (m_chunkedEncoding || len < size ||
+        m_compressionDecision == HasToCompress) {
+      response = deleter;
+      compressed = true;
     }
+  } else {
+    Logger::Error("Unable to compress response: level=%d len=%d",
+                  RuntimeOption::GzipCompressionLevel, len);
   }
 
   return response;
@@ -670,6 +676,43 @@ void Transport::sendRaw(void *data, int size, int code /* = 200 */,
   }
 }
 
+void Transport::sendBuffer(const ChunkedBuffer &buf, int code /* = 200 */,
+                           bool chunked /* = false */) {
+  {
+    FiberWriteLock lock(this);
+    if (!chunked && !m_chunkedEncoding &&
+        !RuntimeOption::ForceChunkedEncoding && !shouldCompress(buf.size())) {
+      // nothing to transform, so hand the chunks down as they are
+      ServerStatsHelper ssh("send");
+      if (!m_headerSent) {
+        prepareHeaders(false, NULL, buf.size());
+        m_headerSent = true;
+      }
+      m_responseSize += buf.size();
+      if (m_responseCode < 0) {
+        m_responseCode = code;
+      }
+      ServerStats::SetThreadMode(ServerStats::Writing);
+      sendChunksImpl(buf, m_responseCode);
+      ServerStats::SetThreadMode(ServerStats::Processing);
+
+      ServerStats::LogBytes(buf.size());
+      if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
+        ServerStats::Log("network.uncompressed", buf.size());
+        ServerStats::Log("network.compressed", buf.size());
+      }
+      return;
+    }
+  }
+  String response = buf.copy();
+  sendRaw((void*)response.data(), response.size(), code, false, chunked);
+}
+
+void Transport::sendChunksImpl(const ChunkedBuffer &buf, int code) {
+  String response = buf.copy();
+  sendImpl(response.data(), response.size(), code, false);
+}
+
 void Transport::onSendEnd() {
   FiberWriteLock lock(this);
   if (m_compressor && m_chunkedEncoding) {
@@ -27,6 +27,8 @@
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
+class ChunkedBuffer;
+
 /**
  * For storing headers and cookies.
  */
@@ -177,6 +179,13 @@ public:
   virtual void sendImpl(const void *data, int size, int code,
                         bool chunked) = 0;
 
+  /**
+   * Send back a whole, uncompressed response that is held in a chunk list.
+   * Default flattens it and calls sendImpl(); transports that can queue
+   * the chunks one by one should override.
+   */
+  virtual void sendChunksImpl(const ChunkedBuffer &buf, int code);
+
   /**
    * Override to implement more send end logic.
    */
@@ -267,6 +276,8 @@ public:
   bool headersSent() { return m_headerSent;}
   virtual void sendRaw(void *data, int size, int code = 200,
                        bool compressed = false, bool chunked = false);
+  void sendBuffer(const ChunkedBuffer &buf, int code = 200,
+                  bool chunked = false);
   void sendString(const char *data, int code = 200, bool compressed = false,
                   bool chunked = false) {
     sendRaw((void*)data, strlen(data), code, compressed, chunked);
@@ -340,6 +351,7 @@ protected:
   bool splitHeader(CStrRef header, String &name, const char *&value);
 
   void prepareHeaders(bool compressed, const void *data, int size);
+  bool shouldCompress(int size);
   String prepareResponse(const void *data, int size, bool &compressed,
                          bool last);
 };
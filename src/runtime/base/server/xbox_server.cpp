@@ -20,6 +20,7 @@
 #include <runtime/base/server/satellite_server.h>
 #include <runtime/base/util/libevent_http_client.h>
 #include <runtime/ext/ext_json.h>
+#include <runtime/ext/ext_fb.h>
 #include <util/job_queue.h>
 #include <util/lock.h>
 
@@ -191,6 +192,39 @@ static bool isLocalHost(CStrRef host) {
   return host.empty() || host == "localhost" || host == "127.0.0.1";
 }
 
+/**
+ * A client to the xbox server on a remote host, out of the keep-alive pool
+ * for that host when Xbox.ConnectionPoolSize is set.
+ */
+static LibEventHttpClientPtr get_http_client(const string &host) {
+  if (RuntimeOption::XboxConnectionPoolSize > 0) {
+    static Mutex s_mutex;
+    static set<string> s_pooled;
+    Lock lock(s_mutex);
+    if (s_pooled.insert(host).second) {
+      LibEventHttpClient::SetCache(host, RuntimeOption::XboxServerPort,
+                                   RuntimeOption::XboxConnectionPoolSize);
+    }
+  }
+  return LibEventHttpClient::Get(host, RuntimeOption::XboxServerPort);
+}
+
+/**
+ * Remote xbox servers answer format=fb requests with fb_serialize()-d
+ * responses, unless the return value could only be sent as JSON.
+ */
+static Variant decode_response(LibEventHttpClientPtr http,
+                               CStrRef response) {
+  const vector<string> &headers = http->getResponseHeaders();
+  for (unsigned int i = 0; i < headers.size(); i++) {
+    if (strcasecmp(headers[i].c_str(),
+                   "Content-Type: application/x-fb-serialize") == 0) {
+      return f_fb_unserialize(response, null);
+    }
+  }
+  return f_json_decode(response);
+}
+
 bool XboxServer::SendMessage(CStrRef message, Variant &ret, int timeout_ms,
                              CStrRef host /* = "localhost" */) {
   if (isLocalHost(host)) {
@@ -235,29 +269,44 @@ bool XboxServer::SendMessage(CStrRef message, Variant &ret, int timeout_ms,
       timeoutSeconds = RuntimeOption::XboxDefaultRemoteTimeoutSeconds;
     }
 
-    string hostStr(host.data());
+    // older servers would take an fb_serialize()-d body for the message
+    // itself, so mixed versions keep sending it raw
+    String body = message;
+    if (RuntimeOption::XboxFBSerializeMessages) {
+      url += "?format=fb";
+      body = f_fb_serialize(CREATE_VECTOR1(message)).toString();
+    }
     vector<string> headers;
-    LibEventHttpClientPtr http =
-      LibEventHttpClient::Get(hostStr, RuntimeOption::XboxServerPort);
+    LibEventHttpClientPtr http = get_http_client(host.data());
+    bool done = false;
+    int code = 0;
     if (http->send(url, headers, timeoutSeconds, false,
-                   message.data(), message.size())) {
-      int code = http->getCode();
+                   body.data(), body.size())) {
+      code = http->getCode();
       if (code > 0) {
         int len = 0;
         char *response = http->recv(len);
         String sresponse(response, len, AttachString);
         ret.set("code", code);
         if (code == 200) {
-          ret.set("response", f_json_decode(sresponse));
+          ret.set("response", decode_response(http, sresponse));
         } else {
           ret.set("error", sresponse);
         }
-        return true;
+        done = true;
+      } else {
+        // code wasn't correctly set by http client, treat it as not found
+        ret.set("code", 404);
+        ret.set("error", "http client failed");
       }
-      // code wasn't correctly set by http client, treat it as not found
-      ret.set("code", 404);
-      ret.set("error", "http client failed");
     }
+    // only a connection that got its response back can be pooled again
+    if (code > 0) {
+      http->release();
+    } else {
+      http->discard();
+    }
+    return done;
   }
 
   return false;
@@ -284,20 +333,24 @@ bool XboxServer::PostMessage(CStrRef message,
     url += "/xbox_post_message";
 
     vector<string> headers;
-    string hostStr(host.data());
-    LibEventHttpClientPtr http =
-      LibEventHttpClient::Get(hostStr, RuntimeOption::XboxServerPort);
+    LibEventHttpClientPtr http = get_http_client(host.data());
+    bool done = false;
+    int code = 0;
     if (http->send(url, headers, 0, false, message.data(), message.size())) {
-      int code = http->getCode();
+      code = http->getCode();
       if (code > 0) {
         int len = 0;
         char *response = http->recv(len);
         String sresponse(response, len, AttachString);
-        if (code == 200 && same(f_json_decode(sresponse), true)) {
-          return true;
-        }
+        done = code == 200 && same(f_json_decode(sresponse), true);
       }
     }
+    if (code > 0) {
+      http->release();
+    } else {
+      http->discard();
+    }
+    return done;
   }
 
   return false;
@@ -0,0 +1,465 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/shared/packed_shared_variant.h>
+#include <runtime/ext/ext_variable.h>
+#include <runtime/base/shared/shared_map.h>
+#include <runtime/base/array/array_init.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+struct PackedSharedVariant::Bucket {
+  /** index of the next bucket, or -1 if the end of a chain */
+  int next;
+  PackedSharedVariant key;
+  PackedSharedVariant val;
+};
+
+static inline size_t align_packed(size_t size) {
+  return (size + 7) & ~(size_t)7;
+}
+
+static inline char *segment_base() {
+  return (char*)SharedMemoryManager::GetSegment()->get_address();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Two passes over the source: measure() adds up the payload bytes so the
+ * block can be allocated in one go, fill() then lays the nodes out. Anything
+ * serialized during measuring is kept so fill() doesn't serialize it again.
+ */
+class PackedSharedVariantBuilder {
+public:
+  PackedSharedVariantBuilder() : m_next(0), m_cursor(NULL) {}
+
+  size_t measure(CVarRef source, bool inner);
+  void start(char *cursor) { m_cursor = cursor;}
+  char *end() const { return m_cursor;}
+  void fill(PackedSharedVariant *node, PackedSharedVariant *root,
+            CVarRef source, bool inner);
+
+private:
+  std::vector<String> m_serialized;
+  size_t m_next;
+  char *m_cursor;
+
+  char *reserve(size_t size) {
+    char *ret = m_cursor;
+    m_cursor += align_packed(size);
+    return ret;
+  }
+  size_t measureSerialized(CVarRef source) {
+    m_serialized.push_back(f_serialize(source));
+    return align_packed(m_serialized.back().size() + 1);
+  }
+  void fillString(PackedSharedVariant *node, const char *data, int len) {
+    char *p = reserve(len + 1);
+    memcpy(p, data, len);
+    p[len] = '\0';
+    node->m_size = len;
+    node->m_data.off = p - (char*)node;
+  }
+  void fillSerialized(PackedSharedVariant *node) {
+    ASSERT(m_next < m_serialized.size());
+    CStrRef s = m_serialized[m_next++];
+    fillString(node, s.data(), s.size());
+  }
+};
+
+size_t PackedSharedVariantBuilder::measure(CVarRef source, bool inner) {
+  switch (source.getType()) {
+  case KindOfBoolean:
+  case KindOfByte:
+  case KindOfInt16:
+  case KindOfInt32:
+  case KindOfInt64:
+  case KindOfDouble:
+    return 0;
+  case KindOfStaticString:
+  case KindOfString:
+    return align_packed(source.getStringData()->size() + 1);
+  case KindOfArray:
+    {
+      ArrayData *arr = source.getArrayData();
+      if (!inner) {
+        // only need to call hasInternalReference() on the toplevel array
+        PointerSet seen;
+        if (arr->hasInternalReference(seen)) {
+          return measureSerialized(source);
+        }
+      }
+      size_t n = arr->size();
+      size_t size = align_packed(sizeof(int) * n) +
+        sizeof(PackedSharedVariant::Bucket) * n;
+      for (ArrayIter it(arr); !it.end(); it.next()) {
+        size += measure(it.first(), true);
+        size += measure(it.second(), true);
+      }
+      return size;
+    }
+  default:
+    return measureSerialized(source);
+  }
+}
+
+void PackedSharedVariantBuilder::fill(PackedSharedVariant *node,
+                                      PackedSharedVariant *root,
+                                      CVarRef source, bool inner) {
+  node->m_root = (char*)node - (char*)root;
+  switch (source.getType()) {
+  case KindOfBoolean:
+    node->m_type = KindOfBoolean;
+    node->m_data.num = source.toBoolean();
+    break;
+  case KindOfByte:
+  case KindOfInt16:
+  case KindOfInt32:
+  case KindOfInt64:
+    node->m_type = KindOfInt64;
+    node->m_data.num = source.toInt64();
+    break;
+  case KindOfDouble:
+    node->m_type = KindOfDouble;
+    node->m_data.dbl = source.toDouble();
+    break;
+  case KindOfStaticString:
+  case KindOfString:
+    {
+      StringData *sd = source.getStringData();
+      node->m_type = KindOfString;
+      fillString(node, sd->data(), sd->size());
+      break;
+    }
+  case KindOfArray:
+    {
+      node->m_type = KindOfArray;
+      ArrayData *arr = source.getArrayData();
+      if (!inner) {
+        PointerSet seen;
+        if (arr->hasInternalReference(seen)) {
+          node->setSerializedArray();
+          node->setShouldCache();
+          fillSerialized(node);
+          break;
+        }
+      }
+
+      uint n = arr->size();
+      int *hash = (int*)reserve(sizeof(int) * n);
+      for (uint i = 0; i < n; i++) hash[i] = -1;
+      PackedSharedVariant::Bucket *buckets =
+        (PackedSharedVariant::Bucket*)
+        reserve(sizeof(PackedSharedVariant::Bucket) * n);
+      node->m_size = n;
+      node->m_data.off = (char*)hash - (char*)node;
+
+      // NOTE: no check on duplication because we assume the original array
+      // has no duplication
+      uint i = 0;
+      for (ArrayIter it(arr); !it.end(); it.next(), i++) {
+        PackedSharedVariant::Bucket *b = buckets + i;
+        PackedSharedVariant *key = new (&b->key) PackedSharedVariant();
+        PackedSharedVariant *val = new (&b->val) PackedSharedVariant();
+        fill(key, root, it.first(), true);
+        fill(val, root, it.second(), true);
+        if (val->shouldCache()) node->setShouldCache();
+
+        size_t hash_pos;
+        if (key->is(KindOfInt64)) {
+          hash_pos = (size_t)key->m_data.num % n;
+        } else {
+          ASSERT(key->is(KindOfString));
+          hash_pos = (size_t)hash_string(key->stringData(), key->m_size) % n;
+        }
+        b->next = hash[hash_pos];
+        hash[hash_pos] = i;
+      }
+      break;
+    }
+  default:
+    node->m_type = KindOfObject;
+    node->setShouldCache();
+    fillSerialized(node);
+    break;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PackedSharedVariant *PackedSharedVariant::Create(CVarRef source,
+                                                 ProcessSharedVariantLock *lock,
+                                                 SharedMemoryArena *arena) {
+  ASSERT(lock && arena);
+  PackedSharedVariantBuilder builder;
+  size_t bytes = sizeof(Header) + sizeof(PackedSharedVariant) +
+    builder.measure(source, false);
+
+  Header *header = (Header*)arena->allocate(bytes);
+  header->lock = (char*)lock - segment_base();
+  header->arena = (char*)arena - segment_base();
+  header->bytes = bytes;
+  header->reserved = 0;
+
+  PackedSharedVariant *root = new (header + 1) PackedSharedVariant();
+  builder.start((char*)(root + 1));
+  builder.fill(root, root, source, false);
+  ASSERT(builder.end() == (char*)header + bytes);
+  return root;
+}
+
+PackedSharedVariant *PackedSharedVariant::relocate(SharedMemoryArena *arena) {
+  ASSERT(m_root == 0 && m_ref == 1);
+  Header *header = (Header*)arena->relocate(getHeader());
+  if (header == NULL) return NULL;
+  return (PackedSharedVariant*)(header + 1);
+}
+
+ProcessSharedVariantLock *PackedSharedVariant::getLock() const {
+  return (ProcessSharedVariantLock*)(segment_base() + getHeader()->lock);
+}
+
+SharedMemoryArena *PackedSharedVariant::getArena() const {
+  return (SharedMemoryArena*)(segment_base() + getHeader()->arena);
+}
+
+size_t PackedSharedVariant::getBlockSize() const {
+  return getHeader()->bytes;
+}
+
+PackedSharedVariant::Bucket *PackedSharedVariant::buckets() const {
+  ASSERT(is(KindOfArray) && !getSerializedArray());
+  return (Bucket*)(getPayload<char>() + align_packed(sizeof(int) * m_size));
+}
+
+void PackedSharedVariant::incRef() {
+  PackedSharedVariant *root = getRoot();
+  ProcessSharedVariantLock *lock = getLock();
+  lock->lock();
+  ++root->m_ref;
+  lock->unlock();
+}
+
+void PackedSharedVariant::decRef() {
+  PackedSharedVariant *root = getRoot();
+  ASSERT(root->m_ref);
+  ProcessSharedVariantLock *lock = getLock();
+  lock->lock();
+  if (--root->m_ref == 0) {
+    lock->unlock();
+    // children live inside the same block, nothing to release one by one
+    getArena()->deallocate(getHeader());
+  } else {
+    lock->unlock();
+  }
+}
+
+Variant PackedSharedVariant::toLocal() {
+  switch (m_type) {
+  case KindOfBoolean:
+    {
+      return (bool)m_data.num;
+    }
+  case KindOfInt64:
+    {
+      return m_data.num;
+    }
+  case KindOfDouble:
+    {
+      return m_data.dbl;
+    }
+  case KindOfString:
+    {
+      return NEW(StringData)(this);
+    }
+  case KindOfArray:
+    {
+      if (getSerializedArray()) {
+        return f_unserialize(String(serializedData(), m_size, AttachLiteral));
+      }
+      return NEW(SharedMap)(this);
+    }
+  default:
+    {
+      ASSERT(m_type == KindOfObject);
+      return f_unserialize(String(serializedData(), m_size, AttachLiteral));
+    }
+  }
+}
+
+int PackedSharedVariant::indexOf(int64 key) const {
+  if (m_size == 0) return -1;
+  const Bucket *b = buckets();
+  for (int i = hashTable()[(size_t)key % m_size]; i != -1; i = b[i].next) {
+    if (b[i].key.is(KindOfInt64) && b[i].key.m_data.num == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int PackedSharedVariant::indexOf(const char *key, int len) const {
+  if (m_size == 0) return -1;
+  const Bucket *b = buckets();
+  size_t hash_pos = (size_t)hash_string(key, len) % m_size;
+  for (int i = hashTable()[hash_pos]; i != -1; i = b[i].next) {
+    const PackedSharedVariant &k = b[i].key;
+    if (k.is(KindOfString) && k.m_size == (uint32)len &&
+        memcmp(k.stringData(), key, len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int PackedSharedVariant::getIndex(CVarRef key) {
+  ASSERT(is(KindOfArray));
+  if (getSerializedArray()) return -1;
+  switch (key.getType()) {
+  case KindOfByte:
+  case KindOfInt16:
+  case KindOfInt32:
+  case KindOfInt64:
+    return indexOf(key.getNumData());
+  case KindOfStaticString:
+  case KindOfString:
+    {
+      StringData *sd = key.getStringData();
+      return indexOf(sd->data(), sd->size());
+    }
+  default:
+    // No other types are legitimate keys
+    break;
+  }
+  return -1;
+}
+
+SharedVariant* PackedSharedVariant::get(CVarRef key) {
+  int idx = getIndex(key);
+  if (idx != -1) {
+    return &buckets()[idx].val;
+  }
+  return NULL;
+}
+
+bool PackedSharedVariant::exists(CVarRef key) {
+  return getIndex(key) != -1;
+}
+
+void PackedSharedVariant::loadElems(ArrayData *&elems,
+                                    const SharedMap &sharedMap,
+                                    bool keepRef /* = false */) {
+  ASSERT(is(KindOfArray));
+  uint count = arrSize();
+  Bucket *b = buckets();
+  ArrayInit ai(count, false, keepRef);
+  for (uint i = 0; i < count; i++) {
+    ai.set(i, b[i].key.toLocal(), sharedMap.getValue(i), -1, true);
+  }
+  elems = ai.create();
+  if (elems->isStatic()) elems = elems->copy();
+}
+
+Variant PackedSharedVariant::getKey(ssize_t pos) const {
+  return buckets()[pos].key.toLocal();
+}
+
+SharedVariant* PackedSharedVariant::getKeySV(ssize_t pos) const {
+  return &buckets()[pos].key;
+}
+
+SharedVariant* PackedSharedVariant::getValue(ssize_t pos) const {
+  return &buckets()[pos].val;
+}
+
+void PackedSharedVariant::dump(std::string &out) {
+  out += "ref(";
+  out += boost::lexical_cast<string>(getRoot()->m_ref);
+  out += ") ";
+  switch (m_type) {
+  case KindOfBoolean:
+    out += "boolean: ";
+    out += m_data.num ? "true" : "false";
+    break;
+  case KindOfInt64:
+    out += "int: ";
+    out += boost::lexical_cast<string>(m_data.num);
+    break;
+  case KindOfDouble:
+    out += "double: ";
+    out += boost::lexical_cast<string>(m_data.dbl);
+    break;
+  case KindOfString:
+    out += "string(";
+    out += boost::lexical_cast<string>(stringLength());
+    out += "): ";
+    out += stringData();
+    break;
+  case KindOfArray:
+    if (getSerializedArray()) {
+      out += "array: ";
+      out += serializedData();
+    } else {
+      incRef();
+      SharedMap(this).dump(out);
+    }
+    break;
+  default:
+    out += "object: ";
+    out += serializedData();
+    break;
+  }
+  out += "\n";
+}
+
+void PackedSharedVariant::getStats(SharedVariantStats *stats) {
+  stats->initStats();
+  stats->variantCount = 1;
+  switch (m_type) {
+  case KindOfBoolean:
+  case KindOfInt64:
+    stats->dataSize = sizeof(m_data.num);
+    break;
+  case KindOfDouble:
+    stats->dataSize = sizeof(m_data.dbl);
+    break;
+  case KindOfArray:
+    if (!getSerializedArray()) {
+      Bucket *b = buckets();
+      for (uint i = 0; i < m_size; i++) {
+        SharedVariantStats childStats;
+        b[i].key.getStats(&childStats);
+        stats->addChildStats(&childStats);
+        b[i].val.getStats(&childStats);
+        stats->addChildStats(&childStats);
+      }
+      break;
+    }
+    // fall through
+  default:
+    stats->dataSize = m_size;
+    break;
+  }
+  // the block is accounted for once, on the root
+  stats->dataTotalSize = m_root ? 0 : getBlockSize();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
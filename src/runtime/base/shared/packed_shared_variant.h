@@ -0,0 +1,138 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_PACKED_SHARED_VARIANT_H__
+#define __HPHP_PACKED_SHARED_VARIANT_H__
+
+#include <runtime/base/shared/process_shared_variant.h>
+#include <util/shared_memory_arena.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A process-shared value whose whole tree (strings, nested arrays, keys and
+ * their hash chains) is laid out in one contiguous block of shared memory.
+ *
+ *   [Header][root node][array payloads and string bytes ...]
+ *
+ * Every reference inside the block is a byte offset relative to the node that
+ * holds it, so the block is position independent: the owning store can move
+ * it with a plain memcpy when compacting the arena. Child nodes are never
+ * allocated or freed individually; their reference counts are forwarded to
+ * the root, which releases the whole block at once.
+ */
+class PackedSharedVariant : public SharedVariant {
+public:
+  static PackedSharedVariant *Create(CVarRef source,
+                                     ProcessSharedVariantLock *lock,
+                                     SharedMemoryArena *arena);
+
+  /**
+   * Moves the block out of a sparse arena chunk. Returns the new root, or
+   * NULL if it stayed. Caller must hold the only reference.
+   */
+  PackedSharedVariant *relocate(SharedMemoryArena *arena);
+
+  virtual void incRef();
+  virtual void decRef();
+
+  Variant toLocal();
+
+  virtual int64 intData() const {
+    ASSERT(is(KindOfInt64));
+    return m_data.num;
+  }
+
+  const char* stringData() const {
+    ASSERT(is(KindOfString));
+    return getPayload<char>();
+  }
+  size_t stringLength() const {
+    ASSERT(is(KindOfString));
+    return m_size;
+  }
+
+  size_t arrSize() const {
+    ASSERT(is(KindOfArray));
+    return getSerializedArray() ? 0 : m_size;
+  }
+
+  int getIndex(CVarRef key);
+  SharedVariant* get(CVarRef key);
+  bool exists(CVarRef key);
+  void loadElems(ArrayData *&elems, const SharedMap &sharedMap,
+                 bool keepRef = false);
+
+  virtual Variant getKey(ssize_t pos) const;
+  virtual SharedVariant* getValue(ssize_t pos) const;
+
+  int getRefCount() const { return getRoot()->m_ref;}
+  size_t getBlockSize() const;
+
+  // implementing LeakDetectable
+  virtual void dump(std::string &out);
+  virtual void getStats(SharedVariantStats* stats);
+
+  struct Bucket;
+
+private:
+  friend class PackedSharedVariantBuilder;
+
+  struct Header {
+    int64 lock;   // offset of the lock from the segment base
+    int64 arena;  // offset of the owning arena from the segment base
+    uint32 bytes; // size of the whole block, header included
+    uint32 reserved;
+  };
+
+  PackedSharedVariant() : m_root(0), m_size(0) {}
+
+  int32 m_root;  // distance back to the root node, 0 on the root itself
+  uint32 m_size; // string length or number of elements
+  union {
+    int64 num;
+    double dbl;
+    int64 off;   // distance to string bytes or the array's hash table
+  } m_data;
+
+  PackedSharedVariant *getRoot() const {
+    return (PackedSharedVariant*)((char*)this - m_root);
+  }
+  Header *getHeader() const {
+    return (Header*)getRoot() - 1;
+  }
+  ProcessSharedVariantLock *getLock() const;
+  SharedMemoryArena *getArena() const;
+
+  template<class T>
+  T *getPayload() const {
+    return (T*)((char*)this + m_data.off);
+  }
+  const int *hashTable() const { return getPayload<int>();}
+  Bucket *buckets() const;
+  const char *serializedData() const { return getPayload<char>();}
+
+  int indexOf(int64 key) const;
+  int indexOf(const char *key, int len) const;
+
+  virtual SharedVariant* getKeySV(ssize_t pos) const;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif /* __HPHP_PACKED_SHARED_VARIANT_H__ */
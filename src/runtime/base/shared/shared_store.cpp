@@ -17,6 +17,7 @@
 #include <runtime/base/shared/shared_store.h>
 #include <runtime/base/complex_types.h>
 #include <runtime/base/shared/process_shared_variant.h>
+#include <runtime/base/shared/packed_shared_variant.h>
 #include <runtime/base/shared/thread_shared_variant.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/builtin_functions.h>
@@ -66,7 +67,7 @@ protected:
 
 class ProcessSharedStore : public LockedSharedStore {
 public:
-  ProcessSharedStore(int id) : LockedSharedStore(id) {
+  ProcessSharedStore(int id) : LockedSharedStore(id), m_arena(NULL) {
     if (!s_initialized) {
       Lock lock(s_mutex);
       if (!s_initialized) {
@@ -86,6 +87,11 @@ public:
       find_or_construct<ProcessSharedVariantLock>(valLocksName.c_str())
       [s_lockCount]();
     m_vars = SharedMemory<SharedMap>::OpenOrCreate(mapName.c_str());
+    if (RuntimeOption::ApcSharedMemoryCompact) {
+      std::string arenaName = std::string("HPHP_APCArena") + sid;
+      m_arena = SharedMemoryArena::OpenOrCreate
+        (arenaName.c_str(), RuntimeOption::ApcSharedMemoryChunkSize * 1024);
+    }
   }
   virtual bool find(CStrRef key, StoreValue *&val, bool &expired) {
     ASSERT(expired == false);
@@ -104,9 +110,13 @@ public:
   }
   virtual void set(CStrRef key, SharedVariant* v, int64 ttl) {
     (*m_vars)[SharedMemoryString(key.data(), key.size())].set(putVar(v), ttl);
+    compactLocked();
   }
   virtual SharedVariant* construct(CStrRef key, CVarRef v) {
     ProcessSharedVariantLock* lock = getLock(key);
+    if (m_arena) {
+      return PackedSharedVariant::Create(v, lock, m_arena);
+    }
     return SharedMemoryManager::GetSegment()->construct<ProcessSharedVariant>
       (boost::interprocess::anonymous_instance)(v, lock);
   }
@@ -161,6 +171,7 @@ public:
       }
       getVar(iter->second.var)->decRef();
       m_vars->erase(iter);
+      compactLocked();
       return true;
     }
     return false;
@@ -193,15 +204,39 @@ public:
     unlockMap();
   }
 
+  virtual std::string reportStats(int &reachable, int indent);
+
 private:
   typedef SharedMemoryMap<SharedMemoryString, StoreValue> SharedMap;
   ProcessSharedVariantLock* getLock(CStrRef key) {
     ssize_t hash = hash_string(key.data(), key.size());
     return &m_locks[hash % s_lockCount];
   }
+
+  /**
+   * Packed values are position independent, so once sparse chunks take up
+   * enough of the arena we move every value nobody else is reading out of
+   * them, which lets those chunks go back to the segment. The walk stops as
+   * soon as no sparse chunk is left. Map lock has to be held for writing, so
+   * no new references can be handed out meanwhile.
+   */
+  void compactLocked() {
+    if (!m_arena || !m_arena->needsCompaction()) return;
+    for (SharedMap::iterator iter = m_vars->begin();
+         iter != m_vars->end() && m_arena->getSparseBytes(); ++iter) {
+      PackedSharedVariant *var =
+        static_cast<PackedSharedVariant*>(getVar(iter->second.var));
+      if (var->getRefCount() != 1) continue;
+      PackedSharedVariant *moved = var->relocate(m_arena);
+      if (moved) iter->second.var = putVar(moved);
+    }
+    m_arena->compacted();
+  }
+
   SharedMap *m_vars;
   boost::interprocess::interprocess_upgradable_mutex* m_mapLock;
   ProcessSharedVariantLock *m_locks;
+  SharedMemoryArena *m_arena;
   static Mutex s_mutex;
   static bool s_initialized;
 };
@@ -371,6 +406,18 @@ public:
     }
     unlockMap();
   }
+  virtual void getKeys(std::vector<KeyExpiry> &keys) {
+    readLockMap();
+    for (StringMap::const_iterator iter = m_vars.begin();
+         iter != m_vars.end(); ++iter) {
+      if (!iter->second.expired()) {
+        keys.push_back(KeyExpiry(string(iter->first->data(),
+                                        iter->first->size()),
+                                 iter->second.expiry));
+      }
+    }
+    readUnlockMap();
+  }
   virtual void lockMap() {
     m_mlock.acquireWrite();
   }
@@ -606,7 +653,9 @@ private:
 class ConcurrentTableSharedStore : public SharedStore,
                                    private ThreadSharedVariantFactory {
 public:
-  ConcurrentTableSharedStore(int id) : SharedStore(id), m_purgeCounter(0) {}
+  ConcurrentTableSharedStore(int id,
+                             bool expireOnSets = RuntimeOption::ApcExpireOnSets)
+    : SharedStore(id), m_purgeCounter(0), m_expireOnSets(expireOnSets) {}
 
   virtual int size() {
     return m_vars.size();
@@ -640,6 +689,15 @@ public:
   virtual SharedVariant* construct(litstr str, int len, CVarRef v) {
     return create(str, len, v);
   }
+  virtual void getKeys(std::vector<KeyExpiry> &keys) {
+    WriteLock l(m_lock);
+    for (Map::const_iterator iter = m_vars.begin();
+         iter != m_vars.end(); ++iter) {
+      if (!iter->second.expired()) {
+        keys.push_back(KeyExpiry(iter->first, iter->second.expiry));
+      }
+    }
+  }
 protected:
   virtual SharedVariant* construct(CStrRef key, CVarRef v) {
     return create(key, v);
@@ -726,6 +784,7 @@ protected:
                       ExpirationCompare> m_expirationQueue;
   ReadWriteMutex m_expirationQueueLock;
   uint64 m_purgeCounter;
+  bool m_expireOnSets;
 
   // Should be called outside m_lock
   void purgeExpired() {
@@ -969,7 +1028,7 @@ bool ConcurrentTableSharedStore::store(CStrRef key, CVarRef val, int64 ttl,
       SharedStoreStats::onStore(key.get(), var, ttl, false);
     }
   }
-  if (RuntimeOption::ApcExpireOnSets) {
+  if (m_expireOnSets) {
     if (ttl) {
       addToExpirationQueue(key.data(), expiry);
     }
@@ -1304,6 +1363,22 @@ std::string SharedStore::reportStats(int &reachable, int indent) {
 }
 
 
+std::string ProcessSharedStore::reportStats(int &reachable, int indent) {
+  string ret = SharedStore::reportStats(reachable, indent);
+  if (m_arena) {
+    lockMap();
+    ret += appendElement(indent, "ArenaChunks", m_arena->getChunkCount());
+    ret += appendElement(indent, "ArenaChunkKB",
+                         m_arena->getChunkBytes() / 1024);
+    ret += appendElement(indent, "ArenaLiveKB",
+                         m_arena->getLiveBytes() / 1024);
+    ret += appendElement(indent, "ArenaSparseKB",
+                         m_arena->getSparseBytes() / 1024);
+    unlockMap();
+  }
+  return ret;
+}
+
 std::string LfuTableSharedStore::reportStats(int &reachable, int indent) {
   string ret = SharedStore::reportStats(reachable, indent);
   ret += appendElement(indent, "Immortal", m_vars.immortalCount());
@@ -1347,12 +1422,6 @@ void SharedStores::create() {
           time_t maturity = RuntimeOption::ApcKeyMaturityThreshold;
           size_t maxCap = RuntimeOption::ApcMaximumCapacity;
           int updatePeriod = RuntimeOption::ApcKeyFrequencyUpdatePeriod;
-
-          if (i == SHARED_STORE_DNS_CACHE) {
-            maturity = RuntimeOption::DnsCacheKeyMaturityThreshold;
-            maxCap = RuntimeOption::DnsCacheMaximumCapacity;
-            updatePeriod = RuntimeOption::DnsCacheKeyFrequencyUpdatePeriod;
-          }
           m_stores[i] = new LfuTableSharedStore(i, maturity, maxCap,
                                                 updatePeriod);
         }
@@ -1365,6 +1434,8 @@ void SharedStores::create() {
       }
     }
   }
+  // sessions always expire on sets, as nothing else would ever drop them
+  m_session = new ConcurrentTableSharedStore(SHARED_STORE_SESSION, true);
 }
 
 SharedStores::~SharedStores() {
@@ -1375,6 +1446,7 @@ void SharedStores::clear() {
   for (int i = 0; i < MAX_SHARED_STORE; i++) {
     delete m_stores[i];
   }
+  delete m_session;
 }
 
 void SharedStores::reset() {
@@ -1388,13 +1460,14 @@ std::string SharedStores::reportStats(int indent) {
 #ifdef DEBUG_APC_LEAK
   LeakDetectable::BeginLeakChecking();
 #endif
-  for (int i = 0; i < MAX_SHARED_STORE; i++) {
+  for (int i = 0; i <= MAX_SHARED_STORE; i++) {
+    SharedStore *store = i == SHARED_STORE_SESSION ? m_session : m_stores[i];
     for (int j = 0; j < indent; j++) ret += "  ";
     ret += "<SharedStore>\n";
 
     ret += appendElement(indent + 1, "Index", i);
     int reachable = 0;
-    ret += m_stores[i]->reportStats(reachable, indent + 1);
+    ret += store->reportStats(reachable, indent + 1);
     totalReachable += reachable;
 
     for (int j = 0; j < indent; j++) ret += "  ";
@@ -23,8 +23,10 @@
 #include <runtime/base/complex_types.h>
 
 #define SHARED_STORE_APPLICATION_CACHE 0
-#define SHARED_STORE_DNS_CACHE 1
+// cache id 1 used to hold DNS lookups, and is now a store like any other
 #define MAX_SHARED_STORE 2
+// not one of the apc_*() cache ids, see SharedStores::session()
+#define SHARED_STORE_SESSION MAX_SHARED_STORE
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -66,6 +68,14 @@ public:
   };
   virtual void prime(const std::vector<KeyValuePair> &vars) = 0;
 
+  /**
+   * Keys that have not expired, with their expiration times (0 for none),
+   * for handing APC over to another server process. Stores that cannot
+   * list their keys cheaply return none.
+   */
+  typedef std::pair<std::string, int64> KeyExpiry;
+  virtual void getKeys(std::vector<KeyExpiry> &keys) {}
+
   virtual std::string reportStats(int &reachable, int indent);
   virtual bool check() { return true; }
   static size_t s_lockCount;
@@ -98,10 +108,20 @@ public:
     return *m_stores[id];
   }
 
+  /**
+   * Sessions of the "shm" save handler. They never share a table with APC:
+   * this store does not evict, whatever ApcTableType says, and apc_*() have
+   * no cache id to reach it with.
+   */
+  SharedStore& session() {
+    return *m_session;
+  }
+
   std::string reportStats(int indent);
 
 private:
   SharedStore* m_stores[MAX_SHARED_STORE];
+  SharedStore* m_session;
 };
 
 extern SharedStores s_apc_store;
@@ -19,6 +19,7 @@
 #include <runtime/ext/ext_apc.h>
 #include <runtime/base/shared/shared_map.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/string_intern_table.h>
 
 using namespace std;
 
@@ -99,7 +100,17 @@ ThreadSharedVariant::ThreadSharedVariant(CVarRef source, bool serialized,
         m_data.map = new ImmutableMap(size);
         uint i = 0;
         for (ArrayIter it(arr); !it.end(); it.next(), i++) {
-          ThreadSharedVariant* key = createAnother(it.first(), false);
+          Variant k = it.first();
+          if (k.isString() && !k.getStringData()->isStatic()) {
+            // keys are fetched over and over, and interned ones come back
+            // out of APC without allocating anything; one-off keys are left
+            // out of the table, as when unserializing
+            StringData *sd = k.getStringData();
+            sd = StringInternTable::InternRepeated(sd->data(), sd->size(),
+                                                   sd->hash());
+            if (sd) k = sd;
+          }
+          ThreadSharedVariant* key = createAnother(k, false);
           ThreadSharedVariant* val = createAnother(it.second(), false, true);
           if (val->shouldCache()) setShouldCache();
           m_data.map->add(key, val);
@@ -0,0 +1,156 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/string_intern_table.h>
+#include <runtime/base/string_data.h>
+#include <runtime/base/runtime_option.h>
+#include <util/atomic.h>
+#include <util/lock.h>
+#include <util/striped_counter.h>
+#include <util/util.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const int MaxProbes = 16;
+
+StringData **s_table = NULL;
+int64 *s_seen = NULL; // hashes asked for once by InternRepeated()
+int s_mask = 0;
+Mutex s_mutex;
+
+int s_count = 0;
+StripedCounter s_hits;
+StripedCounter s_bytesSaved;
+
+bool init() {
+  if (*(StringData ** volatile *)&s_table) return true;
+  if (RuntimeOption::StringInternTableSize <= 0) return false;
+
+  Lock lock(s_mutex);
+  if (s_table) return true;
+  int size = 1;
+  while (size < RuntimeOption::StringInternTableSize) size <<= 1;
+  s_seen = (int64*)calloc(size, sizeof(int64));
+  s_mask = size - 1;
+  StringData **table = (StringData**)calloc(size, sizeof(StringData*));
+  // lookups do not lock, so everything else has to be ready first
+  __sync_synchronize();
+  s_table = table;
+  return true;
+}
+
+inline bool matches(const StringData *sd, const char *s, int len,
+                    int64 hash) {
+  return sd->hash() == hash && sd->size() == len &&
+    memcmp(sd->data(), s, len) == 0;
+}
+
+inline void count_hit(int len) {
+  s_hits.inc();
+  s_bytesSaved.add(sizeof(StringData) + len + 1);
+}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+StringData *StringInternTable::Find(const char *s, int len, int64 hash) {
+  if (len <= 0 || len > RuntimeOption::StringInternMaxLength) return NULL;
+  StringData **table = *(StringData ** volatile *)&s_table;
+  if (table == NULL) return NULL;
+
+  int index = hash & s_mask;
+  for (int probe = 0; probe < MaxProbes; probe++) {
+    StringData *sd = *(StringData * volatile *)&table[index];
+    if (sd == NULL) break;
+    if (matches(sd, s, len, hash)) {
+      count_hit(len);
+      return sd;
+    }
+    index = (index + 1) & s_mask;
+  }
+  return NULL;
+}
+
+StringData *StringInternTable::Intern(const char *s, int len, int64 hash) {
+  if (len <= 0 || len > RuntimeOption::StringInternMaxLength) return NULL;
+  if (!init()) return NULL;
+
+  StringData *created = NULL;
+  int index = hash & s_mask;
+  for (int probe = 0; probe < MaxProbes; probe++) {
+    StringData *sd = *(StringData * volatile *)&s_table[index];
+    if (sd == NULL) {
+      if (created == NULL) {
+        created = new StringData(s, len, CopyString);
+        created->setStatic();
+      }
+      sd = __sync_val_compare_and_swap(&s_table[index], (StringData*)NULL,
+                                       created);
+      if (sd == NULL) {
+        atomic_inc(s_count);
+        return created;
+      }
+      // somebody else took the slot first, maybe with the same string
+    }
+    if (matches(sd, s, len, hash)) {
+      delete created;
+      count_hit(len);
+      return sd;
+    }
+    index = (index + 1) & s_mask;
+  }
+  delete created;
+  return NULL;
+}
+
+StringData *StringInternTable::Intern(const StringData *s) {
+  ASSERT(s);
+  if (s->isStatic()) return const_cast<StringData*>(s);
+  return Intern(s->data(), s->size(), s->hash());
+}
+
+StringData *StringInternTable::InternRepeated(const char *s, int len,
+                                              int64 hash) {
+  StringData *sd = Find(s, len, hash);
+  if (sd || len <= 0 || len > RuntimeOption::StringInternMaxLength ||
+      !init()) {
+    return sd;
+  }
+  // a lost update only means waiting for the string to come back again
+  int64 &seen = s_seen[hash & s_mask];
+  if (seen != hash) {
+    seen = hash;
+    return NULL;
+  }
+  return Intern(s, len, hash);
+}
+
+std::string StringInternTable::ReportStats(int indent) {
+  string out;
+  Util::appendXmlElement(out, indent, "Strings", s_count);
+  Util::appendXmlElement(out, indent, "Capacity", s_table ? s_mask + 1 : 0);
+  Util::appendXmlElement(out, indent, "Hits", s_hits.get());
+  Util::appendXmlElement(out, indent, "BytesSaved", s_bytesSaved.get());
+  return out;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
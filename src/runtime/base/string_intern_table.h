@@ -0,0 +1,70 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_STRING_INTERN_TABLE_H__
+#define __HPHP_STRING_INTERN_TABLE_H__
+
+#include <runtime/base/types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Process-wide table of short immutable strings, handing out one static
+ * StringData per distinct string. Static strings are shared by all threads
+ * and carry their hash, so code that keeps getting the same few strings,
+ * like array keys coming out of APC or unserialize(), can use the interned
+ * copy instead of allocating and hashing a new one each time, and no
+ * reference counting happens on it.
+ *
+ * The table is an open-addressed array of pointers indexed by hash. Lookups
+ * take no lock, and a new string claims its slot with a compare-and-swap.
+ * Strings are never removed, so once StringIntern.TableSize strings are in,
+ * or a string's probe sequence is full, callers just keep their own copy.
+ */
+class StringInternTable {
+public:
+  /**
+   * The interned copy of a string, added if not there yet. The hash is
+   * hash_string() of the bytes. Returns NULL for strings longer than
+   * StringIntern.MaxLength, and when there is no room.
+   */
+  static StringData *Intern(const char *s, int len, int64 hash);
+  static StringData *Intern(const StringData *s);
+
+  /**
+   * Like Intern(), but a string is only added the second time it is asked
+   * for, so strings made up from request input, that may never come back,
+   * do not use up the table.
+   */
+  static StringData *InternRepeated(const char *s, int len, int64 hash);
+
+  /**
+   * The interned copy of a string, without adding it.
+   */
+  static StringData *Find(const char *s, int len, int64 hash);
+
+  /**
+   * Strings in the table, lookups that found one, and the bytes those
+   * lookups did not have to allocate, as XML elements.
+   */
+  static std::string ReportStats(int indent);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_STRING_INTERN_TABLE_H__
@@ -19,6 +19,7 @@
 #include <runtime/base/util/string_buffer.h>
 #include <runtime/base/runtime_error.h>
 #include <runtime/base/builtin_functions.h>
+#include <runtime/base/execution_context.h>
 
 namespace HPHP {
 
@@ -101,6 +102,58 @@ SmartObject<DateTime> DateTime::Current(bool utc /* = false */) {
   return NEW(DateTime)(time(0), utc);
 }
 
+/**
+ * The last strtotime() a thread did. Scripts tend to call it over and over
+ * with the same string, like "today" or "-1 week", and the current time,
+ * which only changes once a second.
+ */
+class StrToTimeMemo {
+public:
+  StrToTimeMemo() : timestamp(0), result(0), failed(false), valid(false) {}
+
+  std::string input;
+  std::string timezone; // set by the request, if any
+  int64 timestamp;
+  int64 result;
+  bool failed;
+  bool valid;
+};
+static IMPLEMENT_THREAD_LOCAL(StrToTimeMemo, s_strtotime_memo);
+
+Variant DateTime::StrToTime(CStrRef input, int64 timestamp) {
+  if (input.empty()) {
+    return false;
+  }
+
+  StrToTimeMemo *memo = s_strtotime_memo.get();
+  String timezone = g_context->getTimeZone();
+  if (memo->valid && memo->timestamp == timestamp &&
+      memo->input.size() == (size_t)input.size() &&
+      memcmp(memo->input.data(), input.data(), input.size()) == 0 &&
+      memo->timezone.size() == (size_t)timezone.size() &&
+      memcmp(memo->timezone.data(), timezone.data(), timezone.size()) == 0) {
+    if (memo->failed) return false;
+    return memo->result;
+  }
+
+  int64 result = 0;
+  DateTime dt(timestamp);
+  bool failed = !dt.fromString(input, SmartObject<TimeZone>());
+  if (!failed) {
+    bool error;
+    result = dt.toTimeStamp(error);
+  }
+  memo->input.assign(input.data(), input.size());
+  memo->timezone.assign(timezone.data(), timezone.size());
+  memo->timestamp = timestamp;
+  memo->result = result;
+  memo->failed = failed;
+  memo->valid = true;
+
+  if (failed) return false;
+  return result;
+}
+
 #define PHP_DATE_PARSE_DATE_SET_TIME_ELEMENT(name, elem) \
   if ((int)parsed_time->elem == -99999) {                \
     ret.set(#name, false);                               \
@@ -218,6 +218,12 @@ public:
   static Array Parse(CStrRef datetime);
   static Array Parse(CStrRef ts, CStrRef format);
 
+  /**
+   * strtotime(): the timestamp input stands for, relative to timestamp and
+   * in the current timezone, or false.
+   */
+  static Variant StrToTime(CStrRef input, int64 timestamp);
+
 public:
   // constructor
   DateTime();
@@ -21,6 +21,7 @@
 #include <runtime/base/builtin_functions.h>
 #include <runtime/base/runtime_error.h>
 #include <util/logger.h>
+#include <util/hash.h>
 
 namespace HPHP {
 
@@ -69,39 +70,121 @@ static GuessedTimeZone s_guessed_timezone;
 ///////////////////////////////////////////////////////////////////////////////
 // statics
 
-class TimeZoneData {
+/**
+ * Parsed timezones shared by all threads. timelib only ever reads a parsed
+ * timezone, so one copy serves everybody. Entries are added with a
+ * compare-and-swap and never change or go away afterwards, so lookups take
+ * no lock. The builtin database has fewer zones than there are slots.
+ */
+class TimeZoneCache {
 public:
-  TimeZoneData() : Database(NULL) {}
+  static const int Size = 1024;
+
+  static TimeZoneInfo Find(const char *name, int len, int64 hash) {
+    int index = hash & (Size - 1);
+    for (int probe = 0; probe < Size; probe++) {
+      Entry *entry = *(Entry * volatile *)&s_entries[index];
+      if (entry == NULL) break;
+      if (entry->hash == hash && entry->name.size() == (size_t)len &&
+          memcmp(entry->name.data(), name, len) == 0) {
+        return entry->tzi;
+      }
+      index = (index + 1) & (Size - 1);
+    }
+    return TimeZoneInfo();
+  }
 
-  const timelib_tzdb *Database;
-  MapStringToTimeZoneInfo Cache;
+  /**
+   * Returns what is in the cache under this name, which is tzi unless
+   * another thread added the same timezone first.
+   */
+  static TimeZoneInfo Add(const char *name, int len, int64 hash,
+                          TimeZoneInfo tzi) {
+    Entry *created = new Entry();
+    created->name.assign(name, len);
+    created->hash = hash;
+    created->tzi = tzi;
+    int index = hash & (Size - 1);
+    for (int probe = 0; probe < Size; probe++) {
+      Entry *entry = *(Entry * volatile *)&s_entries[index];
+      if (entry == NULL) {
+        entry = __sync_val_compare_and_swap(&s_entries[index], (Entry*)NULL,
+                                            created);
+        if (entry == NULL) return tzi;
+      }
+      if (entry->hash == hash && entry->name == created->name) {
+        delete created;
+        return entry->tzi;
+      }
+      index = (index + 1) & (Size - 1);
+    }
+    delete created; // full, and whoever asked keeps its own copy
+    return tzi;
+  }
+
+private:
+  struct Entry {
+    std::string name;
+    int64 hash;
+    TimeZoneInfo tzi;
+  };
+  static Entry *s_entries[Size];
+};
+TimeZoneCache::Entry *TimeZoneCache::s_entries[TimeZoneCache::Size];
+
+/**
+ * The timezone a thread used last, which is almost always the one it is
+ * going to use next.
+ */
+class TimeZoneData {
+public:
+  std::string LastName;
+  TimeZoneInfo Last;
 };
 static IMPLEMENT_THREAD_LOCAL(TimeZoneData, s_timezone_data);
 
 const timelib_tzdb *TimeZone::GetDatabase() {
-  const timelib_tzdb *&Database = s_timezone_data->Database;
-  if (Database == NULL) {
-    Database = timelib_builtin_db();
-  }
-  return Database;
+  return timelib_builtin_db();
 }
 
 TimeZoneInfo TimeZone::GetTimeZoneInfo(CStrRef name) {
-  MapStringToTimeZoneInfo &Cache = s_timezone_data->Cache;
-
-  MapStringToTimeZoneInfo::const_iterator iter = Cache.find(name.data());
-  if (iter != Cache.end()) {
-    return iter->second;
+  TimeZoneData *data = s_timezone_data.get();
+  if (data->Last && data->LastName.size() == (size_t)name.size() &&
+      memcmp(data->LastName.data(), name.data(), name.size()) == 0) {
+    return data->Last;
   }
 
-  TimeZoneInfo tzi(timelib_parse_tzfile((char *)name.data(), GetDatabase()),
-                   tzinfo_deleter());
-  if (tzi) {
-    Cache[name.data()] = tzi;
+  int64 hash = hash_string(name.data(), name.size());
+  TimeZoneInfo tzi = TimeZoneCache::Find(name.data(), name.size(), hash);
+  if (!tzi) {
+    tzi = TimeZoneInfo(timelib_parse_tzfile((char *)name.data(),
+                                            GetDatabase()),
+                       tzinfo_deleter());
+    if (!tzi) return tzi;
+    tzi = TimeZoneCache::Add(name.data(), name.size(), hash, tzi);
   }
+  data->LastName.assign(name.data(), name.size());
+  data->Last = tzi;
   return tzi;
 }
 
+void TimeZone::Preload(const std::vector<std::string> &names) {
+  const timelib_tzdb *tzdb = GetDatabase();
+  int count = 0;
+  for (unsigned int i = 0; i < names.size(); i++) {
+    if (names[i] == "*") {
+      for (int j = 0; j < tzdb->index_size; j++) {
+        if (GetTimeZoneInfo(tzdb->index[j].id)) count++;
+      }
+    } else if (GetTimeZoneInfo(names[i])) {
+      count++;
+    } else {
+      Logger::Warning("Unable to preload timezone %s", names[i].c_str());
+    }
+  }
+  Logger::Verbose("preloaded %d timezones", count);
+}
+
 bool TimeZone::IsValid(CStrRef name) {
   return timelib_timezone_id_is_valid((char*)name.data(), GetDatabase());
 }
@@ -55,6 +55,12 @@ public:
   static String AbbreviationToName(String abbr, int utcoffset = -1,
                                    bool isdst = true);
 
+  /**
+   * Parses timezones into the process-wide cache ahead of time, so that
+   * no request has to. A name of "*" stands for the whole database.
+   */
+  static void Preload(const std::vector<std::string> &names);
+
 public:
   /**
    * Constructing a timezone object by name or a raw pointer (internal).
@@ -121,6 +127,7 @@ private:
 
   /**
    * Look up cache and if found return it, otherwise, read it from database.
+   * The cache is shared by all threads, so what it returns must not change.
    */
   static TimeZoneInfo GetTimeZoneInfo(CStrRef name);
 
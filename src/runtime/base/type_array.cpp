@@ -26,6 +26,7 @@
 #include <runtime/base/comparisons.h>
 #include <runtime/base/zend/zend_string.h>
 #include <runtime/base/array/array_util.h>
+#include <runtime/base/array/sort_keys.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/ext/ext_iconv.h>
 #include <unicode/coll.h> // icu
@@ -109,8 +110,8 @@ Array Array::intersect(CArrRef array, bool by_key, bool by_value,
 
 
 static void _sort(vector<int> &indices, CArrRef source, Array::SortData &opaque,
-                  Array::PFUNC_CMP cmp_func,
-                  bool by_key, const void *data /* = NULL */);
+                  Array::PFUNC_CMP cmp_func, bool by_key, const void *data,
+                  bool renumber);
 
 Array Array::diffImpl(CArrRef array, bool by_key, bool by_value, bool match,
                       PFUNC_CMP key_cmp_function,
@@ -163,7 +164,7 @@ Array Array::diffImpl(CArrRef array, bool by_key, bool by_value, bool match,
     cmp = value_cmp_function;
     cmp_data = value_data;
   }
-  _sort(perm1, array, opaque1, cmp, by_key, cmp_data);
+  _sort(perm1, array, opaque1, cmp, by_key, cmp_data, false);
 
   for (ArrayIter iter(*this); iter; ++iter) {
     Variant target;
@@ -738,17 +739,9 @@ void Array::serialize(VariableSerializer *serializer) const {
 }
 
 void Array::unserialize(VariableUnserializer *unserializer) {
-  std::istream &in = unserializer->in();
-  int64 size;
-  char sep;
-  in >> size >> sep;
-  if (sep != ':') {
-    throw Exception("Expected ':' but got '%c'", sep);
-  }
-  in >> sep;
-  if (sep != '{') {
-    throw Exception("Expected '{' but got '%c'", sep);
-  }
+  int64 size = unserializer->readInt();
+  unserializer->expectChar(':');
+  unserializer->expectChar('{');
 
   if (size == 0) {
     operator=(Create());
@@ -765,10 +758,7 @@ void Array::unserialize(VariableUnserializer *unserializer) {
     }
   }
 
-  in >> sep;
-  if (sep != '}') {
-    throw Exception("Expected '}' but got '%c'", sep);
-  }
+  unserializer->expectChar('}');
 }
 
 Array Array::fiberMarshal(FiberReferenceMap &refMap) const {
@@ -836,16 +826,31 @@ static int array_compare_func(const void *n1, const void *n2, const void *op) {
                           opaque->data);
 }
 
+static int keys_compare_func(const void *n1, const void *n2, const void *op) {
+  return ((const SortKeys*)op)->compare(*(int*)n1, *(int*)n2);
+}
+
+struct MultiSortData {
+  const std::vector<Array::SortData> *opaques;
+  const std::vector<SortKeys> *keys;
+};
+
 static int multi_compare_func(const void *n1, const void *n2, const void *op) {
   int index1 = *(int*)n1;
   int index2 = *(int*)n2;
-  const std::vector<Array::SortData> *opaques =
-    (const std::vector<Array::SortData> *)op;
+  const MultiSortData *multi = (const MultiSortData *)op;
+  const std::vector<Array::SortData> *opaques = multi->opaques;
   for (unsigned int i = 0; i < opaques->size(); i++) {
     const Array::SortData *opaque = &opaques->at(i);
+    const SortKeys &keys = multi->keys->at(i);
+    int result;
+    if (keys.valid()) {
+      result = keys.compare(index1, index2);
+      if (result != 0) return result;
+      continue;
+    }
     ssize_t pos1 = opaque->positions[index1];
     ssize_t pos2 = opaque->positions[index2];
-    int result;
     if (opaque->by_key) {
       result = opaque->cmp_func((*opaque->array)->getKey(pos1),
                                 (*opaque->array)->getKey(pos2),
@@ -861,8 +866,8 @@ static int multi_compare_func(const void *n1, const void *n2, const void *op) {
 }
 
 static void _sort(vector<int> &indices, CArrRef source, Array::SortData &opaque,
-                  Array::PFUNC_CMP cmp_func, bool by_key,
-                  const void *data /* = NULL */) {
+                  Array::PFUNC_CMP cmp_func, bool by_key, const void *data,
+                  bool renumber) {
   ASSERT(cmp_func);
 
   int count = source.size();
@@ -883,6 +888,16 @@ static void _sort(vector<int> &indices, CArrRef source, Array::SortData &opaque,
        pos = source->iter_advance(pos)) {
     opaque.positions.push_back(pos);
   }
+
+  SortKeys keys;
+  if (keys.init(source, opaque.positions, by_key, cmp_func)) {
+    if (keys.canReorderTies(by_key, renumber)) {
+      keys.sort(indices);
+    } else {
+      zend_qsort(&indices[0], count, sizeof(int), keys_compare_func, &keys);
+    }
+    return;
+  }
   zend_qsort(&indices[0], count, sizeof(int), array_compare_func, &opaque);
 }
 
@@ -891,7 +906,7 @@ void Array::sort(PFUNC_CMP cmp_func, bool by_key, bool renumber,
   Array sorted = Array::Create();
   SortData opaque;
   vector<int> indices;
-  _sort(indices, *this, opaque, cmp_func, by_key, data);
+  _sort(indices, *this, opaque, cmp_func, by_key, data, renumber);
   int count = size();
   for (int i = 0; i < count; i++) {
     ssize_t pos = opaque.positions[indices[i]];
@@ -939,7 +954,15 @@ bool Array::MultiSort(std::vector<SortData> &data, bool renumber) {
     indices[i] = i;
   }
 
-  zend_qsort(indices, count, sizeof(int), multi_compare_func, (void *)&data);
+  std::vector<SortKeys> keys(data.size());
+  for (unsigned int k = 0; k < data.size(); k++) {
+    keys[k].init(*data[k].array, data[k].positions, data[k].by_key,
+                 data[k].cmp_func);
+  }
+  MultiSortData multi;
+  multi.opaques = &data;
+  multi.keys = &keys;
+  zend_qsort(indices, count, sizeof(int), multi_compare_func, (void *)&multi);
 
   for (unsigned int k = 0; k < data.size(); k++) {
     SortData &opaque = data[k];
@@ -45,9 +45,11 @@ CVarRef ref(CVarRef v);
  * escalation. This describes all possible escalation paths:
  *
  *   SmallArray --> ZendArray
+ *   ShapedArray --> ZendArray
  *
  * SmallArray escalates to ZendArray when the capacity of the SmallArray is
- * exceeded.
+ * exceeded. ShapedArray escalates to ZendArray when a key is added or
+ * removed in a way its ArrayShape cannot describe.
  */
 class Array : public SmartPtr<ArrayData> {
  public:
@@ -19,6 +19,7 @@
 #include <runtime/base/builtin_functions.h>
 #include <runtime/base/comparisons.h>
 #include <runtime/base/variable_serializer.h>
+#include <runtime/base/variable_unserializer.h>
 #include <runtime/base/zend/zend_functions.h>
 #include <runtime/base/zend/zend_string.h>
 #include <runtime/base/zend/zend_printf.h>
@@ -26,7 +27,6 @@
 
 namespace HPHP {
 
-#define SERIALIZE_MAX_SIZE (64*1024*1024)
 
 const String null_string = String();
 const StaticString empty_string("");
@@ -2930,9 +2930,8 @@ void Variant::serialize(VariableSerializer *serializer,
 }
 
 void Variant::unserialize(VariableUnserializer *unserializer) {
-  std::istream &in = unserializer->in();
-  char type, sep;
-  in >> type >> sep;
+  char type = unserializer->readChar();
+  char sep = unserializer->readChar();
 
   if (type != 'R') {
     unserializer->add(this);
@@ -2950,8 +2949,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
   switch (type) {
   case 'r':
     {
-      int64 id;
-      in >> id;
+      int64 id = unserializer->readInt();
       Variant *v = unserializer->get(id);
       if (v == NULL) {
         throw Exception("Id %ld out of range", id);
@@ -2961,8 +2959,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
     break;
   case 'R':
     {
-      int64 id;
-      in >> id;
+      int64 id = unserializer->readInt();
       Variant *v = unserializer->get(id);
       if (v == NULL) {
         throw Exception("Id %ld out of range", id);
@@ -2970,41 +2967,40 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
       operator=(ref(*v));
     }
     break;
-  case 'b': { int64 v;  in >> v; operator=((bool)v); } break;
-  case 'i': { int64 v;  in >> v; operator=(v);       } break;
+  case 'b': { int64 v = unserializer->readInt(); operator=((bool)v); } break;
+  case 'i': { int64 v = unserializer->readInt(); operator=(v);       } break;
   case 'd':
     {
       double v;
-      char ch = in.peek();
+      char ch = unserializer->peek();
       bool negative = false;
       char buf[4];
       if (ch == '-') {
         negative = true;
-        in >> ch;
-        ch = in.peek();
+        unserializer->readChar();
+        ch = unserializer->peek();
       }
       if (ch == 'I') {
-        in.read(buf, 3); buf[3] = '\0';
+        memcpy(buf, unserializer->readBytes(3), 3); buf[3] = '\0';
         if (strcmp(buf, "INF")) {
           throw Exception("Expected 'INF' but got '%s'", buf);
         }
         v = atof("inf");
       } else if (ch == 'N') {
-        in.read(buf, 3); buf[3] = '\0';
+        memcpy(buf, unserializer->readBytes(3), 3); buf[3] = '\0';
         if (strcmp(buf, "NAN")) {
           throw Exception("Expected 'NAN' but got '%s'", buf);
         }
         v = atof("nan");
       } else {
-        in >> v;
+        v = unserializer->readDouble();
       }
       operator=(negative ? -v : v);
     }
     break;
   case 's':
     {
-      String v;
-      v.unserialize(in);
+      String v = unserializer->readString();
       operator=(v);
     }
     break;
@@ -3014,7 +3010,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
         char buf[8];
         StringData *sd;
       } u;
-      in.read(u.buf, 8);
+      memcpy(u.buf, unserializer->readBytes(8), 8);
       operator=(u.sd);
     }
     break;
@@ -3032,19 +3028,14 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
         char buf[8];
         ArrayData *ad;
       } u;
-      in.read(u.buf, 8);
+      memcpy(u.buf, unserializer->readBytes(8), 8);
       operator=(u.ad);
     }
     break;
   case 'o':
     {
-      String clsName;
-      clsName.unserialize(in);
-
-      in >> sep;
-      if (sep != ':') {
-        throw Exception("Expected ':' but got '%c'", sep);
-      }
+      String clsName = unserializer->readClassName();
+      unserializer->expectChar(':');
 
       Object obj;
       try {
@@ -3064,13 +3055,8 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
     break;
   case 'O':
     {
-      String clsName;
-      clsName.unserialize(in);
-
-      in >> sep;
-      if (sep != ':') {
-        throw Exception("Expected ':' but got '%c'", sep);
-      }
+      String clsName = unserializer->readClassName();
+      unserializer->expectChar(':');
 
       Object obj;
       try {
@@ -3080,16 +3066,9 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
         obj->o_set("__PHP_Incomplete_Class_Name", clsName);
       }
       operator=(obj);
-      int64 size;
-      char sep;
-      in >> size >> sep;
-      if (sep != ':') {
-        throw Exception("Expected ':' but got '%c'", sep);
-      }
-      in >> sep;
-      if (sep != '{') {
-        throw Exception("Expected '{' but got '%c'", sep);
-      }
+      int64 size = unserializer->readInt();
+      unserializer->expectChar(':');
+      unserializer->expectChar('{');
       if (size > 0) {
         for (int64 i = 0; i < size; i++) {
           String key = unserializer->unserializeKey().toString();
@@ -3113,10 +3092,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
           value.unserialize(unserializer);
         }
       }
-      in >> sep;
-      if (sep != '}') {
-        throw Exception("Expected '}' but got '%c'", sep);
-      }
+      unserializer->expectChar('}');
 
       obj->t___wakeup();
       return; // object has '}' terminating
@@ -3124,13 +3100,8 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
     break;
   case 'C':
     {
-      String clsName;
-      clsName.unserialize(in);
-
-      in >> sep;
-      if (sep != ':') {
-        throw Exception("Expected ':' but got '%c'", sep);
-      }
+      String clsName = unserializer->readClassName();
+      unserializer->expectChar(':');
 
       Object obj = create_object(clsName.data(), Array::Create(), false);
       if (!obj->o_instanceof("Serializable")) {
@@ -3138,8 +3109,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
       }
       operator=(obj);
 
-      String serialized;
-      serialized.unserialize(in, '{', '}');
+      String serialized = unserializer->readString('{', '}');
       obj->o_invoke_mil("unserialize",
                     CREATE_VECTOR1(serialized), -1);
 
@@ -3149,10 +3119,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
   default:
     throw Exception("Unknown type '%c'", type);
   }
-  in >> sep;
-  if (sep != ';') {
-    throw Exception("Expected ';' but got '%c'", sep);
-  }
+  unserializer->expectChar(';');
 }
 
 Variant Variant::share(bool save) const {
@@ -0,0 +1,150 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/util/chunked_buffer.h>
+#include <runtime/base/util/alloc.h>
+#include <util/thread_local.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+int ChunkedBuffer::PoolSize = 64;
+
+class ChunkPool {
+public:
+  ChunkPool() : m_free(NULL), m_count(0) {}
+  ~ChunkPool() {
+    while (m_free) {
+      ChunkedBuffer::Chunk *next = m_free->next;
+      free(m_free);
+      m_free = next;
+    }
+  }
+
+  ChunkedBuffer::Chunk *get() {
+    ChunkedBuffer::Chunk *chunk = m_free;
+    if (chunk) {
+      m_free = chunk->next;
+      m_count--;
+    } else {
+      chunk = (ChunkedBuffer::Chunk*)
+        Util::safe_malloc(sizeof(ChunkedBuffer::Chunk));
+    }
+    chunk->next = NULL;
+    chunk->size = 0;
+    return chunk;
+  }
+
+  void put(ChunkedBuffer::Chunk *chunk) {
+    if (m_count >= ChunkedBuffer::PoolSize) {
+      free(chunk);
+      return;
+    }
+    chunk->next = m_free;
+    m_free = chunk;
+    m_count++;
+  }
+
+private:
+  ChunkedBuffer::Chunk *m_free;
+  int m_count;
+};
+static IMPLEMENT_THREAD_LOCAL(ChunkPool, s_chunk_pool);
+
+ChunkedBuffer::Chunk *ChunkedBuffer::NewChunk() {
+  return s_chunk_pool->get();
+}
+
+void ChunkedBuffer::FreeChunks(Chunk *chunk) {
+  ChunkPool *pool = s_chunk_pool.get();
+  while (chunk) {
+    Chunk *next = chunk->next;
+    pool->put(chunk);
+    chunk = next;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ChunkedBuffer::append(const char *s, int len) {
+  ASSERT(len >= 0);
+  while (len > 0) {
+    if (m_tail == NULL || m_tail->size == ChunkCapacity) {
+      Chunk *chunk = NewChunk();
+      if (m_tail) {
+        m_tail->next = chunk;
+      } else {
+        m_head = chunk;
+      }
+      m_tail = chunk;
+    }
+    int n = ChunkCapacity - m_tail->size;
+    if (n > len) n = len;
+    memcpy(m_tail->data + m_tail->size, s, n);
+    m_tail->size += n;
+    m_size += n;
+    s += n;
+    len -= n;
+  }
+}
+
+void ChunkedBuffer::absorb(ChunkedBuffer &buf) {
+  if (buf.empty()) return;
+  if (m_tail && buf.m_size <= ChunkCapacity - m_tail->size) {
+    // cheaper to copy a few bytes than to leave a mostly empty chunk behind
+    for (Chunk *chunk = buf.m_head; chunk; chunk = chunk->next) {
+      append(chunk->data, chunk->size);
+    }
+    buf.reset();
+    return;
+  }
+  if (m_tail) {
+    m_tail->next = buf.m_head;
+  } else {
+    m_head = buf.m_head;
+  }
+  m_tail = buf.m_tail;
+  m_size += buf.m_size;
+  buf.m_head = buf.m_tail = NULL;
+  buf.m_size = 0;
+}
+
+String ChunkedBuffer::copy() const {
+  if (m_size == 0) return String("");
+  char *data = (char *)Util::safe_malloc(m_size + 1);
+  char *p = data;
+  for (Chunk *chunk = m_head; chunk; chunk = chunk->next) {
+    memcpy(p, chunk->data, chunk->size);
+    p += chunk->size;
+  }
+  *p = '\0';
+  return String(data, m_size, AttachString);
+}
+
+String ChunkedBuffer::detach() {
+  String ret = copy();
+  reset();
+  return ret;
+}
+
+void ChunkedBuffer::reset() {
+  FreeChunks(m_head);
+  m_head = m_tail = NULL;
+  m_size = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
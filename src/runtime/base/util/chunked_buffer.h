@@ -0,0 +1,93 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_CHUNKED_BUFFER_H__
+#define __HPHP_CHUNKED_BUFFER_H__
+
+#include <runtime/base/types.h>
+#include <runtime/base/complex_types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Output buffer made of fixed-size chunks that are recycled through a
+ * per-thread pool. Unlike StringBuffer, appending never moves what was
+ * already written, absorbing another buffer splices its chunks instead of
+ * copying them, and a transport can walk the chunks and send them as they
+ * are, without first flattening everything into one string.
+ */
+class ChunkedBuffer {
+public:
+  struct Chunk {
+    Chunk *next;
+    int size;
+    char data[16 * 1024 - sizeof(Chunk*) - sizeof(int) * 2];
+  };
+  static const int ChunkCapacity = sizeof(((Chunk*)0)->data);
+
+  /**
+   * Maximum number of free chunks each thread keeps around.
+   */
+  static int PoolSize;
+
+  ChunkedBuffer() : m_head(NULL), m_tail(NULL), m_size(0) {}
+  ~ChunkedBuffer() { reset();}
+
+  bool empty() const { return m_size == 0;}
+  int size() const { return m_size;}
+  const Chunk *head() const { return m_head;}
+
+  void append(const char *s, int len);
+  void append(CStrRef s) { append(s.data(), s.size());}
+
+  /**
+   * Append what buf has, and reset buf. Chunks are moved over as they are,
+   * unless buf is small enough to fit into our last chunk.
+   */
+  void absorb(ChunkedBuffer &buf);
+
+  /**
+   * Flatten into one String. detach() also resets this buffer.
+   */
+  String copy() const;
+  String detach();
+
+  /**
+   * Release all chunks back to this thread's pool.
+   */
+  void reset();
+
+private:
+  Chunk *m_head;
+  Chunk *m_tail;
+  int m_size;
+
+  // disabling copy constructor and assignment
+  ChunkedBuffer(const ChunkedBuffer &buf) { ASSERT(false);}
+  ChunkedBuffer &operator=(const ChunkedBuffer &buf) {
+    ASSERT(false);
+    return *this;
+  }
+
+  static Chunk *NewChunk();
+  static void FreeChunks(Chunk *chunk);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_CHUNKED_BUFFER_H__
@@ -0,0 +1,389 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/util/dns_cache.h>
+#include <runtime/base/runtime_option.h>
+#include <util/async_func.h>
+#include <util/synchronizable.h>
+#include <util/network.h>
+#include <util/atomic.h>
+#include <util/lock.h>
+#include <util/hash.h>
+#include <util/thread_local.h>
+#include <util/base.h>
+#include <util/util.h>
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+#include <resolv.h>
+#include <sys/time.h>
+#include <deque>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const int ShardCount = 16; // power of 2
+const int PurgeSeconds = 10;
+
+struct DnsEntry {
+  DnsEntry() : herr(0), expire(0), refreshAt(0), resolving(false),
+               refreshing(false) {}
+
+  vector<in_addr> addrs; // empty for a failed lookup
+  int herr;
+  time_t expire;
+  time_t refreshAt;
+  bool resolving;  // first lookup in progress, others wait for it
+  bool refreshing; // queued for the background thread
+};
+
+struct DnsShard : public Synchronizable {
+  hphp_string_map<DnsEntry> entries;
+};
+
+DnsShard s_shards[ShardCount];
+
+int64 s_lookups = 0;
+int64 s_hits = 0;
+int64 s_negativeHits = 0;
+int64 s_misses = 0;
+int64 s_coalesced = 0;
+int64 s_refreshes = 0;
+int64 s_resolves = 0;
+int64 s_failures = 0;
+int64 s_resolveUs = 0;
+int64 s_maxResolveUs = 0;
+
+DnsShard &shard_of(const string &host) {
+  return s_shards[hash_string(host.data(), host.size()) & (ShardCount - 1)];
+}
+
+/**
+ * Resolver state of a thread, set up once rather than for every query.
+ */
+struct ResolverState {
+  ResolverState() {
+    memset(&res, 0, sizeof(res));
+    ok = res_ninit(&res) == 0;
+  }
+  ~ResolverState() {
+    if (ok) res_nclose(&res);
+  }
+
+  struct __res_state res;
+  bool ok;
+};
+IMPLEMENT_THREAD_LOCAL(ResolverState, s_resolver);
+
+/**
+ * Smallest TTL of the A and CNAME records the name server has for host, or
+ * -1 when it has none, like for names that only are in /etc/hosts.
+ */
+int record_ttl(const char *host) {
+  ResolverState *state = s_resolver.get();
+  if (!state->ok) return -1;
+
+  int ttl = -1;
+  unsigned char answer[NS_PACKETSZ * 4];
+  int len = res_nsearch(&state->res, host, ns_c_in, ns_t_a, answer,
+                        sizeof(answer));
+  if (len > (int)sizeof(answer)) {
+    len = sizeof(answer); // truncated, take what did fit
+  }
+  ns_msg msg;
+  if (len > 0 && ns_initparse(answer, len, &msg) == 0) {
+    int count = ns_msg_count(msg, ns_s_an);
+    for (int i = 0; i < count; i++) {
+      ns_rr rr;
+      if (ns_parserr(&msg, ns_s_an, i, &rr) != 0) break;
+      if (ns_rr_type(rr) == ns_t_a || ns_rr_type(rr) == ns_t_cname) {
+        int rrttl = ns_rr_ttl(rr);
+        if (ttl < 0 || rrttl < ttl) ttl = rrttl;
+      }
+    }
+  }
+  return ttl;
+}
+
+/**
+ * Looks host up through the system resolver, which follows nsswitch.conf,
+ * and with withTTL, returns how many seconds the answer may be kept.
+ */
+int lookup(const string &host, vector<in_addr> &addrs, int &herr,
+           bool withTTL) {
+  timeval start;
+  gettimeofday(&start, NULL);
+
+  addrs.clear();
+  herr = 0;
+  Util::HostEnt result;
+  if (Util::safe_gethostbyname(host.c_str(), result) &&
+      result.hostbuf.h_addrtype == AF_INET) {
+    for (int i = 0; result.hostbuf.h_addr_list[i]; i++) {
+      addrs.push_back(*(in_addr*)result.hostbuf.h_addr_list[i]);
+    }
+  }
+  if (addrs.empty()) {
+    herr = result.herr ? result.herr : NO_DATA;
+  }
+
+  int ttl = 0;
+  if (withTTL) {
+    if (addrs.empty()) {
+      // a name server that is not answering may well answer in a moment
+      ttl = herr == TRY_AGAIN ? 1 : RuntimeOption::DnsCacheNegativeTTL;
+    } else {
+      ttl = RuntimeOption::DnsCacheTTL;
+      in_addr numeric;
+      if (!inet_aton(host.c_str(), &numeric)) {
+        int rrttl = record_ttl(host.c_str());
+        if (rrttl >= 0 && rrttl < ttl) ttl = rrttl;
+      }
+    }
+    if (ttl < 1) ttl = 1;
+  }
+
+  timeval end;
+  gettimeofday(&end, NULL);
+  int64 us = (end.tv_sec - start.tv_sec) * 1000000LL +
+    (end.tv_usec - start.tv_usec);
+  atomic_add(s_resolves, (int64)1);
+  atomic_add(s_resolveUs, us);
+  if (addrs.empty()) atomic_add(s_failures, (int64)1);
+  if (us > s_maxResolveUs) s_maxResolveUs = us; // a lost update is fine
+  return ttl;
+}
+
+void fill(DnsEntry &entry, const vector<in_addr> &addrs, int herr, int ttl,
+          time_t now) {
+  entry.addrs = addrs;
+  entry.herr = herr;
+  entry.expire = now + ttl;
+  // positive answers are looked up again in the last quarter of their
+  // life, if anybody still asks for them
+  entry.refreshAt = addrs.empty() ? entry.expire : now + ttl - ttl / 4;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Background thread looking up again the names queued by Resolve(), and
+ * dropping expired entries every now and then.
+ */
+class DnsRefresher : public Synchronizable {
+public:
+  DnsRefresher() : m_stopped(false), m_thread(this, &DnsRefresher::run),
+                   m_started(false) {}
+
+  void queue(const string &host) {
+    Lock lock(this);
+    if (m_stopped) return;
+    if (!m_started) {
+      m_started = true;
+      m_thread.start();
+    }
+    m_hosts.push_back(host);
+    notify();
+  }
+
+  void stop() {
+    {
+      Lock lock(this);
+      if (!m_started || m_stopped) {
+        m_stopped = true;
+        return;
+      }
+      m_stopped = true;
+      notify();
+    }
+    m_thread.waitForEnd();
+  }
+
+  void run() {
+    time_t lastPurge = time(NULL);
+    while (true) {
+      string host;
+      {
+        Lock lock(this);
+        while (!m_stopped && m_hosts.empty()) {
+          if (!wait(PurgeSeconds)) break;
+        }
+        if (m_stopped) return;
+        if (!m_hosts.empty()) {
+          host = m_hosts.front();
+          m_hosts.pop_front();
+        }
+      }
+      if (!host.empty()) refresh(host);
+
+      time_t now = time(NULL);
+      if (now - lastPurge >= PurgeSeconds) {
+        purge(now);
+        lastPurge = now;
+      }
+    }
+  }
+
+private:
+  bool m_stopped;
+  AsyncFunc<DnsRefresher> m_thread;
+  bool m_started;
+  deque<string> m_hosts;
+
+  static void refresh(const string &host) {
+    vector<in_addr> addrs;
+    int herr;
+    int ttl = lookup(host, addrs, herr, true);
+    atomic_add(s_refreshes, (int64)1);
+
+    DnsShard &shard = shard_of(host);
+    Lock lock(&shard);
+    hphp_string_map<DnsEntry>::iterator iter = shard.entries.find(host);
+    if (iter == shard.entries.end()) return;
+    DnsEntry &entry = iter->second;
+    entry.refreshing = false;
+    if (entry.resolving) return;
+    if (addrs.empty() && herr == TRY_AGAIN) {
+      // keep the old answer until it expires, and try again next time
+      return;
+    }
+    fill(entry, addrs, herr, ttl, time(NULL));
+  }
+
+  static void purge(time_t now) {
+    for (int i = 0; i < ShardCount; i++) {
+      DnsShard &shard = s_shards[i];
+      Lock lock(&shard);
+      for (hphp_string_map<DnsEntry>::iterator iter = shard.entries.begin();
+           iter != shard.entries.end(); ) {
+        const DnsEntry &entry = iter->second;
+        if (entry.expire <= now && !entry.resolving && !entry.refreshing) {
+          shard.entries.erase(iter++);
+        } else {
+          ++iter;
+        }
+      }
+    }
+  }
+};
+
+DnsRefresher s_refresher;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool DnsCache::Resolve(const std::string &host, std::vector<in_addr> &addrs,
+                       int &herr) {
+  atomic_add(s_lookups, (int64)1);
+  if (!RuntimeOption::EnableDnsCache) {
+    lookup(host, addrs, herr, false);
+    return !addrs.empty();
+  }
+
+  DnsShard &shard = shard_of(host);
+  {
+    Lock lock(&shard);
+    bool waited = false;
+    while (true) {
+      hphp_string_map<DnsEntry>::iterator iter = shard.entries.find(host);
+      if (iter == shard.entries.end()) break;
+      DnsEntry &entry = iter->second;
+      if (entry.resolving) {
+        if (!waited) {
+          atomic_add(s_coalesced, (int64)1);
+          waited = true;
+        }
+        shard.wait();
+        continue;
+      }
+      time_t now = time(NULL);
+      if (entry.expire <= now) break;
+
+      addrs = entry.addrs;
+      herr = entry.herr;
+      if (addrs.empty()) {
+        atomic_add(s_negativeHits, (int64)1);
+        return false;
+      }
+      atomic_add(s_hits, (int64)1);
+      if (now >= entry.refreshAt && !entry.refreshing) {
+        entry.refreshing = true;
+        s_refresher.queue(host);
+      }
+      return true;
+    }
+    shard.entries[host].resolving = true;
+  }
+
+  atomic_add(s_misses, (int64)1);
+  int ttl = lookup(host, addrs, herr, true);
+
+  Lock lock(&shard);
+  DnsEntry &entry = shard.entries[host];
+  fill(entry, addrs, herr, ttl, time(NULL));
+  entry.resolving = false;
+  shard.notifyAll();
+  return !addrs.empty();
+}
+
+std::string DnsCache::ResolveToIP(const std::string &host) {
+  vector<in_addr> addrs;
+  int herr;
+  if (!Resolve(host, addrs, herr)) return "";
+  return Util::safe_inet_ntoa(addrs[0]);
+}
+
+std::string DnsCache::Rewrite(const std::string &host) {
+  if (!RuntimeOption::EnableDnsCache || host.empty() ||
+      host == "localhost") {
+    return host;
+  }
+  in_addr tmp;
+  if (inet_aton(host.c_str(), &tmp)) return host;
+  string ip = ResolveToIP(host);
+  return ip.empty() ? host : ip;
+}
+
+void DnsCache::Stop() {
+  s_refresher.stop();
+}
+
+std::string DnsCache::ReportStats(int indent) {
+  int64 entries = 0;
+  for (int i = 0; i < ShardCount; i++) {
+    Lock lock(&s_shards[i]);
+    entries += s_shards[i].entries.size();
+  }
+  string out;
+  Util::appendXmlElement(out, indent, "Entries", entries);
+  Util::appendXmlElement(out, indent, "Lookups", s_lookups);
+  Util::appendXmlElement(out, indent, "Hits", s_hits);
+  Util::appendXmlElement(out, indent, "NegativeHits", s_negativeHits);
+  Util::appendXmlElement(out, indent, "Misses", s_misses);
+  Util::appendXmlElement(out, indent, "Coalesced", s_coalesced);
+  Util::appendXmlElement(out, indent, "Refreshes", s_refreshes);
+  Util::appendXmlElement(out, indent, "Resolves", s_resolves);
+  Util::appendXmlElement(out, indent, "Failures", s_failures);
+  Util::appendXmlElement(out, indent, "ResolveUs", s_resolveUs);
+  Util::appendXmlElement(out, indent, "MaxResolveUs", s_maxResolveUs);
+  return out;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,80 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_DNS_CACHE_H__
+#define __HPHP_DNS_CACHE_H__
+
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Process-wide cache of host name lookups, shared by every thread.
+ *
+ * An answer is kept for the smallest TTL of the DNS records it came from,
+ * capped at Server.DnsCache.TTL, and failures are kept for
+ * Server.DnsCache.NegativeTTL, so a name that does not resolve does not
+ * cost a round trip to the name server on every request. When several
+ * threads ask for the same name that is not in the cache, only one of them
+ * looks it up and the others wait for its answer. A name that is asked for
+ * again when its answer is about to expire is looked up again by a
+ * background thread, while callers keep getting the old answer.
+ *
+ * With Server.DnsCache.Enable off, every call does its own lookup, which
+ * still shows up in ReportStats().
+ */
+class DnsCache {
+public:
+  /**
+   * IPv4 addresses of a host. On failure, herr is the h_errno of the
+   * lookup.
+   */
+  static bool Resolve(const std::string &host, std::vector<in_addr> &addrs,
+                      int &herr);
+
+  /**
+   * First address of a host in dotted notation, or an empty string if it
+   * does not resolve.
+   */
+  static std::string ResolveToIP(const std::string &host);
+
+  /**
+   * The address to connect to in place of a host name, for clients that
+   * would otherwise look the name up themselves: host itself when the
+   * cache is off, when it is already an address or "localhost", or when it
+   * does not resolve, so the client reports the error the usual way.
+   */
+  static std::string Rewrite(const std::string &host);
+
+  /**
+   * Stops the background refresh thread.
+   */
+  static void Stop();
+
+  /**
+   * Cached names, hits and misses, lookups done and their latency, as XML
+   * elements.
+   */
+  static std::string ReportStats(int indent);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_DNS_CACHE_H__
@@ -17,10 +17,12 @@
 #include <runtime/base/util/http_client.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/server/server_stats.h>
+#include <runtime/base/util/dns_cache.h>
 #include <util/timer.h>
 #include <curl/curl.h>
 #include <curl/easy.h>
 #include <util/logger.h>
+#include <boost/lexical_cast.hpp>
 
 using namespace std;
 
@@ -37,6 +39,40 @@ HttpClient::HttpClient(int timeout /* = 5 */, int maxRedirect /* = 1 */,
   }
 }
 
+/**
+ * "host:port:address" for CURLOPT_RESOLVE, so that curl connects to the
+ * address DnsCache has for the host of an http or https url, instead of
+ * looking the name up again. Empty if there is nothing to pin.
+ */
+static string resolve_entry(const char *url) {
+  int port;
+  const char *host;
+  if (strncasecmp(url, "http://", 7) == 0) {
+    port = 80;
+    host = url + 7;
+  } else if (strncasecmp(url, "https://", 8) == 0) {
+    port = 443;
+    host = url + 8;
+  } else {
+    return "";
+  }
+  const char *end = host + strcspn(host, "/?#");
+  const char *at = (const char *)memchr(host, '@', end - host);
+  if (at) host = at + 1;
+  if (*host == '[') return ""; // IPv6 literal
+  const char *colon = (const char *)memchr(host, ':', end - host);
+  if (colon) {
+    port = atoi(colon + 1);
+    end = colon;
+  }
+  if (host == end || port <= 0) return "";
+
+  string name(host, end - host);
+  string address = DnsCache::Rewrite(name);
+  if (address == name) return "";
+  return name + ":" + boost::lexical_cast<string>(port) + ":" + address;
+}
+
 size_t HttpClient::curl_write(char *data, size_t size, size_t nmemb,
                               void *ctx) {
   return ((HttpClient*)ctx)->write(data, size, nmemb);
@@ -146,6 +182,17 @@ int HttpClient::impl(const char *url, const char *data, int size,
     }
   }
 
+  curl_slist *resolve = NULL;
+#if LIBCURL_VERSION_NUM >= 0x071503
+  if (m_proxyHost.empty() && RuntimeOption::EnableDnsCache) {
+    string entry = resolve_entry(url);
+    if (!entry.empty()) {
+      resolve = curl_slist_append(NULL, entry.c_str());
+      curl_easy_setopt(cp, CURLOPT_RESOLVE, resolve);
+    }
+  }
+#endif
+
   std::vector<String> headers; // holding those temporary strings
   curl_slist *slist = NULL;
   if (requestHeaders) {
@@ -187,6 +234,9 @@ int HttpClient::impl(const char *url, const char *data, int size,
   }
 
   curl_easy_cleanup(cp);
+  if (resolve) {
+    curl_slist_free_all(resolve);
+  }
   return code;
 }
 
@@ -161,6 +161,16 @@ void LibEventHttpClient::release() {
   m_busy = false;
 }
 
+void LibEventHttpClient::discard() {
+  clear();
+  if (m_conn) {
+    evhttp_connection_free(m_conn);
+    m_conn = NULL;
+  }
+  m_requests = 0;
+  m_busy = false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 bool LibEventHttpClient::send(const std::string &url,
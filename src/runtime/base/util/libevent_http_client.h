@@ -65,6 +65,13 @@ public:
    */
   void release();
 
+  /**
+   * Like release(), but for an object whose last send() didn't complete, e.g.
+   * timed out: its connection may still have a request outstanding, so it is
+   * closed rather than reused by the next Get().
+   */
+  void discard();
+
   /**
    * Synchronously or asynchronously GET/POST an URL.
    * If data is NULL, do GET, otherwise, do POST.
@@ -378,9 +378,9 @@ void VariableSerializer::writeOverflow(void* ptr, bool isObject /* = false */) {
   case Serialize:
   case APCSerialize:
     {
-      PointerCounterMap::const_iterator iter = m_arrayIds.find(ptr);
-      ASSERT(iter != m_arrayIds.end());
-      int id = iter->second;
+      SeenMap::const_iterator iter = m_seen.find(ptr);
+      ASSERT(iter != m_seen.end() && iter->second.id);
+      int id = iter->second.id;
       if (isObject) {
         m_buf->append("r:");
         m_buf->append(id);
@@ -675,8 +675,7 @@ void VariableSerializer::writeArrayKey(const ArrayData *arr, Variant key) {
 void VariableSerializer::writeArrayValue(const ArrayData *arr, CVarRef value) {
   // Do not count referenced values after the first
   if ((m_type == Serialize || m_type == APCSerialize) &&
-      !(value.isReferenced() &&
-        m_arrayIds.find(value.getVariantData()) != m_arrayIds.end()))
+      !(value.isReferenced() && hasId(value.getVariantData())))
     m_valueCount++;
 
   write(value);
@@ -768,27 +767,28 @@ void VariableSerializer::indent() {
 
 bool VariableSerializer::incNestedLevel(void *ptr,
                                         bool isObject /* = false */) {
+  // one lookup for both the nesting count and the reference id
+  SeenInfo &info = m_seen[ptr];
   switch (m_type) {
   case VarExport:
   case PrintR:
   case VarDump:
   case DebugDump:
-    return ++m_counts[ptr] >= m_maxCount;
+    return ++info.count >= m_maxCount;
   case Serialize:
   case APCSerialize:
     {
-      int ct = ++m_counts[ptr];
-      if (m_arrayIds.find(ptr) != m_arrayIds.end() &&
-          (m_referenced || isObject)) {
+      int ct = ++info.count;
+      if (info.id && (m_referenced || isObject)) {
         return true;
       } else {
-        m_arrayIds[ptr] = m_valueCount;
+        info.id = m_valueCount;
       }
       return ct >= (m_maxCount - 1);
     }
     break;
   case JSON:
-    return ++m_counts[ptr] >= m_maxCount;
+    return ++info.count >= m_maxCount;
   default:
     ASSERT(false);
     break;
@@ -797,7 +797,12 @@ bool VariableSerializer::incNestedLevel(void *ptr,
 }
 
 void VariableSerializer::decNestedLevel(void *ptr) {
-  --m_counts[ptr];
+  --m_seen[ptr].count;
+}
+
+bool VariableSerializer::hasId(void *ptr) const {
+  SeenMap::const_iterator iter = m_seen.find(ptr);
+  return iter != m_seen.end() && iter->second.id;
 }
 
 void VariableSerializer::checkOutputSize() {
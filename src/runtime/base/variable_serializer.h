@@ -100,8 +100,13 @@ private:
   int m_option;                  // type specific extra options
   StringBuffer *m_buf;
   int m_indent;
-  PointerCounterMap m_counts;    // counting seen arrays for recursive levels
-  PointerCounterMap m_arrayIds;  // reference ids for objs/arrays
+  struct SeenInfo {
+    SeenInfo() : count(0), id(0) {}
+    int count; // nesting count, for recursive levels
+    int id;    // reference id for serialize(), 0 if none yet
+  };
+  typedef hphp_hash_map<void*, SeenInfo, pointer_hash<void> > SeenMap;
+  SeenMap m_seen;                // arrays and objects on the way down
   int m_valueCount;              // Current ref index
   bool m_referenced;             // mark current array element as reference
   int m_refCount;                // current variable's reference count
@@ -121,6 +126,7 @@ private:
   };
   std::vector<ArrayInfo> m_arrayInfos;
 
+  bool hasId(void *ptr) const;
   void writePropertyPrivacy(const char *prop, const ClassInfo *cls);
   void writeSerializedProperty(CStrRef prop, const ClassInfo *cls);
   void checkOutputSize();
@@ -0,0 +1,139 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/variable_unserializer.h>
+#include <runtime/base/string_intern_table.h>
+#include <runtime/base/zend/zend_strtod.h>
+#include <util/exception.h>
+#include <util/hash.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+char VariableUnserializer::readChar() {
+  skipSpaces();
+  if (m_p >= m_end) {
+    throw Exception("Unexpected end of serialized data");
+  }
+  return *m_p++;
+}
+
+void VariableUnserializer::expectChar(char expected) {
+  char ch = readChar();
+  if (ch != expected) {
+    throw Exception("Expected '%c' but got '%c'", expected, ch);
+  }
+}
+
+int64 VariableUnserializer::readInt() {
+  skipSpaces();
+  const char *p = m_p;
+  bool negative = false;
+  if (p < m_end && (*p == '-' || *p == '+')) {
+    negative = (*p++ == '-');
+  }
+  if (p >= m_end || !isdigit(*p)) {
+    throw Exception("Expected a number at offset %d", position());
+  }
+  // one more for the negative side, so that the smallest int64 makes it
+  uint64 limit = (uint64)0x7FFFFFFFFFFFFFFFLL + (negative ? 1 : 0);
+  uint64 v = 0;
+  while (p < m_end && isdigit(*p)) {
+    int digit = *p++ - '0';
+    if (v > (limit - digit) / 10) {
+      throw Exception("Number out of range at offset %d", position());
+    }
+    v = v * 10 + digit;
+  }
+  m_p = p;
+  return negative ? -(int64)v : (int64)v;
+}
+
+double VariableUnserializer::readDouble() {
+  skipSpaces();
+  // zend_strtod() wants a terminated string, and unlike strtod() it doesn't
+  // care about the current locale
+  char buf[64];
+  int n = 0;
+  for (const char *p = m_p; p < m_end && n < (int)sizeof(buf) - 1; p++) {
+    char ch = *p;
+    if (!isdigit(ch) && ch != '-' && ch != '+' && ch != '.' &&
+        ch != 'e' && ch != 'E') {
+      break;
+    }
+    buf[n++] = ch;
+  }
+  buf[n] = '\0';
+  char *end;
+  double v = zend_strtod(buf, &end);
+  if (end == buf) {
+    throw Exception("Expected a number at offset %d", position());
+  }
+  m_p += end - buf;
+  return v;
+}
+
+const char *VariableUnserializer::readBytes(int size) {
+  if (size < 0 || size > m_end - m_p) {
+    throw Exception("Unexpected end of serialized data");
+  }
+  const char *ret = m_p;
+  m_p += size;
+  return ret;
+}
+
+String VariableUnserializer::readStringImpl(char delimiter0, char delimiter1,
+                                            bool intern) {
+  int64 size = readInt();
+  if (size >= SERIALIZE_MAX_SIZE) {
+    throw Exception("Size of serialized string (%ld) exceeds max", size);
+  }
+  expectChar(':');
+  expectChar(delimiter0);
+  const char *s = readBytes(size);
+  String ret;
+  if (intern && size <= InternMaxSize) {
+    ret = this->intern(s, size);
+  } else {
+    ret = String(s, size, CopyString);
+    ret.checkStatic();
+  }
+  expectChar(delimiter1);
+  return ret;
+}
+
+String VariableUnserializer::intern(const char *s, int size) {
+  // keys that keep coming back, in this payload or others, end up in the
+  // process-wide table
+  int64 hash = hash_string(s, size);
+  StringData *sd = StringInternTable::InternRepeated(s, size, hash);
+  if (sd) return sd;
+
+  // a direct-mapped cache: a collision just replaces the older string
+  if (m_interned.empty()) {
+    m_interned.resize(InternSlots);
+  }
+  String &slot = m_interned[hash & (InternSlots - 1)];
+  if (slot.isNull() || slot.size() != size ||
+      memcmp(slot.data(), s, size) != 0) {
+    slot = String(s, size, CopyString);
+    slot.checkStatic();
+  }
+  return slot;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -18,13 +18,23 @@
 #define __HPHP_VARIABLE_UNSERIALIZER_H__
 
 #include <runtime/base/types.h>
+#include <runtime/base/complex_types.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
+#define SERIALIZE_MAX_SIZE (64*1024*1024)
+
+/**
+ * Reads serialize() format straight out of a memory buffer. Array keys and
+ * class names that repeat, like the same field names in a list of records,
+ * are interned, so they share one StringData and its cached hash instead of
+ * being copied and hashed again for every array.
+ */
 class VariableUnserializer {
 public:
-  VariableUnserializer(std::istream &in) : m_in(in), m_key(false) {}
+  VariableUnserializer(const char *str, int len)
+    : m_buf(str), m_end(str + len), m_p(str), m_key(false) {}
 
   Variant unserialize() {
     Variant v;
@@ -40,9 +50,6 @@ public:
     return v;
   }
 
-  std::istream &in() const {
-    return m_in;
-  }
   void add(Variant* v) {
     if (!m_key) {
       m_refs.push_back(v);
@@ -53,10 +60,48 @@ public:
     return m_refs[id-1];
   }
 
+  /**
+   * Number of bytes consumed so far.
+   */
+  int position() const { return m_p - m_buf;}
+
+  /**
+   * Parsing helpers. Like the stream extractors they replace, readChar(),
+   * readInt() and readDouble() skip leading whitespace; all of them throw
+   * on malformed or truncated input.
+   */
+  char peek() const { return m_p < m_end ? *m_p : '\0';}
+  char readChar();
+  void expectChar(char expected);
+  int64 readInt();
+  double readDouble();
+  const char *readBytes(int size);
+
+  /**
+   * Reads <size>:<delimiter0><bytes><delimiter1>. Array keys and class
+   * names go through the intern table.
+   */
+  String readString(char delimiter0 = '"', char delimiter1 = '"') {
+    return readStringImpl(delimiter0, delimiter1, m_key);
+  }
+  String readClassName() { return readStringImpl('"', '"', true);}
+
  private:
-  std::istream &m_in;
+  static const int InternSlots = 256;
+  static const int InternMaxSize = 64;
+
+  const char *m_buf;
+  const char *m_end;
+  const char *m_p;
   std::vector<Variant*> m_refs;
   bool m_key;
+  std::vector<String> m_interned; // allocated on first use
+
+  void skipSpaces() {
+    while (m_p < m_end && isspace(*m_p)) m_p++;
+  }
+  String readStringImpl(char delimiter0, char delimiter1, bool intern);
+  String intern(const char *s, int size);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
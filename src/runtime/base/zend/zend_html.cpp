@@ -18,6 +18,7 @@
 #include <runtime/base/zend/zend_html.h>
 #include <runtime/base/complex_types.h>
 #include <util/lock.h>
+#include <util/simd_string.h>
 
 namespace HPHP {
 
@@ -371,8 +372,26 @@ char *string_html_encode(const char *input, int &len, bool encode_double_quote,
   if (!ret) {
     return NULL;
   }
+  // bytes that may need an entity; NUL ends the input
+  char special[8];
+  int nspecial = 0;
+  special[nspecial++] = '\0';
+  special[nspecial++] = '<';
+  special[nspecial++] = '>';
+  special[nspecial++] = '&';
+  if (encode_double_quote) special[nspecial++] = '"';
+  if (encode_single_quote) special[nspecial++] = '\'';
+  if (nbsp) special[nspecial++] = utf8 ? '\xc2' : '\xa0';
+
   char *q = ret;
-  for (const char *p = input; *p; p++) {
+  const char *end = input + len;
+  for (const char *p = input; ; p++) {
+    // bulk copy the run of plain bytes before the next special one
+    int n = simd_scan_any(p, end - p, special, nspecial);
+    memcpy(q, p, n);
+    q += n;
+    p += n;
+    if (p == end || !*p) break;
     char c = *p;
     switch (c) {
     case '"':
@@ -21,6 +21,7 @@
 #include <runtime/base/zend/utf8_to_utf16.h>
 
 #include <util/lock.h>
+#include <util/simd_string.h>
 #include <math.h>
 #include <monetary.h>
 
@@ -349,9 +350,7 @@ int string_natural_cmp(char const *a, size_t a_len,
 char *string_to_lower(const char *s, int len) {
   ASSERT(s);
   char *ret = (char *)malloc(len + 1);
-  for (int i = 0; i < len; i++) {
-    ret[i] = tolower(s[i]);
-  }
+  simd_to_lower(ret, s, len);
   ret[len] = '\0';
   return ret;
 }
@@ -359,9 +358,7 @@ char *string_to_lower(const char *s, int len) {
 char *string_to_upper(const char *s, int len) {
   ASSERT(s);
   char *ret = (char *)malloc(len + 1);
-  for (int i = 0; i < len; i++) {
-    ret[i] = toupper(s[i]);
-  }
+  simd_to_upper(ret, s, len);
   ret[len] = '\0';
   return ret;
 }
@@ -394,6 +391,19 @@ char *string_to_upper_words(const char *s, int len) {
 char *string_trim(const char *s, int &len,
                   const char *charlist, int charlistlen, int mode) {
   ASSERT(s);
+  if (charlistlen <= 16 && !simd_memmem(charlist, charlistlen, "..", 2)) {
+    // no ranges, so charlist itself is the set of bytes to strip
+    if (mode & 1) {
+      int trimmed = simd_span(s, len, charlist, charlistlen);
+      len -= trimmed;
+      s += trimmed;
+    }
+    if (mode & 2) {
+      len -= simd_rspan(s, len, charlist, charlistlen);
+    }
+    return string_duplicate(s, len);
+  }
+
   char mask[256];
   string_charmask(charlist, charlistlen, mask);
 
@@ -517,10 +527,9 @@ int string_find(const char *input, int len, char ch, int pos,
     if (!string_substr_check(len, pos, l)) {
       return -1;
     }
-    for (int i = pos; i < len; i++) {
-      if (input[i] == ch) {
-        return i;
-      }
+    const char *p = (const char *)memchr(input + pos, ch, len - pos);
+    if (p) {
+      return p - input;
     }
   }
   return -1;
@@ -583,11 +592,9 @@ int string_find(const char *input, int len, const char *s, int s_len,
     if (!string_substr_check(len, pos, l)) {
       return -1;
     }
-    int i_max = len - s_len + 1;
-    for (int i = pos; i < i_max; i++) {
-      if (input[i] == s[0] && memcmp(input+i, s, s_len) == 0) {
-        return i;
-      }
+    const char *p = simd_memmem(input + pos, len - pos, s, s_len);
+    if (p) {
+      return p - input;
     }
   }
   return -1;
@@ -635,22 +642,7 @@ int string_rfind(const char *input, int len, const char *s, int s_len,
 
 const char *string_memnstr(const char *haystack, const char *needle,
                            int needle_len, const char *end) {
-  const char *p = haystack;
-  char ne = needle[needle_len-1];
-
-  end -= needle_len;
-  while (p <= end) {
-    if ((p = (char *)memchr(p, *needle, (end-p+1))) && ne == p[needle_len-1]) {
-      if (!memcmp(needle, p, needle_len-1)) {
-        return p;
-      }
-    }
-    if (p == NULL) {
-      return NULL;
-    }
-    p++;
-  }
-  return NULL;
+  return simd_memmem(haystack, end - haystack, needle, needle_len);
 }
 
 void *string_memrchr(const void *s, int c, size_t n) {
@@ -709,24 +701,25 @@ char *string_replace(const char *input, int &len,
     return NULL;
   }
 
+  // fold case once up front, rather than on every string_find() call
+  const char *haystack = input;
+  char *lowered = NULL;
+  char *lowered_search = NULL;
+  if (!case_sensitive) {
+    haystack = lowered = string_to_lower(input, len);
+    search = lowered_search = string_to_lower(search, len_search);
+  }
+
   std::vector<int> founds;
   founds.reserve(16);
-  if (len_search == 1) {
-    for (int pos = string_find(input, len, *search, 0, case_sensitive);
-         pos >= 0;
-         pos = string_find(input, len, *search, pos + len_search,
-                           case_sensitive)) {
-      founds.push_back(pos);
-    }
-  } else {
-    for (int pos = string_find(input, len, search, len_search, 0,
-                               case_sensitive);
-         pos >= 0;
-         pos = string_find(input, len, search, len_search,
-                           pos + len_search, case_sensitive)) {
-      founds.push_back(pos);
-    }
+  const char *end = haystack + len;
+  for (const char *p = simd_memmem(haystack, len, search, len_search); p;
+       p = simd_memmem(p + len_search, end - p - len_search,
+                       search, len_search)) {
+    founds.push_back(p - haystack);
   }
+  free(lowered);
+  free(lowered_search);
 
   count = founds.size();
   if (count == 0) {
@@ -1465,6 +1458,14 @@ char *string_addslashes(const char *str, int &length) {
   char *target = new_str;
 
   while (source < end) {
+    // bulk copy everything up to the next byte that needs a slash
+    int n = simd_scan_any(source, end - source, "\0'\"\\", 4);
+    memcpy(target, source, n);
+    target += n;
+    source += n;
+    if (source == end) {
+      break;
+    }
     switch (*source) {
     case '\0':
       *target++ = '\\';
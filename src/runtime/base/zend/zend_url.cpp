@@ -17,6 +17,7 @@
 
 #include <runtime/base/zend/zend_url.h>
 #include <runtime/base/zend/zend_string.h>
+#include <util/simd_string.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -320,6 +321,15 @@ char *url_encode(const char *s, int &len) {
   start = to = (unsigned char *)malloc(3 * len + 1);
 
   while (from < end) {
+    // bulk copy the run of bytes that go out as they are
+    int n = simd_scan_outside((const char *)from, end - from,
+                              "--..09AZ__az", 6);
+    memcpy(to, from, n);
+    to += n;
+    from += n;
+    if (from == end) {
+      break;
+    }
     c = *from++;
 
     if (c == ' ') {
@@ -16,6 +16,7 @@
 
 #include <runtime/eval/runtime/code_coverage.h>
 #include <runtime/base/complex_types.h>
+#include <util/atomic.h>
 #include <util/logger.h>
 
 using namespace std;
@@ -23,56 +24,172 @@ using namespace std;
 namespace HPHP { namespace Eval {
 ///////////////////////////////////////////////////////////////////////////////
 
-Mutex CodeCoverage::s_mutex;
-CodeCoverage::CodeCoverageMap CodeCoverage::s_hits;
+namespace {
+
+// counters come in chunks of 1K lines, and a file can have 256 of them
+const int ChunkBits = 10;
+const int ChunkSize = 1 << ChunkBits;
+const int MaxChunks = 256;
+const int MaxLine = MaxChunks * ChunkSize - 1;
+
+const int TableSize = 1 << 16;
+
+struct FileCoverage {
+  char *name;
+  int64 hash;
+  int maxLine; // highest line executed so far, 0 if none
+  int *chunks[MaxChunks];
+};
+
+FileCoverage **s_files = NULL;
+bool s_full = false;
+
+__thread const char *t_lastName = NULL;
+__thread FileCoverage *t_lastFile = NULL;
+
+FileCoverage **get_table() {
+  FileCoverage **table = *(FileCoverage ** volatile *)&s_files;
+  if (table) return table;
+  table = (FileCoverage**)calloc(TableSize, sizeof(FileCoverage*));
+  FileCoverage **old =
+    __sync_val_compare_and_swap(&s_files, (FileCoverage**)NULL, table);
+  if (old) {
+    free(table);
+    return old;
+  }
+  return table;
+}
+
+FileCoverage *find_file(const char *filename) {
+  if (t_lastName == filename && strcmp(t_lastFile->name, filename) == 0) {
+    return t_lastFile;
+  }
+
+  FileCoverage **table = get_table();
+  int len = strlen(filename);
+  int64 hash = hash_string(filename, len);
+  FileCoverage *created = NULL;
+  int index = hash & (TableSize - 1);
+  for (int probe = 0; probe < TableSize; probe++) {
+    FileCoverage *file = *(FileCoverage * volatile *)&table[index];
+    if (file == NULL) {
+      if (created == NULL) {
+        created = (FileCoverage*)calloc(1, sizeof(FileCoverage));
+        created->name = strdup(filename);
+        created->hash = hash;
+      }
+      file = __sync_val_compare_and_swap(&table[index], (FileCoverage*)NULL,
+                                         created);
+      if (file == NULL) {
+        file = created;
+        created = NULL;
+      }
+    }
+    if (file->hash == hash && strcmp(file->name, filename) == 0) {
+      if (created) {
+        free(created->name);
+        free(created);
+      }
+      t_lastName = filename;
+      t_lastFile = file;
+      return file;
+    }
+    index = (index + 1) & (TableSize - 1);
+  }
+
+  if (created) {
+    free(created->name);
+    free(created);
+  }
+  if (!s_full) {
+    s_full = true;
+    Logger::Warning("code coverage is not recorded for more than %d files",
+                    TableSize);
+  }
+  return NULL;
+}
+
+int *get_chunk(FileCoverage *file, int index) {
+  int *chunk = *(int * volatile *)&file->chunks[index];
+  if (chunk) return chunk;
+  chunk = (int*)calloc(ChunkSize, sizeof(int));
+  int *old = __sync_val_compare_and_swap(&file->chunks[index], (int*)NULL,
+                                         chunk);
+  if (old) {
+    free(chunk);
+    return old;
+  }
+  return chunk;
+}
+
+inline int get_count(const FileCoverage *file, int line) {
+  const int *chunk = file->chunks[line >> ChunkBits];
+  return chunk ? chunk[line & (ChunkSize - 1)] : 0;
+}
+
+}
 
 void CodeCoverage::Record(const char *filename, int line0, int line1) {
   if (!filename || !*filename || line0 <= 0 || line1 <= 0 || line0 > line1) {
     return;
   }
+  if (line1 > MaxLine) {
+    line1 = MaxLine;
+    if (line0 > line1) return;
+  }
 
-  Lock lock(s_mutex);
+  FileCoverage *file = find_file(filename);
+  if (file == NULL) return;
 
-  CodeCoverageMap::iterator iter = s_hits.find(filename);
-  if (iter == s_hits.end()) {
-    vector<int> &lines = s_hits[filename];
-    lines.resize(line1 + 1);
-    for (int i = line0; i <= line1; i++) {
-      lines[i] = 1;
-    }
-  } else {
-    vector<int> &lines = iter->second;
-    if ((int)lines.size() < line1 + 1) {
-      lines.resize(line1 + 1);
-    }
-    for (int i = line0; i <= line1; i++) {
-      ++lines[i];
+  int *chunk = NULL;
+  for (int i = line0; i <= line1; i++) {
+    if (chunk == NULL || (i & (ChunkSize - 1)) == 0) {
+      chunk = get_chunk(file, i >> ChunkBits);
     }
+    atomic_inc(chunk[i & (ChunkSize - 1)]);
+  }
+
+  int maxLine = *(volatile int *)&file->maxLine;
+  while (maxLine < line1) {
+    int old = __sync_val_compare_and_swap(&file->maxLine, maxLine, line1);
+    if (old == maxLine) break;
+    maxLine = old;
   }
 }
 
-Array CodeCoverage::Report() {
-  Lock lock(s_mutex);
+void CodeCoverage::Register(const char *filename, int lastLine) {
+  if (!filename || !*filename || lastLine <= 0) return;
+  if (lastLine > MaxLine) lastLine = MaxLine;
 
+  FileCoverage *file = find_file(filename);
+  if (file == NULL) return;
+  for (int i = 0; i <= (lastLine >> ChunkBits); i++) {
+    get_chunk(file, i);
+  }
+}
+
+Array CodeCoverage::Report() {
   Array ret = Array::Create();
-  for (CodeCoverageMap::const_iterator iter = s_hits.begin();
-       iter != s_hits.end(); ++iter) {
-    const vector<int> &lines = iter->second;
+  FileCoverage **table = *(FileCoverage ** volatile *)&s_files;
+  if (table == NULL) return ret;
+
+  for (int index = 0; index < TableSize; index++) {
+    const FileCoverage *file = *(FileCoverage * volatile *)&table[index];
+    if (file == NULL || file->maxLine == 0) continue;
     Array tmp = Array::Create();
-    for (int i = 1; i < (int)lines.size(); i++) {
-      if (lines[i]) {
-        tmp.set(i, Variant((int64)lines[i]));
+    for (int i = 1; i <= file->maxLine; i++) {
+      int count = get_count(file, i);
+      if (count) {
+        tmp.set(i, Variant((int64)count));
       }
     }
-    ret.set(String(iter->first), Variant(tmp));
+    ret.set(String(file->name), Variant(tmp));
   }
 
   return ret;
 }
 
 void CodeCoverage::Report(const std::string &filename) {
-  Lock lock(s_mutex);
-
   ofstream f(filename.c_str());
   if (!f) {
     Logger::Error("unable to open %s", filename.c_str());
@@ -80,21 +197,26 @@ void CodeCoverage::Report(const std::string &filename) {
   }
 
   f << "{\n";
-  for (CodeCoverageMap::const_iterator iter = s_hits.begin();
-       iter != s_hits.end();) {
-    const vector<int> &lines = iter->second;
-    f << "\"" << iter->first << "\": [";
-    int count = lines.size();
-    for (int i = 0 /* not 1 */; i < count; i++) {
-      f << lines[i];
-      if (i < count - 1) {
+  FileCoverage **table = *(FileCoverage ** volatile *)&s_files;
+  bool first = true;
+  for (int index = 0; table && index < TableSize; index++) {
+    const FileCoverage *file = *(FileCoverage * volatile *)&table[index];
+    if (file == NULL || file->maxLine == 0) continue;
+    if (!first) {
+      f << ",\n";
+    }
+    first = false;
+    f << "\"" << file->name << "\": [";
+    int maxLine = file->maxLine;
+    for (int i = 0 /* not 1 */; i <= maxLine; i++) {
+      f << get_count(file, i);
+      if (i < maxLine) {
         f << ",";
       }
     }
     f << "]";
-    if (++iter != s_hits.end()) {
-      f << ",";
-    }
+  }
+  if (!first) {
     f << "\n";
   }
   f << "}\n";
@@ -18,15 +18,31 @@
 #define __HPHP_EVAL_CODE_COVERAGE_H__
 
 #include <runtime/base/complex_types.h>
-#include <util/lock.h>
 
 namespace HPHP { namespace Eval {
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Line counters of every file executed while Eval.RecordCodeCoverage is on.
+ *
+ * Each file has its own counters, in chunks of lines allocated the first
+ * time one of their lines runs, found by name through a table that files
+ * are only ever added to. Neither the table nor the counters take a lock:
+ * new files and chunks claim their slots with a compare-and-swap, and
+ * counters are bumped with atomic increments, so threads executing the same
+ * code only ever share cache lines, never a mutex. Reports add nothing up
+ * and just read the counters as they are.
+ */
 class CodeCoverage {
 public:
   static void Record(const char *filename, int line0, int line1);
 
+  /**
+   * Sets up the counters of a file that was just parsed, up to its last
+   * line, so that executing it does not have to.
+   */
+  static void Register(const char *filename, int lastLine);
+
   /**
    * Returns an array in this format,
    *
@@ -42,12 +58,6 @@ public:
    * Note it's 0-indexed, so first count should always be 0.
    */
   static void Report(const std::string &filename);
-
-private:
-  typedef hphp_const_char_map<std::vector<int> > CodeCoverageMap;
-
-  static Mutex s_mutex;
-  static CodeCoverageMap s_hits;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
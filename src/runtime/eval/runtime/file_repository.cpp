@@ -23,6 +23,7 @@
 #include <runtime/base/runtime_option.h>
 #include <util/process.h>
 #include <runtime/eval/runtime/eval_state.h>
+#include <runtime/eval/runtime/code_coverage.h>
 
 using namespace std;
 
@@ -133,6 +134,9 @@ PhpFile *FileRepository::readFile(const std::string &name, const struct stat &s)
   const char *canoname = canonicalize(name);
   StatementPtr stmt = Parser::parseFile(canoname, sts);
   if (stmt) {
+    if (RuntimeOption::RecordCodeCoverage) {
+      CodeCoverage::Register(canoname, stmt->loc()->line1);
+    }
     uint lock = hash_string(canoname) & 127;
     PhpFile *p = new PhpFile(stmt, sts, s_locks[lock], s);
     return p;
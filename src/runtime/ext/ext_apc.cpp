@@ -21,7 +21,10 @@
 #include <runtime/base/runtime_option.h>
 #include <util/async_job.h>
 #include <util/timer.h>
+#include <util/logger.h>
+#include <util/util.h>
 #include <dlfcn.h>
+#include <sys/socket.h>
 #include <runtime/base/program_functions.h>
 #include <runtime/base/builtin_functions.h>
 #include <runtime/base/variable_serializer.h>
@@ -642,6 +645,122 @@ int apc_rfc1867_progress(apc_rfc1867_data *rfc1867ApcData,
   return 0;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// handing APC over to a new server process
+
+static bool write_all(int fd, const void *data, size_t size) {
+  const char *p = (const char *)data;
+  while (size > 0) {
+    // the other end may go away any time, which must not kill us
+    ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool read_all(int fd, void *data, size_t size) {
+  char *p = (char *)data;
+  while (size > 0) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool match_prefix(const string &key, const vector<string> &prefixes) {
+  if (prefixes.empty()) return true;
+  for (unsigned int i = 0; i < prefixes.size(); i++) {
+    if (key.compare(0, prefixes[i].size(), prefixes[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// anything bigger means the stream is broken
+static const int64 MaxHandoffValueSize = 1LL << 30;
+
+// the session store rides along as cache id SHARED_STORE_SESSION
+static SharedStore &handoff_store(int64 id) {
+  return id == SHARED_STORE_SESSION ? s_apc_store.session() : s_apc_store[id];
+}
+
+// each entry is a header of cache id, key size, value size and expiration
+// time, followed by the key and its APC-serialized value
+int64 apc_dump_handoff(int fd, const vector<string> &prefixes,
+                       int64 maxBytes) {
+  int64 sent = 0;
+  for (int id = 0; id <= SHARED_STORE_SESSION; id++) {
+    SharedStore &store = handoff_store(id);
+    vector<SharedStore::KeyExpiry> keys;
+    store.getKeys(keys);
+    for (unsigned int i = 0; i < keys.size(); i++) {
+      const string &key = keys[i].first;
+      if (!match_prefix(key, prefixes)) continue;
+
+      Variant value;
+      if (!store.get(key, value)) continue; // gone since
+      String data = apc_serialize(value);
+      if (sent + (int64)key.size() + data.size() > maxBytes) {
+        return sent;
+      }
+      int64 header[4] = { id, key.size(), data.size(), keys[i].second };
+      if (!write_all(fd, header, sizeof(header)) ||
+          !write_all(fd, key.data(), key.size()) ||
+          !write_all(fd, data.data(), data.size())) {
+        Logger::Error("APC hand-off stopped: %s",
+                      Util::safe_strerror(errno).c_str());
+        return sent;
+      }
+      sent += key.size() + data.size();
+    }
+  }
+  return sent;
+}
+
+int apc_load_handoff(int fd) {
+  int count = 0;
+  time_t now = time(NULL);
+  int64 header[4];
+  string key, data;
+  while (read_all(fd, header, sizeof(header))) {
+    int64 id = header[0];
+    int64 keySize = header[1];
+    int64 dataSize = header[2];
+    int64 expiry = header[3];
+    if (id < 0 || id > SHARED_STORE_SESSION || keySize <= 0 ||
+        keySize > MaxHandoffValueSize || dataSize <= 0 ||
+        dataSize > MaxHandoffValueSize) {
+      Logger::Error("APC hand-off sent a bad entry");
+      break;
+    }
+    key.resize(keySize);
+    data.resize(dataSize);
+    if (!read_all(fd, &key[0], keySize) ||
+        !read_all(fd, &data[0], dataSize)) {
+      break;
+    }
+
+    int64 ttl = 0;
+    if (expiry) {
+      ttl = expiry - now;
+      if (ttl <= 0) continue;
+    }
+    if (handoff_store(id).store(key, apc_unserialize(data), ttl, false)) {
+      count++;
+    }
+  }
+  return count;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // apc serialization
 
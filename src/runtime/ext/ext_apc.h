@@ -109,6 +109,23 @@ void const_load_impl(const char **int_keys, int64 *int_values,
                    const char **char_keys, char *char_values,
                    const char **strings, const char **objects,
                    const char **thrifts, const char **others);
+///////////////////////////////////////////////////////////////////////////////
+// handing APC over to a new server process
+
+/**
+ * Writes entries of keys starting with one of the prefixes (any key, if
+ * there are none) to a socket, up to maxBytes of keys and serialized values.
+ * Returns how many bytes were written.
+ */
+int64 apc_dump_handoff(int fd, const std::vector<std::string> &prefixes,
+                       int64 maxBytes);
+
+/**
+ * Stores what apc_dump_handoff() wrote, until the other end closes, without
+ * overwriting any key already there. Returns how many keys were stored.
+ */
+int apc_load_handoff(int fd);
+
 ///////////////////////////////////////////////////////////////////////////////
 // apc serialization
 
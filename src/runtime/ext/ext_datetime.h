@@ -263,16 +263,7 @@ inline Variant f_strptime(CStrRef date, CStrRef format) {
 
 inline Variant f_strtotime(CStrRef input,
                            int64 timestamp = TimeStamp::Current()) {
-  if (input.empty()) {
-    return false;
-  }
-
-  DateTime dt(timestamp);
-  if (!dt.fromString(input, SmartObject<TimeZone>())) {
-    return false;
-  }
-  bool error;
-  return dt.toTimeStamp(error);
+  return DateTime::StrToTime(input, timestamp);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
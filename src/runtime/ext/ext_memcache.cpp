@@ -18,34 +18,85 @@
 #include <runtime/ext/ext_memcache.h>
 #include <runtime/base/util/request_local.h>
 #include <runtime/base/ini_setting.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/base/server/server_stats.h>
 
 #define MMC_SERIALIZED 1
 #define MMC_COMPRESSED 2
 
+// queued writes a connection sends without waiting for more
+#define MMC_MAX_PENDING 64
+
+using namespace std;
+
 namespace HPHP {
 IMPLEMENT_DEFAULT_EXTENSION(memcache);
 
 bool ini_on_update_hash_strategy(CStrRef value, void *p);
 bool ini_on_update_hash_function(CStrRef value, void *p);
+bool ini_on_update_pipeline(CStrRef value, void *p);
 
 class MEMCACHEGlobals : public RequestEventHandler {
 public:
   std::string hash_strategy;
   std::string hash_function;
 
-  MEMCACHEGlobals() {}
+  /**
+   * With memcache.pipeline on, set() and delete() are queued on their
+   * connection and return true right away. Queued writes are streamed out
+   * without waiting for replies before any other command on the same
+   * connection, when the setting is turned off again, and at the end of
+   * the request; only the last write of each key is sent. get() answers
+   * keys with a queued write by itself.
+   *
+   * Queued writes are fire-and-forget: what can be checked up front, the
+   * key and whether there is a server at all, fails the call right away,
+   * but a write the server later refuses or never receives is only counted
+   * in mcc.pipeline_failures.
+   */
+  bool pipeline;
+  std::set<c_memcache*> pending; // connections with queued writes
+
+  // per-request counters, added to server stats when the request ends
+  int64 queued;
+  int64 localHits;
+  int64 roundTripsSaved;
+  int64 failures;
+
+  MEMCACHEGlobals() : pipeline(false) {}
 
   virtual void requestInit() {
     hash_strategy = "standard";
     hash_function = "crc32";
+    pipeline = false;
+    queued = localHits = roundTripsSaved = failures = 0;
 
     IniSetting::Bind("memcache.hash_strategy",     "standard",
                      ini_on_update_hash_strategy,  &hash_strategy);
     IniSetting::Bind("memcache.hash_function",     "crc32",
                      ini_on_update_hash_function,  &hash_function);
+    IniSetting::Bind("memcache.pipeline",          "0",
+                     ini_on_update_pipeline,       this);
   }
 
   virtual void requestShutdown() {
+    flushAll();
+    if (RuntimeOption::EnableStats && queued) {
+      ServerStats::Log("mcc.pipelined", queued);
+      ServerStats::Log("mcc.local_hits", localHits);
+      ServerStats::Log("mcc.round_trips_saved", roundTripsSaved);
+      ServerStats::Log("mcc.pipeline_failures", failures);
+    }
+  }
+
+  void flushAll() {
+    // flushPipeline() takes each connection out of the set
+    std::set<c_memcache*> conns;
+    conns.swap(pending);
+    for (std::set<c_memcache*>::const_iterator iter = conns.begin();
+         iter != conns.end(); ++iter) {
+      (*iter)->flushPipeline();
+    }
   }
 };
 
@@ -63,6 +114,17 @@ bool ini_on_update_hash_strategy(CStrRef value, void *p) {
   return true;
 }
 
+bool ini_on_update_pipeline(CStrRef value, void *p) {
+  MEMCACHEGlobals *g = (MEMCACHEGlobals*)p;
+  bool on = false;
+  ini_on_update_bool(value, &on);
+  if (g->pipeline && !on) {
+    g->flushAll();
+  }
+  g->pipeline = on;
+  return true;
+}
+
 bool ini_on_update_hash_function(CStrRef value, void *p) {
   if (!strncasecmp(value.data(), "crc32", sizeof("crc32"))) {
     MEMCACHEG(hash_strategy) = "crc32";
@@ -100,9 +162,86 @@ c_memcache::c_memcache() : m_memcache(), m_compress_threshold(0),
 }
 
 c_memcache::~c_memcache() {
+  flushPipeline();
   memcached_free(&m_memcache);
 }
 
+bool c_memcache::queueWrite(CStrRef key, CStrRef value, int flag,
+                            int expire) {
+  // nobody hears about failures once the write is queued, so whatever
+  // libmemcached would reject anyway has to fail here
+  if (key.size() >= MEMCACHED_MAX_KEY) {
+    raise_warning("Key too long");
+    return false;
+  }
+  if (!memcached_server_count(&m_memcache)) {
+    return false;
+  }
+
+  PendingWrite w;
+  w.key = string(key.data(), key.size());
+  w.value = value;
+  w.flag = flag;
+  w.expire = expire;
+  m_pendingIndex[w.key] = m_pending.size();
+  m_pending.push_back(w);
+  MEMCACHEG(pending).insert(this);
+  MEMCACHEG(queued)++;
+  if (m_pending.size() >= MMC_MAX_PENDING) {
+    flushPipeline();
+  }
+  return true;
+}
+
+const c_memcache::PendingWrite *c_memcache::findPending(CStrRef key) const {
+  if (m_pending.empty()) return NULL;
+  hphp_string_map<int>::const_iterator iter =
+    m_pendingIndex.find(string(key.data(), key.size()));
+  if (iter == m_pendingIndex.end()) return NULL;
+  MEMCACHEG(localHits)++;
+  return &m_pending[iter->second];
+}
+
+void c_memcache::flushPipeline() {
+  if (m_pending.empty()) return;
+  vector<PendingWrite> pending;
+  pending.swap(m_pending);
+  hphp_string_map<int> index;
+  index.swap(m_pendingIndex);
+  MEMCACHEG(pending).erase(this);
+
+  // set() and delete() have returned already, so nobody waits for the
+  // replies: the commands are streamed to their servers with "noreply",
+  // on the same connections later commands use, so they stay in order;
+  // with no replies, all we can count as failed is what was not sent
+  memcached_behavior_set(&m_memcache, MEMCACHED_BEHAVIOR_NOREPLY, 1);
+  int64 sent = 0;
+  for (unsigned int i = 0; i < pending.size(); i++) {
+    const PendingWrite &w = pending[i];
+    if (index[w.key] != (int)i) continue; // overwritten by a later one
+    memcached_return_t ret;
+    if (w.value.isNull()) {
+      ret = memcached_delete(&m_memcache, w.key.c_str(), w.key.size(),
+                             w.expire);
+    } else {
+      ret = memcached_set(&m_memcache, w.key.c_str(), w.key.size(),
+                          w.value.data(), w.value.size(), w.expire, w.flag);
+    }
+    if (ret == MEMCACHED_SUCCESS || ret == MEMCACHED_BUFFERED) {
+      sent++;
+    } else {
+      MEMCACHEG(failures)++;
+    }
+  }
+  if (memcached_flush_buffers(&m_memcache) != MEMCACHED_SUCCESS) {
+    // some of them may still have gone out, but we cannot tell which
+    MEMCACHEG(failures) += sent;
+  }
+  memcached_behavior_set(&m_memcache, MEMCACHED_BEHAVIOR_NOREPLY, 0);
+
+  MEMCACHEG(roundTripsSaved) += pending.size();
+}
+
 void c_memcache::t___construct() {
   INSTANCE_METHOD_INJECTION_BUILTIN(memcache, memcache::__construct);
   return;
@@ -112,6 +251,7 @@ bool c_memcache::t_connect(CStrRef host, int port /*= 0*/,
                            int timeout /*= 0*/,
                            int timeoutms /*= 0*/) {
   INSTANCE_METHOD_INJECTION_BUILTIN(memcache, memcache::connect);
+  flushPipeline(); // keys may be on other servers afterwards
   memcached_return_t ret;
 
   if (!host.empty() && host[0] == '/') {
@@ -171,6 +311,7 @@ bool c_memcache::t_add(CStrRef key, CVarRef var, int flag /*= 0*/,
 
   String serialized = memcache_prepare_for_storage(var, flag);
 
+  flushPipeline();
   memcached_return_t ret = memcached_add(&m_memcache,
                                         key.c_str(), key.length(),
                                         serialized.c_str(),
@@ -190,6 +331,10 @@ bool c_memcache::t_set(CStrRef key, CVarRef var, int flag /*= 0*/,
 
   String serialized = memcache_prepare_for_storage(var, flag);
 
+  if (MEMCACHEG(pipeline)) {
+    return queueWrite(key, serialized, flag, expire);
+  }
+
   memcached_return_t ret = memcached_set(&m_memcache,
                                         key.c_str(), key.length(),
                                         serialized.c_str(),
@@ -213,6 +358,7 @@ bool c_memcache::t_replace(CStrRef key, CVarRef var, int flag /*= 0*/,
 
   String serialized = memcache_prepare_for_storage(var, flag);
 
+  flushPipeline();
   memcached_return_t ret = memcached_replace(&m_memcache,
                                              key.c_str(), key.length(),
                                              serialized.c_str(),
@@ -224,18 +370,36 @@ bool c_memcache::t_replace(CStrRef key, CVarRef var, int flag /*= 0*/,
 Variant c_memcache::t_get(CVarRef key, Variant flags /*= null*/) {
   INSTANCE_METHOD_INJECTION_BUILTIN(memcache, memcache::get);
   if (key.is(KindOfArray)) {
+    std::vector<String> key_strs;
     std::vector<const char *> real_keys;
     std::vector<size_t> key_len;
     Array keyArr = key.toArray();
+    Array local_vals;
 
+    key_strs.reserve(keyArr.size());
     real_keys.reserve(keyArr.size());
     key_len.reserve(keyArr.size());
 
     for (ArrayIter iter(keyArr); iter; ++iter) {
-      real_keys.push_back(const_cast<char *>(iter.second().toString().c_str()));
-      key_len.push_back(iter.second().toString().length());
+      String skey = iter.second().toString();
+      const PendingWrite *w = findPending(skey);
+      if (w) {
+        if (!w->value.isNull()) {
+          local_vals.set(skey, memcache_fetch_from_storage(w->value.data(),
+                                                           w->value.size(),
+                                                           w->flag));
+        }
+        continue;
+      }
+      key_strs.push_back(skey);
+      real_keys.push_back(skey.data());
+      key_len.push_back(skey.size());
     }
 
+    if (real_keys.empty() && !keyArr.empty()) {
+      MEMCACHEG(roundTripsSaved)++;
+      return local_vals;
+    }
     if (!real_keys.empty()) {
       const char *payload = NULL;
       size_t payload_len = 0;
@@ -248,7 +412,7 @@ Variant c_memcache::t_get(CVarRef key, Variant flags /*= null*/) {
       memcached_return_t ret = memcached_mget(&m_memcache, &real_keys[0],
                                               &key_len[0], real_keys.size());
       memcached_result_create(&m_memcache, &result);
-      Array return_val;
+      Array return_val = local_vals;
 
       while ((memcached_fetch_result(&m_memcache, &result, &ret)) != NULL) {
         if (ret != MEMCACHED_SUCCESS) {
@@ -277,6 +441,15 @@ Variant c_memcache::t_get(CVarRef key, Variant flags /*= null*/) {
 
     memcached_return_t ret;
     String skey = key.toString();
+    const PendingWrite *w = findPending(skey);
+    if (w) {
+      MEMCACHEG(roundTripsSaved)++;
+      if (w->value.isNull()) {
+        return false;
+      }
+      return memcache_fetch_from_storage(w->value.data(), w->value.size(),
+                                         w->flag);
+    }
     payload = memcached_get(&m_memcache, skey.c_str(), skey.length(),
                             &payload_len, &flags, &ret);
 
@@ -305,6 +478,10 @@ bool c_memcache::t_delete(CStrRef key, int expire /*= 0*/) {
     return false;
   }
 
+  if (MEMCACHEG(pipeline)) {
+    return queueWrite(key, null_string, 0, expire);
+  }
+
   memcached_return_t ret = memcached_delete(&m_memcache,
                                             key.c_str(), key.length(),
                                             expire);
@@ -318,6 +495,7 @@ int64 c_memcache::t_increment(CStrRef key, int offset /*= 1*/) {
     return false;
   }
 
+  flushPipeline();
   uint64_t value;
   memcached_return_t ret = memcached_increment(&m_memcache, key.c_str(),
                                               key.length(), offset, &value);
@@ -336,6 +514,7 @@ int64 c_memcache::t_decrement(CStrRef key, int offset /*= 1*/) {
     return false;
   }
 
+  flushPipeline();
   uint64_t value;
   memcached_return_t ret = memcached_decrement(&m_memcache, key.c_str(),
                                               key.length(), offset, &value);
@@ -349,12 +528,14 @@ int64 c_memcache::t_decrement(CStrRef key, int offset /*= 1*/) {
 
 bool c_memcache::t_close() {
   INSTANCE_METHOD_INJECTION_BUILTIN(memcache, memcache::close);
+  flushPipeline();
   memcached_quit(&m_memcache);
   return true;
 }
 
 Variant c_memcache::t_getversion() {
   INSTANCE_METHOD_INJECTION_BUILTIN(memcache, memcache::getversion);
+  flushPipeline();
   int server_count = memcached_server_count(&m_memcache);
   char version[16];
   int version_len = 0;
@@ -382,6 +563,7 @@ Variant c_memcache::t_getversion() {
 
 bool c_memcache::t_flush(int expire /*= 0*/) {
   INSTANCE_METHOD_INJECTION_BUILTIN(memcache, memcache::flush);
+  flushPipeline();
   return memcached_flush(&m_memcache, expire) == MEMCACHED_SUCCESS;
 }
 
@@ -455,6 +637,7 @@ Array static memcache_build_stats(const memcached_st *ptr,
 Array c_memcache::t_getstats(CStrRef type /* = null_string */,
                              int slabid /* = 0 */, int limit /* = 100 */) {
   INSTANCE_METHOD_INJECTION_BUILTIN(memcache, memcache::getstats);
+  flushPipeline();
   if (!memcached_server_count(&m_memcache)) {
     return false;
   }
@@ -485,6 +668,7 @@ Array c_memcache::t_getextendedstats(CStrRef type /* = null_string */,
                                      int slabid /* = 0 */,
                                      int limit /* = 100 */) {
   INSTANCE_METHOD_INJECTION_BUILTIN(memcache, memcache::getextendedstats);
+  flushPipeline();
   memcached_return_t ret;
   memcached_stat_st *stats;
 
@@ -539,6 +723,7 @@ bool c_memcache::t_addserver(CStrRef host, int port /* = 11211 */,
                              CVarRef failure_callback /* = null_variant */,
                              int timeoutms /* = 0 */) {
   INSTANCE_METHOD_INJECTION_BUILTIN(memcache, memcache::addserver);
+  flushPipeline();
   memcached_return_t ret;
 
   if (!host.empty() && host[0] == '/') {
@@ -124,10 +124,31 @@ class c_memcache : public ExtObjectData {
                                     const Eval::FunctionCallExpression *call);
   public: virtual void destruct();
 
+ public:
+  /**
+   * Sends the writes queued while memcache.pipeline was on, all at once.
+   */
+  void flushPipeline();
+
  private:
+  /**
+   * A set, or a delete if value is null, not sent yet.
+   */
+  struct PendingWrite {
+    std::string key;
+    String value;
+    int flag;
+    int expire;
+  };
+
   memcached_st m_memcache;
   int m_compress_threshold;
   double m_min_compress_savings;
+  std::vector<PendingWrite> m_pending;
+  hphp_string_map<int> m_pendingIndex; // key => its last write in m_pending
+
+  bool queueWrite(CStrRef key, CStrRef value, int flag, int expire);
+  const PendingWrite *findPending(CStrRef key) const;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -22,6 +22,7 @@
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/server/server_stats.h>
 #include <runtime/base/util/request_local.h>
+#include <runtime/base/util/dns_cache.h>
 #include <runtime/base/util/extended_logger.h>
 #include <util/timer.h>
 #include <util/db_mysql.h>
@@ -276,7 +277,8 @@ bool MySQL::connect(CStrRef host, int port, CStrRef socket, CStrRef username,
   }
   IOStatusHelper io("mysql::connect", host.data(), port);
   m_xaction_count = 0;
-  bool ret = mysql_real_connect(m_conn, host.data(), username.data(),
+  string address = DnsCache::Rewrite(host.data());
+  bool ret = mysql_real_connect(m_conn, address.c_str(), username.data(),
                             password.data(),
                             (database.empty() ? NULL : database.data()),
                             port,
@@ -306,7 +308,8 @@ bool MySQL::reconnect(CStrRef host, int port, CStrRef socket, CStrRef username,
       ServerStats::Log("sql.reconn_new", 1);
     }
     IOStatusHelper io("mysql::connect", host.data(), port);
-    return mysql_real_connect(m_conn, host.data(), username.data(),
+    string address = DnsCache::Rewrite(host.data());
+    return mysql_real_connect(m_conn, address.c_str(), username.data(),
                               password.data(),
                               (database.empty() ? NULL : database.data()),
                               port, socket.data(), client_flags);
@@ -331,7 +334,8 @@ bool MySQL::reconnect(CStrRef host, int port, CStrRef socket, CStrRef username,
   }
   IOStatusHelper io("mysql::connect", host.data(), port);
   m_xaction_count = 0;
-  return mysql_real_connect(m_conn, host.data(), username.data(),
+  string address = DnsCache::Rewrite(host.data());
+  return mysql_real_connect(m_conn, address.c_str(), username.data(),
                             password.data(),
                             (database.empty() ? NULL : database.data()),
                             port, socket.data(), client_flags);
@@ -875,8 +879,9 @@ static Variant php_mysql_do_query_general(CStrRef query, CVarRef link_id,
           MYSQL *new_conn = create_new_conn();
           IOStatusHelper io("mysql::kill", rconn->m_host.c_str(),
                             rconn->m_port);
+          string address = DnsCache::Rewrite(rconn->m_host);
           MYSQL *connected = mysql_real_connect
-            (new_conn, rconn->m_host.c_str(), rconn->m_username.c_str(),
+            (new_conn, address.c_str(), rconn->m_username.c_str(),
              rconn->m_password.c_str(), NULL, rconn->m_port, NULL, 0);
           if (connected) {
             string killsql = "KILL " + boost::lexical_cast<string>(tid);
@@ -19,6 +19,7 @@
 #include <runtime/ext/ext_apc.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/server/server_stats.h>
+#include <runtime/base/util/dns_cache.h>
 #include <util/lock.h>
 #include <runtime/base/file/file.h>
 #include <netinet/in.h>
@@ -102,48 +103,25 @@ Variant f_gethostbyaddr(CStrRef ip_address) {
 
 String f_gethostbyname(CStrRef hostname) {
   IOStatusHelper io("gethostbyname", hostname.data());
-  if (RuntimeOption::EnableDnsCache) {
-    Variant success;
-    Variant resolved = f_apc_fetch(hostname, ref(success),
-                                   SHARED_STORE_DNS_CACHE);
-    if (same(success, true)) {
-      if (same(resolved, false)) {
-        return hostname;
-      }
-      return resolved.toString();
-    }
-  }
-
-  Util::HostEnt result;
-  if (!Util::safe_gethostbyname(hostname.data(), result)) {
-    if (RuntimeOption::EnableDnsCache) {
-      f_apc_store(hostname, false, RuntimeOption::DnsCacheTTL,
-                  SHARED_STORE_DNS_CACHE);
-    }
+  string ip = DnsCache::ResolveToIP(string(hostname.data(), hostname.size()));
+  if (ip.empty()) {
     return hostname;
   }
-
-  struct in_addr in;
-  memcpy(&in.s_addr, *(result.hostbuf.h_addr_list), sizeof(in.s_addr));
-  String ret(Util::safe_inet_ntoa(in));
-  if (RuntimeOption::EnableDnsCache) {
-    f_apc_store(hostname, ret, RuntimeOption::DnsCacheTTL,
-                SHARED_STORE_DNS_CACHE);
-  }
-  return ret;
+  return String(ip);
 }
 
 Variant f_gethostbynamel(CStrRef hostname) {
   IOStatusHelper io("gethostbynamel", hostname.data());
-  Util::HostEnt result;
-  if (!Util::safe_gethostbyname(hostname.data(), result)) {
+  vector<in_addr> addrs;
+  int herr;
+  if (!DnsCache::Resolve(string(hostname.data(), hostname.size()), addrs,
+                         herr)) {
     return false;
   }
 
   Array ret;
-  for (int i = 0 ; result.hostbuf.h_addr_list[i] != 0 ; i++) {
-    struct in_addr in = *(struct in_addr *)result.hostbuf.h_addr_list[i];
-    ret.append(String(Util::safe_inet_ntoa(in)));
+  for (unsigned int i = 0; i < addrs.size(); i++) {
+    ret.append(String(Util::safe_inet_ntoa(addrs[i])));
   }
   return ret;
 }
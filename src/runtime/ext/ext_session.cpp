@@ -26,7 +26,9 @@
 #include <runtime/base/ini_setting.h>
 #include <runtime/base/time/datetime.h>
 #include <runtime/base/variable_unserializer.h>
+#include <runtime/base/shared/shared_store.h>
 #include <util/lock.h>
+#include <util/synchronizable.h>
 #include <util/compatibility.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -738,6 +740,170 @@ public:
 };
 static UserSessionModule s_user_session_module;
 
+///////////////////////////////////////////////////////////////////////////////
+// SharedSessionModule
+
+/**
+ * Session ids that requests are using, so that two requests of the same
+ * session take turns, just like flock() makes them with session files.
+ * Requests of different sessions only share the mutex of a slot, which is
+ * never held while waiting.
+ */
+class SessionLocks {
+public:
+  void lock(const std::string &id) {
+    Slot &slot = getSlot(id);
+    Lock lock(&slot);
+    while (slot.ids.find(id) != slot.ids.end()) {
+      slot.wait();
+    }
+    slot.ids.insert(id);
+  }
+
+  void unlock(const std::string &id) {
+    Slot &slot = getSlot(id);
+    Lock lock(&slot);
+    slot.ids.erase(id);
+    slot.notifyAll();
+  }
+
+private:
+  static const int SlotCount = 64;
+
+  class Slot : public Synchronizable {
+  public:
+    std::set<std::string> ids;
+  };
+  Slot m_slots[SlotCount];
+
+  Slot &getSlot(const std::string &id) {
+    return m_slots[hash_string(id.data(), id.size()) & (SlotCount - 1)];
+  }
+};
+static SessionLocks s_session_locks;
+
+class SharedSessionData : public RequestEventHandler {
+public:
+  SharedSessionData() : m_locked(false), m_written(0) {}
+
+  virtual void requestInit() {
+    reset();
+  }
+  virtual void requestShutdown() {
+    unlock();
+  }
+
+  void lock(const char *key) {
+    if (m_locked && m_key == key) return;
+    unlock();
+    s_session_locks.lock(key);
+    m_key = key;
+    m_locked = true;
+  }
+  void unlock() {
+    if (m_locked) {
+      s_session_locks.unlock(m_key);
+    }
+    reset();
+  }
+  void reset() {
+    m_locked = false;
+    m_key.clear();
+    m_data.reset();
+    m_written = 0;
+  }
+
+  bool m_locked;
+  std::string m_key;
+  String m_data;   // what was last read or written
+  int64 m_written; // when it was written
+};
+IMPLEMENT_STATIC_REQUEST_LOCAL(SharedSessionData, s_shared_session);
+
+/**
+ * Sessions kept in their own SharedStore, for all threads of the server to
+ * share without any file I/O. Entries expire by themselves after
+ * session.gc_maxlifetime, so gc() has nothing to do. A request that leaves
+ * its session as it found it does not store it again, unless that was more
+ * than half a lifetime ago and its expiration has to be pushed back.
+ *
+ * An entry is the time it was written, as 8 raw bytes, and the session
+ * data.
+ */
+class SharedSessionModule : public SessionModule {
+public:
+  SharedSessionModule() : SessionModule("shm") {}
+
+  virtual bool open(const char *save_path, const char *session_name) {
+    return true;
+  }
+
+  virtual bool close() {
+    s_shared_session->unlock();
+    return true;
+  }
+
+  virtual bool read(const char *key, String &value) {
+    SharedSessionData *data = s_shared_session.get();
+    data->lock(key);
+    data->m_data.reset();
+    data->m_written = 0;
+
+    Variant entry;
+    if (s_apc_store.session().get(String(key, CopyString), entry) &&
+        entry.isString()) {
+      String s = entry.toString();
+      if (s.size() >= (int)sizeof(int64)) {
+        memcpy(&data->m_written, s.data(), sizeof(int64));
+        data->m_data = s.substr(sizeof(int64));
+      }
+    }
+    value = data->m_data.isNull() ? String("") : data->m_data;
+    return true;
+  }
+
+  virtual bool write(const char *key, CStrRef value) {
+    SharedSessionData *data = s_shared_session.get();
+    data->lock(key);
+
+    int64 lifetime = PS(gc_maxlifetime);
+    int64 now = time(NULL);
+    if (!data->m_data.isNull() && data->m_data.size() == value.size() &&
+        memcmp(data->m_data.data(), value.data(), value.size()) == 0 &&
+        (lifetime <= 0 || now - data->m_written < lifetime / 2)) {
+      return true;
+    }
+
+    StringBuffer entry(sizeof(int64) + value.size());
+    entry.append((const char *)&now, sizeof(int64));
+    entry.append(value);
+    if (!s_apc_store.session().store(String(key, CopyString),
+                                     entry.detach(),
+                                     lifetime > 0 ? lifetime : 0)) {
+      return false;
+    }
+    data->m_data = value;
+    data->m_written = now;
+    return true;
+  }
+
+  virtual bool destroy(const char *key) {
+    s_apc_store.session().erase(String(key, CopyString));
+    SharedSessionData *data = s_shared_session.get();
+    if (data->m_key == key) {
+      data->m_data.reset();
+      data->m_written = 0;
+    }
+    return true;
+  }
+
+  virtual bool gc(int maxlifetime, int *nrdels) {
+    *nrdels = 0;
+    return true;
+  }
+};
+static SharedSessionModule s_shared_session_module;
+
 ///////////////////////////////////////////////////////////////////////////////
 // session serializers
 
@@ -808,12 +974,11 @@ public:
       String key(p + 1, namelen, CopyString);
       p += namelen + 1;
       if (has_value) {
-        istringstream in(std::string(p, endptr - p));
-        VariableUnserializer vu(in);
+        VariableUnserializer vu(p, endptr - p);
         try {
           g->gv__SESSION.set(key, vu.unserialize());
-          if (in.tellg() > 0 && in.tellg() < endptr - p) {
-            p += in.tellg();
+          if (vu.position() > 0 && vu.position() < endptr - p) {
+            p += vu.position();
           }
         } catch (Exception &e) {
         }
@@ -871,12 +1036,11 @@ public:
       String key(p, q - p, CopyString);
       q++;
       if (has_value) {
-        istringstream in(std::string(q, endptr - q));
-        VariableUnserializer vu(in);
+        VariableUnserializer vu(q, endptr - q);
         try {
           g->gv__SESSION.set(key, vu.unserialize());
-          if (in.tellg() > 0 && in.tellg() < endptr - q) {
-            q += in.tellg();
+          if (vu.position() > 0 && vu.position() < endptr - q) {
+            q += vu.position();
           }
         } catch (Exception &e) {
         }
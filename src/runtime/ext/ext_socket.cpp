@@ -19,6 +19,7 @@
 #include <runtime/base/file/socket.h>
 #include <runtime/base/file/ssl_socket.h>
 #include <runtime/base/server/server_stats.h>
+#include <runtime/base/util/dns_cache.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -134,19 +135,14 @@ static bool php_set_inet_addr(struct sockaddr_in *sin, const char *address,
   if (inet_aton(address, &tmp)) {
     sin->sin_addr.s_addr = tmp.s_addr;
   } else {
-    Util::HostEnt result;
-    if (!Util::safe_gethostbyname(address, result)) {
+    vector<in_addr> addrs;
+    int herr;
+    if (!DnsCache::Resolve(address, addrs, herr)) {
       /* Note: < -10000 indicates a host lookup error */
-      SOCKET_ERROR(sock, "Host lookup failed", (-10000 - result.herr));
+      SOCKET_ERROR(sock, "Host lookup failed", (-10000 - herr));
       return false;
     }
-    if (result.hostbuf.h_addrtype != AF_INET) {
-      raise_warning("Host lookup failed: Non AF_INET domain "
-                      "returned on AF_INET socket");
-      return false;
-    }
-    memcpy(&(sin->sin_addr.s_addr), result.hostbuf.h_addr_list[0],
-           result.hostbuf.h_length);
+    sin->sin_addr = addrs[0];
   }
 
   return true;
@@ -17,6 +17,9 @@
 
 #include <runtime/ext/ext_thrift.h>
 #include <runtime/ext/ext_class.h>
+#include <runtime/eval/runtime/eval_state.h>
+#include <util/lock.h>
+#include <util/util.h>
 
 #include <sys/types.h>
 #include <netinet/in.h>
@@ -281,9 +284,15 @@ protected:
 
 };
 
-void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport, CArrRef spec);
-void binary_serialize_spec(CObjRef zthis, PHPOutputTransport& transport, CArrRef spec);
-void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport, CVarRef value, CArrRef fieldspec);
+struct ThriftFieldSpec;
+struct ThriftStructSpec;
+
+void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport,
+                             const ThriftStructSpec &spec);
+void binary_serialize_spec(CObjRef zthis, PHPOutputTransport& transport,
+                           const ThriftStructSpec &spec);
+void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
+                      CVarRef value, const ThriftFieldSpec &fieldspec);
 void skip_element(long thrift_typeID, PHPInputTransport& transport);
 
 // Create a PHP object given a typename and call the ctor, optionally passing up to 2 arguments
@@ -308,36 +317,227 @@ void throw_tprotocolexception(CStrRef what, long errorcode) {
   throw ex;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// $_TSPEC arrays compiled into field tables
+
+/**
+ * What a $_TSPEC entry says about one field, or what a container's spec says
+ * about its keys, values or elements. Names are static strings, so they
+ * carry their hashes into o_get() and o_set(). The spec of a nested struct
+ * is looked up the first time one is encoded or decoded, then kept if it
+ * lasts for the process.
+ */
+struct ThriftFieldSpec {
+  ThriftFieldSpec()
+    : fieldno(0), type(T_STOP), ktype(T_STOP), vtype(T_STOP), etype(T_STOP),
+      key(NULL), val(NULL), elem(NULL), structSpec(NULL) {}
+  ~ThriftFieldSpec() {
+    delete key;
+    delete val;
+    delete elem;
+  }
+
+  int16_t fieldno;
+  int8_t type;
+  String name;      // 'var'
+  String className; // 'class'
+  int8_t ktype;
+  int8_t vtype;
+  int8_t etype;
+  ThriftFieldSpec *key;
+  ThriftFieldSpec *val;
+  ThriftFieldSpec *elem;
+  mutable const ThriftStructSpec *structSpec;
+};
+
+/**
+ * The fields of a Thrift struct in $_TSPEC order, compiled once per process
+ * the first time its class is written or read. Generated Thrift classes
+ * never change their $_TSPEC, so later messages only walk this table.
+ * Classes defined by eval'd code may be different in the next request, so
+ * theirs are compiled once per request instead.
+ */
+struct ThriftStructSpec {
+  static const int MaxIndexedField = 256;
+
+  ThriftStructSpec(bool persistent = true) : persistent(persistent) {}
+  ~ThriftStructSpec() {
+    for (unsigned int i = 0; i < fields.size(); i++) {
+      delete fields[i];
+    }
+  }
+
+  const ThriftFieldSpec *find(int16_t fieldno) const {
+    if (fieldno >= 0 && fieldno < (int)byNumber.size()) {
+      return byNumber[fieldno];
+    }
+    for (unsigned int i = 0; i < fields.size(); i++) {
+      if (fields[i]->fieldno == fieldno) return fields[i];
+    }
+    return NULL;
+  }
+
+  std::vector<ThriftFieldSpec*> fields;
+  std::vector<const ThriftFieldSpec*> byNumber; // below MaxIndexedField
+  bool persistent; // false when it only lasts for this request
+};
+
+// for containers without a spec, and structs without a $_TSPEC
+static const ThriftFieldSpec s_no_field_spec;
+static const ThriftStructSpec s_no_struct_spec;
+
+typedef hphp_string_map<const ThriftStructSpec*> ThriftStructSpecMap;
+static ReadWriteMutex s_struct_specs_mutex;
+static ThriftStructSpecMap s_struct_specs; // by lower-cased class name
+
+class ThriftRequestData : public RequestEventHandler {
+public:
+  virtual void requestInit() {}
+
+  virtual void requestShutdown() {
+    for (ThriftStructSpecMap::const_iterator iter = evalSpecs.begin();
+         iter != evalSpecs.end(); ++iter) {
+      delete iter->second;
+    }
+    evalSpecs.clear();
+  }
+
+  ThriftStructSpecMap evalSpecs; // by lower-cased class name
+};
+IMPLEMENT_STATIC_REQUEST_LOCAL(ThriftRequestData, s_thrift_data);
+
+static String static_string(CStrRef s) {
+  StringData *sd = new StringData(s.data(), s.size(), CopyString);
+  sd->setStatic();
+  return sd;
+}
+
+static ThriftFieldSpec *compile_field_spec(CArrRef spec, bool persistent) {
+  ThriftFieldSpec *field = new ThriftFieldSpec();
+  field->type = spec.rvalAt(s_type, -1).toByte();
+  Variant val;
+  if (!(val = spec.rvalAt(s_var, -1)).isNull()) {
+    field->name = persistent ? static_string(val.toString()) : val.toString();
+  }
+  if (!(val = spec.rvalAt(s_class, -1)).isNull()) {
+    field->className =
+      persistent ? static_string(val.toString()) : val.toString();
+  }
+  field->ktype = spec.rvalAt(s_ktype, -1).toByte();
+  field->vtype = spec.rvalAt(s_vtype, -1).toByte();
+  field->etype = spec.rvalAt(s_etype, -1).toByte();
+  if (!(val = spec.rvalAt(s_key, -1)).isNull()) {
+    field->key = compile_field_spec(val.toArray(), persistent);
+  }
+  if (!(val = spec.rvalAt(s_val, -1)).isNull()) {
+    field->val = compile_field_spec(val.toArray(), persistent);
+  }
+  if (!(val = spec.rvalAt(s_elem, -1)).isNull()) {
+    field->elem = compile_field_spec(val.toArray(), persistent);
+  }
+  return field;
+}
+
+static inline const ThriftFieldSpec &sub_spec(const ThriftFieldSpec *spec) {
+  return spec ? *spec : s_no_field_spec;
+}
+
+/**
+ * Compiled $_TSPEC of a class, or NULL when the class does not have one, at
+ * least not yet: generated constructors only set it up in the first one.
+ */
+static const ThriftStructSpec *get_struct_spec(CStrRef className) {
+  std::string name = Util::toLower(className.data());
+  bool persistent = !Eval::RequestEvalState::findClass(className.data());
+  if (persistent) {
+    ReadLock lock(s_struct_specs_mutex);
+    ThriftStructSpecMap::const_iterator iter = s_struct_specs.find(name);
+    if (iter != s_struct_specs.end()) {
+      return iter->second;
+    }
+  } else {
+    ThriftStructSpecMap &specs = s_thrift_data->evalSpecs;
+    ThriftStructSpecMap::const_iterator iter = specs.find(name);
+    if (iter != specs.end()) {
+      return iter->second;
+    }
+  }
+
+  Variant spec = get_static_property(className.data(), "_TSPEC");
+  if (!spec.is(KindOfArray)) {
+    return NULL;
+  }
+  Array fields = spec.toArray();
+  for (ArrayIter iter(fields); iter; ++iter) {
+    if (!iter.first().isInteger()) {
+      throw_tprotocolexception("Bad keytype in TSPEC (expected 'long')",
+                               INVALID_DATA);
+    }
+  }
+
+  ThriftStructSpec *compiled = new ThriftStructSpec(persistent);
+  for (ArrayIter iter(fields); iter; ++iter) {
+    ThriftFieldSpec *field =
+      compile_field_spec(iter.second().toArray(), persistent);
+    field->fieldno = iter.first().toInt64();
+    compiled->fields.push_back(field);
+    if (field->fieldno >= 0 &&
+        field->fieldno < ThriftStructSpec::MaxIndexedField) {
+      if (field->fieldno >= (int)compiled->byNumber.size()) {
+        compiled->byNumber.resize(field->fieldno + 1, NULL);
+      }
+      compiled->byNumber[field->fieldno] = field;
+    }
+  }
+  if (!persistent) {
+    s_thrift_data->evalSpecs[name] = compiled;
+    return compiled;
+  }
+
+  WriteLock lock(s_struct_specs_mutex);
+  std::pair<ThriftStructSpecMap::iterator, bool> ret =
+    s_struct_specs.insert(ThriftStructSpecMap::value_type(name, compiled));
+  if (!ret.second) {
+    delete compiled; // another thread got there first
+  }
+  return ret.first->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
-                           CArrRef fieldspec) {
+                           const ThriftFieldSpec &fieldspec) {
   Variant ret;
   switch (thrift_typeID) {
     case T_STOP:
     case T_VOID:
       return null;
     case T_STRUCT: {
-      Variant val;
-      if ((val = fieldspec.rvalAt(s_class)).isNull()) {
+      if (fieldspec.className.isNull()) {
         throw_tprotocolexception("no class type in spec", INVALID_DATA);
         skip_element(T_STRUCT, transport);
         return null;
       }
-      String structType = val.toString();
+      CStrRef structType = fieldspec.className;
       ret = createObject(structType);
       if (ret.isNull()) {
         // unable to create class entry
         skip_element(T_STRUCT, transport);
         return null;
       }
-      Variant spec = get_static_property(structType, "_TSPEC");
-      if (!spec.is(KindOfArray)) {
-        char errbuf[128];
-        snprintf(errbuf, 128, "spec for %s is wrong type: %d\n",
-                 structType.data(), ret.getType());
-        throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
-        return null;
+      const ThriftStructSpec *spec = fieldspec.structSpec;
+      if (!spec) {
+        spec = get_struct_spec(structType);
+        if (!spec) {
+          char errbuf[128];
+          snprintf(errbuf, 128, "spec for %s is wrong type: %d\n",
+                   structType.data(), ret.getType());
+          throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+          return null;
+        }
+        if (spec->persistent) fieldspec.structSpec = spec;
       }
-      binary_deserialize_spec(ret, transport, spec.toArray());
+      binary_deserialize_spec(ret, transport, *spec);
       return ret;
     } break;
     case T_BOOL: {
@@ -395,8 +595,8 @@ Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
       transport.readBytes(types, 2);
       uint32_t size = transport.readU32();
 
-      Array keyspec = fieldspec.rvalAt(s_key, -1).toArray();
-      Array valspec = fieldspec.rvalAt(s_val, -1).toArray();
+      const ThriftFieldSpec &keyspec = sub_spec(fieldspec.key);
+      const ThriftFieldSpec &valspec = sub_spec(fieldspec.val);
       ret = Array::Create();
 
       for (uint32_t s = 0; s < size; ++s) {
@@ -409,8 +609,7 @@ Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
     case T_LIST: { // array with autogenerated numeric keys
       int8_t type = transport.readI8();
       uint32_t size = transport.readU32();
-      Variant elemvar = fieldspec.rvalAt(s_elem, -1);
-      Array elemspec = elemvar.toArray();
+      const ThriftFieldSpec &elemspec = sub_spec(fieldspec.elem);
       ret = Array::Create();
 
       for (uint32_t s = 0; s < size; ++s) {
@@ -425,8 +624,7 @@ Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
       transport.readBytes(&type, 1);
       transport.readBytes(&size, 4);
       size = ntohl(size);
-      Variant elemvar = fieldspec.rvalAt(s_elem, -1);
-      Array elemspec = elemvar.toArray();
+      const ThriftFieldSpec &elemspec = sub_spec(fieldspec.elem);
       ret = Array::Create();
 
       for (uint32_t s = 0; s < size; ++s) {
@@ -517,7 +715,7 @@ void binary_serialize_hashtable_key(int8_t keytype, PHPOutputTransport& transpor
   } else {
     key = key.toString();
   }
-  binary_serialize(keytype, transport, key, Array());
+  binary_serialize(keytype, transport, key, s_no_field_spec);
 }
 
 inline bool ttype_is_int(int8_t t) {
@@ -531,30 +729,17 @@ inline bool ttypes_are_compatible(int8_t t1, int8_t t2) {
 }
 
 void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport,
-                             CArrRef spec) {
+                             const ThriftStructSpec &spec) {
   // SET and LIST have 'elem' => array('type', [optional] 'class')
   // MAP has 'val' => array('type', [optiona] 'class')
   while (true) {
-    Variant val;
-
     int8_t ttype = transport.readI8();
     if (ttype == T_STOP) return;
     int16_t fieldno = transport.readI16();
-    if (!(val = spec.rvalAt(fieldno)).isNull()) {
-      Array fieldspec = val.toArray();
-      // pull the field name
-      // zend hash tables use the null at the end in the length... so strlen(hash key) + 1.
-      String varname = fieldspec.rvalAt(s_var).toString();
-
-      // and the type
-      int8_t expected_ttype = fieldspec.rvalAt(s_type).toInt64();
-
-      if (ttypes_are_compatible(ttype, expected_ttype)) {
-        Variant rv = binary_deserialize(ttype, transport, fieldspec);
-        zthis->set(varname, rv);
-      } else {
-        skip_element(ttype, transport);
-      }
+    const ThriftFieldSpec *fieldspec = spec.find(fieldno);
+    if (fieldspec && ttypes_are_compatible(ttype, fieldspec->type)) {
+      Variant rv = binary_deserialize(ttype, transport, *fieldspec);
+      zthis->set(fieldspec->name, rv);
     } else {
       skip_element(ttype, transport);
     }
@@ -562,7 +747,7 @@ void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport,
 }
 
 void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
-                      CVarRef value, CArrRef fieldspec) {
+                      CVarRef value, const ThriftFieldSpec &fieldspec) {
   // At this point the typeID (and field num, if applicable) should've already
   // been written to the output so all we need to do is write the payload.
   switch (thrift_typeID) {
@@ -574,10 +759,16 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
         throw_tprotocolexception("Attempt to send non-object "
                                  "type as a T_STRUCT", INVALID_DATA);
       }
-      binary_serialize_spec(value, transport,
-                            get_static_property(toObject(value)->
-                                                o_getClassName(),
-                                                "_TSPEC").toArray());
+      CStrRef structType = toObject(value)->o_getClassName();
+      // a subclass of the declared class has a spec of its own
+      bool declared = !fieldspec.className.isNull() &&
+        strcasecmp(structType.data(), fieldspec.className.data()) == 0;
+      const ThriftStructSpec *spec = declared ? fieldspec.structSpec : NULL;
+      if (!spec) {
+        spec = get_struct_spec(structType);
+        if (declared && spec && spec->persistent) fieldspec.structSpec = spec;
+      }
+      binary_serialize_spec(value, transport, spec ? *spec : s_no_struct_spec);
     } return;
     case T_BOOL:
       transport.writeI8(value.toBoolean() ? 1 : 0);
@@ -612,12 +803,12 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
     } return;
     case T_MAP: {
       Array ht = value.toArray();
-      uint8_t keytype = fieldspec.rvalAt(s_ktype, -1).toByte();
+      uint8_t keytype = fieldspec.ktype;
       transport.writeI8(keytype);
-      uint8_t valtype = fieldspec.rvalAt(s_vtype, -1).toByte();
+      uint8_t valtype = fieldspec.vtype;
       transport.writeI8(valtype);
 
-      Array valspec = fieldspec.rvalAt(s_val, -1).toArray();
+      const ThriftFieldSpec &valspec = sub_spec(fieldspec.val);
 
       transport.writeI32(ht.size());
       for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
@@ -627,11 +818,10 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
     } return;
     case T_LIST: {
       Array ht = value.toArray();
-      Variant val;
 
-      uint8_t valtype = fieldspec.rvalAt(s_etype, -1).toInt64();
+      uint8_t valtype = fieldspec.etype;
       transport.writeI8(valtype);
-      Array valspec = fieldspec.rvalAt(s_elem, -1).toArray();
+      const ThriftFieldSpec &valspec = sub_spec(fieldspec.elem);
       transport.writeI32(ht.size());
       for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
         binary_serialize(valtype, transport, key_ptr.second(), valspec);
@@ -640,7 +830,7 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
     case T_SET: {
       Array ht = value.toArray();
 
-      uint8_t keytype = fieldspec.rvalAt(s_etype, -1).toByte();
+      uint8_t keytype = fieldspec.etype;
       transport.writeI8(keytype);
 
       transport.writeI32(ht.size());
@@ -656,27 +846,14 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
 
 
 void binary_serialize_spec(CObjRef zthis, PHPOutputTransport& transport,
-                           CArrRef spec) {
-  for (ArrayIter key_ptr = spec.begin(); !key_ptr.end(); ++key_ptr) {
-    Variant key = key_ptr.first();
-    if (!key.isInteger()) {
-      throw_tprotocolexception("Bad keytype in TSPEC (expected 'long')", INVALID_DATA);
-      return;
-    }
-    unsigned long fieldno = key.toInt64();
-    Array fieldspec = key_ptr.second().toArray();
-
-    // field name
-    String varname = fieldspec.rvalAt(s_var, -1).toString();
-
-    // thrift type
-    int8_t ttype = fieldspec.rvalAt(s_type, -1).toByte();
-
-    Variant prop = zthis->o_get(varname);
+                           const ThriftStructSpec &spec) {
+  for (unsigned int i = 0; i < spec.fields.size(); i++) {
+    const ThriftFieldSpec &fieldspec = *spec.fields[i];
+    Variant prop = zthis->o_get(fieldspec.name);
     if (!prop.isNull()) {
-      transport.writeI8(ttype);
-      transport.writeI16(fieldno);
-      binary_serialize(ttype, transport, prop, fieldspec);
+      transport.writeI8(fieldspec.type);
+      transport.writeI16(fieldspec.fieldno);
+      binary_serialize(fieldspec.type, transport, prop, fieldspec);
     }
   }
   transport.writeI8(T_STOP); // struct end
@@ -699,9 +876,10 @@ void f_thrift_protocol_write_binary(CObjRef transportobj, CStrRef method_name,
     transport.writeI32(seqid);
   }
 
-  Variant spec = get_static_property(request_struct->o_getClassName(),
-                                     "_TSPEC");
-  binary_serialize_spec(request_struct, transport, spec.toArray());
+  const ThriftStructSpec *spec =
+    get_struct_spec(request_struct->o_getClassName());
+  binary_serialize_spec(request_struct, transport,
+                        spec ? *spec : s_no_struct_spec);
 }
 
 Variant f_thrift_protocol_read_binary(CObjRef transportobj,
@@ -734,14 +912,14 @@ Variant f_thrift_protocol_read_binary(CObjRef transportobj,
 
   if (messageType == T_EXCEPTION) {
     Object ex = createObject("TApplicationException");
-    Variant spec = get_static_property("TApplicationException", "_TSPEC");
-    binary_deserialize_spec(ex, transport, spec.toArray());
+    const ThriftStructSpec *spec = get_struct_spec("TApplicationException");
+    binary_deserialize_spec(ex, transport, spec ? *spec : s_no_struct_spec);
     throw ex;
   }
 
   Object ret_val = createObject(obj_typename);
-  Variant spec = get_static_property(obj_typename, "_TSPEC");
-  binary_deserialize_spec(ret_val, transport, spec.toArray());
+  const ThriftStructSpec *spec = get_struct_spec(obj_typename);
+  binary_deserialize_spec(ret_val, transport, spec ? *spec : s_no_struct_spec);
   return ret_val;
 }
 
@@ -17,6 +17,7 @@
 
 #include <runtime/ext/pdo_mysql.h>
 #include <runtime/ext/ext_stream.h>
+#include <runtime/base/util/dns_cache.h>
 #include <mysql/mysql.h>
 
 #ifdef PHP_MYSQL_UNIX_SOCK_ADDR
@@ -241,6 +242,7 @@ PDOMySqlConnection::~PDOMySqlConnection() {
 bool PDOMySqlConnection::create(CArrRef options) {
   int i, ret = 0;
   char *host = NULL, *unix_socket = NULL;
+  std::string address;
   unsigned int port = 3306;
   char *dbname;
   struct pdo_data_src_parser vars[] = {
@@ -358,8 +360,13 @@ bool PDOMySqlConnection::create(CArrRef options) {
     unix_socket = vars[4].optval;
   }
 
+  if (host) {
+    address = DnsCache::Rewrite(host);
+  }
+
   /* TODO: - Check zval cache + ZTS */
-  if (mysql_real_connect(m_server, host, username.c_str(), password.c_str(),
+  if (mysql_real_connect(m_server, host ? address.c_str() : NULL,
+                         username.c_str(), password.c_str(),
                          dbname, port, unix_socket, connect_opts) == NULL) {
     handleError(__FILE__, __LINE__);
     goto cleanup;
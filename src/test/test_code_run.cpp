@@ -22,6 +22,7 @@
 #include <util/util.h>
 #include <util/process.h>
 #include <compiler/option.h>
+#include <compiler/analysis/profile_data.h>
 #include <runtime/base/fiber_async_func.h>
 #include <runtime/base/runtime_option.h>
 
@@ -490,6 +491,7 @@ bool TestCodeRun::RunTests(const std::string &which) {
   RUN_TEST(TestFiber);
   RUN_TEST(TestAPC);
   RUN_TEST(TestInlining);
+  RUN_TEST(TestProfileData);
 
   // PHP 5.3 features
   RUN_TEST(TestVariableClassName);
@@ -2660,6 +2662,43 @@ bool TestCodeRun::TestArrayForEach() {
        "int(0)\n"
        );
 
+  // arrays whose values all have one type
+  MVCR("<?php function f() {\n"
+       "  $a = array(1, 2, 3);\n"
+       "  $s = array();\n"
+       "  foreach ($a as $v) $s[] = 'v' . $v;\n"
+       "  $t = 0;\n"
+       "  foreach ($a as $v) $t += $v;\n"
+       "  var_dump($t);\n"
+       "  foreach ($s as $v) var_dump($v);\n"
+       "  $b = $a;\n"
+       "  $b[] = 'x';\n"
+       "  foreach ($b as $v) var_dump($v);\n"
+       "  $c = array(1.5);\n"
+       "  $c[] = true;\n"
+       "  foreach ($c as $v) var_dump($v);\n"
+       "  $d = array('a' => 1);\n"
+       "  $d['b'] = null;\n"
+       "  foreach ($d as $v) var_dump($v);\n"
+       "  foreach (sys_getloadavg() as $v) var_dump(is_float($v));\n"
+       "}\n"
+       "f();\n");
+
+  // arrays that never leave the function
+  MVCR("<?php function g($p) {\n"
+       "  $a = array('x' => 1, 'y' => 2);\n"
+       "  foreach ($a as $k => $v) {\n"
+       "    foreach ($a as $w) echo \"$k$v$w\\n\";\n"
+       "  }\n"
+       "  foreach ($a as $v) { $a[] = $v; }\n"
+       "  var_dump(count($a));\n"
+       "  foreach ($p as $v) echo $v;\n"
+       "  foreach (array_keys($p) as $k) echo $k;\n"
+       "  foreach (array(3, 4) as $v) echo $v;\n"
+       "  echo \"\\n\";\n"
+       "}\n"
+       "g(array(5, 6));\n");
+
   return true;
 }
 
@@ -10418,7 +10457,63 @@ bool TestCodeRun::TestThrift() {
       "  var_dump(md5($p->getTransport()->buff));"
       "  var_dump(thrift_protocol_read_binary($p, 'TestStruct', true));"
       "}"
-      "test();");
+      "test();"
+      "class InnerStruct {"
+      "  static $_TSPEC;"
+      "  public $name = null;"
+      "  public $ids = null;"
+      "  public function __construct() {"
+      "    if (!isset(self::$_TSPEC)) {"
+      "      self::$_TSPEC = array("
+      "        1 => array('var' => 'name', 'type' => TType::STRING),"
+      "        2 => array('var' => 'ids', 'type' => TType::LST,"
+      "                   'etype' => TType::I64,"
+      "                   'elem' => array('type' => TType::I64)));"
+      "    }"
+      "  }"
+      "}"
+      "class OuterStruct {"
+      "  static $_TSPEC;"
+      "  public $inner = null;"
+      "  public $inners = null;"
+      "  public $byName = null;"
+      "  public function __construct() {"
+      "    if (!isset(self::$_TSPEC)) {"
+      "      self::$_TSPEC = array("
+      "        1 => array('var' => 'inner', 'type' => TType::STRUCT,"
+      "                   'class' => 'InnerStruct'),"
+      "        2 => array('var' => 'inners', 'type' => TType::LST,"
+      "                   'etype' => TType::STRUCT,"
+      "                   'elem' => array('type' => TType::STRUCT,"
+      "                                   'class' => 'InnerStruct')),"
+      "        3 => array('var' => 'byName', 'type' => TType::MAP,"
+      "                   'ktype' => TType::STRING,"
+      "                   'vtype' => TType::STRUCT,"
+      "                   'key' => array('type' => TType::STRING),"
+      "                   'val' => array('type' => TType::STRUCT,"
+      "                                  'class' => 'InnerStruct')));"
+      "    }"
+      "  }"
+      "}"
+      "function inner($name) {"
+      "  $v = new InnerStruct();"
+      "  $v->name = $name;"
+      "  $v->ids = array(1, 2, 8589934592);"
+      "  return $v;"
+      "}"
+      "function test_nested() {"
+      "  $v = new OuterStruct();"
+      "  $v->inner = inner('a');"
+      "  $v->inners = array(inner('b'), inner('c'));"
+      "  $v->byName = array('d' => inner('d'));"
+      "  for ($i = 0; $i < 2; $i++) {"
+      "    $p = new DummyProtocol();"
+      "    thrift_protocol_write_binary($p, 'foomethod', 1, $v, 20, true);"
+      "    var_dump(md5($p->getTransport()->buff));"
+      "    var_dump(thrift_protocol_read_binary($p, 'OuterStruct', true));"
+      "  }"
+      "}"
+      "test_nested();");
   return true;
 }
 
@@ -13781,6 +13876,97 @@ bool TestCodeRun::TestInlining() {
   return true;
 }
 
+bool TestCodeRun::TestProfileData() {
+  {
+    ProfileData profile;
+    VERIFY(!profile.isLoaded());
+    VERIFY(!profile.isHot("main"));
+    VERIFY(!profile.isHotCall("main", "foo"));
+
+    profile.loadFromString("main;Foo;bar 60\n"
+                           "main;Foo 30\n"
+                           "main;baz;baz;baz 9\n"
+                           "main;qux 1\n"
+                           "garbage\n"
+                           "main;foo -5\n");
+    VS(profile.getTotal(), 100);
+    VS(profile.getInclusive("main"), 100);
+    VS(profile.getInclusive("FOO"), 90);
+    VS(profile.getSelf("foo"), 30);
+    VS(profile.getSelf("bar"), 60);
+    VS(profile.getCalls("main", "foo"), 90);
+    VS(profile.getCalls("foo", "bar"), 60);
+    VS(profile.getCalls("bar", "foo"), 0);
+
+    // recursion counts once per sample, but every edge is a call
+    VS(profile.getInclusive("baz"), 9);
+    VS(profile.getCalls("baz", "baz"), 18);
+
+    // a second dump adds up
+    profile.loadFromString("main;qux 100\n");
+    VS(profile.getTotal(), 200);
+    VS(profile.getInclusive("qux"), 101);
+
+    double savePercent = Option::HotFunctionPercent;
+    Option::HotFunctionPercent = 10.0;
+    VERIFY(profile.isHot("foo"));
+    VERIFY(profile.isHot("qux"));
+    VERIFY(!profile.isHot("baz"));
+    VERIFY(!profile.isHot("unsampled"));
+    VERIFY(profile.isHotCall("main", "foo"));
+    VERIFY(!profile.isHotCall("main", "baz"));
+    VERIFY(!profile.isHotCall("main", "unsampled"));
+
+    // configured sections win, and names are kept as they were sampled
+    std::map<std::string, std::string> saveSections = Option::FunctionSections;
+    std::string saveSection = Option::HotFunctionSection;
+    Option::HotFunctionSection = "hot";
+    Option::FunctionSections.clear();
+    Option::FunctionSections["qux"] = "mine";
+    int placed = profile.assignFunctionSections();
+    std::map<std::string, std::string> sections = Option::FunctionSections;
+    Option::FunctionSections = saveSections;
+    Option::HotFunctionSection = saveSection;
+    Option::HotFunctionPercent = savePercent;
+
+    VS(placed, 3);
+    VS(sections["qux"], "mine");
+    VS(sections["main"], "hot");
+    VS(sections["Foo"], "hot");
+    VS(sections["bar"], "hot");
+    VERIFY(sections.find("baz") == sections.end());
+  }
+
+  // callers the profile never sampled still inline, and hot calls inline
+  // more, without changing what the code does
+  bool save = Option::AutoInline;
+  ProfileData saveProfile = ProfileData::TheProfileData;
+  Option::AutoInline = true;
+  ProfileData::TheProfileData = ProfileData();
+  ProfileData::TheProfileData.loadFromString("test;big 100\n");
+
+  MVCR("<?php "
+       "function small($x) { return $x + 1; }"
+       "function big($x) {"
+       "  $a = $x + 1; $b = $a * 2; $c = $b - 3; $d = $c * $c;"
+       "  $e = $d + $a; $f = $e - $b; $g = $f * 2; $h = $g + $c;"
+       "  $i = $h - 1; $j = $i + $d; $k = $j * 3;"
+       "  return $k;"
+       "}"
+       "function test($x) {"
+       "  return big($x);"
+       "}"
+       "function cold($x) {"
+       "  return small($x);"
+       "}"
+       "var_dump(test(2));"
+       "var_dump(cold(2));");
+
+  ProfileData::TheProfileData = saveProfile;
+  Option::AutoInline = save;
+  return true;
+}
+
 bool TestCodeRun::TestVariableClassName() {
   MVCRO(
     "<?php\n"
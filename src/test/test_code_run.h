@@ -170,6 +170,7 @@ class TestCodeRun : public TestBase {
   bool TestFiber();
   bool TestAPC();
   bool TestInlining();
+  bool TestProfileData();
   bool TestRenameFunction();
   bool TestIntercept();
 
@@ -18,14 +18,24 @@
 #include <runtime/base/base_includes.h>
 #include <util/logger.h>
 #include <runtime/base/memory/memory_manager.h>
+#include <runtime/base/memory/smart_block_pool.h>
+#include <runtime/base/util/chunked_buffer.h>
 #include <runtime/base/builtin_functions.h>
 #include <runtime/ext/ext_variable.h>
 #include <runtime/ext/ext_apc.h>
 #include <runtime/ext/ext_mysql.h>
 #include <runtime/ext/ext_curl.h>
 #include <runtime/base/shared/shared_store.h>
+#include <runtime/base/shared/packed_shared_variant.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/server/ip_block_map.h>
+#include <runtime/base/frame_injection.h>
+#include <runtime/base/sampling_profiler.h>
+#include <runtime/base/allocation_profiler.h>
+#include <runtime/base/string_intern_table.h>
+#include <runtime/base/array/shaped_array.h>
+#include <runtime/base/array/zend_array.h>
+#include <runtime/eval/runtime/code_coverage.h>
 #include <test/test_mysql_info.inc>
 
 using namespace std;
@@ -42,12 +52,21 @@ bool TestCppBase::RunTests(const std::string &which) {
   RUN_TEST(TestSmartAllocator);
   RUN_TEST(TestString);
   RUN_TEST(TestArray);
+  RUN_TEST(TestShapedArray);
   RUN_TEST(TestObject);
   RUN_TEST(TestVariant);
 #ifndef DEBUGGING_SMART_ALLOCATOR
   RUN_TEST(TestMemoryManager);
 #endif
+  RUN_TEST(TestSmartBlockPool);
+  RUN_TEST(TestChunkedBuffer);
   RUN_TEST(TestIpBlockMap);
+  RUN_TEST(TestSamplingProfiler);
+  RUN_TEST(TestAllocationProfiler);
+  RUN_TEST(TestStringIntern);
+  RUN_TEST(TestApcHandoff);
+  RUN_TEST(TestPackedSharedVariant);
+  RUN_TEST(TestCodeCoverage);
   return ret;
 }
 
@@ -623,6 +642,105 @@ bool TestCppBase::TestArray() {
     VERIFY(!arr->isVectorData());
   }
 
+  {
+    // string keys on both sides of the inline limit, through rehashing,
+    // copying and iteration
+    Array arr(NEW(ZendArray)());
+    String k11("abcdefghijk");
+    String k12("abcdefghijkl");
+    arr.set("", 0);
+    arr.set(k11, 11);
+    arr.set(k12, 12);
+    for (int i = 0; i < 100; i++) {
+      arr.set(String("k") + String((int64)i), i);
+    }
+    arr.set(7, "seven");
+    VS(arr.size(), 104);
+    VS(arr[""], 0);
+    VS(arr["abcdefghijk"], 11);
+    VS(arr[String("abcdefghij") + String("kl")], 12);
+    VS(arr["k99"], 99);
+    VS(arr[7], "seven");
+    VERIFY(!arr.exists("abcdefghij"));
+    VERIFY(!arr.exists("abcdefghijx"));
+
+    Array copy = arr;
+    copy.set("k0", "zero");
+    copy.remove(k11);
+    VS(arr["k0"], 0);
+    VS(copy["k0"], "zero");
+    VERIFY(arr.exists(k11));
+    VERIFY(!copy.exists(k11));
+
+    // keys handed out by iteration stay the same strings the second time
+    ArrayIter iter(arr);
+    Variant first = iter.first();
+    VS(first, "");
+    iter.next();
+    VS(iter.first(), "abcdefghijk");
+    iter.next();
+    VS(iter.first(), "abcdefghijkl");
+    ArrayIter again(arr);
+    VERIFY(again.first().getStringData() == first.getStringData());
+    VS(arr["abcdefghijk"], 11);
+
+    // and static arrays have no key left to turn into a string
+    Array literal(NEW(ZendArray)());
+    literal.set("id", 1);
+    literal.set(k12, 2);
+    literal->setStatic();
+    literal->onSetStatic();
+    ArrayIter static_iter(literal);
+    VERIFY(static_iter.first().getStringData()->isStatic());
+    VS(literal["id"], 1);
+  }
+
+  return Count(true);
+}
+
+bool TestCppBase::TestShapedArray() {
+  static StaticString s_id("id");
+  static StaticString s_name("name");
+  static StaticString s_extra("extra");
+
+  Array arr(ArrayInit(2, false, false, true).
+            set(0, s_id, 1, -1, true).
+            set(1, s_name, "x", -1, true).create());
+  ShapedArray *shaped = dynamic_cast<ShapedArray*>(arr.get());
+  VERIFY(shaped);
+  VS(arr.size(), 2);
+  VS(arr[s_id], 1);
+  VS(arr["name"], "x");
+  VERIFY(!arr.exists(0));
+  VERIFY(arr.exists(String("na") + String("me")));
+  VS(arr, CREATE_MAP2("id", 1, "name", "x"));
+
+  // the same keys in the same order share one shape
+  Array other(ArrayInit(2, false, false, true).
+              set(0, s_id, 2, -1, true).
+              set(1, s_name, "y", -1, true).create());
+  VERIFY(dynamic_cast<ShapedArray*>(other.get())->getShape() ==
+         shaped->getShape());
+
+  // copy-on-write, and adding a literal key, keep the array shaped
+  Array copy = arr;
+  copy.set(s_name, "z", -1, true);
+  copy.set(s_extra, 3, -1, true);
+  VERIFY(dynamic_cast<ShapedArray*>(copy.get()));
+  VS(arr, CREATE_MAP2("id", 1, "name", "x"));
+  VS(copy, CREATE_MAP3("id", 1, "name", "z", "extra", 3));
+
+  // and anything a shape cannot describe escalates
+  copy.append(4);
+  VERIFY(!dynamic_cast<ShapedArray*>(copy.get()));
+  VS(copy, CREATE_MAP4("id", 1, "name", "z", "extra", 3, 0, 4));
+  arr.remove(s_id);
+  VERIFY(!dynamic_cast<ShapedArray*>(arr.get()));
+  VS(arr, CREATE_MAP1("name", "x"));
+  other.set(String("un") + String("seen"), 5);
+  VERIFY(!dynamic_cast<ShapedArray*>(other.get()));
+  VS(other, CREATE_MAP3("id", 2, "name", "y", "unseen", 5));
+
   return Count(true);
 }
 
@@ -950,6 +1068,79 @@ bool TestCppBase::TestMemoryManager() {
   return Count(true);
 }
 
+bool TestCppBase::TestSmartBlockPool() {
+  // a size no allocator uses, so nobody else takes the block in between
+  const size_t size = 12345;
+  void *block = SmartBlockPool::Acquire(size);
+  VERIFY(block != NULL);
+  memset(block, 1, size);
+  SmartBlockPool::Release(block, size);
+  VERIFY(SmartBlockPool::Acquire(size) == block);
+
+  // an idle block is still handed out after giving its pages back
+  SmartBlockPool::Release(block, size);
+  SmartBlockPool::Trim(0);
+  void *reused = SmartBlockPool::Acquire(size);
+  VERIFY(reused == block);
+  memset(reused, 2, size);
+  free(reused);
+  return Count(true);
+}
+
+bool TestCppBase::TestChunkedBuffer() {
+  const int cap = ChunkedBuffer::ChunkCapacity;
+  string big(cap * 2 + 10, 'x');
+  big[0] = 'a';
+  big[cap] = 'b';
+  big[cap * 2 + 9] = 'c';
+
+  ChunkedBuffer buf;
+  VERIFY(buf.empty());
+  VS(buf.copy(), "");
+  buf.append("hello ", 6);
+  buf.append(String("world"));
+  VS(buf.size(), 11);
+  VS(buf.copy(), "hello world");
+
+  // appends spill over into new chunks
+  ChunkedBuffer large;
+  large.append(big.data(), big.size());
+  VS(large.size(), (int)big.size());
+  VS(large.head()->size, cap);
+  VS(large.head()->next->size, cap);
+  VS(large.head()->next->next->size, 10);
+  VERIFY(large.head()->next->next->next == NULL);
+  VERIFY(large.copy() == String(big));
+
+  // a small buffer is copied into the last chunk
+  ChunkedBuffer small;
+  small.append("!", 1);
+  buf.absorb(small);
+  VERIFY(small.empty());
+  VERIFY(small.head() == NULL);
+  VS(buf.copy(), "hello world!");
+  VERIFY(buf.head()->next == NULL);
+
+  // and a large one has its chunks moved over
+  const ChunkedBuffer::Chunk *moved = large.head();
+  buf.absorb(large);
+  VERIFY(large.empty());
+  VERIFY(buf.head()->next == moved);
+  VS(buf.size(), 12 + (int)big.size());
+  VERIFY(buf.detach() == String("hello world!") + String(big));
+  VERIFY(buf.empty());
+  VERIFY(buf.head() == NULL);
+
+  // absorbing into an empty buffer takes the chunks as they are
+  ChunkedBuffer empty, other;
+  other.append("xyz", 3);
+  empty.absorb(other);
+  VS(empty.copy(), "xyz");
+  empty.absorb(other);
+  VS(empty.copy(), "xyz");
+  return Count(true);
+}
+
 bool TestCppBase::TestIpBlockMap() {
   unsigned int start, end;
 
@@ -983,3 +1174,237 @@ bool TestCppBase::TestIpBlockMap() {
 
   return Count(true);
 }
+
+bool TestCppBase::TestSamplingProfiler() {
+  ThreadInfo *info = ThreadInfo::s_threadInfo.get();
+  SamplingProfiler::Start();
+  SamplingProfiler::Clear();
+  {
+    FrameInjection main(info, empty_string, "run_init::my file.php");
+    FrameInjection foo(info, empty_string, "foo");
+    SamplingProfiler::RecordStack(info->m_top);
+    SamplingProfiler::RecordStack(info->m_top);
+    {
+      FrameInjection bar(info, empty_string, "C::bar");
+      SamplingProfiler::RecordStack(info->m_top);
+      SamplingProfiler::RecordStack(info->m_top);
+      SamplingProfiler::RecordStack(info->m_top);
+    }
+  }
+  SamplingProfiler::Stop();
+
+  string out;
+  VS(SamplingProfiler::Dump(out), 2);
+  VS(out,
+     "run_init::my_file.php;foo;C::bar 3\n"
+     "run_init::my_file.php;foo 2\n");
+  VS(SamplingProfiler::GetDroppedCount(), 0);
+
+  SamplingProfiler::Clear();
+  out.clear();
+  VS(SamplingProfiler::Dump(out), 0);
+  return Count(true);
+}
+
+bool TestCppBase::TestAllocationProfiler() {
+  ThreadInfo *info = ThreadInfo::s_threadInfo.get();
+  AllocationProfiler::Start();
+  AllocationProfiler::Clear();
+  {
+    FrameInjection main(info, empty_string, "run_init::my file.php");
+    FrameInjection foo(info, empty_string, "foo");
+    AllocationProfiler::RecordStack(info->m_top, 100);
+    AllocationProfiler::RecordStack(info->m_top, 100);
+    {
+      FrameInjection bar(info, empty_string, "C::bar");
+      AllocationProfiler::RecordStack(info->m_top, 300);
+    }
+  }
+
+  string out;
+  VS(AllocationProfiler::Dump(out), 2);
+  VS(out,
+     "[none];run_init::my_file.php;foo;C::bar 300\n"
+     "[none];run_init::my_file.php;foo 200\n");
+  VS(AllocationProfiler::GetDroppedCount(), 0);
+
+  // sampling every byte charges exactly what was allocated
+  AllocationProfiler::Clear();
+  int64 interval = RuntimeOption::AllocationProfilerInterval;
+  RuntimeOption::AllocationProfilerInterval = 1;
+  MemoryUsageStats &stats = MemoryManager::TheMemoryManager()->getStats();
+  AllocationProfiler::StartCountdown(stats);
+  {
+    FrameInjection main(info, empty_string, "alloc");
+    StringData *sd = NEW(StringData)();
+    DELETE(StringData)(sd);
+  }
+  AllocationProfiler::Stop();
+  AllocationProfiler::StartCountdown(stats);
+  RuntimeOption::AllocationProfilerInterval = interval;
+
+  out.clear();
+  VS(AllocationProfiler::Dump(out), 1);
+  char expected[64];
+  snprintf(expected, sizeof(expected), "[none];alloc %d\n",
+           (int)sizeof(StringData));
+  VS(out, expected);
+
+  // sampling leaves the C library's random sequence, which rand() uses,
+  // alone
+  AllocationProfiler::Start();
+  RuntimeOption::AllocationProfilerInterval = 16;
+  AllocationProfiler::StartCountdown(stats);
+  srandom(42);
+  long expected1 = random();
+  srandom(42);
+  for (int i = 0; i < 100; i++) {
+    StringData *sd = NEW(StringData)();
+    DELETE(StringData)(sd);
+  }
+  VS((int64)random(), (int64)expected1);
+  AllocationProfiler::Stop();
+  AllocationProfiler::StartCountdown(stats);
+  RuntimeOption::AllocationProfilerInterval = interval;
+
+  AllocationProfiler::Clear();
+  out.clear();
+  VS(AllocationProfiler::Dump(out), 0);
+  return Count(true);
+}
+
+bool TestCppBase::TestStringIntern() {
+  const char *key = "intern_test_key";
+  int len = strlen(key);
+  int64 hash = hash_string(key, len);
+
+  VERIFY(StringInternTable::Find(key, len, hash) == NULL);
+  StringData *sd = StringInternTable::Intern(key, len, hash);
+  VERIFY(sd != NULL);
+  VERIFY(sd->isStatic());
+  VS(String(sd), key);
+  VERIFY(StringInternTable::Find(key, len, hash) == sd);
+
+  String copy(key, len, CopyString);
+  VERIFY(StringInternTable::Intern(copy.get()) == sd);
+
+  // only added the second time
+  const char *other = "intern_test_other";
+  len = strlen(other);
+  hash = hash_string(other, len);
+  VERIFY(StringInternTable::InternRepeated(other, len, hash) == NULL);
+  sd = StringInternTable::InternRepeated(other, len, hash);
+  VERIFY(sd != NULL);
+  VERIFY(StringInternTable::Find(other, len, hash) == sd);
+
+  string longKey(RuntimeOption::StringInternMaxLength + 1, 'x');
+  VERIFY(StringInternTable::Intern(longKey.data(), longKey.size(),
+                                   hash_string(longKey.data(),
+                                               longKey.size())) == NULL);
+  return Count(true);
+}
+
+bool TestCppBase::TestApcHandoff() {
+  f_apc_store("handoff_key", CREATE_VECTOR2("value", "s"));
+  f_apc_store("handoff_other", "apple");
+  f_apc_store("skipped_key", 1);
+
+  int fds[2];
+  VERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  vector<string> prefixes;
+  prefixes.push_back("handoff_");
+  VERIFY(apc_dump_handoff(fds[0], prefixes, 1 << 20) > 0);
+  close(fds[0]);
+
+  // what is already there is kept
+  f_apc_delete("handoff_key");
+  f_apc_delete("skipped_key");
+  f_apc_store("handoff_other", "orange");
+  VS(apc_load_handoff(fds[1]), 1);
+  close(fds[1]);
+
+  VS(f_apc_fetch("handoff_key"), CREATE_VECTOR2("value", "s"));
+  VS(f_apc_fetch("handoff_other"), "orange");
+  VERIFY(!f_apc_fetch("skipped_key"));
+
+  f_apc_delete("handoff_key");
+  f_apc_delete("handoff_other");
+  return Count(true);
+}
+
+bool TestCppBase::TestPackedSharedVariant() {
+  SharedMemoryArena *arena =
+    SharedMemoryArena::OpenOrCreate("TestPackedSharedVariant", 8192);
+  ProcessSharedVariantLock *lock = SharedMemoryManager::GetSegment()->
+    find_or_construct<ProcessSharedVariantLock>("TestPackedSharedLock")();
+
+  PackedSharedVariant *s = PackedSharedVariant::Create("hello", lock, arena);
+  VS(String(s->stringData(), s->stringLength(), CopyString), "hello");
+  VS(s->toLocal(), "hello");
+  s->decRef();
+  VS(arena->getLiveBytes(), 0);
+
+  Array value = CREATE_MAP4("a", 1, "b", 2.5, 3, "three",
+                            "nested", CREATE_VECTOR3("x",
+                                                     CREATE_MAP1("y", true),
+                                                     null));
+  PackedSharedVariant *v = PackedSharedVariant::Create(value, lock, arena);
+  VS(v->toLocal(), value);
+  VS((int64)v->arrSize(), 4);
+  VS(v->getIndex("b"), 1);
+  VS(v->getIndex(3), 2);
+  VERIFY(v->exists("nested"));
+  VERIFY(!v->exists("c"));
+  VERIFY(!v->exists(4));
+
+  // children hand their references to the root
+  PackedSharedVariant *nested = (PackedSharedVariant*)v->get("nested");
+  VS(nested->toLocal(), value["nested"]);
+  nested->incRef();
+  VS(v->getRefCount(), 2);
+  nested->decRef();
+  VS(v->getRefCount(), 1);
+
+  // leave the value alone in a retired chunk, then move it out of there
+  vector<void*> fillers;
+  while (arena->getChunkCount() < 2) {
+    fillers.push_back(arena->allocate(200));
+  }
+  for (unsigned int i = 0; i < fillers.size(); i++) {
+    arena->deallocate(fillers[i]);
+  }
+  int64 live = arena->getLiveBytes();
+  VERIFY(arena->getSparseBytes() > 0);
+  PackedSharedVariant *moved = v->relocate(arena);
+  VERIFY(moved != NULL && moved != v);
+  VS(arena->getLiveBytes(), live);
+  VS(arena->getChunkCount(), 1);
+  VS(moved->toLocal(), value);
+  VS(((PackedSharedVariant*)moved->get("nested"))->toLocal(),
+     value["nested"]);
+  VERIFY(moved->relocate(arena) == NULL); // current chunk is never sparse
+
+  moved->decRef();
+  VS(arena->getLiveBytes(), 0);
+  return Count(true);
+}
+
+bool TestCppBase::TestCodeCoverage() {
+  // only files with executed lines are reported
+  Eval::CodeCoverage::Register("coverage_registered.php", 10);
+  Eval::CodeCoverage::Record("coverage_test.php", 2, 3);
+  Eval::CodeCoverage::Record("coverage_test.php", 3, 3);
+  // spans two chunks of counters
+  Eval::CodeCoverage::Record("coverage_test.php", 1023, 1025);
+
+  Array report = Eval::CodeCoverage::Report();
+  VERIFY(!report.exists("coverage_registered.php"));
+  Array lines = report["coverage_test.php"];
+  VS(lines.size(), 5);
+  VS(lines[2], 1);
+  VS(lines[3], 2);
+  VS(lines[1023], 1);
+  VS(lines[1025], 1);
+  VERIFY(!lines.exists(1));
+  return Count(true);
+}
@@ -40,7 +40,15 @@ class TestCppBase : public TestBase {
   // building blocks
   bool TestSmartAllocator();
   bool TestMemoryManager();
+  bool TestSmartBlockPool();
+  bool TestChunkedBuffer();
   bool TestIpBlockMap();
+  bool TestSamplingProfiler();
+  bool TestAllocationProfiler();
+  bool TestStringIntern();
+  bool TestApcHandoff();
+  bool TestPackedSharedVariant();
+  bool TestCodeCoverage();
 
   /**
    * Date types. This in turn tests StringData, ArrayData, StringOffset,
@@ -56,6 +64,7 @@ class TestCppBase : public TestBase {
    */
   bool TestString();
   bool TestArray();
+  bool TestShapedArray();
   bool TestObject();
   bool TestVariant();
   bool TestListAssignment();
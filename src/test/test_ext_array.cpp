@@ -1592,6 +1592,24 @@ bool TestExtArray::test_sort() {
      "    [2] => lemon\n"
      "    [3] => orange\n"
      ")\n");
+
+  // enough integers for a radix sort
+  Variant numbers = Array::Create();
+  for (int i = 0; i < 3000; i++) {
+    numbers.append((int64)((i * 7919) % 3001 - 1500) * 1000000007LL);
+  }
+  f_sort(ref(numbers));
+  VS(f_count(numbers), 3000);
+  for (int i = 1; i < 3000; i++) {
+    VERIFY(numbers[i - 1].toInt64() < numbers[i].toInt64());
+  }
+
+  Variant strings = CREATE_VECTOR4("10", "9", "2", "-1.5");
+  f_sort(ref(strings));
+  VS(strings, CREATE_VECTOR4("-1.5", "2", "9", "10"));
+  strings = CREATE_VECTOR4("10", "9", "2", "-1.5");
+  f_sort(ref(strings), k_SORT_STRING);
+  VS(strings, CREATE_VECTOR4("-1.5", "10", "2", "9"));
   return Count(true);
 }
 
@@ -499,7 +499,19 @@ bool TestExtDatetime::test_strtotime() {
   String str = "Not Good";
   Variant timestamp = f_strtotime(str);
   VERIFY(same(timestamp, false));
+  VERIFY(same(f_strtotime(str), false));
   VERIFY(same(f_strtotime(""), false));
+
+  // the same string again, relative to another time or in another timezone
+  VS(f_strtotime("+1 day", 968569200), 968655600);
+  VS(f_strtotime("+1 day", 968655600), 968742000);
+  VS(f_strtotime("1970-01-01 00:00:00 UTC"), 0);
+  VS(f_strtotime("1969-12-31 23:59:59 UTC"), -1);
+  String tz = f_date_default_timezone_get();
+  VS(f_strtotime("10 September 2000"), 968569200);
+  f_date_default_timezone_set("UTC");
+  VS(f_strtotime("10 September 2000"), 968544000);
+  f_date_default_timezone_set(tz);
   return Count(true);
 }
 
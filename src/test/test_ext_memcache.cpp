@@ -16,6 +16,7 @@
 
 #include <test/test_ext_memcache.h>
 #include <runtime/ext/ext_memcache.h>
+#include <runtime/ext/ext_options.h>
 
 IMPLEMENT_SEP_EXTENSION_TEST(Memcache);
 ///////////////////////////////////////////////////////////////////////////////
@@ -62,6 +63,28 @@ bool TestExtMemcache::test_memcache_add() {
 }
 
 bool TestExtMemcache::test_memcache_set() {
+  // queued writes are read back without a server
+  f_ini_set("memcache.pipeline", "1");
+  Object mc = f_memcache_connect("localhost", 11211);
+  VERIFY(f_memcache_set(mc, "k1", "v1"));
+  VERIFY(f_memcache_set(mc, "k2", CREATE_VECTOR2(1, 2)));
+  VERIFY(f_memcache_set(mc, "k1", "v2"));
+  VERIFY(f_memcache_delete(mc, "k3"));
+  VS(f_memcache_get(mc, "k1"), "v2");
+  VS(f_memcache_get(mc, "k2"), CREATE_VECTOR2(1, 2));
+  VS(f_memcache_get(mc, "k3"), false);
+  VS(f_memcache_get(mc, CREATE_VECTOR2("k1", "k3")),
+     CREATE_MAP1("k1", "v2"));
+
+  // what would fail anyway fails before it is queued
+  VERIFY(!f_memcache_set(mc, String(string(251, 'k')), "v"));
+  VERIFY(!f_memcache_delete(mc, String(string(251, 'k'))));
+  VERIFY(f_memcache_set(mc, String(string(250, 'k')), "v"));
+  Object none(NEW(c_memcache)());
+  VERIFY(!f_memcache_set(none, "k1", "v1"));
+  VERIFY(!f_memcache_delete(none, "k1"));
+  VS(f_memcache_get(none, "k1"), false);
+  f_ini_set("memcache.pipeline", "0");
   return Count(true);
 }
 
@@ -19,6 +19,7 @@
 #include <runtime/ext/ext_file.h>
 #include <runtime/ext/ext_string.h>
 #include <runtime/base/util/string_buffer.h>
+#include <runtime/base/runtime_option.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -69,11 +70,27 @@ bool TestExtNetwork::test_gethostbyaddr() {
 
 bool TestExtNetwork::test_gethostbyname() {
   VS(f_gethostbyname("localhost"), "127.0.0.1");
+
+  bool saved = RuntimeOption::EnableDnsCache;
+  RuntimeOption::EnableDnsCache = true;
+  for (int i = 0; i < 2; i++) { // a miss, then a hit
+    VS(f_gethostbyname("localhost"), "127.0.0.1");
+    VS(f_gethostbyname("no.such.host.invalid"), "no.such.host.invalid");
+  }
+  RuntimeOption::EnableDnsCache = saved;
   return Count(true);
 }
 
 bool TestExtNetwork::test_gethostbynamel() {
   VS(f_gethostbynamel("localhost"), CREATE_VECTOR1("127.0.0.1"));
+
+  bool saved = RuntimeOption::EnableDnsCache;
+  RuntimeOption::EnableDnsCache = true;
+  for (int i = 0; i < 2; i++) {
+    VS(f_gethostbynamel("localhost"), CREATE_VECTOR1("127.0.0.1"));
+    VS(f_gethostbynamel("no.such.host.invalid"), false);
+  }
+  RuntimeOption::EnableDnsCache = saved;
   return Count(true);
 }
 
@@ -16,6 +16,11 @@
 
 #include <test/test_ext_session.h>
 #include <runtime/ext/ext_session.h>
+#include <runtime/ext/ext_apc.h>
+#include <runtime/base/shared/shared_store.h>
+#include <runtime/base/program_functions.h>
+#include <system/gen/sys/system_globals.h>
+#include <util/async_func.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -42,6 +47,10 @@ bool TestExtSession::RunTests(const std::string &which) {
   RUN_TEST(test_session_register);
   RUN_TEST(test_session_unregister);
   RUN_TEST(test_session_is_registered);
+  RUN_TEST(test_shm_session_read_write);
+  RUN_TEST(test_shm_session_skip_write);
+  RUN_TEST(test_shm_session_lock);
+  RUN_TEST(test_shm_session_apc);
 
   return ret;
 }
@@ -71,6 +80,8 @@ bool TestExtSession::test_session_name() {
 }
 
 bool TestExtSession::test_session_module_name() {
+  VERIFY(!same(f_session_module_name("shm"), false));
+  VERIFY(!same(f_session_module_name("files"), false));
   return Count(true);
 }
 
@@ -154,3 +165,148 @@ bool TestExtSession::test_session_is_registered() {
   }
   return Count(false);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// "shm" save handler
+
+static Variant &session_vars() {
+  return ((SystemGlobals*)get_global_variables())->gv__SESSION;
+}
+
+static void shm_session_start(const char *id) {
+  f_session_module_name("shm");
+  f_session_id(id);
+  f_session_start();
+}
+
+// the time an entry was written, and the session data after it
+static bool shm_session_entry(const char *id, int64 &written, String &data) {
+  Variant entry;
+  if (!s_apc_store.session().get(id, entry) || !entry.isString()) {
+    return false;
+  }
+  String s = entry.toString();
+  if (s.size() < (int)sizeof(int64)) return false;
+  memcpy(&written, s.data(), sizeof(int64));
+  data = s.substr(sizeof(int64));
+  return true;
+}
+
+static void shm_session_put(const char *id, int64 written, CStrRef data) {
+  String entry = String((const char *)&written, sizeof(int64), CopyString) +
+    data;
+  s_apc_store.session().store(id, entry, 0);
+}
+
+bool TestExtSession::test_shm_session_read_write() {
+  shm_session_start("shm_rw");
+  session_vars().set("a", 1);
+  session_vars().set("b", "two");
+  f_session_write_close();
+
+  int64 written;
+  String data;
+  VERIFY(shm_session_entry("shm_rw", written, data));
+  VS(data, "a|i:1;b|s:3:\"two\";");
+  VERIFY(written <= time(NULL) && written >= time(NULL) - 1);
+
+  session_vars().reset();
+  shm_session_start("shm_rw");
+  VS(session_vars()["a"], 1);
+  VS(session_vars()["b"], "two");
+  f_session_destroy();
+  VERIFY(!shm_session_entry("shm_rw", written, data));
+  return Count(true);
+}
+
+bool TestExtSession::test_shm_session_skip_write() {
+  int64 now = time(NULL);
+
+  // unchanged and recently written: left alone
+  shm_session_put("shm_skip", now - 10, "a|i:1;");
+  shm_session_start("shm_skip");
+  VS(session_vars()["a"], 1);
+  f_session_write_close();
+  int64 written;
+  String data;
+  VERIFY(shm_session_entry("shm_skip", written, data));
+  VS(written, now - 10);
+
+  // unchanged but more than half a lifetime old: stored again
+  shm_session_put("shm_skip", now - 1000, "a|i:1;");
+  shm_session_start("shm_skip");
+  f_session_write_close();
+  VERIFY(shm_session_entry("shm_skip", written, data));
+  VERIFY(written >= now);
+  VS(data, "a|i:1;");
+
+  // changed: stored
+  shm_session_put("shm_skip", now - 10, "a|i:1;");
+  shm_session_start("shm_skip");
+  session_vars().set("a", 2);
+  f_session_write_close();
+  VERIFY(shm_session_entry("shm_skip", written, data));
+  VERIFY(written >= now);
+  VS(data, "a|i:2;");
+
+  shm_session_start("shm_skip");
+  f_session_destroy();
+  return Count(true);
+}
+
+void TestExtSession::lockedSessionRequest() {
+  hphp_session_init();
+  shm_session_start("shm_lock");
+  m_started = true;
+  m_seen = session_vars()["n"];
+  f_session_write_close();
+  hphp_session_exit();
+}
+
+bool TestExtSession::test_shm_session_lock() {
+  shm_session_start("shm_lock");
+  session_vars().set("n", 1);
+
+  // a second request of the same session waits for this one to finish
+  m_started = false;
+  AsyncFunc<TestExtSession> func(this, &TestExtSession::lockedSessionRequest);
+  func.start();
+  usleep(200000);
+  VERIFY(!m_started);
+
+  f_session_write_close();
+  func.waitForEnd();
+  VERIFY(m_started);
+  VS(m_seen, 1);
+
+  shm_session_start("shm_lock");
+  f_session_destroy();
+  return Count(true);
+}
+
+bool TestExtSession::test_shm_session_apc() {
+  shm_session_start("shm_apc");
+  session_vars().set("a", 1);
+  f_session_write_close();
+
+  // no apc cache id reaches sessions, and all of them stay usable
+  for (int id = 0; id < MAX_SHARED_STORE; id++) {
+    VS(f_apc_fetch("shm_apc", null, id), false);
+    VS(f_apc_store("shm_apc", "x", 0, id), true);
+    VS(f_apc_fetch("shm_apc", null, id), "x");
+    VS(f_apc_delete("shm_apc", id), true);
+  }
+  VS(f_apc_fetch("shm_apc", null, SHARED_STORE_SESSION), false);
+  VS(f_apc_store("shm_apc", "x", 0, SHARED_STORE_SESSION), false);
+  VS(f_apc_clear_cache(SHARED_STORE_SESSION), false);
+  VS(f_apc_clear_cache(), true);
+
+  int64 written;
+  String data;
+  VERIFY(shm_session_entry("shm_apc", written, data));
+  VS(data, "a|i:1;");
+
+  shm_session_start("shm_apc");
+  f_session_destroy();
+  return Count(true);
+}
@@ -47,6 +47,15 @@ class TestExtSession : public TestCppExt {
   bool test_session_register();
   bool test_session_unregister();
   bool test_session_is_registered();
+
+  bool test_shm_session_read_write();
+  bool test_shm_session_skip_write();
+  bool test_shm_session_lock();
+  bool test_shm_session_apc();
+
+  void lockedSessionRequest();
+  volatile bool m_started;
+  Variant m_seen;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
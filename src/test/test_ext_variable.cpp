@@ -344,6 +344,31 @@ bool TestExtVariable::test_unserialize() {
     Variant v2 = f_unserialize("a:3:{s:1:\"a\";s:5:\"apple\";s:1:\"b\";i:2;s:1:\"c\";a:3:{i:0;i:1;i:1;s:1:\"y\";i:2;i:3;}}");
     VS(v1, v2);
   }
+  {
+    // repeated keys and class names are shared, values must not be
+    Variant v1 = CREATE_VECTOR3(CREATE_MAP2("id", 1, "name", "a"),
+                                CREATE_MAP2("id", 2, "name", "b"),
+                                CREATE_MAP2("id", 3.5, "name", "c"));
+    Variant v2 = f_unserialize(f_serialize(v1));
+    VS(v1, v2);
+    VS(f_serialize(v2), f_serialize(v1));
+  }
+  {
+    String s = "a:2:{i:0;s:1:\"x\";i:1;R:2;}";
+    VS(f_serialize(f_unserialize(s)), s);
+  }
+  VS(f_unserialize("a:2:{i:0;s:1:\"x\";"), false);
+  VS(f_unserialize("s:5:\"abc\";"), false);
+
+  // integers and lengths that do not fit in 64 bits are rejected
+  VS(f_unserialize("i:9223372036854775807;"), 9223372036854775807LL);
+  VS(f_unserialize("i:-9223372036854775808;"),
+     -9223372036854775807LL - 1);
+  VS(f_unserialize("i:9223372036854775808;"), false);
+  VS(f_unserialize("i:-9223372036854775809;"), false);
+  VS(f_unserialize("i:99999999999999999999;"), false);
+  VS(f_unserialize("s:18446744073709551619:\"abc\";"), false);
+  VS(f_unserialize("a:18446744073709551617:{i:0;i:1;}"), false);
   return Count(true);
 }
 
@@ -16,6 +16,17 @@
 
 #include <test/test_performance.h>
 #include <util/util.h>
+#include <util/timer.h>
+#include <util/simd_string.h>
+#include <util/async_func.h>
+#include <util/process.h>
+#include <runtime/base/memory/memory_manager.h>
+#include <runtime/base/zend/zend_string.h>
+#include <runtime/base/zend/zend_html.h>
+#include <runtime/base/zend/zend_url.h>
+#include <runtime/ext/ext_fb.h>
+#include <runtime/ext/ext_json.h>
+#include <sys/wait.h>
 
 using namespace std;
 
@@ -49,6 +60,11 @@ bool TestPerformance::RunTests(const std::string &which) {
   bool ret = true;
   RUN_TEST(TestBasicOperations);
   RUN_TEST(TestMemoryUsage);
+  RUN_TEST(TestStringKernels);
+  RUN_TEST(TestSerialization);
+  RUN_TEST(TestRPCEncoding);
+  RUN_TEST(TestArraySort);
+  RUN_TEST(TestRequestReset);
   RUN_TEST(TestAdHocFile);
   RUN_TEST(TestAdHoc);
   return ret;
@@ -147,6 +163,387 @@ bool TestPerformance::TestMemoryUsage() {
   return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// string kernels, plain loops vs. the best SIMD level this CPU has
+
+static string take_string(char *s, int len) {
+  string ret;
+  if (s) {
+    ret.assign(s, len);
+    free(s);
+  }
+  return ret;
+}
+
+static string bench_strpos(const string &s) {
+  int pos = string_find(s.data(), s.size(), "</html>", 7, 0, true);
+  return string((const char *)&pos, sizeof(pos));
+}
+
+static string bench_str_replace(const string &s) {
+  int len = s.size(), count;
+  return take_string(string_replace(s.data(), len, "fox", 3, "cat", 3,
+                                    count, true), len);
+}
+
+static string bench_str_ireplace(const string &s) {
+  int len = s.size(), count;
+  return take_string(string_replace(s.data(), len, "FOX", 3, "cat", 3,
+                                    count, false), len);
+}
+
+static string bench_strtolower(const string &s) {
+  return take_string(string_to_lower(s.data(), s.size()), s.size());
+}
+
+static string bench_addslashes(const string &s) {
+  int len = s.size();
+  return take_string(string_addslashes(s.data(), len), len);
+}
+
+static string bench_htmlspecialchars(const string &s) {
+  int len = s.size();
+  return take_string(string_html_encode(s.data(), len, true, false, true,
+                                        false), len);
+}
+
+static string bench_trim(const string &s) {
+  int len = s.size();
+  return take_string(string_trim(s.data(), len, " \t\n\r", 4, 3), len);
+}
+
+static string bench_urlencode(const string &s) {
+  int len = s.size();
+  return take_string(url_encode(s.data(), len), len);
+}
+
+typedef string (*StringBench)(const string &input);
+
+static string make_input(const char *pattern, int len, bool padded) {
+  string ret;
+  if (padded) ret.append(len / 4, ' ');
+  while ((int)ret.size() < len) ret += pattern;
+  ret.resize(len - (padded ? len / 4 : 0));
+  if (padded) ret.append(len / 4, '\n');
+  return ret;
+}
+
+static bool run_string_bench(const char *name, StringBench func,
+                             const char *pattern, bool padded = false) {
+  static const int lengths[] = {16, 64, 256, 4096};
+  SimdLevel best = simd_get_level();
+  for (unsigned int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    string input = make_input(pattern, lengths[i], padded);
+    int iterations = (64 << 20) / lengths[i];
+    string expected, actual;
+    int64 us[2];
+    for (int pass = 0; pass < 2; pass++) {
+      simd_set_level(pass ? best : SimdNone);
+      Timer timer(Timer::UserCPU);
+      for (int n = 0; n < iterations; n++) {
+        (pass ? actual : expected) = func(input);
+      }
+      us[pass] = timer.getMicroSeconds();
+    }
+    simd_set_level(best);
+    if (actual != expected) {
+      printf("%s: output differs for %d bytes\n", name, lengths[i]);
+      return false;
+    }
+    printf("%-18s %5d bytes: %7lld us -> %7lld us (%.2fx)\n",
+           name, lengths[i], (long long)us[0], (long long)us[1],
+           us[1] ? (double)us[0] / us[1] : 0.0);
+  }
+  return true;
+}
+
+bool TestPerformance::TestStringKernels() {
+  static const char *text =
+    "The quick brown fox jumps over the lazy dog's back, <b>twice</b> & "
+    "then \"runs\" away.\n";
+  static const char *query =
+    "name=John Smith&city=San Francisco&path=/home/user/file.php&q=hphp ";
+
+  bool ret = true;
+  ret = run_string_bench("strpos", bench_strpos, text) && ret;
+  ret = run_string_bench("str_replace", bench_str_replace, text) && ret;
+  ret = run_string_bench("str_ireplace", bench_str_ireplace, text) && ret;
+  ret = run_string_bench("strtolower", bench_strtolower, text) && ret;
+  ret = run_string_bench("addslashes", bench_addslashes, text) && ret;
+  ret = run_string_bench("htmlspecialchars", bench_htmlspecialchars, text) &&
+    ret;
+  ret = run_string_bench("trim", bench_trim, text, true) && ret;
+  ret = run_string_bench("urlencode", bench_urlencode, query) && ret;
+  return Count(ret);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// encodings of the same values: serialize() vs. fb_serialize() on a typical
+// cached blob, and JSON vs. fb_serialize() on what an RPC server returns
+
+struct Codec {
+  const char *name;
+  String (*encode)(CVarRef value);
+  Variant (*decode)(CStrRef data);
+};
+
+static String php_encode(CVarRef value) { return f_serialize(value);}
+static Variant php_decode(CStrRef data) { return f_unserialize(data);}
+static String json_encode(CVarRef value) { return f_json_encode(value);}
+static Variant json_decode(CStrRef data) { return f_json_decode(data, true);}
+static String fb_encode(CVarRef value) { return f_fb_serialize(value);}
+static Variant fb_decode(CStrRef data) { return f_fb_unserialize(data, null);}
+
+/**
+ * Times each codec encoding and decoding value, and checks that what comes
+ * back equals it.
+ */
+static bool run_codec_bench(const Codec *codecs, int count, CVarRef value,
+                            const char *what, int size, int iterations) {
+  printf("%6d %s x %6d:", size, what, iterations);
+  for (int i = 0; i < count; i++) {
+    const Codec &codec = codecs[i];
+    String data;
+    Variant back;
+    int64 us[2];
+    {
+      Timer timer(Timer::UserCPU);
+      for (int n = 0; n < iterations; n++) data = codec.encode(value);
+      us[0] = timer.getMicroSeconds();
+    }
+    {
+      Timer timer(Timer::UserCPU);
+      for (int n = 0; n < iterations; n++) back = codec.decode(data);
+      us[1] = timer.getMicroSeconds();
+    }
+    if (!equal(back, value)) {
+      printf("\n%s: output differs for %d %s\n", codec.name, size, what);
+      return false;
+    }
+    printf("%s %s %7lld/%7lld us (%d bytes)", i ? "," : "", codec.name,
+           (long long)us[0], (long long)us[1], data.size());
+  }
+  printf("\n");
+  return true;
+}
+
+bool TestPerformance::TestSerialization() {
+  static const Codec codecs[] = {
+    {"serialize", php_encode, php_decode},
+    {"fb_serialize", fb_encode, fb_decode},
+  };
+  static const int counts[] = {10, 1000, 100000};
+  for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    Array records;
+    for (int n = 0; n < counts[i]; n++) {
+      records.append(CREATE_MAP4("id", n,
+                                 "name", String("user") + String((int64)n),
+                                 "score", n * 1.5,
+                                 "tags", CREATE_VECTOR2("a", "b")));
+    }
+    if (!run_codec_bench(codecs, 2, records, "records", counts[i],
+                         1000000 / counts[i])) {
+      return Count(false);
+    }
+  }
+  return Count(true);
+}
+
+bool TestPerformance::TestRPCEncoding() {
+  static const Codec codecs[] = {
+    {"json", json_encode, json_decode},
+    {"fb", fb_encode, fb_decode},
+  };
+  static const int counts[] = {1, 100, 10000};
+  for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    Array rows;
+    for (int n = 0; n < counts[i]; n++) {
+      rows.append(CREATE_MAP4("id", n,
+                              "title", String("story ") + String((int64)n),
+                              "body", String("lorem ipsum dolor sit amet, "
+                                             "consectetur adipiscing elit"),
+                              "ids", CREATE_VECTOR3(n, n + 1, n + 2)));
+    }
+    Array ret = CREATE_MAP2("count", counts[i], "rows", rows);
+    if (!run_codec_bench(codecs, 2, ret, "rows", counts[i],
+                         100000 / counts[i])) {
+      return Count(false);
+    }
+  }
+  return Count(true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sorting with the comparison functions vs. with keys taken out of Variants
+
+static int generic_regular_ascending(CVarRef v1, CVarRef v2,
+                                     const void *data) {
+  return Array::SortRegularAscending(v1, v2, data);
+}
+
+static int generic_numeric_ascending(CVarRef v1, CVarRef v2,
+                                     const void *data) {
+  return Array::SortNumericAscending(v1, v2, data);
+}
+
+static bool run_sort_bench(const char *name, CArrRef input,
+                           Array::PFUNC_CMP cmp, Array::PFUNC_CMP generic,
+                           bool renumber) {
+  Array expected, actual;
+  int64 us[2];
+  for (int pass = 0; pass < 2; pass++) {
+    Array sorted = input;
+    Timer timer(Timer::UserCPU);
+    sorted.sort(pass ? cmp : generic, false, renumber);
+    us[pass] = timer.getMicroSeconds();
+    (pass ? actual : expected) = sorted;
+  }
+  if (!same(actual, expected)) {
+    printf("%s: output differs for %d elements\n", name, input.size());
+    return false;
+  }
+  printf("%-14s %8d elements: %8lld us -> %8lld us (%.2fx)\n",
+         name, input.size(), (long long)us[0], (long long)us[1],
+         us[1] ? (double)us[0] / us[1] : 0.0);
+  return true;
+}
+
+bool TestPerformance::TestArraySort() {
+  static const int counts[] = {1000, 10000, 100000, 1000000};
+  bool ret = true;
+  for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    srand(counts[i]);
+    Array ints, doubles, strings, numeric;
+    for (int n = 0; n < counts[i]; n++) {
+      int64 r = ((int64)rand() << 16) ^ rand();
+      ints.append(r - (1LL << 45));
+      doubles.append(r / 3.0);
+      strings.append(String("key") + String(r % counts[i]));
+      numeric.append(String(r % 100000));
+    }
+    ret = run_sort_bench("sort int", ints, Array::SortRegularAscending,
+                         generic_regular_ascending, true) && ret;
+    ret = run_sort_bench("asort int", ints, Array::SortRegularAscending,
+                         generic_regular_ascending, false) && ret;
+    ret = run_sort_bench("sort double", doubles, Array::SortRegularAscending,
+                         generic_regular_ascending, true) && ret;
+    ret = run_sort_bench("sort string", strings, Array::SortRegularAscending,
+                         generic_regular_ascending, true) && ret;
+    ret = run_sort_bench("asort string", strings, Array::SortRegularAscending,
+                         generic_regular_ascending, false) && ret;
+    ret = run_sort_bench("sort numeric", numeric, Array::SortNumericAscending,
+                         generic_numeric_ascending, true) && ret;
+  }
+  return Count(ret);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getting back to the warmed-up heap after each request: rolling memory back
+// as the threaded server does, vs. forking a fresh worker off a template as
+// the prefork server does
+
+static Array make_items(int count) {
+  Array items;
+  for (int n = 0; n < count; n++) {
+    items.append(CREATE_MAP2("id", n,
+                             "name", String("item") + String((int64)n)));
+  }
+  return items;
+}
+
+/**
+ * Runs on a thread of its own, to have a memory checkpoint of its own.
+ */
+class RequestResetBench {
+public:
+  RequestResetBench(int warm, int request, int iterations)
+    : m_warm(warm), m_request(request), m_iterations(iterations),
+      m_ok(false) {}
+
+  bool ok() const { return m_ok;}
+
+  void run() {
+    MemoryManager *mm = MemoryManager::TheMemoryManager().get();
+    if (!mm->beforeCheckpoint()) {
+      mm->enable();
+    }
+    // what WarmupDocument would have left behind
+    Array *warm = new Array(make_items(m_warm));
+    mm->checkpoint();
+
+    // both timings include building what the request itself allocates
+    int64 rollbackUs;
+    {
+      Timer timer(Timer::WallTime);
+      for (int n = 0; n < m_iterations; n++) {
+        make_items(m_request);
+        mm->sweepAll();
+        mm->rollback();
+      }
+      rollbackUs = timer.getMicroSeconds();
+    }
+
+    int64 forkUs;
+    long long sharedKB = 0, privateKB = 0;
+    {
+      Timer timer(Timer::WallTime);
+      for (int n = 0; n < m_iterations; n++) {
+        int fds[2];
+        if (pipe(fds) < 0) return;
+        pid_t pid = fork();
+        if (pid == 0) {
+          make_items(m_request);
+          long long kb[2];
+          Process::GetProcessSharing(getpid(), kb[0], kb[1]);
+          _exit(write(fds[1], kb, sizeof(kb)) == sizeof(kb) ? 0 : 1);
+        }
+        close(fds[1]);
+        long long kb[2];
+        bool ok = pid > 0 && read(fds[0], kb, sizeof(kb)) == sizeof(kb);
+        close(fds[0]);
+        if (pid > 0) waitpid(pid, NULL, 0);
+        if (!ok) return;
+        sharedKB = kb[0];
+        privateKB = kb[1];
+      }
+      forkUs = timer.getMicroSeconds();
+    }
+
+    if (warm->size() != m_warm) return;
+    delete warm;
+    printf("%7d warm, %5d per request: rollback %6lld us, fork %6lld us, "
+           "worker shares %lldKB, owns %lldKB\n", m_warm, m_request,
+           (long long)rollbackUs / m_iterations,
+           (long long)forkUs / m_iterations, sharedKB, privateKB);
+    m_ok = true;
+  }
+
+private:
+  int m_warm;
+  int m_request;
+  int m_iterations;
+  bool m_ok;
+};
+
+bool TestPerformance::TestRequestReset() {
+  static const int warms[] = {1000, 100000, 300000};
+  static const int requests[] = {100, 10000};
+  for (unsigned int i = 0; i < sizeof(warms) / sizeof(warms[0]); i++) {
+    for (unsigned int j = 0; j < sizeof(requests) / sizeof(requests[0]);
+         j++) {
+      RequestResetBench bench(warms[i], requests[j], 100);
+      AsyncFunc<RequestResetBench> func(&bench, &RequestResetBench::run);
+      func.start();
+      func.waitForEnd();
+      if (!bench.ok()) {
+        printf("request reset failed for %d warm items\n", warms[i]);
+        return Count(false);
+      }
+    }
+  }
+  return Count(true);
+}
+
 bool TestPerformance::TestAdHocFile() {
   string input;
   FILE *f = fopen("test/perf_ad_hoc.php", "r");
@@ -32,6 +32,11 @@ class TestPerformance : public TestCodeRun {
 
   bool TestBasicOperations();
   bool TestMemoryUsage();
+  bool TestStringKernels();
+  bool TestSerialization();
+  bool TestRPCEncoding();
+  bool TestArraySort();
+  bool TestRequestReset();
   bool TestAdHocFile();
   bool TestAdHoc();
 };
@@ -25,9 +25,16 @@
 #include <util/async_func.h>
 #include <runtime/ext/ext_curl.h>
 #include <runtime/ext/ext_options.h>
+#include <runtime/ext/ext_fb.h>
 #include <runtime/base/server/http_request_handler.h>
+#include <runtime/base/server/libevent_server_group.h>
+#include <runtime/base/server/prefork_server.h>
 #include <runtime/base/util/http_client.h>
 #include <runtime/base/runtime_option.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
 
 using namespace std;
 using namespace boost;
@@ -44,7 +51,8 @@ TestServer::TestServer() {
 
 static int s_server_port = 0;
 
-bool TestServer::VerifyServerResponse(const char *input, const char *output,
+bool TestServer::VerifyServerResponse(const char *input,
+                                      const std::string &output,
                                       const char *url, const char *method,
                                       const char *header, const char *postdata,
                                       bool responseHeader,
@@ -120,7 +128,7 @@ bool TestServer::VerifyServerResponse(const char *input, const char *output,
            "--------------------------------------\n"
            "%s"
            "--------------------------------------\n",
-           file, line, input, (int)strlen(output), output,
+           file, line, input, (int)output.size(), output.c_str(),
            (int)actual.length(), actual.c_str());
     return false;
   }
@@ -168,6 +176,8 @@ bool TestServer::RunTests(const std::string &which) {
 
   // This needs to be the 1st, so to find a good server port.
   RUN_TEST(TestLibeventServer);
+  RUN_TEST(TestLibeventServerGroup);
+  RUN_TEST(TestPreforkServer);
 
   RUN_TEST(TestSanity);
   RUN_TEST(TestServerVariables);
@@ -232,6 +242,17 @@ bool TestServer::TestServerVariables() {
 
         "string?a=1&b=2");
 
+  VSRX("<?php "
+       "var_dump($_SERVER['SERVER_SOFTWARE']);"
+       "var_dump($_SERVER['HTTP_X_FOO_BAR']);"
+       "var_dump($_ENV['HPHP']);",
+
+       "string(4) \"HPHP\"\n"
+       "string(3) \"baz\"\n"
+       "int(1)\n",
+
+       "string", "GET", "X-Foo-Bar: baz", NULL);
+
   return true;
 }
 
@@ -266,6 +287,9 @@ bool TestServer::TestGet() {
   VSGET("<?php print $_REQUEST['name'];",
         "value", "string?name=value");
 
+  VSGET("<?php $_GET['name'] = 'changed'; print $_REQUEST['name'];",
+        "value", "string?name=value");
+
   return true;
 }
 
@@ -420,6 +444,243 @@ bool TestServer::TestLibeventServer() {
   return Count(true);
 }
 
+typedef TypedServer<LibEventServerGroup, TestRequestHandler> TestServerGroup;
+
+/**
+ * Starts a group of two event loops on the port, true if it failed to.
+ */
+static bool group_fails_to_start(int port) {
+  int saveLoops = RuntimeOption::ServerEventLoopCount;
+  RuntimeOption::ServerEventLoopCount = 2;
+  ServerPtr server(new TestServerGroup("127.0.0.1", port, 4, -1));
+  RuntimeOption::ServerEventLoopCount = saveLoops;
+  try {
+    server->start();
+  } catch (FailedToListenException &e) {
+    return true;
+  }
+  server->stop();
+  server->waitForEnd();
+  return false;
+}
+
+bool TestServer::TestLibeventServerGroup() {
+  int saveLoops = RuntimeOption::ServerEventLoopCount;
+  RuntimeOption::ServerEventLoopCount = 2;
+  ServerPtr server(new TestServerGroup("127.0.0.1", s_server_port, 4, -1));
+  RuntimeOption::ServerEventLoopCount = saveLoops;
+  server->start();
+
+  // a second instance must not quietly share the port with the first
+  bool failed = group_fails_to_start(s_server_port);
+  server->stop();
+  server->waitForEnd();
+  VERIFY(failed);
+
+  // and neither with somebody else's SO_REUSEPORT socket
+#ifdef SO_REUSEPORT
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(s_server_port);
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+  VERIFY(bind(fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+  VERIFY(listen(fd, 16) == 0);
+  failed = group_fails_to_start(s_server_port);
+  close(fd);
+  VERIFY(failed);
+#endif
+
+  // once the port is free again, a group starts fine
+  VERIFY(!group_fails_to_start(s_server_port));
+  return Count(true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Answers with its process's id and how many requests that process has
+ * served, or dies in the middle of "crash".
+ */
+class PreforkRequestHandler : public RequestHandler {
+public:
+  // implementing RequestHandler
+  virtual void handleRequest(Transport *transport) {
+    static int served = 0;
+    if (transport->getCommand() == "crash") {
+      _exit(1);
+    }
+    transport->sendString(lexical_cast<string>(getpid()) + " " +
+                          lexical_cast<string>(++served));
+  }
+};
+
+typedef TypedServer<PreforkServer, PreforkRequestHandler> PreforkTestServer;
+
+static int connect_to(int port) {
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  timeval tv = {10, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void send_request(int fd, const char *url) {
+  string request = string("GET /") + url + " HTTP/1.1\r\n"
+    "Host: 127.0.0.1\r\n\r\n";
+  if (write(fd, request.data(), request.size()) < 0) {
+    // read_response() finds nothing
+  }
+}
+
+/**
+ * Reads one response off a connection and returns its body, "" if there is
+ * none. Also tells whether the server closes the connection after it.
+ */
+static string read_response(int fd, bool &closing) {
+  string data;
+  size_t body = string::npos;
+  int length = 0;
+  while (true) {
+    if (body == string::npos) {
+      size_t end = data.find("\r\n\r\n");
+      if (end != string::npos) {
+        string headers = Util::toLower(data.substr(0, end));
+        size_t pos = headers.find("content-length:");
+        if (pos != string::npos) {
+          length = atoi(headers.c_str() + pos + strlen("content-length:"));
+        }
+        closing = headers.find("connection: close") != string::npos;
+        body = end + 4;
+      }
+    }
+    if (body != string::npos && (int)(data.size() - body) >= length) {
+      return data.substr(body, length);
+    }
+    char buf[1024];
+    int n = read(fd, buf, sizeof(buf));
+    if (n <= 0) return "";
+    data.append(buf, n);
+  }
+}
+
+/**
+ * Sends url on a connection, and tells which worker answered it, and as
+ * how many-th request of that worker.
+ */
+static bool serve(int fd, const char *url, int &pid, int &served,
+                  bool &closing) {
+  send_request(fd, url);
+  string response = read_response(fd, closing);
+  return sscanf(response.c_str(), "%d %d", &pid, &served) == 2;
+}
+
+/**
+ * Talks to a prefork server with one worker that retires after two
+ * requests.
+ */
+static bool talk_to_prefork_server(int port) {
+  int pid1, pid2, pid3, served;
+  bool closing;
+
+  // a keep-alive connection to the only worker
+  int a = connect_to(port);
+  if (!serve(a, "first", pid1, served, closing) || served != 1 || closing) {
+    close(a);
+    return false;
+  }
+
+  // another client has to wait for that worker, which serves its last
+  // request on the first connection rather than dropping it...
+  int b = connect_to(port);
+  send_request(b, "second");
+  bool ok = serve(a, "third", pid2, served, closing) && pid2 == pid1 &&
+    served == 2 && closing;
+  close(a);
+
+  // ... and whoever was waiting gets its replacement
+  string response = read_response(b, closing);
+  close(b);
+  ok = ok && sscanf(response.c_str(), "%d %d", &pid2, &served) == 2 &&
+    pid2 != pid1 && served == 1;
+
+  // a worker dying in the middle of a request is replaced, too
+  int c = connect_to(port);
+  send_request(c, "crash");
+  ok = ok && read_response(c, closing).empty();
+  close(c);
+  int d = connect_to(port);
+  ok = ok && serve(d, "fourth", pid3, served, closing) && pid3 != pid2 &&
+    served == 1;
+  close(d);
+  return ok;
+}
+
+bool TestServer::TestPreforkServer() {
+  int saveMaxRequests = RuntimeOption::ServerPreforkMaxRequests;
+  bool saveKeepAlive = RuntimeOption::EnableKeepAlive;
+  RuntimeOption::ServerPreforkMaxRequests = 2;
+  RuntimeOption::EnableKeepAlive = true;
+
+  // a prefork server has to start before any other thread does, and a
+  // process just forked off this one has none
+  int ready[2], done[2];
+  VERIFY(pipe(ready) == 0);
+  VERIFY(pipe(done) == 0);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(ready[0]);
+    close(done[1]);
+    int active = -1;
+    try {
+      ServerPtr server(new PreforkTestServer("127.0.0.1", s_server_port, 1,
+                                             -1));
+      server->start();
+      char c = 0;
+      if (write(ready[1], &c, 1) == 1 && read(done[0], &c, 1) >= 0) {
+        // the template frees the slot of a dead worker once it reaps it
+        for (int i = 0; i < 100 && server->getActiveWorker(); i++) {
+          usleep(10000);
+        }
+        active = server->getActiveWorker();
+      }
+      server->stop();
+      server->waitForEnd();
+    } catch (Exception &e) {
+      printf("%s\n", e.getMessage().c_str());
+    }
+    _exit(active == 0 ? 0 : 1);
+  }
+  RuntimeOption::ServerPreforkMaxRequests = saveMaxRequests;
+  RuntimeOption::EnableKeepAlive = saveKeepAlive;
+  VERIFY(pid > 0);
+  close(ready[1]);
+  close(done[0]);
+
+  char c;
+  bool ok = read(ready[0], &c, 1) == 1 &&
+    talk_to_prefork_server(s_server_port);
+  close(ready[0]);
+  close(done[1]); // lets the server check its workers and stop
+  int status = -1;
+  waitpid(pid, &status, 0);
+  VERIFY(ok);
+  VERIFY(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  return Count(true);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 class EchoHandler : public RequestHandler {
@@ -565,5 +826,31 @@ bool TestServer::TestRPCServer() {
          "call_user_func?auth=test&p=\"A::f\"&p=100",
          8083);
 
+  // fb_serialize()-d return, with a Content-Type saying so
+  String fb = f_fb_serialize(CREATE_MAP4(0, 1, 1, "two", "a", 3,
+                                         "b", CREATE_VECTOR2("hello", 4)))
+    .toString();
+  VSGETP("<?php\n"
+         "function f($a) {\n"
+         "  return array(1, 'two', 'a' => 3, 'b' => array($a, 4));\n"
+         "}\n",
+         string(fb.data(), fb.size()),
+         "f?auth=test&format=fb&p=\"hello\"",
+         8083);
+  if (!Count(VerifyServerResponse("<?php\n"
+                                  "function f() { return 100; }\n",
+                                  "Content-Type: application/x-fb-serialize",
+                                  "f?auth=test&format=fb", "GET", NULL, NULL,
+                                  true, __FILE__, __LINE__, 8083))) {
+    return false;
+  }
+
+  // objects cannot be fb_serialize()-d, so they still come back in JSON
+  VSGETP("<?php\n"
+         "function f($a) { $o = new stdClass; $o->a = $a; return $o; }\n",
+         "{\"a\":\"hello\"}",
+         "f?auth=test&format=fb&p=\"hello\"",
+         8083);
+
   return true;
 }
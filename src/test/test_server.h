@@ -47,6 +47,8 @@ public:
   // test multithreaded request processing
   bool TestRequestHandling();
   bool TestLibeventServer();
+  bool TestLibeventServerGroup();
+  bool TestPreforkServer();
 
   // test HttpClient class that proxy server uses
   bool TestHttpClient();
@@ -57,7 +59,7 @@ public:
 protected:
   void RunServer();
   void StopServer();
-  bool VerifyServerResponse(const char *input, const char *output,
+  bool VerifyServerResponse(const char *input, const std::string &output,
                             const char *url, const char *method,
                             const char *header, const char *postdata,
                             bool responseHeader,
@@ -20,6 +20,10 @@
 #include <util/logger.h>
 #include <runtime/base/shared/shared_string.h>
 #include <runtime/base/zend/zend_string.h>
+#include <util/simd_string.h>
+#include <util/shared_memory_arena.h>
+#include <util/process.h>
+#include <sys/wait.h>
 
 using namespace std;
 
@@ -43,6 +47,9 @@ bool TestUtil::RunTests(const std::string &which) {
   //RUN_TEST(TestLFUTable);
   RUN_TEST(TestSharedString);
   RUN_TEST(TestCanonicalize);
+  RUN_TEST(TestSimdString);
+  RUN_TEST(TestSharedMemoryArena);
+  RUN_TEST(TestProcessSharing);
   return ret;
 }
 
@@ -260,3 +267,208 @@ bool TestUtil::TestCanonicalize() {
   VERIFY(Util::canonicalize("./../../") == "../../");
   return Count(true);
 }
+
+class SimdLevelRestorer {
+public:
+  SimdLevelRestorer() : m_level(simd_get_level()) {}
+  ~SimdLevelRestorer() { simd_set_level(m_level);}
+  SimdLevel getLevel() const { return m_level;}
+private:
+  SimdLevel m_level;
+};
+
+bool TestUtil::TestSimdString() {
+  SimdLevelRestorer restorer;
+  int best = restorer.getLevel();
+
+  // every level has to agree with the plain loops, for lengths on both sides
+  // of the 16-byte blocks and for bytes on both sides of 0x7f
+  static const char alphabet[] = "ab \t\n<>&'\"\\\0AZaz09-._\xc2\xa0\xff";
+  srand(0);
+  for (int iter = 0; iter < 2000; iter++) {
+    int len = iter % 100;
+    string s;
+    for (int i = 0; i < len; i++) {
+      s += alphabet[rand() % (sizeof(alphabet) - 1)];
+    }
+    string needle = s.substr(len ? rand() % len : 0, rand() % 4 + 1);
+    const char *p = s.data();
+
+    simd_set_level(SimdNone);
+    const char *found = simd_memmem(p, len, needle.data(), needle.size());
+    VERIFY((found ? found - p : -1) == (int)s.find(needle));
+    int any = simd_scan_any(p, len, "\0'\"\\", 4);
+    int span = simd_span(p, len, " \t\na", 4);
+    int rspan = simd_rspan(p, len, " \t\na", 4);
+    int outside = simd_scan_outside(p, len, "--..09AZ__az", 6);
+    string lower(len, ' '), upper(len, ' ');
+    simd_to_lower(&lower[0], p, len);
+    simd_to_upper(&upper[0], p, len);
+
+    for (int level = SimdSSE2; level <= best; level++) {
+      simd_set_level((SimdLevel)level);
+      VERIFY(simd_memmem(p, len, needle.data(), needle.size()) == found);
+      VERIFY(simd_scan_any(p, len, "\0'\"\\", 4) == any);
+      VERIFY(simd_span(p, len, " \t\na", 4) == span);
+      VERIFY(simd_rspan(p, len, " \t\na", 4) == rspan);
+      VERIFY(simd_scan_outside(p, len, "--..09AZ__az", 6) == outside);
+      string folded(len, ' ');
+      simd_to_lower(&folded[0], p, len);
+      VERIFY(folded == lower);
+      simd_to_upper(&folded[0], p, len);
+      VERIFY(folded == upper);
+    }
+  }
+
+  for (int level = SimdNone; level <= best; level++) {
+    simd_set_level((SimdLevel)level);
+    const char *s = "0123456789abcdef0123456789abcde\"  ";
+    VERIFY(simd_scan_any(s, 34, "\"", 1) == 31);
+    VERIFY(simd_scan_any(s, 31, "\"", 1) == 31);
+    VERIFY(simd_span(s, 34, "0123456789abcdef", 16) == 31);
+    VERIFY(simd_rspan(s, 34, " ", 1) == 2);
+    VERIFY(simd_scan_outside(s, 34, "09af", 2) == 31);
+    VERIFY(simd_memmem(s, 34, "cde\"", 4) == s + 28);
+    VERIFY(simd_memmem(s, 34, "cdef0", 5) == s + 12);
+    VERIFY(simd_memmem(s, 34, "cdef1", 5) == NULL);
+  }
+  return Count(true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// 19 blocks of 200 bytes, 208 with their header, fill a 4KB chunk
+#define ARENA_CHUNK 4096
+#define ARENA_BLOCK 200
+#define ARENA_BLOCK_TOTAL 208
+#define ARENA_PER_CHUNK 19
+
+static bool block_intact(void *p, int i) {
+  for (int j = 0; j < ARENA_BLOCK; j++) {
+    if (((unsigned char *)p)[j] != (unsigned char)i) return false;
+  }
+  return true;
+}
+
+bool TestUtil::TestSharedMemoryArena() {
+  SharedMemoryArena *arena =
+    SharedMemoryArena::OpenOrCreate("TestSharedMemoryArena", ARENA_CHUNK);
+  VS(arena->getChunkCount(), 0);
+
+  // chunks A, B, C, and D as the current one
+  vector<void*> blocks;
+  for (int i = 0; i < ARENA_PER_CHUNK * 4; i++) {
+    void *p = arena->allocate(ARENA_BLOCK);
+    memset(p, i, ARENA_BLOCK);
+    blocks.push_back(p);
+  }
+  VS(arena->getChunkCount(), 4);
+  VS(arena->getLiveBytes(), ARENA_PER_CHUNK * 4 * ARENA_BLOCK_TOTAL);
+  VS(arena->getSparseBytes(), 0);
+
+  // A and B still a third alive: not sparse, so nothing to do, however much
+  // was freed
+  for (int c = 0; c < 2; c++) {
+    for (int i = 6; i < ARENA_PER_CHUNK; i++) {
+      int n = c * ARENA_PER_CHUNK + i;
+      arena->deallocate(blocks[n]);
+      blocks[n] = NULL;
+    }
+  }
+  VS(arena->getSparseBytes(), 0);
+  VERIFY(!arena->needsCompaction());
+  VERIFY(arena->relocate(blocks[0]) == NULL);
+
+  // down to 4 blocks each, both are sparse
+  for (int c = 0; c < 2; c++) {
+    for (int i = 4; i < 6; i++) {
+      int n = c * ARENA_PER_CHUNK + i;
+      arena->deallocate(blocks[n]);
+      blocks[n] = NULL;
+    }
+  }
+  VS(arena->getSparseBytes(), 2 * ARENA_CHUNK);
+  VERIFY(arena->needsCompaction());
+
+  // moving their blocks out gives both chunks back; D fills up on the way
+  // and E takes over
+  for (int c = 0; c < 2; c++) {
+    for (int i = 0; i < 4; i++) {
+      int n = c * ARENA_PER_CHUNK + i;
+      void *p = arena->relocate(blocks[n]);
+      VERIFY(p != NULL);
+      VERIFY(block_intact(p, n));
+      blocks[n] = p;
+    }
+  }
+  VS(arena->getSparseBytes(), 0);
+  VS(arena->getChunkCount(), 3);
+  VERIFY(arena->relocate(blocks[ARENA_PER_CHUNK * 2]) == NULL);
+  arena->compacted();
+  VERIFY(!arena->needsCompaction());
+
+  // C and D sparse again, but a pass that could not move anything does not
+  // make the next one come any sooner
+  for (int c = 2; c < 4; c++) {
+    for (int i = 2; i < ARENA_PER_CHUNK; i++) {
+      int n = c * ARENA_PER_CHUNK + i;
+      arena->deallocate(blocks[n]);
+      blocks[n] = NULL;
+    }
+  }
+  VS(arena->getSparseBytes(), 2 * ARENA_CHUNK);
+  VERIFY(arena->needsCompaction());
+  arena->compacted();
+  VERIFY(!arena->needsCompaction());
+  for (int c = 2; c < 4; c++) {
+    int n = c * ARENA_PER_CHUNK + 1;
+    arena->deallocate(blocks[n]);
+    blocks[n] = NULL;
+  }
+  VERIFY(!arena->needsCompaction());
+
+  // big blocks have a chunk of their own, given back with them
+  int chunks = arena->getChunkCount();
+  void *big = arena->allocate(ARENA_CHUNK);
+  VS(arena->getChunkCount(), chunks + 1);
+  arena->deallocate(big);
+  VS(arena->getChunkCount(), chunks);
+
+  for (unsigned int i = 0; i < blocks.size(); i++) {
+    if (blocks[i]) {
+      VERIFY(block_intact(blocks[i], i));
+      arena->deallocate(blocks[i]);
+    }
+  }
+  VS(arena->getLiveBytes(), 0);
+  VS(arena->getChunkCount(), 1); // the current one stays
+  return Count(true);
+}
+
+bool TestUtil::TestProcessSharing() {
+  VERIFY(Process::GetThreadCount(getpid()) >= 1);
+  VS(Process::GetThreadCount(-1), 0);
+
+  // what a child has not written to since fork() it shares with us, and
+  // what it has written to it has to itself
+  const int size = 16 << 20;
+  char *buf = (char *)malloc(size);
+  memset(buf, 1, size);
+  pid_t pid = fork();
+  if (pid == 0) {
+    long long shared[2], priv[2];
+    bool ok = Process::GetProcessSharing(getpid(), shared[0], priv[0]);
+    memset(buf, 2, size);
+    ok = Process::GetProcessSharing(getpid(), shared[1], priv[1]) && ok;
+    _exit(ok && shared[0] >= size / 1024 &&
+          priv[1] - priv[0] >= size / 1024 ? 0 : 1);
+  }
+  int status = -1;
+  if (pid > 0) waitpid(pid, &status, 0);
+  free(buf);
+  VERIFY(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  long long shared, priv;
+  VERIFY(!Process::GetProcessSharing(-1, shared, priv));
+  return Count(true);
+}
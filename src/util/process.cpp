@@ -403,31 +403,80 @@ bool Process::IsUnderGDB() {
   return CommandStartsWith(GetParentProcessId(), "gdb ");
 }
 
-int Process::GetProcessRSS(pid_t pid) {
+/**
+ * Reads /proc/<pid>/<file> line by line, false if there is no such file.
+ */
+static bool read_proc_lines(pid_t pid, const char *file,
+                            vector<string> &lines) {
   string name = "/proc/" + boost::lexical_cast<string>((long long)pid) +
-    "/status";
+    "/" + file;
 
-  string status;
+  string content;
   FILE * f = fopen(name.c_str(), "r");
-  if (f) {
-    FileReader::readString(f, status);
-    fclose(f);
+  if (!f) return false;
+  FileReader::readString(f, content);
+  fclose(f);
+
+  Util::split('\n', content.c_str(), lines, true);
+  return true;
+}
+
+/**
+ * Number after "label" at the start of a line like "VmRSS:   1024 kB".
+ */
+static bool read_proc_field(const string &line, const char *label,
+                            long long &value) {
+  if (line.find(label) != 0) return false;
+  value = atoll(line.c_str() + strlen(label));
+  return true;
+}
+
+int Process::GetProcessRSS(pid_t pid) {
+  vector<string> lines;
+  read_proc_lines(pid, "status", lines);
+  for (unsigned int i = 0; i < lines.size(); i++) {
+    long long mem;
+    if (read_proc_field(lines[i], "VmRSS:", mem)) {
+      return mem/1024;
+    }
   }
 
+  return 0;
+}
+
+bool Process::GetProcessSharing(pid_t pid, long long &sharedKB,
+                                long long &privateKB) {
+  sharedKB = privateKB = 0;
   vector<string> lines;
-  Util::split('\n', status.c_str(), lines, true);
+  if (!read_proc_lines(pid, "smaps", lines)) {
+    return false;
+  }
+  // a page counts as shared for as long as another process maps it too,
+  // be it a file or an anonymous page neither side has written to since
+  // fork()
   for (unsigned int i = 0; i < lines.size(); i++) {
-    string &line = lines[i];
-    if (line.find("VmRSS:") == 0) {
-      for (unsigned int j = strlen("VmRSS:"); j < line.size(); j++) {
-        if (line[j] != ' ') {
-          long long mem = atoll(line.c_str() + j);
-          return mem/1024;
-        }
-      }
+    const string &line = lines[i];
+    long long kb;
+    if (read_proc_field(line, "Shared_Clean:", kb) ||
+        read_proc_field(line, "Shared_Dirty:", kb)) {
+      sharedKB += kb;
+    } else if (read_proc_field(line, "Private_Clean:", kb) ||
+               read_proc_field(line, "Private_Dirty:", kb)) {
+      privateKB += kb;
     }
   }
+  return true;
+}
 
+int Process::GetThreadCount(pid_t pid) {
+  vector<string> lines;
+  read_proc_lines(pid, "status", lines);
+  for (unsigned int i = 0; i < lines.size(); i++) {
+    long long count;
+    if (read_proc_field(lines[i], "Threads:", count)) {
+      return count;
+    }
+  }
   return 0;
 }
 
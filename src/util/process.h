@@ -108,6 +108,20 @@ public:
    */
   static int GetProcessRSS(pid_t pid);
 
+  /**
+   * Get resident memory in KB that a process shares with others, such as
+   * pages it still has copy-on-write from its parent, and that it has to
+   * itself. Returns false if there is no such process.
+   */
+  static bool GetProcessSharing(pid_t pid, long long &sharedKB,
+                                long long &privateKB);
+
+  /**
+   * Get number of threads a process is running, 0 if there is no such
+   * process.
+   */
+  static int GetThreadCount(pid_t pid);
+
   /**
    * Current thread's identifier.
    */
@@ -0,0 +1,169 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "shared_memory_arena.h"
+#include "exception.h"
+
+using namespace boost::interprocess;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint32 align_block(size_t size) {
+  return (size + 7) & ~(size_t)7;
+}
+
+SharedMemoryArena *SharedMemoryArena::OpenOrCreate(const char *name,
+                                                   int chunkSize) {
+  ASSERT(name && *name);
+  return SharedMemoryManager::GetSegment()->find_or_construct
+    <SharedMemoryArena>(name)(chunkSize);
+}
+
+SharedMemoryArena::SharedMemoryArena(int chunkSize)
+  : m_chunks(NULL), m_current(NULL), m_chunkCount(0), m_chunkBytes(0),
+    m_usedBytes(0), m_liveBytes(0), m_sparseBytes(0), m_freedBytes(0),
+    m_compactedBytes(0) {
+  ASSERT(chunkSize > 0);
+  m_chunkSize = align_block(chunkSize);
+}
+
+SharedMemoryArena::Chunk *SharedMemoryArena::newChunk(uint32 size) {
+  void *p;
+  try {
+    p = SharedMemoryManager::GetSegment()->allocate(sizeof(Chunk) + size);
+  } catch (std::exception &e) {
+    throw Exception(e.what()); // so we have stacktrace
+  }
+  Chunk *chunk = (Chunk*)p;
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->live = 0;
+  chunk->sparse = false;
+  chunk->prev = NULL;
+  chunk->next = m_chunks;
+  if (m_chunks) m_chunks->prev = chunk;
+  m_chunks = chunk;
+  m_chunkCount++;
+  m_chunkBytes += size;
+  return chunk;
+}
+
+void SharedMemoryArena::freeChunk(Chunk *chunk) {
+  ASSERT(chunk->live == 0);
+  ASSERT(chunk != m_current.get());
+  if (chunk->sparse) m_sparseBytes -= chunk->size;
+  if (chunk->prev) {
+    chunk->prev->next = chunk->next;
+  } else {
+    m_chunks = chunk->next;
+  }
+  if (chunk->next) chunk->next->prev = chunk->prev;
+  m_chunkCount--;
+  m_chunkBytes -= chunk->size;
+  m_usedBytes -= chunk->used;
+  SharedMemoryManager::GetSegment()->deallocate(chunk);
+}
+
+void *SharedMemoryArena::allocateLocked(uint32 size) {
+  uint32 total = align_block(sizeof(BlockHeader) + size);
+  Chunk *chunk = m_current.get();
+  if (total > m_chunkSize / 2) {
+    // big blocks get a chunk of their own, so they don't waste the tail of
+    // the current one
+    chunk = newChunk(total);
+  } else if (chunk == NULL || chunk->used + total > chunk->size) {
+    Chunk *retired = chunk;
+    m_current = chunk = newChunk(m_chunkSize);
+    if (retired) {
+      if (retired->live == 0) {
+        freeChunk(retired);
+      } else {
+        updateSparse(retired);
+      }
+    }
+  }
+  BlockHeader *header = (BlockHeader*)((char*)(chunk + 1) + chunk->used);
+  header->size = total;
+  header->chunkOffset = (char*)header - (char*)chunk;
+  chunk->used += total;
+  chunk->live += total;
+  m_usedBytes += total;
+  m_liveBytes += total;
+  return header + 1;
+}
+
+void SharedMemoryArena::deallocateLocked(BlockHeader *header) {
+  Chunk *chunk = GetChunk(header);
+  ASSERT(chunk->live >= header->size);
+  chunk->live -= header->size;
+  m_liveBytes -= header->size;
+  m_freedBytes += header->size;
+  if (chunk->live == 0 && chunk != m_current.get()) {
+    freeChunk(chunk);
+  } else {
+    updateSparse(chunk);
+  }
+}
+
+void *SharedMemoryArena::allocate(size_t size) {
+  scoped_lock<interprocess_mutex> lock(m_mutex);
+  return allocateLocked(size);
+}
+
+void SharedMemoryArena::deallocate(void *p) {
+  if (p == NULL) return;
+  scoped_lock<interprocess_mutex> lock(m_mutex);
+  deallocateLocked(GetHeader(p));
+}
+
+bool SharedMemoryArena::isSparse(const Chunk *chunk) const {
+  // less than a quarter of what was handed out is still alive
+  return chunk != m_current.get() && chunk->live * 4 < chunk->used;
+}
+
+void SharedMemoryArena::updateSparse(Chunk *chunk) {
+  bool sparse = isSparse(chunk);
+  if (sparse != chunk->sparse) {
+    chunk->sparse = sparse;
+    m_sparseBytes += sparse ? chunk->size : -(int64)chunk->size;
+  }
+}
+
+void *SharedMemoryArena::relocate(void *p) {
+  ASSERT(p);
+  scoped_lock<interprocess_mutex> lock(m_mutex);
+  BlockHeader *header = GetHeader(p);
+  if (!isSparse(GetChunk(header))) return NULL;
+  uint32 size = header->size - sizeof(BlockHeader);
+  void *ret = allocateLocked(size);
+  memcpy(ret, p, size);
+  deallocateLocked(header);
+  return ret;
+}
+
+bool SharedMemoryArena::needsCompaction() const {
+  return m_sparseBytes > (int64)m_chunkSize &&
+    m_freedBytes - m_compactedBytes >= (int64)m_chunkSize;
+}
+
+void SharedMemoryArena::compacted() {
+  scoped_lock<interprocess_mutex> lock(m_mutex);
+  m_compactedBytes = m_freedBytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
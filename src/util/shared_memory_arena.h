@@ -0,0 +1,119 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __MEMORY_SHARED_MEMORY_ARENA_H__
+#define __MEMORY_SHARED_MEMORY_ARENA_H__
+
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include "shared_memory_allocator.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Bump allocator on top of SharedMemoryManager's segment.
+ *
+ * Blocks are carved back to back out of fixed-size chunks, so storing a big
+ * value costs one segment allocation per chunk instead of one per node. Freed
+ * space is only accounted for: a chunk is handed back to the segment when the
+ * last block in it goes away. Owners of position-independent blocks (only
+ * self-relative offsets inside) can compact by moving blocks that sit in
+ * sparse chunks to the current chunk with relocate(). A chunk is sparse once
+ * less than a quarter of what it handed out is still alive, and the arena
+ * keeps count of how much room sparse chunks take up.
+ *
+ * The arena itself lives in shared memory and is looked up by name, so every
+ * attached process allocates from the same chunks.
+ */
+class SharedMemoryArena {
+public:
+  static SharedMemoryArena *OpenOrCreate(const char *name, int chunkSize);
+
+  SharedMemoryArena(int chunkSize);
+
+  void *allocate(size_t size);
+  void deallocate(void *p);
+
+  /**
+   * Moves a block out of a sparse chunk. Returns the new address, or NULL if
+   * the block is fine where it is. Caller has to be the sole owner of p.
+   */
+  void *relocate(void *p);
+
+  /**
+   * Whether sparse chunks take up more than a chunk, and at least a chunk's
+   * worth of blocks was freed since the last compacted(), so that a pass of
+   * relocate() calls can give chunks back. Blocks that were busy during the
+   * last pass only get another chance once things have moved on.
+   */
+  bool needsCompaction() const;
+  void compacted();
+
+  /**
+   * Room taken up by sparse chunks, 0 once there is nothing left to move.
+   */
+  int64 getSparseBytes() const { return m_sparseBytes;}
+
+  int64 getChunkBytes() const { return m_chunkBytes;}
+  int64 getUsedBytes() const { return m_usedBytes;}
+  int64 getLiveBytes() const { return m_liveBytes;}
+  int getChunkCount() const { return m_chunkCount;}
+
+private:
+  struct Chunk {
+    boost::interprocess::offset_ptr<Chunk> prev;
+    boost::interprocess::offset_ptr<Chunk> next;
+    uint32 size; // usable bytes after this header
+    uint32 used;
+    uint32 live;
+    bool sparse; // counted in m_sparseBytes
+  };
+  struct BlockHeader {
+    uint32 size;
+    uint32 chunkOffset; // distance back to owning Chunk
+  };
+
+  boost::interprocess::interprocess_mutex m_mutex;
+  boost::interprocess::offset_ptr<Chunk> m_chunks;
+  boost::interprocess::offset_ptr<Chunk> m_current;
+  uint32 m_chunkSize;
+  int m_chunkCount;
+  int64 m_chunkBytes;
+  int64 m_usedBytes;
+  int64 m_liveBytes;
+  int64 m_sparseBytes;
+  int64 m_freedBytes;     // ever deallocated
+  int64 m_compactedBytes; // m_freedBytes at the last compacted()
+
+  Chunk *newChunk(uint32 size);
+  void freeChunk(Chunk *chunk);
+  void *allocateLocked(uint32 size);
+  void deallocateLocked(BlockHeader *header);
+  bool isSparse(const Chunk *chunk) const;
+  void updateSparse(Chunk *chunk);
+
+  static BlockHeader *GetHeader(void *p) {
+    return (BlockHeader*)p - 1;
+  }
+  static Chunk *GetChunk(BlockHeader *header) {
+    return (Chunk*)((char*)header - header->chunkOffset);
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __MEMORY_SHARED_MEMORY_ARENA_H__
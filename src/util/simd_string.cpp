@@ -0,0 +1,401 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "simd_string.h"
+#include "base.h"
+
+#include <ctype.h>
+
+#if defined(__x86_64__) || defined(__SSE2__)
+#define HAVE_SSE2 1
+#include <emmintrin.h>
+#include <cpuid.h>
+// SSE4.2 code is compiled per function, so the rest of the binary still runs
+// on CPUs without it; that needs the target attribute from gcc 4.9 on
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define HAVE_SSE42 1
+#include <nmmintrin.h>
+#define SSE42_FUNCTION __attribute__((__target__("sse4.2")))
+#endif
+#endif
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+static SimdLevel detect_simd_level() {
+#ifdef HAVE_SSE42
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2)) {
+    return SimdSSE42;
+  }
+#endif
+#ifdef HAVE_SSE2
+  return SimdSSE2;
+#else
+  return SimdNone;
+#endif
+}
+
+static const SimdLevel s_supported = detect_simd_level();
+static SimdLevel s_level = s_supported;
+
+SimdLevel simd_get_level() {
+  return s_level;
+}
+
+SimdLevel simd_set_level(SimdLevel level) {
+  s_level = level < s_supported ? level : s_supported;
+  return s_level;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// plain loops, also used for the tails that don't fill a 16-byte block
+
+static inline bool in_set(char c, const char *set, int set_len) {
+  for (int i = 0; i < set_len; i++) {
+    if (set[i] == c) return true;
+  }
+  return false;
+}
+
+static inline bool in_ranges(unsigned char c, const char *ranges, int count) {
+  for (int i = 0; i < count; i++) {
+    if (c >= (unsigned char)ranges[i * 2] &&
+        c <= (unsigned char)ranges[i * 2 + 1]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static const char *memmem_scalar(const char *haystack, int len,
+                                 const char *needle, int needle_len) {
+  const char *p = haystack;
+  const char *end = haystack + len - needle_len;
+  char ne = needle[needle_len - 1];
+  while (p <= end) {
+    p = (const char *)memchr(p, *needle, end - p + 1);
+    if (p == NULL) return NULL;
+    if (p[needle_len - 1] == ne && !memcmp(p, needle, needle_len - 1)) {
+      return p;
+    }
+    p++;
+  }
+  return NULL;
+}
+
+static void fold_scalar(char *dst, const char *src, int len, bool lower) {
+  if (lower) {
+    for (int i = 0; i < len; i++) dst[i] = tolower(src[i]);
+  } else {
+    for (int i = 0; i < len; i++) dst[i] = toupper(src[i]);
+  }
+}
+
+static int find_scalar(const char *s, int len, const char *set, int set_len,
+                       bool member) {
+  for (int i = 0; i < len; i++) {
+    if (in_set(s[i], set, set_len) == member) return i;
+  }
+  return len;
+}
+
+static int rspan_scalar(const char *s, int len, const char *set,
+                        int set_len) {
+  int i = len;
+  while (i > 0 && in_set(s[i - 1], set, set_len)) i--;
+  return len - i;
+}
+
+static int scan_outside_scalar(const char *s, int len, const char *ranges,
+                               int count) {
+  for (int i = 0; i < len; i++) {
+    if (!in_ranges(s[i], ranges, count)) return i;
+  }
+  return len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE2
+
+#ifdef HAVE_SSE2
+
+#define LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+
+static const char *memmem_sse2(const char *haystack, int len,
+                               const char *needle, int needle_len) {
+  // candidates have to match both the first and the last byte of needle;
+  // only those get a memcmp
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+  int i = 0;
+  for (; i + needle_len - 1 + 16 <= len; i += 16) {
+    __m128i a = _mm_cmpeq_epi8(LOAD(haystack + i), first);
+    __m128i b = _mm_cmpeq_epi8(LOAD(haystack + i + needle_len - 1), last);
+    unsigned int mask = _mm_movemask_epi8(_mm_and_si128(a, b));
+    while (mask) {
+      const char *p = haystack + i + __builtin_ctz(mask);
+      if (!memcmp(p + 1, needle + 1, needle_len - 2)) return p;
+      mask &= mask - 1;
+    }
+  }
+  return memmem_scalar(haystack + i, len - i, needle, needle_len);
+}
+
+static void fold_sse2(char *dst, const char *src, int len, bool lower) {
+  const __m128i below = _mm_set1_epi8(lower ? 'A' - 1 : 'a' - 1);
+  const __m128i above = _mm_set1_epi8(lower ? 'Z' + 1 : 'z' + 1);
+  const __m128i flip = _mm_set1_epi8(0x20);
+  int i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = LOAD(src + i);
+    if (_mm_movemask_epi8(x)) {
+      // bytes above 0x7f are up to the locale
+      fold_scalar(dst + i, src + i, 16, lower);
+      continue;
+    }
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(x, below),
+                                    _mm_cmplt_epi8(x, above));
+    x = _mm_xor_si128(x, _mm_and_si128(letters, flip));
+    _mm_storeu_si128((__m128i *)(dst + i), x);
+  }
+  fold_scalar(dst + i, src + i, len - i, lower);
+}
+
+static inline unsigned int match_set_sse2(__m128i x, const __m128i *setv,
+                                          int set_len) {
+  __m128i m = _mm_cmpeq_epi8(x, setv[0]);
+  for (int j = 1; j < set_len; j++) {
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(x, setv[j]));
+  }
+  return _mm_movemask_epi8(m);
+}
+
+static int find_sse2(const char *s, int len, const char *set, int set_len,
+                     bool member) {
+  __m128i setv[16];
+  for (int j = 0; j < set_len; j++) setv[j] = _mm_set1_epi8(set[j]);
+  unsigned int flip = member ? 0 : 0xffff;
+  int i = 0;
+  for (; i + 16 <= len; i += 16) {
+    unsigned int mask = match_set_sse2(LOAD(s + i), setv, set_len) ^ flip;
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  return i + find_scalar(s + i, len - i, set, set_len, member);
+}
+
+static int rspan_sse2(const char *s, int len, const char *set, int set_len) {
+  __m128i setv[16];
+  for (int j = 0; j < set_len; j++) setv[j] = _mm_set1_epi8(set[j]);
+  int e = len;
+  for (; e >= 16; e -= 16) {
+    unsigned int mask =
+      match_set_sse2(LOAD(s + e - 16), setv, set_len) ^ 0xffff;
+    if (mask) return len - (e - 16 + 32 - __builtin_clz(mask));
+  }
+  return len - e + rspan_scalar(s, e, set, set_len);
+}
+
+static int scan_outside_sse2(const char *s, int len, const char *ranges,
+                             int count) {
+  // (c - lo) as an unsigned byte is at most (hi - lo) exactly when c is in
+  // [lo, hi]; saturating subtraction turns that into a compare with zero
+  __m128i lo[8], width[8];
+  for (int j = 0; j < count; j++) {
+    lo[j] = _mm_set1_epi8(ranges[j * 2]);
+    width[j] = _mm_set1_epi8(ranges[j * 2 + 1] - ranges[j * 2]);
+  }
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = LOAD(s + i);
+    __m128i in = zero;
+    for (int j = 0; j < count; j++) {
+      __m128i d = _mm_subs_epu8(_mm_sub_epi8(x, lo[j]), width[j]);
+      in = _mm_or_si128(in, _mm_cmpeq_epi8(d, zero));
+    }
+    unsigned int mask = _mm_movemask_epi8(in) ^ 0xffff;
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  return i + scan_outside_scalar(s + i, len - i, ranges, count);
+}
+
+#endif // HAVE_SSE2
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE4.2: pcmpestri does the set and range matching in one instruction
+
+#ifdef HAVE_SSE42
+
+static inline __m128i load_set(const char *set, int set_len) {
+  char buf[16] __attribute__((__aligned__(16)));
+  memset(buf, 0, sizeof(buf));
+  memcpy(buf, set, set_len);
+  return _mm_load_si128((const __m128i *)buf);
+}
+
+#define ANY_FIRST (_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | \
+                   _SIDD_LEAST_SIGNIFICANT)
+#define NONE_FIRST (ANY_FIRST | _SIDD_NEGATIVE_POLARITY)
+#define NONE_LAST (_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | \
+                   _SIDD_MOST_SIGNIFICANT | _SIDD_NEGATIVE_POLARITY)
+#define OUTSIDE_FIRST (_SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | \
+                       _SIDD_LEAST_SIGNIFICANT | _SIDD_NEGATIVE_POLARITY)
+
+SSE42_FUNCTION
+static int find_sse42(const char *s, int len, const char *set, int set_len,
+                      bool member) {
+  const __m128i setv = load_set(set, set_len);
+  int i = 0;
+  if (member) {
+    for (; i + 16 <= len; i += 16) {
+      int k = _mm_cmpestri(setv, set_len, LOAD(s + i), 16, ANY_FIRST);
+      if (k < 16) return i + k;
+    }
+  } else {
+    for (; i + 16 <= len; i += 16) {
+      int k = _mm_cmpestri(setv, set_len, LOAD(s + i), 16, NONE_FIRST);
+      if (k < 16) return i + k;
+    }
+  }
+  return i + find_scalar(s + i, len - i, set, set_len, member);
+}
+
+SSE42_FUNCTION
+static int rspan_sse42(const char *s, int len, const char *set, int set_len) {
+  const __m128i setv = load_set(set, set_len);
+  int e = len;
+  for (; e >= 16; e -= 16) {
+    int k = _mm_cmpestri(setv, set_len, LOAD(s + e - 16), 16, NONE_LAST);
+    if (k < 16) return len - (e - 16 + k + 1);
+  }
+  return len - e + rspan_scalar(s, e, set, set_len);
+}
+
+SSE42_FUNCTION
+static int scan_outside_sse42(const char *s, int len, const char *ranges,
+                              int count) {
+  const __m128i rangev = load_set(ranges, count * 2);
+  int i = 0;
+  for (; i + 16 <= len; i += 16) {
+    int k = _mm_cmpestri(rangev, count * 2, LOAD(s + i), 16, OUTSIDE_FIRST);
+    if (k < 16) return i + k;
+  }
+  return i + scan_outside_scalar(s + i, len - i, ranges, count);
+}
+
+#endif // HAVE_SSE42
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char *simd_memmem(const char *haystack, int len,
+                        const char *needle, int needle_len) {
+  ASSERT(haystack && needle);
+  if (needle_len <= 0) return haystack;
+  if (needle_len > len) return NULL;
+  if (needle_len == 1) {
+    // glibc's memchr is already vectorized
+    return (const char *)memchr(haystack, *needle, len);
+  }
+#ifdef HAVE_SSE2
+  if (s_level >= SimdSSE2) {
+    return memmem_sse2(haystack, len, needle, needle_len);
+  }
+#endif
+  return memmem_scalar(haystack, len, needle, needle_len);
+}
+
+void simd_to_lower(char *dst, const char *src, int len) {
+#ifdef HAVE_SSE2
+  if (s_level >= SimdSSE2) {
+    fold_sse2(dst, src, len, true);
+    return;
+  }
+#endif
+  fold_scalar(dst, src, len, true);
+}
+
+void simd_to_upper(char *dst, const char *src, int len) {
+#ifdef HAVE_SSE2
+  if (s_level >= SimdSSE2) {
+    fold_sse2(dst, src, len, false);
+    return;
+  }
+#endif
+  fold_scalar(dst, src, len, false);
+}
+
+static int find_in_set(const char *s, int len, const char *set, int set_len,
+                       bool member) {
+  ASSERT(set_len >= 0 && set_len <= 16);
+#ifdef HAVE_SSE42
+  if (s_level >= SimdSSE42) {
+    return find_sse42(s, len, set, set_len, member);
+  }
+#endif
+#ifdef HAVE_SSE2
+  if (s_level >= SimdSSE2) {
+    return find_sse2(s, len, set, set_len, member);
+  }
+#endif
+  return find_scalar(s, len, set, set_len, member);
+}
+
+int simd_scan_any(const char *s, int len, const char *set, int set_len) {
+  if (set_len == 0) return len;
+  return find_in_set(s, len, set, set_len, true);
+}
+
+int simd_span(const char *s, int len, const char *set, int set_len) {
+  if (set_len == 0) return 0;
+  return find_in_set(s, len, set, set_len, false);
+}
+
+int simd_rspan(const char *s, int len, const char *set, int set_len) {
+  ASSERT(set_len >= 0 && set_len <= 16);
+  if (set_len == 0) return 0;
+#ifdef HAVE_SSE42
+  if (s_level >= SimdSSE42) {
+    return rspan_sse42(s, len, set, set_len);
+  }
+#endif
+#ifdef HAVE_SSE2
+  if (s_level >= SimdSSE2) {
+    return rspan_sse2(s, len, set, set_len);
+  }
+#endif
+  return rspan_scalar(s, len, set, set_len);
+}
+
+int simd_scan_outside(const char *s, int len, const char *ranges,
+                      int range_count) {
+  ASSERT(range_count >= 0 && range_count <= 8);
+  if (range_count == 0) return 0;
+#ifdef HAVE_SSE42
+  if (s_level >= SimdSSE42) {
+    return scan_outside_sse42(s, len, ranges, range_count);
+  }
+#endif
+#ifdef HAVE_SSE2
+  if (s_level >= SimdSSE2) {
+    return scan_outside_sse2(s, len, ranges, range_count);
+  }
+#endif
+  return scan_outside_scalar(s, len, ranges, range_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
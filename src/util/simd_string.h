@@ -0,0 +1,79 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_SIMD_STRING_H__
+#define __HPHP_SIMD_STRING_H__
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Byte scanning kernels shared by string builtins. Each one has an SSE2
+ * version, an SSE4.2 version where the string instructions help, and a plain
+ * loop for everything else. Which one runs is decided once at startup from
+ * cpuid, and can be lowered with simd_set_level() to compare them.
+ */
+enum SimdLevel {
+  SimdNone,
+  SimdSSE2,
+  SimdSSE42,
+};
+
+SimdLevel simd_get_level();
+
+/**
+ * Capped at what this CPU supports. Returns the level actually in effect.
+ */
+SimdLevel simd_set_level(SimdLevel level);
+
+/**
+ * First occurrence of needle in haystack, or NULL.
+ */
+const char *simd_memmem(const char *haystack, int len,
+                        const char *needle, int needle_len);
+
+/**
+ * ASCII case folding from src into dst, which may be the same buffer. Bytes
+ * above 0x7f go through tolower()/toupper(), so single-byte locales still
+ * get what they expect.
+ */
+void simd_to_lower(char *dst, const char *src, int len);
+void simd_to_upper(char *dst, const char *src, int len);
+
+/**
+ * Index of the first byte that is one of set[0..set_len), or len if there is
+ * none. set_len is at most 16.
+ */
+int simd_scan_any(const char *s, int len, const char *set, int set_len);
+
+/**
+ * Length of the leading (simd_span) or trailing (simd_rspan) run of bytes
+ * that are all in set[0..set_len). set_len is at most 16.
+ */
+int simd_span(const char *s, int len, const char *set, int set_len);
+int simd_rspan(const char *s, int len, const char *set, int set_len);
+
+/**
+ * Index of the first byte outside all the inclusive ranges given as pairs,
+ * e.g. "09AZaz", or len if there is none. At most 8 ranges.
+ */
+int simd_scan_outside(const char *s, int len, const char *ranges,
+                      int range_count);
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_SIMD_STRING_H__
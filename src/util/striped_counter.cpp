@@ -0,0 +1,34 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "striped_counter.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+static int s_nextSlot = 0;
+static __thread int t_slot = -1;
+
+int StripedCounter::GetSlot() {
+  int slot = t_slot;
+  if (slot < 0) {
+    slot = t_slot = (atomic_inc(s_nextSlot) - 1) % Slots;
+  }
+  return slot;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,64 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __STRIPED_COUNTER_H__
+#define __STRIPED_COUNTER_H__
+
+#include "base.h"
+#include "atomic.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Statistics counter that many threads bump without fighting over one cache
+ * line. Each thread adds to its own slot, one of Slots padded ones picked
+ * the first time the thread counts anything, and get() sums them up. Only
+ * threads beyond the first Slots ever share a slot, and even then counts are
+ * exact, since slots are added to atomically.
+ *
+ * Meant for globals: it has no constructor, and relies on static storage
+ * being zeroed, so it can be bumped during static initialization.
+ */
+class StripedCounter {
+public:
+  static const int Slots = 64;
+
+  void add(int64 n) { atomic_add(m_slots[GetSlot()].value, n);}
+  void inc() { add(1);}
+
+  int64 get() const {
+    int64 total = 0;
+    for (int i = 0; i < Slots; i++) {
+      total += *(volatile int64 *)&m_slots[i].value;
+    }
+    return total;
+  }
+
+private:
+  struct Slot {
+    int64 value;
+    char padding[64 - sizeof(int64)];
+  };
+  Slot m_slots[Slots];
+
+  static int GetSlot();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __STRIPED_COUNTER_H__
@@ -84,6 +84,18 @@ std::string Util::toUpper(const std::string &s) {
   return ret;
 }
 
+void Util::appendXmlElement(std::string &out, int indent, const char *name,
+                            long long value) {
+  for (int i = 0; i < indent; i++) {
+    out += "  ";
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%lld", value);
+  out += "<"; out += name; out += ">";
+  out += buf;
+  out += "</"; out += name; out += ">\n";
+}
+
 std::string Util::getIdentifier(const std::string &fileName) {
   string ret = "hphp_" + fileName;
   replaceAll(ret, "/", "__");
@@ -49,6 +49,13 @@ std::string toLower(const std::string &s);
  */
 std::string toUpper(const std::string &s);
 
+/**
+ * Append "<name>value</name>" on a line of its own, indented by indent
+ * levels, the way stats reported by the admin server are formatted.
+ */
+void appendXmlElement(std::string &out, int indent, const char *name,
+                      long long value);
+
 /**
  * Convert a full pathname of a file to an identifier.
  */